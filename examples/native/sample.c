@@ -0,0 +1,49 @@
+/*
+    Sample native extension module for SharpScript
+
+    Build (Linux):  gcc -shared -fPIC -Isrc examples/native/sample.c -o libsample.so
+    Build (macOS):  clang -shared -fPIC -undefined dynamic_lookup -Isrc examples/native/sample.c -o libsample.so
+
+    Use from a script:
+        #involve native "libsample.so"
+        system.output(sample.sum([1, 2, 3]));
+*/
+
+#include "builtins/native.h"
+
+static Value *sample_sum(Interpreter *interp, Value **args, int arg_count)
+{
+    (void)interp;
+    (void)arg_count;
+    double total = 0.0;
+    if (args[0]->type == VAL_ARRAY)
+    {
+        for (int i = 0; i < args[0]->data.array.count; i++)
+        {
+            Value *elem = args[0]->data.array.elements[i];
+            total += value_as_number(elem);
+        }
+    }
+    return value_create_number(total);
+}
+
+static Value *sample_hypot(Interpreter *interp, Value **args, int arg_count)
+{
+    (void)interp;
+    (void)arg_count;
+    double a = value_as_number(args[0]);
+    double b = value_as_number(args[1]);
+    double sq = a * a + b * b;
+    // Newton iteration keeps the sample free of a libm dependency
+    double r = sq > 1.0 ? sq : 1.0;
+    for (int i = 0; i < 64; i++)
+        r = 0.5 * (r + sq / r);
+    return value_create_number(sq == 0.0 ? 0.0 : r);
+}
+
+int sharpscript_module_init(NativeRegisterFunction register_fn)
+{
+    register_fn("sample.sum", sample_sum, 1);
+    register_fn("sample.hypot", sample_hypot, 2);
+    return 0;
+}
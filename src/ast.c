@@ -22,6 +22,42 @@ ASTNode *ast_create_number(double value)
     ASTNode *node = memory_allocate(sizeof(ASTNode));
     node->type = AST_NUMBER;
     node->data.number.value = value;
+    node->data.number.integer = 0;
+    node->data.number.is_integer = 0;
+    node->data.number.text = NULL;
+    node->data.number.is_decimal = 0;
+    return node;
+}
+
+/*
+ * ast_create_integer: Create an AST node for an integer literal
+ * 
+ * Integer literals are AST_NUMBER nodes flagged with is_integer; value holds
+ * the nearest double so code that only reads value keeps working.
+ * 
+ * Returns: Pointer to the newly created AST node
+ */
+ASTNode *ast_create_integer(long long value)
+{
+    ASTNode *node = ast_create_number((double)value);
+    node->data.number.integer = value;
+    node->data.number.is_integer = 1;
+    return node;
+}
+
+/*
+ * ast_create_bignum: Create an AST node for a big integer or decimal literal
+ * 
+ * The digits are kept as text and converted exactly when evaluated; value
+ * holds the nearest double.
+ * 
+ * Returns: Pointer to the newly created AST node
+ */
+ASTNode *ast_create_bignum(const char *text, int is_decimal)
+{
+    ASTNode *node = ast_create_number(atof(text));
+    node->data.number.text = memory_strdup(text);
+    node->data.number.is_decimal = is_decimal;
     return node;
 }
 
@@ -283,6 +319,8 @@ ASTNode *ast_create_call(const char *name, ASTNode **args, int arg_count)
     node->data.call.name = memory_strdup(name);
     node->data.call.args = args;
     node->data.call.arg_count = arg_count;
+    node->data.call.native = NULL;
+    node->data.call.native_generation = 0;
     return node;
 }
 
@@ -601,6 +639,46 @@ ASTNode *ast_create_for_in(const char *var, ASTNode *collection, ASTNode *body)
     return node;
 }
 
+/*
+ * ast_create_include: Create a placeholder node for a pending include
+ * 
+ * Used while included files are parsed in parallel. The parser replaces the
+ * node in place with the included file's tree (or a null node) before the
+ * program is evaluated.
+ * 
+ * Parameters:
+ *   path: The resolved path of the included file (will be copied)
+ * 
+ * Returns: Pointer to the newly created AST node
+ */
+ASTNode *ast_create_include(const char *path)
+{
+    ASTNode *node = memory_allocate(sizeof(ASTNode));
+    node->type = AST_INCLUDE;
+    node->data.include.path = memory_strdup(path);
+    return node;
+}
+
+/*
+ * ast_create_symbol: Create an AST node for a :name symbol literal
+ * 
+ * The name is interned by the interpreter the first time the node is
+ * evaluated, so the parser does not depend on the symbol table.
+ * 
+ * Parameters:
+ *   name: The symbol's name without the colon (will be copied)
+ * 
+ * Returns: Pointer to the newly created AST node
+ */
+ASTNode *ast_create_symbol(const char *name)
+{
+    ASTNode *node = memory_allocate(sizeof(ASTNode));
+    node->type = AST_SYMBOL;
+    node->data.symbol.name = memory_strdup(name);
+    node->data.symbol.interned = NULL;
+    return node;
+}
+
 /*
  * ast_free: Free an AST node and all its children
  * 
@@ -628,6 +706,9 @@ void ast_free(ASTNode *node)
 
     switch (node->type)
     {
+    case AST_NUMBER:
+        memory_free(node->data.number.text);
+        break;
     case AST_STRING:
         memory_free(node->data.string.value);
         break;
@@ -754,6 +835,12 @@ void ast_free(ASTNode *node)
         ast_free(node->data.for_in.collection);
         ast_free(node->data.for_in.body);
         break;
+    case AST_INCLUDE:
+        memory_free(node->data.include.path);
+        break;
+    case AST_SYMBOL:
+        memory_free(node->data.symbol.name);
+        break;
     default:
         break;
     }
@@ -0,0 +1,975 @@
+#include "bignum.h"
+#include "../include/memory.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Limbs hold nine decimal digits each, so parsing and printing are linear
+ * digit copies and decimal rescaling only ever multiplies or divides by a
+ * power of ten that fits in one limb.
+ */
+#define LIMB_BASE 1000000000u
+#define LIMB_DIGITS 9
+
+/* Operand sizes (in limbs) where the next multiplication algorithm takes over */
+#define KARATSUBA_THRESHOLD 32
+#define TOOM3_THRESHOLD 192
+
+/* Largest exponent accepted when parsing, to keep "1e999999999" from allocating gigabytes */
+#define BIGNUM_MAX_EXPONENT 100000
+
+struct BigNum
+{
+    uint32_t *limbs; // little-endian, no leading zero limbs
+    int length;      // 0 for zero
+    int negative;
+    int scale;       // decimal digits after the point
+    int decimal;     // decimal rather than big integer
+};
+
+static const uint32_t powers_of_ten[LIMB_DIGITS + 1] = {
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u};
+
+/* ---- magnitude arithmetic on raw limb arrays ---- */
+
+static int mag_trim(const uint32_t *d, int n)
+{
+    while (n > 0 && d[n - 1] == 0)
+        n--;
+    return n;
+}
+
+static int mag_cmp(const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+    if (an != bn)
+        return an < bn ? -1 : 1;
+    for (int i = an - 1; i >= 0; i--)
+    {
+        if (a[i] != b[i])
+            return a[i] < b[i] ? -1 : 1;
+    }
+    return 0;
+}
+
+/* r = a + b; r needs max(an, bn) + 1 limbs and may alias a or b */
+static int mag_add(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+    if (an < bn)
+    {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        int tn = an;
+        an = bn;
+        bn = tn;
+    }
+    uint32_t carry = 0;
+    int i = 0;
+    for (; i < bn; i++)
+    {
+        uint32_t s = a[i] + b[i] + carry;
+        carry = s >= LIMB_BASE;
+        r[i] = carry ? s - LIMB_BASE : s;
+    }
+    for (; i < an; i++)
+    {
+        uint32_t s = a[i] + carry;
+        carry = s >= LIMB_BASE;
+        r[i] = carry ? s - LIMB_BASE : s;
+    }
+    r[an] = carry;
+    return mag_trim(r, an + 1);
+}
+
+/* r = a - b for a >= b; r may alias a */
+static int mag_sub(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+    uint32_t borrow = 0;
+    int i = 0;
+    for (; i < bn; i++)
+    {
+        uint32_t s = b[i] + borrow;
+        borrow = a[i] < s;
+        r[i] = borrow ? a[i] + LIMB_BASE - s : a[i] - s;
+    }
+    for (; i < an; i++)
+    {
+        uint32_t next = a[i] < borrow;
+        r[i] = next ? LIMB_BASE - 1 : a[i] - borrow;
+        borrow = next;
+    }
+    return mag_trim(r, an);
+}
+
+/* r[0..rn) += b; the sum must fit in rn limbs */
+static void mag_add_into(uint32_t *r, int rn, const uint32_t *b, int bn)
+{
+    uint32_t carry = 0;
+    int i = 0;
+    for (; i < bn; i++)
+    {
+        uint32_t s = r[i] + b[i] + carry;
+        carry = s >= LIMB_BASE;
+        r[i] = carry ? s - LIMB_BASE : s;
+    }
+    for (; carry && i < rn; i++)
+    {
+        uint32_t s = r[i] + 1;
+        carry = s >= LIMB_BASE;
+        r[i] = carry ? 0 : s;
+    }
+}
+
+/* r[0..rn) -= b; r must be at least b */
+static void mag_sub_into(uint32_t *r, int rn, const uint32_t *b, int bn)
+{
+    uint32_t borrow = 0;
+    int i = 0;
+    for (; i < bn; i++)
+    {
+        uint32_t s = b[i] + borrow;
+        borrow = r[i] < s;
+        r[i] = borrow ? r[i] + LIMB_BASE - s : r[i] - s;
+    }
+    for (; borrow && i < rn; i++)
+    {
+        borrow = r[i] == 0;
+        r[i] = borrow ? LIMB_BASE - 1 : r[i] - 1;
+    }
+}
+
+/* r = a * m for m <= LIMB_BASE; returns the carry limb, r may alias a */
+static uint32_t mag_mul_small(uint32_t *r, const uint32_t *a, int an, uint32_t m)
+{
+    uint64_t carry = 0;
+    for (int i = 0; i < an; i++)
+    {
+        uint64_t t = (uint64_t)a[i] * m + carry;
+        r[i] = (uint32_t)(t % LIMB_BASE);
+        carry = t / LIMB_BASE;
+    }
+    return (uint32_t)carry;
+}
+
+/* q = a / d for 0 < d <= LIMB_BASE; returns the remainder, q may alias a */
+static uint32_t mag_div_small(uint32_t *q, const uint32_t *a, int an, uint32_t d)
+{
+    uint64_t rem = 0;
+    for (int i = an - 1; i >= 0; i--)
+    {
+        uint64_t cur = rem * LIMB_BASE + a[i];
+        q[i] = (uint32_t)(cur / d);
+        rem = cur % d;
+    }
+    return (uint32_t)rem;
+}
+
+/* r[0..an+bn) = a * b, quadratic */
+static void mag_mul_school(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+    memset(r, 0, sizeof(uint32_t) * (an + bn));
+    for (int i = 0; i < an; i++)
+    {
+        uint64_t ai = a[i];
+        uint64_t carry = 0;
+        if (!ai)
+            continue;
+        for (int j = 0; j < bn; j++)
+        {
+            uint64_t t = r[i + j] + ai * b[j] + carry;
+            r[i + j] = (uint32_t)(t % LIMB_BASE);
+            carry = t / LIMB_BASE;
+        }
+        r[i + bn] = (uint32_t)carry;
+    }
+}
+
+static void mag_mul(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn);
+
+/*
+ * Signed temporaries for Toom-3, whose evaluation at -1 and -2 and whose
+ * interpolation steps go negative.
+ */
+typedef struct
+{
+    uint32_t *d;
+    int n;
+    int negative;
+} SignedMag;
+
+static SignedMag signed_copy(const uint32_t *d, int n)
+{
+    SignedMag x;
+    x.n = mag_trim(d, n);
+    x.d = memory_allocate(sizeof(uint32_t) * (x.n + 1));
+    memcpy(x.d, d, sizeof(uint32_t) * x.n);
+    x.negative = 0;
+    return x;
+}
+
+/* x + y, or x - y when subtract is set */
+static SignedMag signed_add(SignedMag x, SignedMag y, int subtract)
+{
+    SignedMag r;
+    int y_negative = y.negative ^ subtract;
+    int n = x.n > y.n ? x.n : y.n;
+    r.d = memory_allocate(sizeof(uint32_t) * (n + 1));
+    if (x.negative == y_negative)
+    {
+        r.n = mag_add(r.d, x.d, x.n, y.d, y.n);
+        r.negative = x.negative;
+    }
+    else if (mag_cmp(x.d, x.n, y.d, y.n) >= 0)
+    {
+        r.n = mag_sub(r.d, x.d, x.n, y.d, y.n);
+        r.negative = x.negative;
+    }
+    else
+    {
+        r.n = mag_sub(r.d, y.d, y.n, x.d, x.n);
+        r.negative = y_negative;
+    }
+    if (!r.n)
+        r.negative = 0;
+    return r;
+}
+
+static SignedMag signed_mul(SignedMag x, SignedMag y)
+{
+    SignedMag r;
+    r.d = memory_allocate(sizeof(uint32_t) * (x.n + y.n + 1));
+    mag_mul(r.d, x.d, x.n, y.d, y.n);
+    r.n = mag_trim(r.d, x.n + y.n);
+    r.negative = r.n ? x.negative ^ y.negative : 0;
+    return r;
+}
+
+static void signed_scale(SignedMag *x, uint32_t m)
+{
+    x->d = memory_reallocate(x->d, sizeof(uint32_t) * (x->n + 1));
+    x->d[x->n] = mag_mul_small(x->d, x->d, x->n, m);
+    x->n = mag_trim(x->d, x->n + 1);
+}
+
+/* Exact division by a small constant */
+static void signed_divide(SignedMag *x, uint32_t d)
+{
+    mag_div_small(x->d, x->d, x->n, d);
+    x->n = mag_trim(x->d, x->n);
+    if (!x->n)
+        x->negative = 0;
+}
+
+/* Replace *x with the result of an operation on it, freeing the old digits */
+static void signed_replace(SignedMag *x, SignedMag value)
+{
+    memory_free(x->d);
+    *x = value;
+}
+
+/*
+ * mag_mul_toom3: Toom-Cook 3-way multiplication
+ *
+ * Splits both operands into three parts of k limbs, evaluates the part
+ * polynomials at 0, 1, -1, -2 and infinity, multiplies pointwise and
+ * interpolates with Bodrato's sequence. Requires an >= bn > 2k.
+ */
+static void mag_mul_toom3(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+    int k = (an + 2) / 3;
+    SignedMag a0 = signed_copy(a, k), a1 = signed_copy(a + k, k), a2 = signed_copy(a + 2 * k, an - 2 * k);
+    SignedMag b0 = signed_copy(b, k), b1 = signed_copy(b + k, k), b2 = signed_copy(b + 2 * k, bn - 2 * k);
+
+    // evaluation
+    SignedMag pt = signed_add(a0, a2, 0);
+    SignedMag p1 = signed_add(pt, a1, 0);
+    SignedMag pm1 = signed_add(pt, a1, 1);
+    SignedMag pm2 = signed_add(pm1, a2, 0);
+    signed_scale(&pm2, 2);
+    signed_replace(&pm2, signed_add(pm2, a0, 1));
+    SignedMag qt = signed_add(b0, b2, 0);
+    SignedMag q1 = signed_add(qt, b1, 0);
+    SignedMag qm1 = signed_add(qt, b1, 1);
+    SignedMag qm2 = signed_add(qm1, b2, 0);
+    signed_scale(&qm2, 2);
+    signed_replace(&qm2, signed_add(qm2, b0, 1));
+
+    // pointwise products
+    SignedMag r0 = signed_mul(a0, b0);
+    SignedMag v1 = signed_mul(p1, q1);
+    SignedMag vm1 = signed_mul(pm1, qm1);
+    SignedMag vm2 = signed_mul(pm2, qm2);
+    SignedMag r4 = signed_mul(a2, b2);
+
+    // interpolation
+    SignedMag r3 = signed_add(vm2, v1, 1);
+    signed_divide(&r3, 3);
+    SignedMag r1 = signed_add(v1, vm1, 1);
+    signed_divide(&r1, 2);
+    SignedMag r2 = signed_add(vm1, r0, 1);
+    signed_replace(&r3, signed_add(r2, r3, 1));
+    signed_divide(&r3, 2);
+    SignedMag twice_r4 = signed_copy(r4.d, r4.n);
+    signed_scale(&twice_r4, 2);
+    signed_replace(&r3, signed_add(r3, twice_r4, 0));
+    signed_replace(&r2, signed_add(r2, r1, 0));
+    signed_replace(&r2, signed_add(r2, r4, 1));
+    signed_replace(&r1, signed_add(r1, r3, 1));
+
+    // recomposition; every coefficient is non-negative here
+    int rn = an + bn;
+    memset(r, 0, sizeof(uint32_t) * rn);
+    SignedMag *parts[5] = {&r0, &r1, &r2, &r3, &r4};
+    for (int i = 0; i < 5; i++)
+        mag_add_into(r + i * k, rn - i * k, parts[i]->d, parts[i]->n);
+
+    SignedMag *temps[] = {&a0, &a1, &a2, &b0, &b1, &b2, &pt, &p1, &pm1, &pm2, &qt, &q1, &qm1, &qm2,
+                          &r0, &v1, &vm1, &vm2, &r4, &r3, &r1, &r2, &twice_r4};
+    for (size_t i = 0; i < sizeof(temps) / sizeof(temps[0]); i++)
+        memory_free(temps[i]->d);
+}
+
+/*
+ * mag_mul_karatsuba: Karatsuba multiplication for an >= bn > an / 2
+ *
+ * With a = a1 B^m + a0 and b = b1 B^m + b0 the product is
+ * z2 B^2m + z1 B^m + z0 where z1 = (a0 + a1)(b0 + b1) - z0 - z2.
+ */
+static void mag_mul_karatsuba(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+    int m = (an + 1) / 2;
+    int a0n = mag_trim(a, m), b0n = mag_trim(b, m);
+    int a1n = an - m, b1n = bn - m;
+    int rn = an + bn;
+
+    memset(r, 0, sizeof(uint32_t) * rn);
+    mag_mul(r, a, a0n, b, b0n);
+    mag_mul(r + 2 * m, a + m, a1n, b + m, b1n);
+    int z0n = mag_trim(r, a0n + b0n);
+    int z2n = mag_trim(r + 2 * m, a1n + b1n);
+
+    uint32_t *sa = memory_allocate(sizeof(uint32_t) * (m + 1));
+    uint32_t *sb = memory_allocate(sizeof(uint32_t) * (m + 1));
+    int san = mag_add(sa, a, a0n, a + m, a1n);
+    int sbn = mag_add(sb, b, b0n, b + m, b1n);
+    uint32_t *z1 = memory_allocate(sizeof(uint32_t) * (san + sbn + 1));
+    mag_mul(z1, sa, san, sb, sbn);
+    int z1n = mag_trim(z1, san + sbn);
+    mag_sub_into(z1, z1n, r, z0n);
+    mag_sub_into(z1, z1n, r + 2 * m, z2n);
+    z1n = mag_trim(z1, z1n);
+    mag_add_into(r + m, rn - m, z1, z1n);
+
+    memory_free(sa);
+    memory_free(sb);
+    memory_free(z1);
+}
+
+/*
+ * mag_mul: r[0..an+bn) = a * b, choosing the algorithm by operand size
+ *
+ * r must not alias the operands. Very unbalanced operands are multiplied
+ * in slices of the shorter length so the balanced algorithms still apply.
+ */
+static void mag_mul(uint32_t *r, const uint32_t *a, int an, const uint32_t *b, int bn)
+{
+    if (an < bn)
+    {
+        const uint32_t *t = a;
+        a = b;
+        b = t;
+        int tn = an;
+        an = bn;
+        bn = tn;
+    }
+    if (bn == 0)
+    {
+        memset(r, 0, sizeof(uint32_t) * an);
+        return;
+    }
+    if (bn < KARATSUBA_THRESHOLD)
+    {
+        mag_mul_school(r, a, an, b, bn);
+        return;
+    }
+    if (2 * bn <= an)
+    {
+        uint32_t *slice = memory_allocate(sizeof(uint32_t) * 2 * bn);
+        memset(r, 0, sizeof(uint32_t) * (an + bn));
+        for (int offset = 0; offset < an; offset += bn)
+        {
+            int len = an - offset < bn ? an - offset : bn;
+            mag_mul(slice, a + offset, len, b, bn);
+            mag_add_into(r + offset, an + bn - offset, slice, len + bn);
+        }
+        memory_free(slice);
+        return;
+    }
+    if (bn >= TOOM3_THRESHOLD && bn > 2 * ((an + 2) / 3))
+        mag_mul_toom3(r, a, an, b, bn);
+    else
+        mag_mul_karatsuba(r, a, an, b, bn);
+}
+
+/*
+ * mag_divmod: Long division (Knuth's algorithm D in base 10^9)
+ *
+ * q receives un - vn + 1 limbs and rem receives vn limbs. v must be trimmed
+ * and non-zero, with un >= vn.
+ */
+static void mag_divmod(uint32_t *q, uint32_t *rem, const uint32_t *u, int un, const uint32_t *v, int vn)
+{
+    if (vn == 1)
+    {
+        rem[0] = mag_div_small(q, u, un, v[0]);
+        return;
+    }
+
+    // normalize so the divisor's top limb is at least LIMB_BASE / 2
+    uint32_t f = LIMB_BASE / (v[vn - 1] + 1);
+    uint32_t *nu = memory_allocate(sizeof(uint32_t) * (un + 1));
+    uint32_t *nv = memory_allocate(sizeof(uint32_t) * vn);
+    nu[un] = mag_mul_small(nu, u, un, f);
+    mag_mul_small(nv, v, vn, f);
+    uint64_t top = nv[vn - 1];
+
+    for (int j = un - vn; j >= 0; j--)
+    {
+        uint64_t num = (uint64_t)nu[j + vn] * LIMB_BASE + nu[j + vn - 1];
+        uint64_t qhat = num / top;
+        uint64_t rhat = num % top;
+        while (qhat >= LIMB_BASE || qhat * nv[vn - 2] > rhat * LIMB_BASE + nu[j + vn - 2])
+        {
+            qhat--;
+            rhat += top;
+            if (rhat >= LIMB_BASE)
+                break;
+        }
+
+        // subtract qhat * v from the current window
+        uint64_t carry = 0;
+        uint32_t borrow = 0;
+        for (int i = 0; i < vn; i++)
+        {
+            uint64_t p = qhat * nv[i] + carry;
+            carry = p / LIMB_BASE;
+            uint32_t s = (uint32_t)(p % LIMB_BASE) + borrow;
+            borrow = nu[i + j] < s;
+            nu[i + j] = borrow ? nu[i + j] + LIMB_BASE - s : nu[i + j] - s;
+        }
+        if ((uint64_t)nu[j + vn] < carry + borrow)
+        {
+            // qhat was one too large: add the divisor back
+            qhat--;
+            uint32_t c = 0;
+            for (int i = 0; i < vn; i++)
+            {
+                uint32_t s = nu[i + j] + nv[i] + c;
+                c = s >= LIMB_BASE;
+                nu[i + j] = c ? s - LIMB_BASE : s;
+            }
+        }
+        nu[j + vn] = 0;
+        q[j] = (uint32_t)qhat;
+    }
+
+    mag_div_small(rem, nu, vn, f);
+    memory_free(nu);
+    memory_free(nv);
+}
+
+/* ---- BigNum values ---- */
+
+static BigNum *bignum_alloc(int limbs)
+{
+    BigNum *x = memory_allocate(sizeof(BigNum));
+    x->limbs = memory_allocate(sizeof(uint32_t) * (limbs > 0 ? limbs : 1));
+    x->length = 0;
+    x->negative = 0;
+    x->scale = 0;
+    x->decimal = 0;
+    return x;
+}
+
+static void bignum_normalize(BigNum *x, int length)
+{
+    x->length = mag_trim(x->limbs, length);
+    if (!x->length)
+        x->negative = 0;
+}
+
+BigNum *bignum_clone(const BigNum *x)
+{
+    BigNum *copy = bignum_alloc(x->length);
+    memcpy(copy->limbs, x->limbs, sizeof(uint32_t) * x->length);
+    copy->length = x->length;
+    copy->negative = x->negative;
+    copy->scale = x->scale;
+    copy->decimal = x->decimal;
+    return copy;
+}
+
+void bignum_free(BigNum *x)
+{
+    if (!x)
+        return;
+    memory_free(x->limbs);
+    memory_free(x);
+}
+
+int bignum_is_decimal(const BigNum *x)
+{
+    return x->decimal;
+}
+
+int bignum_is_zero(const BigNum *x)
+{
+    return x->length == 0;
+}
+
+/* Multiply the magnitude by 10^(scale - x->scale) and take the new scale */
+static void bignum_upscale(BigNum *x, int scale)
+{
+    int k = scale - x->scale;
+    if (k <= 0)
+        return;
+    x->scale = scale;
+    if (!x->length)
+        return;
+    int whole = k / LIMB_DIGITS;
+    int n = x->length + whole + 1;
+    x->limbs = memory_reallocate(x->limbs, sizeof(uint32_t) * n);
+    memmove(x->limbs + whole, x->limbs, sizeof(uint32_t) * x->length);
+    memset(x->limbs, 0, sizeof(uint32_t) * whole);
+    x->limbs[n - 1] = mag_mul_small(x->limbs, x->limbs, n - 1, powers_of_ten[k % LIMB_DIGITS]);
+    bignum_normalize(x, n);
+}
+
+/*
+ * Drop digits down to the given scale, truncating or rounding half to even.
+ * sticky marks a non-zero remainder already discarded below the last digit.
+ */
+static void bignum_downscale(BigNum *x, int scale, int round, int sticky)
+{
+    int k = x->scale - scale;
+    if (k <= 0)
+        return;
+    x->scale = scale;
+
+    // everything below the most significant dropped digit only matters as sticky
+    int below = k - 1;
+    int whole = below / LIMB_DIGITS;
+    if (whole >= x->length)
+    {
+        sticky |= x->length > 0;
+        x->length = 0;
+        x->negative = 0;
+        return;
+    }
+    for (int i = 0; i < whole; i++)
+        sticky |= x->limbs[i] != 0;
+    memmove(x->limbs, x->limbs + whole, sizeof(uint32_t) * (x->length - whole));
+    int n = x->length - whole;
+    sticky |= mag_div_small(x->limbs, x->limbs, n, powers_of_ten[below % LIMB_DIGITS]) != 0;
+    uint32_t digit = mag_div_small(x->limbs, x->limbs, n, 10);
+
+    if (round && (digit > 5 || (digit == 5 && (sticky || (n > 0 && (x->limbs[0] & 1))))))
+    {
+        static const uint32_t one = 1;
+        x->limbs = memory_reallocate(x->limbs, sizeof(uint32_t) * (n + 1));
+        x->limbs[n] = 0;
+        mag_add_into(x->limbs, n + 1, &one, 1);
+        n++;
+    }
+    bignum_normalize(x, n);
+}
+
+/*
+ * bignum_from_string: Parse [sign] digits [. digits] [e [sign] digits]
+ *
+ * Big integers drop any fractional digits (truncating toward zero).
+ *
+ * Returns: The new number, or NULL if text is not a number
+ */
+BigNum *bignum_from_string(const char *text, int decimal)
+{
+    const char *p = text;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    int negative = 0;
+    if (*p == '-' || *p == '+')
+        negative = *p++ == '-';
+
+    size_t len = strlen(p);
+    char *digits = memory_allocate(len + 1);
+    int count = 0, fraction = 0, seen_point = 0, seen_digit = 0;
+    for (; *p; p++)
+    {
+        if (*p >= '0' && *p <= '9')
+        {
+            seen_digit = 1;
+            if (count || *p != '0')
+                digits[count++] = *p;
+            fraction += seen_point;
+        }
+        else if (*p == '.' && !seen_point)
+            seen_point = 1;
+        else
+            break;
+    }
+    long exponent = 0;
+    if (seen_digit && (*p == 'e' || *p == 'E'))
+    {
+        char *end;
+        exponent = strtol(p + 1, &end, 10);
+        if (end == p + 1 || exponent > BIGNUM_MAX_EXPONENT || exponent < -BIGNUM_MAX_EXPONENT)
+            seen_digit = 0;
+        p = end;
+    }
+    while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        p++;
+    if (!seen_digit || *p)
+    {
+        memory_free(digits);
+        return NULL;
+    }
+
+    long scale = fraction - exponent;
+    int zeros = scale < 0 ? (int)-scale : 0;
+    int total = count ? count + zeros : 0;
+    BigNum *x = bignum_alloc(total / LIMB_DIGITS + 1);
+    int n = 0;
+    // fill limbs from the least significant digit
+    for (int end = total; end > 0; end -= LIMB_DIGITS)
+    {
+        int start = end > LIMB_DIGITS ? end - LIMB_DIGITS : 0;
+        uint32_t limb = 0;
+        for (int i = start; i < end; i++)
+            limb = limb * 10 + (i < count ? (uint32_t)(digits[i] - '0') : 0);
+        x->limbs[n++] = limb;
+    }
+    memory_free(digits);
+
+    x->negative = negative;
+    x->scale = scale > 0 ? (int)scale : 0;
+    x->decimal = decimal;
+    bignum_normalize(x, n);
+    if (!decimal)
+        bignum_downscale(x, 0, 0, 0);
+    return x;
+}
+
+BigNum *bignum_from_int(long long value, int decimal)
+{
+    BigNum *x = bignum_alloc(3);
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    int n = 0;
+    while (magnitude)
+    {
+        x->limbs[n++] = (uint32_t)(magnitude % LIMB_BASE);
+        magnitude /= LIMB_BASE;
+    }
+    x->negative = value < 0;
+    x->decimal = decimal;
+    bignum_normalize(x, n);
+    return x;
+}
+
+/*
+ * bignum_from_double: Convert a double through its shortest round-trip
+ * decimal form, so 0.1 becomes exactly 0.1 rather than its binary expansion
+ *
+ * Returns: The new number, or NULL for infinities and NaN
+ */
+BigNum *bignum_from_double(double value, int decimal)
+{
+    if (!isfinite(value))
+        return NULL;
+    char buffer[64];
+    for (int precision = 15; precision <= 17; precision++)
+    {
+        snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+        if (strtod(buffer, NULL) == value)
+            break;
+    }
+    return bignum_from_string(buffer, decimal);
+}
+
+/*
+ * bignum_to_string: Format in plain decimal notation
+ *
+ * Returns: A string allocated with memory_allocate
+ */
+char *bignum_to_string(const BigNum *x)
+{
+    int digits = x->length ? x->length * LIMB_DIGITS : 1;
+    if (digits < x->scale + 1)
+        digits = x->scale + 1;
+    char *out = memory_allocate(digits + 3);
+    char *body = memory_allocate(digits + 1);
+
+    // most significant limb without padding, the rest as nine digits each
+    int len = 0;
+    if (!x->length)
+        body[len++] = '0';
+    else
+    {
+        len = sprintf(body, "%u", x->limbs[x->length - 1]);
+        for (int i = x->length - 2; i >= 0; i--)
+            len += sprintf(body + len, "%09u", x->limbs[i]);
+    }
+
+    char *p = out;
+    if (x->negative)
+        *p++ = '-';
+    if (x->scale > 0)
+    {
+        int pad = x->scale + 1 - len;
+        if (pad > 0)
+        {
+            memmove(body + pad, body, len + 1);
+            memset(body, '0', pad);
+            len += pad;
+        }
+        int whole = len - x->scale;
+        memcpy(p, body, whole);
+        p += whole;
+        *p++ = '.';
+        memcpy(p, body + whole, x->scale);
+        p += x->scale;
+    }
+    else
+    {
+        memcpy(p, body, len);
+        p += len;
+    }
+    *p = '\0';
+    memory_free(body);
+    return out;
+}
+
+double bignum_to_double(const BigNum *x)
+{
+    char *text = bignum_to_string(x);
+    double value = strtod(text, NULL);
+    memory_free(text);
+    return value;
+}
+
+/* Copies of a and b brought to a common scale */
+static void bignum_align(const BigNum *a, const BigNum *b, BigNum **x, BigNum **y)
+{
+    int scale = a->scale > b->scale ? a->scale : b->scale;
+    *x = bignum_clone(a);
+    *y = bignum_clone(b);
+    bignum_upscale(*x, scale);
+    bignum_upscale(*y, scale);
+}
+
+int bignum_compare(const BigNum *a, const BigNum *b)
+{
+    int sa = a->length ? (a->negative ? -1 : 1) : 0;
+    int sb = b->length ? (b->negative ? -1 : 1) : 0;
+    if (sa != sb)
+        return sa < sb ? -1 : 1;
+    if (!sa)
+        return 0;
+    BigNum *x, *y;
+    bignum_align(a, b, &x, &y);
+    int c = mag_cmp(x->limbs, x->length, y->limbs, y->length);
+    bignum_free(x);
+    bignum_free(y);
+    return sa < 0 ? -c : c;
+}
+
+static BigNum *bignum_add_signed(const BigNum *a, const BigNum *b, int subtract)
+{
+    BigNum *x, *y;
+    bignum_align(a, b, &x, &y);
+    int n = (x->length > y->length ? x->length : y->length) + 1;
+    BigNum *r = bignum_alloc(n);
+    int y_negative = y->negative ^ subtract;
+    int length;
+    if (x->negative == y_negative)
+    {
+        length = mag_add(r->limbs, x->limbs, x->length, y->limbs, y->length);
+        r->negative = x->negative;
+    }
+    else if (mag_cmp(x->limbs, x->length, y->limbs, y->length) >= 0)
+    {
+        length = mag_sub(r->limbs, x->limbs, x->length, y->limbs, y->length);
+        r->negative = x->negative;
+    }
+    else
+    {
+        length = mag_sub(r->limbs, y->limbs, y->length, x->limbs, x->length);
+        r->negative = y_negative;
+    }
+    r->scale = x->scale;
+    r->decimal = a->decimal || b->decimal;
+    bignum_normalize(r, length);
+    bignum_free(x);
+    bignum_free(y);
+    return r;
+}
+
+BigNum *bignum_add(const BigNum *a, const BigNum *b)
+{
+    return bignum_add_signed(a, b, 0);
+}
+
+BigNum *bignum_sub(const BigNum *a, const BigNum *b)
+{
+    return bignum_add_signed(a, b, 1);
+}
+
+BigNum *bignum_mul(const BigNum *a, const BigNum *b)
+{
+    int n = a->length + b->length;
+    BigNum *r = bignum_alloc(n);
+    if (a->length && b->length)
+        mag_mul(r->limbs, a->limbs, a->length, b->limbs, b->length);
+    else
+        n = 0; // a zero operand: the limbs were never written
+    r->negative = a->negative ^ b->negative;
+    r->scale = a->scale + b->scale;
+    r->decimal = a->decimal || b->decimal;
+    bignum_normalize(r, n);
+    return r;
+}
+
+/* Quotient and remainder of the magnitudes of u and v (v non-zero) */
+static void bignum_divmod(const BigNum *u, const BigNum *v, BigNum **q, BigNum **rem)
+{
+    int qn = u->length >= v->length ? u->length - v->length + 1 : 1;
+    *q = bignum_alloc(qn);
+    *rem = bignum_alloc(v->length);
+    if (u->length < v->length)
+    {
+        memcpy((*rem)->limbs, u->limbs, sizeof(uint32_t) * u->length);
+        bignum_normalize(*rem, u->length);
+        return;
+    }
+    mag_divmod((*q)->limbs, (*rem)->limbs, u->limbs, u->length, v->limbs, v->length);
+    bignum_normalize(*q, qn);
+    bignum_normalize(*rem, v->length);
+}
+
+/*
+ * bignum_div: Divide, exactly when the quotient terminates
+ *
+ * Two big integers give a big integer when the division is exact and a
+ * decimal otherwise. Decimal quotients carry BIGNUM_DIV_DIGITS digits beyond
+ * the larger operand scale, rounded half to even, with trailing zeros past
+ * that operand scale removed.
+ *
+ * Returns: The quotient, or NULL when dividing by zero
+ */
+BigNum *bignum_div(const BigNum *a, const BigNum *b)
+{
+    if (!b->length)
+        return NULL;
+    int negative = a->negative ^ b->negative;
+    BigNum *q, *rem;
+
+    if (!a->decimal && !b->decimal)
+    {
+        bignum_divmod(a, b, &q, &rem);
+        int exact = rem->length == 0;
+        bignum_free(rem);
+        if (exact)
+        {
+            q->negative = q->length ? negative : 0;
+            return q;
+        }
+        bignum_free(q);
+    }
+
+    // q = a * 10^(target + 1 - sa + sb) / b, one guard digit for rounding
+    int keep = a->scale > b->scale ? a->scale : b->scale;
+    int target = keep + BIGNUM_DIV_DIGITS;
+    BigNum *u = bignum_clone(a);
+    u->scale = 0;
+    bignum_upscale(u, target + 1 - a->scale + b->scale);
+    bignum_divmod(u, b, &q, &rem);
+    bignum_free(u);
+
+    q->scale = target + 1;
+    bignum_downscale(q, target, 1, rem->length != 0);
+    bignum_free(rem);
+    while (q->scale > keep && q->length && q->limbs[0] % 10 == 0)
+    {
+        mag_div_small(q->limbs, q->limbs, q->length, 10);
+        bignum_normalize(q, q->length);
+        q->scale--;
+    }
+    if (!q->length)
+        q->scale = keep;
+    q->negative = q->length ? negative : 0;
+    q->decimal = 1;
+    return q;
+}
+
+/*
+ * bignum_mod: Remainder of truncating division (sign follows the dividend)
+ *
+ * Returns: The remainder, or NULL when dividing by zero
+ */
+BigNum *bignum_mod(const BigNum *a, const BigNum *b)
+{
+    if (!b->length)
+        return NULL;
+    BigNum *x, *y, *q, *rem;
+    bignum_align(a, b, &x, &y);
+    bignum_divmod(x, y, &q, &rem);
+    rem->negative = rem->length ? a->negative : 0;
+    rem->scale = x->scale;
+    rem->decimal = a->decimal || b->decimal;
+    bignum_free(x);
+    bignum_free(y);
+    bignum_free(q);
+    return rem;
+}
+
+BigNum *bignum_neg(const BigNum *x)
+{
+    BigNum *r = bignum_clone(x);
+    r->negative = r->length ? !x->negative : 0;
+    return r;
+}
+
+/*
+ * bignum_round: Bring a number to exactly the given scale, rounding half to even
+ */
+BigNum *bignum_round(const BigNum *x, int scale)
+{
+    BigNum *r = bignum_clone(x);
+    if (scale < 0)
+        scale = 0;
+    if (scale > r->scale)
+        bignum_upscale(r, scale);
+    else
+        bignum_downscale(r, scale, 1, 0);
+    return r;
+}
+
+/*
+ * bignum_to_integer: Truncate toward zero to a big integer
+ */
+BigNum *bignum_to_integer(const BigNum *x)
+{
+    BigNum *r = bignum_clone(x);
+    bignum_downscale(r, 0, 0, 0);
+    r->decimal = 0;
+    return r;
+}
+
+BigNum *bignum_to_decimal(const BigNum *x)
+{
+    BigNum *r = bignum_clone(x);
+    r->decimal = 1;
+    return r;
+}
@@ -0,0 +1,37 @@
+#ifndef SHARPSCRIPT_BIGNUM_H
+#define SHARPSCRIPT_BIGNUM_H
+
+/*
+ * Arbitrary-precision integers and decimals behind VAL_BIGNUM. A value is
+ * sign * magnitude * 10^-scale, with the magnitude stored in base 10^9 limbs.
+ * Decimals keep their scale through addition and multiplication; big
+ * integers always have scale 0.
+ */
+typedef struct BigNum BigNum;
+
+/* Extra fractional digits kept when a division does not terminate */
+#define BIGNUM_DIV_DIGITS 28
+
+BigNum *bignum_from_string(const char *text, int decimal);
+BigNum *bignum_from_int(long long value, int decimal);
+BigNum *bignum_from_double(double value, int decimal);
+BigNum *bignum_clone(const BigNum *x);
+void bignum_free(BigNum *x);
+
+int bignum_is_decimal(const BigNum *x);
+int bignum_is_zero(const BigNum *x);
+char *bignum_to_string(const BigNum *x);
+double bignum_to_double(const BigNum *x);
+int bignum_compare(const BigNum *a, const BigNum *b);
+
+BigNum *bignum_add(const BigNum *a, const BigNum *b);
+BigNum *bignum_sub(const BigNum *a, const BigNum *b);
+BigNum *bignum_mul(const BigNum *a, const BigNum *b);
+BigNum *bignum_div(const BigNum *a, const BigNum *b);
+BigNum *bignum_mod(const BigNum *a, const BigNum *b);
+BigNum *bignum_neg(const BigNum *x);
+BigNum *bignum_round(const BigNum *x, int scale);
+BigNum *bignum_to_integer(const BigNum *x);
+BigNum *bignum_to_decimal(const BigNum *x);
+
+#endif
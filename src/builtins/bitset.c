@@ -0,0 +1,705 @@
+#include "bitset.h"
+#include "../include/memory.h"
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITSET_AVX2
+#include <immintrin.h>
+#define BITSET_TARGET __attribute__((target("avx2,popcnt")))
+#define POPCNT_TARGET __attribute__((target("popcnt")))
+#endif
+
+#define CHUNK_WORDS 1024 // 2^16 bits
+
+/*
+ * A chunk holds the bits whose index >> 16 is key. It is an array chunk
+ * (words == NULL) while count <= BITSET_ARRAY_MAX and a bitmap chunk above
+ * that; every operation restores this, so equal sets have equal layouts.
+ * Chunks with no bits set are removed.
+ */
+typedef struct
+{
+    uint32_t key;
+    int count;       // bits set
+    int capacity;    // slots allocated in array
+    uint16_t *array; // sorted offsets within the chunk
+    uint64_t *words; // CHUNK_WORDS words, or NULL
+} Chunk;
+
+struct Bitset
+{
+    int refs;
+    Chunk *chunks; // sorted by key
+    int count;
+    int capacity;
+};
+
+Bitset *bitset_create(void)
+{
+    Bitset *b = memory_allocate(sizeof(Bitset));
+    b->refs = 1;
+    b->chunks = NULL;
+    b->count = 0;
+    b->capacity = 0;
+    return b;
+}
+
+Bitset *bitset_retain(Bitset *b)
+{
+    b->refs++;
+    return b;
+}
+
+static void chunk_free(Chunk *c)
+{
+    memory_free(c->array);
+    memory_free(c->words);
+}
+
+void bitset_release(Bitset *b)
+{
+    if (!b || --b->refs > 0)
+        return;
+    for (int i = 0; i < b->count; i++)
+        chunk_free(&b->chunks[i]);
+    memory_free(b->chunks);
+    memory_free(b);
+}
+
+/* --- word helpers --- */
+
+#ifdef BITSET_AVX2
+static int POPCNT_TARGET words_popcount_native(const uint64_t *w)
+{
+    int count = 0;
+    for (int i = 0; i < CHUNK_WORDS; i++)
+        count += __builtin_popcountll(w[i]);
+    return count;
+}
+
+static int BITSET_TARGET words_combine_avx2(BitsetOp op, const uint64_t *a, const uint64_t *b, uint64_t *out)
+{
+    for (int i = 0; i < CHUNK_WORDS; i += 4)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i r;
+        switch (op)
+        {
+        case BITSET_AND:
+            r = _mm256_and_si256(x, y);
+            break;
+        case BITSET_OR:
+            r = _mm256_or_si256(x, y);
+            break;
+        case BITSET_XOR:
+            r = _mm256_xor_si256(x, y);
+            break;
+        default:
+            r = _mm256_andnot_si256(y, x);
+            break;
+        }
+        _mm256_storeu_si256((__m256i *)(out + i), r);
+    }
+    int count = 0;
+    for (int i = 0; i < CHUNK_WORDS; i++)
+        count += __builtin_popcountll(out[i]);
+    return count;
+}
+#endif
+
+static int words_popcount(const uint64_t *w)
+{
+#ifdef BITSET_AVX2
+    if (__builtin_cpu_supports("popcnt"))
+        return words_popcount_native(w);
+#endif
+    int count = 0;
+    for (int i = 0; i < CHUNK_WORDS; i++)
+        count += __builtin_popcountll(w[i]);
+    return count;
+}
+
+/* out = a op b over one chunk's words; returns the bits set in out */
+static int words_combine(BitsetOp op, const uint64_t *a, const uint64_t *b, uint64_t *out)
+{
+#ifdef BITSET_AVX2
+    if (__builtin_cpu_supports("avx2"))
+        return words_combine_avx2(op, a, b, out);
+#endif
+    for (int i = 0; i < CHUNK_WORDS; i++)
+    {
+        switch (op)
+        {
+        case BITSET_AND:
+            out[i] = a[i] & b[i];
+            break;
+        case BITSET_OR:
+            out[i] = a[i] | b[i];
+            break;
+        case BITSET_XOR:
+            out[i] = a[i] ^ b[i];
+            break;
+        default:
+            out[i] = a[i] & ~b[i];
+            break;
+        }
+    }
+    return words_popcount(out);
+}
+
+/* Set or clear offsets [lo, hi) */
+static void words_fill(uint64_t *w, unsigned lo, unsigned hi, int value)
+{
+    while (lo < hi)
+    {
+        unsigned bit = lo & 63;
+        unsigned span = hi - lo < 64 - bit ? hi - lo : 64 - bit;
+        uint64_t mask = (span == 64 ? ~0ULL : ((1ULL << span) - 1)) << bit;
+        if (value)
+            w[lo >> 6] |= mask;
+        else
+            w[lo >> 6] &= ~mask;
+        lo += span;
+    }
+}
+
+static int words_test(const uint64_t *w, unsigned offset)
+{
+    return (int)((w[offset >> 6] >> (offset & 63)) & 1);
+}
+
+/* --- chunks --- */
+
+/* First position in array[0..n) holding a value >= v */
+static int array_lower_bound(const uint16_t *array, int n, unsigned v)
+{
+    int lo = 0, hi = n;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (array[mid] < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int chunk_test(const Chunk *c, unsigned offset)
+{
+    if (c->words)
+        return words_test(c->words, offset);
+    int i = array_lower_bound(c->array, c->count, offset);
+    return i < c->count && c->array[i] == offset;
+}
+
+static void chunk_to_bitmap(Chunk *c)
+{
+    c->words = memory_allocate(sizeof(uint64_t) * CHUNK_WORDS);
+    memset(c->words, 0, sizeof(uint64_t) * CHUNK_WORDS);
+    for (int i = 0; i < c->count; i++)
+        c->words[c->array[i] >> 6] |= 1ULL << (c->array[i] & 63);
+    memory_free(c->array);
+    c->array = NULL;
+    c->capacity = 0;
+}
+
+static void chunk_to_array(Chunk *c)
+{
+    c->capacity = c->count;
+    c->array = memory_allocate(sizeof(uint16_t) * (c->capacity ? c->capacity : 1));
+    int n = 0;
+    for (int i = 0; i < CHUNK_WORDS; i++)
+    {
+        for (uint64_t w = c->words[i]; w; w &= w - 1)
+            c->array[n++] = (uint16_t)(i * 64 + __builtin_ctzll(w));
+    }
+    memory_free(c->words);
+    c->words = NULL;
+}
+
+/* Index of the chunk with key, or -1 with *pos set to where it would go */
+static int chunk_find(const Bitset *b, uint32_t key, int *pos)
+{
+    int lo = 0, hi = b->count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (b->chunks[mid].key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *pos = lo;
+    return lo < b->count && b->chunks[lo].key == key ? lo : -1;
+}
+
+static Chunk *chunk_insert(Bitset *b, int pos, uint32_t key)
+{
+    if (b->count == b->capacity)
+    {
+        b->capacity = b->capacity ? b->capacity * 2 : 4;
+        b->chunks = memory_reallocate(b->chunks, sizeof(Chunk) * b->capacity);
+    }
+    memmove(b->chunks + pos + 1, b->chunks + pos, sizeof(Chunk) * (b->count - pos));
+    b->count++;
+    Chunk *c = &b->chunks[pos];
+    c->key = key;
+    c->count = 0;
+    c->capacity = 0;
+    c->array = NULL;
+    c->words = NULL;
+    return c;
+}
+
+static Chunk *chunk_get(Bitset *b, uint32_t key)
+{
+    int pos;
+    int i = chunk_find(b, key, &pos);
+    return i >= 0 ? &b->chunks[i] : chunk_insert(b, pos, key);
+}
+
+/* Restore the layout rule after a bulk change; returns 1 if the chunk was removed */
+static int chunk_settle(Bitset *b, int pos)
+{
+    Chunk *c = &b->chunks[pos];
+    if (c->count == 0)
+    {
+        chunk_free(c);
+        memmove(b->chunks + pos, b->chunks + pos + 1, sizeof(Chunk) * (b->count - pos - 1));
+        b->count--;
+        return 1;
+    }
+    if (c->words && c->count <= BITSET_ARRAY_MAX)
+        chunk_to_array(c);
+    else if (!c->words && c->count > BITSET_ARRAY_MAX)
+        chunk_to_bitmap(c);
+    return 0;
+}
+
+/* --- single bits --- */
+
+int bitset_test(const Bitset *b, uint64_t index)
+{
+    int pos;
+    if (index > BITSET_MAX_INDEX)
+        return 0;
+    int i = chunk_find(b, (uint32_t)(index >> 16), &pos);
+    return i >= 0 && chunk_test(&b->chunks[i], (unsigned)(index & 0xffff));
+}
+
+/* Returns 1 if the bit was newly set */
+int bitset_set(Bitset *b, uint64_t index)
+{
+    Chunk *c = chunk_get(b, (uint32_t)(index >> 16));
+    unsigned offset = (unsigned)(index & 0xffff);
+    if (!c->words)
+    {
+        int i = array_lower_bound(c->array, c->count, offset);
+        if (i < c->count && c->array[i] == offset)
+            return 0;
+        if (c->count < BITSET_ARRAY_MAX)
+        {
+            if (c->count == c->capacity)
+            {
+                c->capacity = c->capacity ? c->capacity * 2 : 4;
+                c->array = memory_reallocate(c->array, sizeof(uint16_t) * c->capacity);
+            }
+            memmove(c->array + i + 1, c->array + i, sizeof(uint16_t) * (c->count - i));
+            c->array[i] = (uint16_t)offset;
+            c->count++;
+            return 1;
+        }
+        chunk_to_bitmap(c);
+    }
+    if (words_test(c->words, offset))
+        return 0;
+    c->words[offset >> 6] |= 1ULL << (offset & 63);
+    c->count++;
+    return 1;
+}
+
+/* Returns 1 if the bit was set before */
+int bitset_clear(Bitset *b, uint64_t index)
+{
+    int pos;
+    if (index > BITSET_MAX_INDEX)
+        return 0;
+    int i = chunk_find(b, (uint32_t)(index >> 16), &pos);
+    if (i < 0)
+        return 0;
+    Chunk *c = &b->chunks[i];
+    unsigned offset = (unsigned)(index & 0xffff);
+    if (c->words)
+    {
+        if (!words_test(c->words, offset))
+            return 0;
+        c->words[offset >> 6] &= ~(1ULL << (offset & 63));
+    }
+    else
+    {
+        int k = array_lower_bound(c->array, c->count, offset);
+        if (k == c->count || c->array[k] != offset)
+            return 0;
+        memmove(c->array + k, c->array + k + 1, sizeof(uint16_t) * (c->count - k - 1));
+    }
+    c->count--;
+    chunk_settle(b, i);
+    return 1;
+}
+
+/* --- ranges --- */
+
+/*
+ * bitset_set_range: Set from, from + step, ... below to
+ *
+ * Works a chunk at a time: array chunks take the new offsets by a sorted
+ * merge, and a chunk that would outgrow the array limit becomes a bitmap
+ * first, where a contiguous run is filled a word at a time.
+ */
+void bitset_set_range(Bitset *b, uint64_t from, uint64_t to, uint64_t step)
+{
+    if (to > BITSET_MAX_INDEX + 1)
+        to = BITSET_MAX_INDEX + 1;
+    if (step == 0)
+        step = 1;
+    uint64_t i = from;
+    while (i < to)
+    {
+        uint32_t key = (uint32_t)(i >> 16);
+        uint64_t end = ((uint64_t)key + 1) << 16;
+        if (end > to)
+            end = to;
+        uint64_t n = (end - i + step - 1) / step; // offsets to set in this chunk
+        int pos;
+        chunk_find(b, key, &pos);
+        Chunk *c = chunk_get(b, key);
+        unsigned lo = (unsigned)(i & 0xffff);
+        if (!c->words && c->count + n > BITSET_ARRAY_MAX)
+            chunk_to_bitmap(c);
+        if (c->words && step == 1)
+        {
+            words_fill(c->words, lo, lo + (unsigned)n, 1);
+            c->count = words_popcount(c->words);
+        }
+        else if (c->words)
+        {
+            uint64_t hi = end - ((uint64_t)key << 16);
+            for (uint64_t off = lo; off < hi; off += step)
+            {
+                uint64_t *w = &c->words[off >> 6];
+                c->count += (int)(~(*w >> (off & 63)) & 1);
+                *w |= 1ULL << (off & 63);
+            }
+        }
+        else
+        {
+            // merge the n new offsets with the existing ones
+            uint16_t *merged = memory_allocate(sizeof(uint16_t) * (c->count + n));
+            int a = 0, m = 0;
+            uint64_t off = lo;
+            for (uint64_t k = 0; k < n; k++, off += step)
+            {
+                while (a < c->count && c->array[a] < off)
+                    merged[m++] = c->array[a++];
+                if (a < c->count && c->array[a] == off)
+                    a++;
+                merged[m++] = (uint16_t)off;
+            }
+            while (a < c->count)
+                merged[m++] = c->array[a++];
+            memory_free(c->array);
+            c->array = merged;
+            c->capacity = (int)(c->count + n);
+            c->count = m;
+        }
+        chunk_settle(b, pos);
+        i += n * step;
+    }
+}
+
+/* bitset_clear_range: Clear from, from + step, ... below to */
+void bitset_clear_range(Bitset *b, uint64_t from, uint64_t to, uint64_t step)
+{
+    if (from > BITSET_MAX_INDEX)
+        return;
+    if (step == 0)
+        step = 1;
+    int pos;
+    chunk_find(b, (uint32_t)(from >> 16), &pos);
+    while (pos < b->count)
+    {
+        Chunk *c = &b->chunks[pos];
+        uint64_t start = (uint64_t)c->key << 16, end = start + 65536;
+        if (start >= to)
+            break;
+        uint64_t first = from;
+        if (first < start)
+            first = from + (start - from + step - 1) / step * step;
+        if (end > to)
+            end = to;
+        if (first < end)
+        {
+            unsigned lo = (unsigned)(first - start), hi = (unsigned)(end - start);
+            if (c->words && step == 1)
+            {
+                words_fill(c->words, lo, hi, 0);
+                c->count = words_popcount(c->words);
+            }
+            else if (c->words && step < 64)
+            {
+                // several offsets per word: clear them all, then recount
+                for (uint64_t off = lo; off < hi; off += step)
+                    c->words[off >> 6] &= ~(1ULL << (off & 63));
+                c->count = words_popcount(c->words);
+            }
+            else if (c->words)
+            {
+                for (uint64_t off = lo; off < hi; off += step)
+                {
+                    uint64_t *w = &c->words[off >> 6];
+                    c->count -= (int)((*w >> (off & 63)) & 1);
+                    *w &= ~(1ULL << (off & 63));
+                }
+            }
+            else if ((hi - lo) / step < (uint64_t)c->count)
+            {
+                // fewer offsets than entries: look each one up, compacting behind
+                int k = 0, m = 0; // next entry to read, next slot to write
+                for (uint64_t off = lo; off < hi && k < c->count; off += step)
+                {
+                    int found = k + array_lower_bound(c->array + k, c->count - k, (unsigned)off);
+                    if (found == c->count || c->array[found] != off)
+                        continue;
+                    if (m != k)
+                        memmove(c->array + m, c->array + k, sizeof(uint16_t) * (found - k));
+                    m += found - k;
+                    k = found + 1;
+                }
+                if (m != k)
+                    memmove(c->array + m, c->array + k, sizeof(uint16_t) * (c->count - k));
+                c->count -= k - m;
+            }
+            else
+            {
+                int m = 0;
+                for (int k = 0; k < c->count; k++)
+                {
+                    unsigned off = c->array[k];
+                    if (off < lo || off >= hi || (off - lo) % step != 0)
+                        c->array[m++] = c->array[k];
+                }
+                c->count = m;
+            }
+        }
+        if (!chunk_settle(b, pos))
+            pos++;
+    }
+}
+
+/* --- whole sets --- */
+
+uint64_t bitset_count(const Bitset *b)
+{
+    uint64_t count = 0;
+    for (int i = 0; i < b->count; i++)
+        count += (uint64_t)b->chunks[i].count;
+    return count;
+}
+
+/* Bytes held by the bitset, for showing what the compression saves */
+uint64_t bitset_bytes(const Bitset *b)
+{
+    uint64_t bytes = sizeof(Bitset) + sizeof(Chunk) * (uint64_t)b->capacity;
+    for (int i = 0; i < b->count; i++)
+    {
+        const Chunk *c = &b->chunks[i];
+        bytes += c->words ? sizeof(uint64_t) * CHUNK_WORDS : sizeof(uint16_t) * (uint64_t)c->capacity;
+    }
+    return bytes;
+}
+
+/* Find the first set bit at or after from; returns 0 if there is none */
+int bitset_next(const Bitset *b, uint64_t from, uint64_t *index)
+{
+    if (from > BITSET_MAX_INDEX)
+        return 0;
+    int pos;
+    uint32_t key = (uint32_t)(from >> 16);
+    chunk_find(b, key, &pos);
+    for (; pos < b->count; pos++)
+    {
+        const Chunk *c = &b->chunks[pos];
+        unsigned lo = c->key == key ? (unsigned)(from & 0xffff) : 0;
+        uint64_t base = (uint64_t)c->key << 16;
+        if (!c->words)
+        {
+            int k = array_lower_bound(c->array, c->count, lo);
+            if (k < c->count)
+            {
+                *index = base + c->array[k];
+                return 1;
+            }
+            continue;
+        }
+        unsigned word = lo >> 6;
+        uint64_t w = c->words[word] & (~0ULL << (lo & 63));
+        for (;;)
+        {
+            if (w)
+            {
+                *index = base + word * 64 + (unsigned)__builtin_ctzll(w);
+                return 1;
+            }
+            if (++word == CHUNK_WORDS)
+                break;
+            w = c->words[word];
+        }
+    }
+    return 0;
+}
+
+int bitset_equal(const Bitset *a, const Bitset *b)
+{
+    if (a->count != b->count)
+        return 0;
+    for (int i = 0; i < a->count; i++)
+    {
+        const Chunk *x = &a->chunks[i], *y = &b->chunks[i];
+        if (x->key != y->key || x->count != y->count)
+            return 0;
+        if (x->words ? memcmp(x->words, y->words, sizeof(uint64_t) * CHUNK_WORDS) != 0
+                     : memcmp(x->array, y->array, sizeof(uint16_t) * x->count) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+static Chunk *chunk_append(Bitset *b, uint32_t key)
+{
+    return chunk_insert(b, b->count, key);
+}
+
+static void chunk_copy(Bitset *b, const Chunk *c)
+{
+    Chunk *out = chunk_append(b, c->key);
+    out->count = c->count;
+    if (c->words)
+    {
+        out->words = memory_allocate(sizeof(uint64_t) * CHUNK_WORDS);
+        memcpy(out->words, c->words, sizeof(uint64_t) * CHUNK_WORDS);
+    }
+    else
+    {
+        out->capacity = c->count;
+        out->array = memory_allocate(sizeof(uint16_t) * c->count);
+        memcpy(out->array, c->array, sizeof(uint16_t) * c->count);
+    }
+}
+
+/* Bitmap words for either kind of chunk; array chunks are expanded into scratch */
+static const uint64_t *chunk_words(const Chunk *c, uint64_t *scratch)
+{
+    if (c->words)
+        return c->words;
+    memset(scratch, 0, sizeof(uint64_t) * CHUNK_WORDS);
+    for (int i = 0; i < c->count; i++)
+        scratch[c->array[i] >> 6] |= 1ULL << (c->array[i] & 63);
+    return scratch;
+}
+
+/* Append x op y for two chunks with the same key, unless it is empty */
+static void chunk_combine(Bitset *r, BitsetOp op, const Chunk *x, const Chunk *y)
+{
+    Chunk *out = chunk_append(r, x->key);
+    if (!x->words && !y->words)
+    {
+        // sorted merge of two arrays
+        out->capacity = x->count + y->count;
+        out->array = memory_allocate(sizeof(uint16_t) * (out->capacity ? out->capacity : 1));
+        int i = 0, j = 0, n = 0;
+        while (i < x->count || j < y->count)
+        {
+            int take_x = j == y->count || (i < x->count && x->array[i] < y->array[j]);
+            int take_y = i == x->count || (j < y->count && y->array[j] < x->array[i]);
+            if (take_x)
+            {
+                if (op != BITSET_AND)
+                    out->array[n++] = x->array[i];
+                i++;
+            }
+            else if (take_y)
+            {
+                if (op == BITSET_OR || op == BITSET_XOR)
+                    out->array[n++] = y->array[j];
+                j++;
+            }
+            else
+            {
+                if (op == BITSET_AND || op == BITSET_OR)
+                    out->array[n++] = x->array[i];
+                i++;
+                j++;
+            }
+        }
+        out->count = n;
+    }
+    else if (!x->words && (op == BITSET_AND || op == BITSET_ANDNOT))
+    {
+        // the result is a subset of x's array
+        out->capacity = x->count;
+        out->array = memory_allocate(sizeof(uint16_t) * x->count);
+        int n = 0;
+        for (int i = 0; i < x->count; i++)
+        {
+            if (words_test(y->words, x->array[i]) == (op == BITSET_AND))
+                out->array[n++] = x->array[i];
+        }
+        out->count = n;
+    }
+    else
+    {
+        uint64_t scratch[CHUNK_WORDS];
+        out->words = memory_allocate(sizeof(uint64_t) * CHUNK_WORDS);
+        out->count = words_combine(op, chunk_words(x, scratch), chunk_words(y, scratch), out->words);
+    }
+    chunk_settle(r, r->count - 1);
+}
+
+/*
+ * bitset_combine: A new bitset holding a op b
+ *
+ * Chunks are matched up by key; a chunk present on one side only is copied
+ * or dropped as the operation requires, so the cost follows the number of
+ * chunks rather than the highest index.
+ */
+Bitset *bitset_combine(BitsetOp op, const Bitset *a, const Bitset *b)
+{
+    Bitset *r = bitset_create();
+    int i = 0, j = 0;
+    while (i < a->count || j < b->count)
+    {
+        const Chunk *x = i < a->count ? &a->chunks[i] : NULL;
+        const Chunk *y = j < b->count ? &b->chunks[j] : NULL;
+        if (!y || (x && x->key < y->key))
+        {
+            if (op != BITSET_AND)
+                chunk_copy(r, x);
+            i++;
+        }
+        else if (!x || y->key < x->key)
+        {
+            if (op == BITSET_OR || op == BITSET_XOR)
+                chunk_copy(r, y);
+            j++;
+        }
+        else
+        {
+            chunk_combine(r, op, x, y);
+            i++;
+            j++;
+        }
+    }
+    return r;
+}
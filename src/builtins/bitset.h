@@ -0,0 +1,42 @@
+#ifndef SHARPSCRIPT_BITSET_H
+#define SHARPSCRIPT_BITSET_H
+
+#include <stdint.h>
+
+/*
+ * Bitsets behind VAL_BITSET, compressed the way Roaring bitmaps are: bit
+ * indexes are split into chunks of 2^16, and each chunk with any bits set
+ * is either a sorted array of 16-bit offsets (up to BITSET_ARRAY_MAX bits)
+ * or a plain bitmap of 64-bit words. Sparse sets cost about two bytes per
+ * bit, dense ones one bit per bit. Bitsets are shared by reference count.
+ */
+#define BITSET_ARRAY_MAX 4096
+#define BITSET_MAX_INDEX ((1ULL << 48) - 1)
+
+typedef enum
+{
+    BITSET_AND,
+    BITSET_OR,
+    BITSET_XOR,
+    BITSET_ANDNOT
+} BitsetOp;
+
+typedef struct Bitset Bitset;
+
+Bitset *bitset_create(void);
+Bitset *bitset_retain(Bitset *b);
+void bitset_release(Bitset *b);
+
+int bitset_test(const Bitset *b, uint64_t index);
+int bitset_set(Bitset *b, uint64_t index);
+int bitset_clear(Bitset *b, uint64_t index);
+void bitset_set_range(Bitset *b, uint64_t from, uint64_t to, uint64_t step);
+void bitset_clear_range(Bitset *b, uint64_t from, uint64_t to, uint64_t step);
+
+uint64_t bitset_count(const Bitset *b);
+uint64_t bitset_bytes(const Bitset *b);
+int bitset_next(const Bitset *b, uint64_t from, uint64_t *index);
+int bitset_equal(const Bitset *a, const Bitset *b);
+Bitset *bitset_combine(BitsetOp op, const Bitset *a, const Bitset *b);
+
+#endif
@@ -0,0 +1,264 @@
+#include "buffer.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BUFFER_HOST_BIG_ENDIAN 1
+#else
+#define BUFFER_HOST_BIG_ENDIAN 0
+#endif
+
+/* The bytes shared by every view of one buffer */
+typedef struct
+{
+    int refs;
+    uint8_t *data;
+} ByteBlock;
+
+struct Buffer
+{
+    int refs;
+    ByteBlock *block;
+    size_t offset;
+    size_t length;
+};
+
+static Buffer *buffer_view(ByteBlock *block, size_t offset, size_t length)
+{
+    Buffer *b = memory_allocate(sizeof(Buffer));
+    b->refs = 1;
+    b->block = block;
+    b->offset = offset;
+    b->length = length;
+    return b;
+}
+
+/* Take over data (allocated with memory_allocate) as a new buffer */
+Buffer *buffer_wrap(uint8_t *data, size_t length)
+{
+    ByteBlock *block = memory_allocate(sizeof(ByteBlock));
+    block->refs = 1;
+    block->data = data;
+    return buffer_view(block, 0, length);
+}
+
+/* A new zero-filled buffer */
+Buffer *buffer_create(size_t length)
+{
+    uint8_t *data = memory_allocate(length ? length : 1);
+    memset(data, 0, length);
+    return buffer_wrap(data, length);
+}
+
+/* A view of length bytes from offset, clamped to b; shares b's bytes */
+Buffer *buffer_slice(Buffer *b, size_t offset, size_t length)
+{
+    if (offset > b->length)
+        offset = b->length;
+    if (length > b->length - offset)
+        length = b->length - offset;
+    b->block->refs++;
+    return buffer_view(b->block, b->offset + offset, length);
+}
+
+Buffer *buffer_retain(Buffer *b)
+{
+    b->refs++;
+    return b;
+}
+
+void buffer_release(Buffer *b)
+{
+    if (!b || --b->refs > 0)
+        return;
+    if (--b->block->refs == 0)
+    {
+        memory_free(b->block->data);
+        memory_free(b->block);
+    }
+    memory_free(b);
+}
+
+uint8_t *buffer_data(const Buffer *b)
+{
+    return b->block->data + b->offset;
+}
+
+size_t buffer_length(const Buffer *b)
+{
+    return b->length;
+}
+
+/*
+ * buffer_type_parse: Read a type name such as "u8", "i32", "f64be"
+ *
+ * Names are u8..u64, i8..i64, f32 and f64, optionally followed by "le"
+ * (the default) or "be". Returns 0 for anything else.
+ */
+int buffer_type_parse(const char *name, BufferType *type, int *big_endian)
+{
+    static const struct
+    {
+        const char *name;
+        BufferType type;
+    } types[] = {{"u8", BUFFER_U8},   {"i8", BUFFER_I8},   {"u16", BUFFER_U16}, {"i16", BUFFER_I16},
+                 {"u32", BUFFER_U32}, {"i32", BUFFER_I32}, {"u64", BUFFER_U64}, {"i64", BUFFER_I64},
+                 {"f32", BUFFER_F32}, {"f64", BUFFER_F64}};
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+    {
+        size_t n = strlen(types[i].name);
+        if (strncmp(name, types[i].name, n) != 0)
+            continue;
+        const char *suffix = name + n;
+        if (*suffix == '\0' || strcmp(suffix, "le") == 0)
+            *big_endian = 0;
+        else if (strcmp(suffix, "be") == 0)
+            *big_endian = 1;
+        else
+            continue;
+        *type = types[i].type;
+        return 1;
+    }
+    return 0;
+}
+
+size_t buffer_type_size(BufferType type)
+{
+    switch (type)
+    {
+    case BUFFER_U8:
+    case BUFFER_I8:
+        return 1;
+    case BUFFER_U16:
+    case BUFFER_I16:
+        return 2;
+    case BUFFER_U32:
+    case BUFFER_I32:
+    case BUFFER_F32:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
+/* Swap the low size bytes of bits end for end */
+static uint64_t swap_bytes(uint64_t bits, size_t size)
+{
+    switch (size)
+    {
+    case 2:
+        return __builtin_bswap16((uint16_t)bits);
+    case 4:
+        return __builtin_bswap32((uint32_t)bits);
+    case 8:
+        return __builtin_bswap64(bits);
+    default:
+        return bits;
+    }
+}
+
+/*
+ * buffer_load: Read a size-byte (1, 2, 4 or 8) value at offset into the low
+ * bits of *bits, zero-extended
+ *
+ * Returns 0 if the value does not lie inside the buffer.
+ */
+int buffer_load(const Buffer *b, size_t offset, size_t size, int big_endian, uint64_t *bits)
+{
+    if (offset > b->length || size > b->length - offset)
+        return 0;
+    const uint8_t *p = buffer_data(b) + offset;
+    switch (size)
+    {
+    case 1:
+        *bits = p[0];
+        return 1;
+    case 2:
+    {
+        uint16_t v;
+        memcpy(&v, p, 2);
+        *bits = v;
+        break;
+    }
+    case 4:
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        *bits = v;
+        break;
+    }
+    default:
+        memcpy(bits, p, 8);
+        break;
+    }
+    if (big_endian != BUFFER_HOST_BIG_ENDIAN)
+        *bits = swap_bytes(*bits, size);
+    return 1;
+}
+
+/* buffer_store: Write the low size bytes of bits at offset; returns 0 if they do not fit */
+int buffer_store(Buffer *b, size_t offset, size_t size, int big_endian, uint64_t bits)
+{
+    if (offset > b->length || size > b->length - offset)
+        return 0;
+    if (big_endian != BUFFER_HOST_BIG_ENDIAN)
+        bits = swap_bytes(bits, size);
+    uint8_t *p = buffer_data(b) + offset;
+    switch (size)
+    {
+    case 1:
+        p[0] = (uint8_t)bits;
+        break;
+    case 2:
+    {
+        uint16_t v = (uint16_t)bits;
+        memcpy(p, &v, 2);
+        break;
+    }
+    case 4:
+    {
+        uint32_t v = (uint32_t)bits;
+        memcpy(p, &v, 4);
+        break;
+    }
+    default:
+        memcpy(p, &bits, 8);
+        break;
+    }
+    return 1;
+}
+
+/* Read a whole file as bytes; NULL if it cannot be read */
+Buffer *buffer_read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    if (fseek(f, 0, SEEK_END) != 0)
+    {
+        fclose(f);
+        return NULL;
+    }
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0)
+    {
+        fclose(f);
+        return NULL;
+    }
+    uint8_t *data = memory_allocate(size ? (size_t)size : 1);
+    size_t got = fread(data, 1, (size_t)size, f);
+    fclose(f);
+    return buffer_wrap(data, got);
+}
+
+/* Write a buffer's bytes to a file; returns 0 on failure */
+int buffer_write_file(const char *path, const Buffer *b)
+{
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return 0;
+    size_t wrote = fwrite(buffer_data(b), 1, b->length, f);
+    return fclose(f) == 0 && wrote == b->length;
+}
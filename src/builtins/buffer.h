@@ -0,0 +1,46 @@
+#ifndef SHARPSCRIPT_BUFFER_H
+#define SHARPSCRIPT_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Byte buffers behind VAL_BUFFER. A buffer is a view (offset and length)
+ * of a reference-counted block of bytes; slices are new views of the same
+ * block, so they copy nothing and writes through one view are seen by all
+ * the others. Views themselves are shared by reference count too.
+ */
+typedef enum
+{
+    BUFFER_U8,
+    BUFFER_I8,
+    BUFFER_U16,
+    BUFFER_I16,
+    BUFFER_U32,
+    BUFFER_I32,
+    BUFFER_U64,
+    BUFFER_I64,
+    BUFFER_F32,
+    BUFFER_F64
+} BufferType;
+
+typedef struct Buffer Buffer;
+
+Buffer *buffer_create(size_t length);
+Buffer *buffer_wrap(uint8_t *data, size_t length);
+Buffer *buffer_slice(Buffer *b, size_t offset, size_t length);
+Buffer *buffer_retain(Buffer *b);
+void buffer_release(Buffer *b);
+
+uint8_t *buffer_data(const Buffer *b);
+size_t buffer_length(const Buffer *b);
+
+int buffer_type_parse(const char *name, BufferType *type, int *big_endian);
+size_t buffer_type_size(BufferType type);
+int buffer_load(const Buffer *b, size_t offset, size_t size, int big_endian, uint64_t *bits);
+int buffer_store(Buffer *b, size_t offset, size_t size, int big_endian, uint64_t bits);
+
+Buffer *buffer_read_file(const char *path);
+int buffer_write_file(const char *path, const Buffer *b);
+
+#endif
@@ -0,0 +1,662 @@
+#include "calcmem.h"
+#include "bignum.h"
+#include "hash.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Store file layout (host byte order):
+ *   "SSMEM001", then records of
+ *   u32 name length, name bytes, u32 value length, encoded value
+ *
+ * Records are only ever appended and the last record for a name wins. A
+ * record with an empty value is a tombstone: the name was last given a value
+ * that can't be persisted, so older records for it must not come back. When
+ * a file is opened only the record headers are read; values are decoded from
+ * the mapping the first time they are recalled. The file is rewritten with
+ * one record per persistable name when it holds many superseded records.
+ *
+ * Encoded values are a type byte followed by
+ *   'n' double | 'i' int64 | 'b' u8 | 'z' nothing | 's' u32 length + bytes
+ *   'd' decimal | 'g' bigint, both as u32 length + decimal text
+ *   'a' u32 count + values | 'm' u32 count + (u32 length + key bytes + value)
+ * Other value types (functions, classes, ...) are kept in memory only.
+ */
+#define CALCMEM_MAGIC "SSMEM001"
+#define CALCMEM_MAGIC_LEN 8
+
+typedef struct
+{
+    char *name;      // NULL for an empty slot
+    Value *value;    // decoded value, NULL while it only lives in the mapped file
+    size_t offset;   // encoded value in the map
+    uint32_t length; // 0 with no value: the name is unset (a tombstone was read)
+} CalcMemoryEntry;
+
+struct CalcMemory
+{
+    CalcMemoryEntry *slots; // open addressing with linear probing
+    int count;
+    int capacity;
+    char *path;
+    FILE *log;                // append handle of the store file
+    unsigned char *map;       // store file contents as of calcmem_open
+    size_t map_size;
+    int records;              // records in the store file
+};
+
+typedef struct
+{
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+} CalcBuffer;
+
+/*
+ * calcmem_slot: Find the slot holding name, or the empty slot it would go in
+ */
+static CalcMemoryEntry *calcmem_slot(CalcMemory *mem, const char *name)
+{
+    unsigned long mask = (unsigned long)mem->capacity - 1;
+    unsigned long i = hash_string(name) & mask;
+    while (mem->slots[i].name && strcmp(mem->slots[i].name, name) != 0)
+        i = (i + 1) & mask;
+    return &mem->slots[i];
+}
+
+static void calcmem_grow(CalcMemory *mem)
+{
+    CalcMemoryEntry *old = mem->slots;
+    int old_capacity = mem->capacity;
+    mem->capacity = old_capacity ? old_capacity * 2 : 32;
+    mem->slots = memory_allocate(sizeof(CalcMemoryEntry) * mem->capacity);
+    memset(mem->slots, 0, sizeof(CalcMemoryEntry) * mem->capacity);
+    for (int i = 0; i < old_capacity; i++)
+    {
+        if (old[i].name)
+            *calcmem_slot(mem, old[i].name) = old[i];
+    }
+    memory_free(old);
+}
+
+static CalcMemoryEntry *calcmem_insert(CalcMemory *mem, const char *name)
+{
+    // keep the load factor below one half
+    if ((mem->count + 1) * 2 > mem->capacity)
+        calcmem_grow(mem);
+    CalcMemoryEntry *entry = calcmem_slot(mem, name);
+    if (!entry->name)
+    {
+        entry->name = memory_strdup(name);
+        entry->value = NULL;
+        entry->offset = 0;
+        entry->length = 0;
+        mem->count++;
+    }
+    return entry;
+}
+
+static void buffer_put(CalcBuffer *b, const void *bytes, size_t n)
+{
+    if (b->size + n > b->capacity)
+    {
+        while (b->size + n > b->capacity)
+            b->capacity = b->capacity ? b->capacity * 2 : 64;
+        b->data = memory_reallocate(b->data, b->capacity);
+    }
+    memcpy(b->data + b->size, bytes, n);
+    b->size += n;
+}
+
+static void buffer_put_u32(CalcBuffer *b, uint32_t n)
+{
+    buffer_put(b, &n, sizeof(n));
+}
+
+/*
+ * calcmem_encode: Append the encoding of a value
+ *
+ * Returns: 1 on success, 0 if the value (or something inside it) can't be persisted
+ */
+static int calcmem_encode(CalcBuffer *b, Value *v)
+{
+    unsigned char tag;
+    switch (v->type)
+    {
+    case VAL_NUMBER:
+        tag = 'n';
+        buffer_put(b, &tag, 1);
+        buffer_put(b, &v->data.number, sizeof(double));
+        return 1;
+    case VAL_INT:
+        tag = 'i';
+        buffer_put(b, &tag, 1);
+        buffer_put(b, &v->data.integer, sizeof(long long));
+        return 1;
+    case VAL_BIGNUM:
+    {
+        char *text = bignum_to_string(v->data.bignum);
+        uint32_t len = (uint32_t)strlen(text);
+        tag = bignum_is_decimal(v->data.bignum) ? 'd' : 'g';
+        buffer_put(b, &tag, 1);
+        buffer_put_u32(b, len);
+        buffer_put(b, text, len);
+        memory_free(text);
+        return 1;
+    }
+    case VAL_BOOLEAN:
+    {
+        unsigned char flag = v->data.boolean ? 1 : 0;
+        tag = 'b';
+        buffer_put(b, &tag, 1);
+        buffer_put(b, &flag, 1);
+        return 1;
+    }
+    case VAL_NULL:
+        tag = 'z';
+        buffer_put(b, &tag, 1);
+        return 1;
+    case VAL_STRING:
+    {
+        uint32_t len = (uint32_t)strlen(v->data.string);
+        tag = 's';
+        buffer_put(b, &tag, 1);
+        buffer_put_u32(b, len);
+        buffer_put(b, v->data.string, len);
+        return 1;
+    }
+    case VAL_ARRAY:
+        tag = 'a';
+        buffer_put(b, &tag, 1);
+        buffer_put_u32(b, (uint32_t)v->data.array.count);
+        for (int i = 0; i < v->data.array.count; i++)
+        {
+            if (!calcmem_encode(b, v->data.array.elements[i]))
+                return 0;
+        }
+        return 1;
+    case VAL_MAP:
+        tag = 'm';
+        buffer_put(b, &tag, 1);
+        buffer_put_u32(b, (uint32_t)v->data.map.count);
+        for (int i = 0; i < v->data.map.count; i++)
+        {
+            uint32_t len = (uint32_t)strlen(v->data.map.keys[i]);
+            buffer_put_u32(b, len);
+            buffer_put(b, v->data.map.keys[i], len);
+            if (!calcmem_encode(b, v->data.map.values[i]))
+                return 0;
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int read_u32(const unsigned char **p, const unsigned char *end, uint32_t *out)
+{
+    if ((size_t)(end - *p) < sizeof(uint32_t))
+        return 0;
+    memcpy(out, *p, sizeof(uint32_t));
+    *p += sizeof(uint32_t);
+    return 1;
+}
+
+static char *read_text(const unsigned char **p, const unsigned char *end)
+{
+    uint32_t len;
+    if (!read_u32(p, end, &len) || (size_t)(end - *p) < len)
+        return NULL;
+    char *text = memory_allocate(len + 1);
+    memcpy(text, *p, len);
+    text[len] = '\0';
+    *p += len;
+    return text;
+}
+
+/*
+ * calcmem_decode: Decode one value, advancing *p past it
+ *
+ * Returns: The new value, or NULL if the bytes are malformed
+ */
+static Value *calcmem_decode(const unsigned char **p, const unsigned char *end)
+{
+    if (*p >= end)
+        return NULL;
+    unsigned char tag = *(*p)++;
+    switch (tag)
+    {
+    case 'n':
+    {
+        double number;
+        if ((size_t)(end - *p) < sizeof(double))
+            return NULL;
+        memcpy(&number, *p, sizeof(double));
+        *p += sizeof(double);
+        return value_create_number(number);
+    }
+    case 'i':
+    {
+        long long integer;
+        if ((size_t)(end - *p) < sizeof(long long))
+            return NULL;
+        memcpy(&integer, *p, sizeof(long long));
+        *p += sizeof(long long);
+        return value_create_int(integer);
+    }
+    case 'd':
+    case 'g':
+    {
+        char *text = read_text(p, end);
+        if (!text)
+            return NULL;
+        BigNum *num = bignum_from_string(text, tag == 'd');
+        memory_free(text);
+        return num ? value_create_bignum(num) : NULL;
+    }
+    case 'b':
+        if (*p >= end)
+            return NULL;
+        return value_create_boolean(*(*p)++ != 0);
+    case 'z':
+        return value_create_null();
+    case 's':
+    {
+        char *text = read_text(p, end);
+        if (!text)
+            return NULL;
+        Value *v = value_create_string(text);
+        memory_free(text);
+        return v;
+    }
+    case 'a':
+    {
+        uint32_t count;
+        if (!read_u32(p, end, &count))
+            return NULL;
+        Value *arr = value_create_array();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            Value *elem = calcmem_decode(p, end);
+            if (!elem)
+            {
+                value_free(arr);
+                return NULL;
+            }
+            value_array_push(arr, elem);
+        }
+        return arr;
+    }
+    case 'm':
+    {
+        uint32_t count;
+        if (!read_u32(p, end, &count))
+            return NULL;
+        Value *map = value_create_map();
+        for (uint32_t i = 0; i < count; i++)
+        {
+            char *key = read_text(p, end);
+            Value *elem = key ? calcmem_decode(p, end) : NULL;
+            if (!elem)
+            {
+                memory_free(key);
+                value_free(map);
+                return NULL;
+            }
+            value_map_set(map, key, elem);
+            memory_free(key);
+        }
+        return map;
+    }
+    default:
+        return NULL;
+    }
+}
+
+/*
+ * calcmem_materialize: Decode an entry that so far only lives in the map
+ */
+static Value *calcmem_materialize(CalcMemory *mem, CalcMemoryEntry *entry)
+{
+    if (!entry->value && entry->length && mem->map)
+    {
+        const unsigned char *p = mem->map + entry->offset;
+        entry->value = calcmem_decode(&p, p + entry->length);
+        if (!entry->value)
+        {
+            fprintf(stderr, "Calculator memory: corrupt value for '%s' in %s\n", entry->name, mem->path);
+            entry->value = value_create_null();
+        }
+    }
+    return entry->value;
+}
+
+/*
+ * calcmem_append: Write a record for name to the store file
+ *
+ * A NULL value writes a tombstone.
+ *
+ * Returns: 1 on success, 0 if the value can't be persisted (nothing is written)
+ */
+static int calcmem_append(CalcMemory *mem, const char *name, Value *value)
+{
+    CalcBuffer b = {NULL, 0, 0};
+    uint32_t name_len = (uint32_t)strlen(name);
+    buffer_put_u32(&b, name_len);
+    buffer_put(&b, name, name_len);
+    buffer_put_u32(&b, 0); // value length, patched below
+    size_t start = b.size;
+    if (value && !calcmem_encode(&b, value))
+    {
+        memory_free(b.data);
+        return 0;
+    }
+    uint32_t value_len = (uint32_t)(b.size - start);
+    memcpy(b.data + start - sizeof(uint32_t), &value_len, sizeof(uint32_t));
+    fwrite(b.data, 1, b.size, mem->log);
+    fflush(mem->log);
+    memory_free(b.data);
+    mem->records++;
+    return 1;
+}
+
+/*
+ * calcmem_persist: Append a value for name, or a tombstone if it can't be persisted
+ */
+static void calcmem_persist(CalcMemory *mem, const char *name, Value *value)
+{
+    if (!calcmem_append(mem, name, value))
+        calcmem_append(mem, name, NULL);
+}
+
+static void calcmem_unmap(CalcMemory *mem)
+{
+    if (!mem->map)
+        return;
+#ifdef _WIN32
+    memory_free(mem->map);
+#else
+    munmap(mem->map, mem->map_size);
+#endif
+    mem->map = NULL;
+    mem->map_size = 0;
+}
+
+/*
+ * calcmem_detach: Stop using the store file, keeping every value in memory
+ */
+static void calcmem_detach(CalcMemory *mem)
+{
+    for (int i = 0; i < mem->capacity; i++)
+    {
+        if (mem->slots[i].name)
+            calcmem_materialize(mem, &mem->slots[i]);
+        mem->slots[i].length = 0; // nothing is mapped any more
+    }
+    calcmem_unmap(mem);
+    if (mem->log)
+        fclose(mem->log);
+    mem->log = NULL;
+    memory_free(mem->path);
+    mem->path = NULL;
+    mem->records = 0;
+}
+
+/*
+ * calcmem_rewrite: Replace the store file with one record per persistable name
+ */
+static void calcmem_rewrite(CalcMemory *mem)
+{
+    char *path = memory_strdup(mem->path);
+    calcmem_detach(mem);
+
+    char *tmp = memory_allocate(strlen(path) + 5);
+    sprintf(tmp, "%s.tmp", path);
+    mem->log = fopen(tmp, "wb");
+    if (mem->log)
+    {
+        fwrite(CALCMEM_MAGIC, 1, CALCMEM_MAGIC_LEN, mem->log);
+        // unset names and values that can't be persisted are left out
+        for (int i = 0; i < mem->capacity; i++)
+        {
+            if (mem->slots[i].name && mem->slots[i].value)
+                calcmem_append(mem, mem->slots[i].name, mem->slots[i].value);
+        }
+        fclose(mem->log);
+        remove(path); // rename does not replace existing files on Windows
+        rename(tmp, path);
+    }
+    mem->log = fopen(path, "ab");
+    mem->path = path;
+    memory_free(tmp);
+}
+
+static int calcmem_map_file(CalcMemory *mem, const char *path)
+{
+#ifdef _WIN32
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 1;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size > 0)
+    {
+        mem->map = memory_allocate(size);
+        mem->map_size = fread(mem->map, 1, size, f);
+    }
+    fclose(f);
+    return 1;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 1; // a new store
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED)
+        {
+            close(fd);
+            return 0;
+        }
+        mem->map = map;
+        mem->map_size = st.st_size;
+    }
+    close(fd);
+    return 1;
+#endif
+}
+
+CalcMemory *calcmem_create(void)
+{
+    CalcMemory *mem = memory_allocate(sizeof(CalcMemory));
+    memset(mem, 0, sizeof(CalcMemory));
+    calcmem_grow(mem);
+    return mem;
+}
+
+void calcmem_free(CalcMemory *mem)
+{
+    if (!mem)
+        return;
+    // compact on the way out if most records are superseded
+    if (mem->log && mem->records > 2 * mem->count + 64)
+        calcmem_rewrite(mem);
+    calcmem_unmap(mem);
+    if (mem->log)
+        fclose(mem->log);
+    for (int i = 0; i < mem->capacity; i++)
+    {
+        if (mem->slots[i].name)
+        {
+            memory_free(mem->slots[i].name);
+            value_free(mem->slots[i].value);
+        }
+    }
+    memory_free(mem->slots);
+    memory_free(mem->path);
+    memory_free(mem);
+}
+
+/*
+ * calcmem_set: Store a value under name (ownership of value passes to the memory)
+ *
+ * With a store file attached the value is appended to it right away. A value
+ * that can't be persisted appends a tombstone instead, so the next run does
+ * not bring back an older value for the name.
+ */
+void calcmem_set(CalcMemory *mem, const char *name, Value *value)
+{
+    CalcMemoryEntry *entry = calcmem_insert(mem, name);
+    value_free(entry->value);
+    entry->value = value;
+    if (mem->log)
+        calcmem_persist(mem, name, value);
+}
+
+/*
+ * calcmem_get: Look up a stored value
+ *
+ * Returns: The stored value (owned by the memory), or NULL if name is unset
+ */
+Value *calcmem_get(CalcMemory *mem, const char *name)
+{
+    CalcMemoryEntry *entry = calcmem_slot(mem, name);
+    if (!entry->name)
+        return NULL;
+    return calcmem_materialize(mem, entry); // NULL for a name a tombstone unset
+}
+
+/*
+ * calcmem_clear: Forget every value (and empty the store file, if any)
+ */
+void calcmem_clear(CalcMemory *mem)
+{
+    calcmem_unmap(mem);
+    for (int i = 0; i < mem->capacity; i++)
+    {
+        if (mem->slots[i].name)
+        {
+            memory_free(mem->slots[i].name);
+            value_free(mem->slots[i].value);
+        }
+    }
+    memset(mem->slots, 0, sizeof(CalcMemoryEntry) * mem->capacity);
+    mem->count = 0;
+
+    if (mem->log)
+    {
+        fclose(mem->log);
+        mem->log = fopen(mem->path, "wb");
+        if (mem->log)
+        {
+            fwrite(CALCMEM_MAGIC, 1, CALCMEM_MAGIC_LEN, mem->log);
+            fflush(mem->log);
+        }
+        mem->records = 0;
+    }
+}
+
+/*
+ * calcmem_open: Attach a store file, creating it if needed
+ *
+ * Names already in the store are indexed without decoding their values.
+ * Values stored before the file was attached take precedence and are
+ * written to it.
+ *
+ * Returns: 1 on success, 0 if the file can't be used
+ */
+int calcmem_open(CalcMemory *mem, const char *path)
+{
+    if (!path)
+        return 0;
+    if (mem->path)
+        calcmem_detach(mem);
+
+    if (!calcmem_map_file(mem, path))
+    {
+        fprintf(stderr, "Calculator memory: could not map %s\n", path);
+        return 0;
+    }
+    if (mem->map && (mem->map_size < CALCMEM_MAGIC_LEN || memcmp(mem->map, CALCMEM_MAGIC, CALCMEM_MAGIC_LEN) != 0))
+    {
+        fprintf(stderr, "Calculator memory: %s is not a calculator memory file\n", path);
+        calcmem_unmap(mem);
+        return 0;
+    }
+
+    mem->path = memory_strdup(path);
+    mem->records = 0;
+    int damaged = 0;
+    if (mem->map)
+    {
+        const unsigned char *p = mem->map + CALCMEM_MAGIC_LEN;
+        const unsigned char *end = mem->map + mem->map_size;
+        while (p < end)
+        {
+            uint32_t name_len, value_len;
+            if (!read_u32(&p, end, &name_len) || (size_t)(end - p) < name_len)
+            {
+                damaged = 1;
+                break;
+            }
+            char *name = memory_allocate(name_len + 1);
+            memcpy(name, p, name_len);
+            name[name_len] = '\0';
+            p += name_len;
+            if (!read_u32(&p, end, &value_len) || (size_t)(end - p) < value_len)
+            {
+                memory_free(name);
+                damaged = 1;
+                break;
+            }
+
+            // values set before the file was attached win over the file;
+            // a tombstone (empty value) unsets the name
+            CalcMemoryEntry *entry = calcmem_slot(mem, name);
+            if (!entry->name || !entry->value)
+            {
+                entry = calcmem_insert(mem, name);
+                entry->offset = (size_t)(p - mem->map);
+                entry->length = value_len;
+            }
+            memory_free(name);
+            p += value_len;
+            mem->records++;
+        }
+    }
+
+    // a truncated tail (interrupted write) would hide later appends: rewrite instead
+    if (damaged)
+    {
+        fprintf(stderr, "Calculator memory: %s has a damaged tail, rewriting it\n", path);
+        calcmem_rewrite(mem);
+        return mem->log != NULL;
+    }
+
+    mem->log = fopen(path, "ab");
+    if (!mem->log)
+    {
+        fprintf(stderr, "Calculator memory: could not open %s for writing\n", path);
+        calcmem_detach(mem);
+        return 0;
+    }
+    if (!mem->map)
+        fwrite(CALCMEM_MAGIC, 1, CALCMEM_MAGIC_LEN, mem->log);
+    for (int i = 0; i < mem->capacity; i++)
+    {
+        if (mem->slots[i].name && mem->slots[i].value)
+            calcmem_persist(mem, mem->slots[i].name, mem->slots[i].value);
+    }
+    fflush(mem->log);
+    return 1;
+}
@@ -0,0 +1,19 @@
+#ifndef SHARPSCRIPT_CALCMEM_H
+#define SHARPSCRIPT_CALCMEM_H
+
+#include "../include/interpreter.h"
+
+/*
+ * Calculator memory behind system.store/system.recall: a hash table of named
+ * values, optionally backed by a file so values survive across runs.
+ */
+typedef struct CalcMemory CalcMemory;
+
+CalcMemory *calcmem_create(void);
+void calcmem_free(CalcMemory *mem);
+void calcmem_set(CalcMemory *mem, const char *name, Value *value);
+Value *calcmem_get(CalcMemory *mem, const char *name);
+void calcmem_clear(CalcMemory *mem);
+int calcmem_open(CalcMemory *mem, const char *path);
+
+#endif
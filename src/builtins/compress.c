@@ -0,0 +1,1452 @@
+#include "compress.h"
+#include "hash.h"
+#include "../include/memory.h"
+#include <string.h>
+
+#define COMPRESS_CHUNK 65536 // compressed bytes requested from the source at a time
+
+#define LZ4_MAGIC 0x184D2204u
+#define LZ4_HISTORY 65536 // the farthest an LZ4 match reaches back
+
+int compress_format_parse(const char *name, CompressFormat *format)
+{
+    if (strcmp(name, "gzip") == 0)
+        *format = COMPRESS_GZIP;
+    else if (strcmp(name, "deflate") == 0)
+        *format = COMPRESS_DEFLATE;
+    else if (strcmp(name, "lz4") == 0)
+        *format = COMPRESS_LZ4;
+    else
+        return 0;
+    return 1;
+}
+
+static uint32_t load32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void store32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* --- DEFLATE tables (RFC 1951) --- */
+
+static const uint16_t len_base[29] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                      31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t len_extra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                                      2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t dist_base[30] = {1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+                                       33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+                                       1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const uint8_t dist_extra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                       6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const uint8_t code_length_order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+/* The fixed code of block type 1: 288 literal/length lengths, then 32 distance lengths */
+static void fixed_lengths(uint8_t *lens)
+{
+    for (int i = 0; i < 288; i++)
+        lens[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    for (int i = 0; i < 32; i++)
+        lens[288 + i] = 5;
+}
+
+static uint32_t reverse_bits(uint32_t code, int len)
+{
+    uint32_t r = 0;
+    for (int i = 0; i < len; i++, code >>= 1)
+        r = r << 1 | (code & 1);
+    return r;
+}
+
+/* --- compressed input, pulled through the read callback --- */
+
+typedef struct Inflater Inflater;
+typedef struct Lz4Reader Lz4Reader;
+
+struct CompressStream
+{
+    CompressFormat format;
+    CompressReadFn read;
+    void *ctx;
+    uint8_t *in;
+    size_t in_pos, in_len;
+    int in_eof;
+    int failed; // corrupt input: every later read returns -1
+    Inflater *inflate;
+    Lz4Reader *lz4;
+};
+
+/* Make at least n (<= COMPRESS_CHUNK) bytes readable; returns 0 if the input ends first */
+static int src_ensure(CompressStream *s, size_t n)
+{
+    while (s->in_len - s->in_pos < n && !s->in_eof)
+    {
+        memmove(s->in, s->in + s->in_pos, s->in_len - s->in_pos);
+        s->in_len -= s->in_pos;
+        s->in_pos = 0;
+        size_t got = s->read(s->ctx, s->in + s->in_len, COMPRESS_CHUNK - s->in_len);
+        if (got == 0)
+            s->in_eof = 1;
+        s->in_len += got;
+    }
+    return s->in_len - s->in_pos >= n;
+}
+
+/* The next byte, or -1 at the end of the input */
+static int src_byte(CompressStream *s)
+{
+    if (s->in_pos == s->in_len && !src_ensure(s, 1))
+        return -1;
+    return s->in[s->in_pos++];
+}
+
+/* Copy up to n bytes; returns the number copied (short only at the end of the input) */
+static size_t src_copy(CompressStream *s, uint8_t *dst, size_t n)
+{
+    size_t done = 0;
+    while (done < n && src_ensure(s, 1))
+    {
+        size_t take = s->in_len - s->in_pos;
+        if (take > n - done)
+            take = n - done;
+        if (dst)
+            memcpy(dst + done, s->in + s->in_pos, take);
+        s->in_pos += take;
+        done += take;
+    }
+    return done;
+}
+
+/* --- inflate: DEFLATE decoding with gzip member framing --- */
+
+#define INFLATE_WINDOW 65536 // output ring; matches reach back at most 32768
+#define INFLATE_MASK (INFLATE_WINDOW - 1)
+#define INFLATE_BATCH 32768 // decode until this much output waits to be read
+
+typedef struct
+{
+    uint16_t entries[1 << 15]; // symbol << 4 | code length, indexed by the next bits
+    int bits;                  // longest code, so the table has 1 << bits entries
+} Huffman;
+
+typedef enum
+{
+    INFLATE_HEADER,
+    INFLATE_BLOCK,
+    INFLATE_STORED,
+    INFLATE_CODES,
+    INFLATE_TRAILER,
+    INFLATE_END
+} InflateMode;
+
+struct Inflater
+{
+    InflateMode mode;
+    int gzip;
+    int last; // the current block ends the member
+    uint64_t bits;
+    int bit_count;
+    size_t stored; // bytes left in a stored block
+    uint64_t written, delivered; // totals into and out of the window
+    uint64_t member_start;       // written when the gzip member began
+    uint32_t crc;
+    uint8_t window[INFLATE_WINDOW];
+    Huffman lit, dist;
+};
+
+static int bits_need(CompressStream *s, Inflater *z, int n)
+{
+    while (z->bit_count < n)
+    {
+        int b = src_byte(s);
+        if (b < 0)
+            return 0;
+        z->bits |= (uint64_t)b << z->bit_count;
+        z->bit_count += 8;
+    }
+    return 1;
+}
+
+static uint32_t bits_take(Inflater *z, int n)
+{
+    uint32_t v = (uint32_t)(z->bits & ((1ull << n) - 1));
+    z->bits >>= n;
+    z->bit_count -= n;
+    return v;
+}
+
+/* The next n (<= 32) bits, or -1 at the end of the input */
+static long bits_get(CompressStream *s, Inflater *z, int n)
+{
+    return bits_need(s, z, n) ? (long)bits_take(z, n) : -1;
+}
+
+/*
+ * Build a canonical code's lookup table from its code lengths; every entry
+ * whose low bits start a code holds that code. Returns 0 for an
+ * over-subscribed set of lengths. Incomplete codes are allowed (a block may
+ * use a single distance code); their holes decode as errors.
+ */
+static int huff_build(Huffman *h, const uint8_t *lens, int n)
+{
+    int count[16] = {0}, next[16];
+    for (int i = 0; i < n; i++)
+        count[lens[i]]++;
+    count[0] = 0;
+    int left = 1, max = 1;
+    for (int len = 1; len < 16; len++)
+    {
+        left = (left << 1) - count[len];
+        if (left < 0)
+            return 0;
+        if (count[len])
+            max = len;
+    }
+    int code = 0;
+    for (int len = 1; len < 16; len++)
+    {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+    h->bits = max;
+    memset(h->entries, 0, sizeof(uint16_t) << max);
+    for (int sym = 0; sym < n; sym++)
+    {
+        int len = lens[sym];
+        if (!len)
+            continue;
+        for (uint32_t i = reverse_bits(next[len]++, len); i < 1u << max; i += 1u << len)
+            h->entries[i] = (uint16_t)(sym << 4 | len);
+    }
+    return 1;
+}
+
+/* The next symbol, or -1; near the end of the input fewer bits than the longest code may remain */
+static int huff_decode(CompressStream *s, Inflater *z, const Huffman *h)
+{
+    bits_need(s, z, h->bits);
+    uint16_t e = h->entries[z->bits & ((1u << h->bits) - 1)];
+    int len = e & 15;
+    if (len == 0 || len > z->bit_count)
+        return -1;
+    bits_take(z, len);
+    return e >> 4;
+}
+
+/* Read the code-length code and the two codes of a dynamic block */
+static int inflate_dynamic(CompressStream *s, Inflater *z)
+{
+    long hlit = bits_get(s, z, 5), hdist = bits_get(s, z, 5), hclen = bits_get(s, z, 4);
+    if (hlit < 0 || hdist < 0 || hclen < 0)
+        return 0;
+    hlit += 257;
+    hdist += 1;
+    if (hlit > 286 || hdist > 30)
+        return 0;
+    uint8_t lens[286 + 30] = {0};
+    for (int i = 0; i < hclen + 4; i++)
+    {
+        long v = bits_get(s, z, 3);
+        if (v < 0)
+            return 0;
+        lens[code_length_order[i]] = (uint8_t)v;
+    }
+    Huffman *lengths = &z->dist; // rebuilt below once the lengths are read
+    if (!huff_build(lengths, lens, 19))
+        return 0;
+    memset(lens, 0, sizeof(lens));
+    int i = 0;
+    while (i < hlit + hdist)
+    {
+        int sym = huff_decode(s, z, lengths);
+        if (sym < 0)
+            return 0;
+        if (sym < 16)
+        {
+            lens[i++] = (uint8_t)sym;
+            continue;
+        }
+        int value = 0;
+        long repeat;
+        if (sym == 16)
+        {
+            if (i == 0)
+                return 0;
+            value = lens[i - 1];
+            repeat = bits_get(s, z, 2) + 3;
+        }
+        else if (sym == 17)
+            repeat = bits_get(s, z, 3) + 3;
+        else
+            repeat = bits_get(s, z, 7) + 11;
+        if (repeat < 3 || i + repeat > hlit + hdist)
+            return 0;
+        while (repeat--)
+            lens[i++] = (uint8_t)value;
+    }
+    if (lens[256] == 0)
+        return 0;
+    return huff_build(&z->lit, lens, (int)hlit) && huff_build(&z->dist, lens + hlit, (int)hdist);
+}
+
+/* Skip a gzip member header (RFC 1952) */
+static int inflate_gzip_header(CompressStream *s, Inflater *z)
+{
+    long h[10];
+    for (int i = 0; i < 10; i++)
+    {
+        if ((h[i] = bits_get(s, z, 8)) < 0)
+            return 0;
+    }
+    if (h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || (h[3] & 0xe0))
+        return 0;
+    int flags = (int)h[3];
+    if (flags & 4) // FEXTRA
+    {
+        long xlen = bits_get(s, z, 16);
+        if (xlen < 0)
+            return 0;
+        while (xlen--)
+        {
+            if (bits_get(s, z, 8) < 0)
+                return 0;
+        }
+    }
+    for (int field = 8; field <= 16; field <<= 1) // FNAME, FCOMMENT: zero-terminated
+    {
+        if (!(flags & field))
+            continue;
+        long c;
+        while ((c = bits_get(s, z, 8)) > 0)
+            ;
+        if (c < 0)
+            return 0;
+    }
+    if ((flags & 2) && bits_get(s, z, 16) < 0) // FHCRC
+        return 0;
+    z->crc = 0;
+    z->member_start = z->written;
+    return 1;
+}
+
+/* Check a member's CRC-32 and length, then look for another member */
+static int inflate_gzip_trailer(CompressStream *s, Inflater *z)
+{
+    bits_take(z, z->bit_count & 7);
+    long crc = bits_get(s, z, 32), size = bits_get(s, z, 32);
+    if (crc < 0 || size < 0 || (uint32_t)crc != z->crc || (uint32_t)size != (uint32_t)(z->written - z->member_start))
+        return 0;
+    // concatenated members decode as one stream; other trailing bytes are ignored, as gzip does
+    z->last = 0;
+    z->mode = bits_need(s, z, 16) && (z->bits & 0xffff) == 0x8b1f ? INFLATE_HEADER : INFLATE_END;
+    return 1;
+}
+
+/* Decode literals and matches until the block ends or a batch of output is waiting */
+static int inflate_codes(CompressStream *s, Inflater *z)
+{
+    while (z->written - z->delivered < INFLATE_BATCH)
+    {
+        int sym = huff_decode(s, z, &z->lit);
+        if (sym < 256)
+        {
+            if (sym < 0)
+                return 0;
+            z->window[z->written++ & INFLATE_MASK] = (uint8_t)sym;
+            continue;
+        }
+        if (sym == 256)
+        {
+            z->mode = INFLATE_BLOCK;
+            return 1;
+        }
+        sym -= 257;
+        if (sym >= 29)
+            return 0;
+        long extra = bits_get(s, z, len_extra[sym]);
+        int dsym = huff_decode(s, z, &z->dist);
+        if (extra < 0 || dsym < 0 || dsym >= 30)
+            return 0;
+        size_t len = len_base[sym] + (size_t)extra;
+        extra = bits_get(s, z, dist_extra[dsym]);
+        if (extra < 0)
+            return 0;
+        uint64_t dist = dist_base[dsym] + (uint64_t)extra;
+        if (dist > z->written - z->member_start)
+            return 0;
+        for (uint64_t w = z->written; w < z->written + len; w++)
+            z->window[w & INFLATE_MASK] = z->window[(w - dist) & INFLATE_MASK];
+        z->written += len;
+    }
+    return 1;
+}
+
+/* Copy raw bytes of a stored block: first what the bit buffer holds, then straight from the input */
+static int inflate_stored(CompressStream *s, Inflater *z)
+{
+    while (z->stored && z->bit_count >= 8)
+    {
+        z->window[z->written++ & INFLATE_MASK] = (uint8_t)bits_take(z, 8);
+        z->stored--;
+    }
+    size_t n = z->stored, room = INFLATE_WINDOW - (z->written & INFLATE_MASK);
+    size_t wait = INFLATE_BATCH - (size_t)(z->written - z->delivered);
+    if (n > room)
+        n = room;
+    if (n > wait)
+        n = wait;
+    size_t got = src_copy(s, z->window + (z->written & INFLATE_MASK), n);
+    z->written += got;
+    z->stored -= got;
+    if (got < n)
+        return 0;
+    if (!z->stored)
+        z->mode = INFLATE_BLOCK;
+    return 1;
+}
+
+/* Fold the output written since *from into the member CRC */
+static void inflate_crc(Inflater *z, uint64_t *from)
+{
+    while (*from < z->written)
+    {
+        size_t at = *from & INFLATE_MASK, n = INFLATE_WINDOW - at;
+        if (n > z->written - *from)
+            n = (size_t)(z->written - *from);
+        z->crc = hash_crc32(z->crc, z->window + at, n);
+        *from += n;
+    }
+}
+
+/* Decode until a batch of output waits or the stream ends; 0 on corrupt data */
+static int inflate_batch(CompressStream *s, Inflater *z)
+{
+    uint64_t from = z->written;
+    int ok = 1;
+    while (ok && z->mode != INFLATE_END && z->written - z->delivered < INFLATE_BATCH)
+    {
+        switch (z->mode)
+        {
+        case INFLATE_HEADER:
+            ok = inflate_gzip_header(s, z);
+            z->mode = INFLATE_BLOCK;
+            break;
+        case INFLATE_BLOCK:
+        {
+            if (z->last)
+            {
+                z->mode = z->gzip ? INFLATE_TRAILER : INFLATE_END;
+                break;
+            }
+            long head = bits_get(s, z, 3);
+            z->last = head & 1;
+            if (head >> 1 == 0)
+            {
+                bits_take(z, z->bit_count & 7);
+                long len = bits_get(s, z, 16), nlen = bits_get(s, z, 16);
+                ok = len >= 0 && nlen >= 0 && (len ^ 0xffff) == nlen;
+                z->stored = (size_t)len;
+                z->mode = INFLATE_STORED;
+            }
+            else if (head >> 1 == 1)
+            {
+                uint8_t lens[288 + 32];
+                fixed_lengths(lens);
+                huff_build(&z->lit, lens, 288);
+                huff_build(&z->dist, lens + 288, 32);
+                z->mode = INFLATE_CODES;
+            }
+            else if (head >> 1 == 2)
+            {
+                ok = inflate_dynamic(s, z);
+                z->mode = INFLATE_CODES;
+            }
+            else
+                ok = 0; // reserved block type, or the input ended
+            break;
+        }
+        case INFLATE_STORED:
+            ok = inflate_stored(s, z);
+            break;
+        case INFLATE_CODES:
+            ok = inflate_codes(s, z);
+            break;
+        case INFLATE_TRAILER:
+            inflate_crc(z, &from);
+            ok = inflate_gzip_trailer(s, z);
+            break;
+        default:
+            break;
+        }
+    }
+    if (z->gzip)
+        inflate_crc(z, &from);
+    return ok;
+}
+
+static long inflate_read(CompressStream *s, Inflater *z, uint8_t *out, size_t cap)
+{
+    if (z->written == z->delivered)
+    {
+        if (z->mode == INFLATE_END)
+            return 0;
+        if (!inflate_batch(s, z))
+            return -1;
+    }
+    size_t n = (size_t)(z->written - z->delivered), done = 0;
+    if (n > cap)
+        n = cap;
+    while (done < n)
+    {
+        size_t at = z->delivered & INFLATE_MASK, take = INFLATE_WINDOW - at;
+        if (take > n - done)
+            take = n - done;
+        memcpy(out + done, z->window + at, take);
+        z->delivered += take;
+        done += take;
+    }
+    return (long)n;
+}
+
+/* --- LZ4 frames (the lz4 command's format) --- */
+
+struct Lz4Reader
+{
+    int frames;   // frames started so far
+    int in_frame; // between a frame header and its end mark
+    int independent, block_checksum, content_checksum, has_size;
+    uint64_t content_size, produced;
+    size_t block_max;
+    uint8_t *block; // one compressed block
+    uint8_t *out;   // LZ4_HISTORY bytes of history, then one decoded block
+    size_t out_pos, out_end;
+    HashState content;
+};
+
+/*
+ * Decode one LZ4 block into dst from pos up to cap. Matches may reach back
+ * to floor (the block start for independent blocks, earlier history for
+ * linked ones). Returns the new end, or (size_t)-1 for a corrupt block.
+ */
+static size_t lz4_decode_block(const uint8_t *ip, size_t len, uint8_t *dst, size_t pos, size_t cap, size_t floor)
+{
+    const uint8_t *end = ip + len;
+    while (ip < end)
+    {
+        unsigned token = *ip++;
+        size_t run = token >> 4, match = token & 15;
+        if (run == 15)
+        {
+            unsigned b;
+            do
+            {
+                if (ip == end)
+                    return (size_t)-1;
+                run += b = *ip++;
+            } while (b == 255);
+        }
+        if (run > (size_t)(end - ip) || run > cap - pos)
+            return (size_t)-1;
+        memcpy(dst + pos, ip, run);
+        pos += run;
+        ip += run;
+        if (ip == end)
+            return pos; // the last sequence is literals only
+        if (end - ip < 2)
+            return (size_t)-1;
+        size_t offset = ip[0] | (size_t)ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > pos - floor)
+            return (size_t)-1;
+        if (match == 15)
+        {
+            unsigned b;
+            do
+            {
+                if (ip == end)
+                    return (size_t)-1;
+                match += b = *ip++;
+            } while (b == 255);
+        }
+        match += 4;
+        if (match > cap - pos)
+            return (size_t)-1;
+        uint8_t *to = dst + pos;
+        if (offset >= match)
+            memcpy(to, to - offset, match);
+        else
+        {
+            for (size_t i = 0; i < match; i++) // overlapping copies repeat the last offset bytes
+                to[i] = to[i - offset];
+        }
+        pos += match;
+    }
+    return (size_t)-1;
+}
+
+static int lz4_u32(CompressStream *s, uint32_t *v)
+{
+    uint8_t b[4];
+    if (src_copy(s, b, 4) != 4)
+        return 0;
+    *v = load32(b);
+    return 1;
+}
+
+/* Read a frame descriptor after its magic number */
+static int lz4_frame_header(CompressStream *s, Lz4Reader *r)
+{
+    uint8_t d[10], check;
+    if (src_copy(s, d, 2) != 2)
+        return 0;
+    int flags = d[0], bd = d[1];
+    // version 01; reserved bits clear; dictionary ids are not supported
+    if (flags >> 6 != 1 || (flags & 3) || (bd & 0x8f) || ((bd >> 4) & 7) < 4)
+        return 0;
+    size_t n = 2;
+    if (flags & 8)
+    {
+        if (src_copy(s, d + 2, 8) != 8)
+            return 0;
+        r->content_size = (uint64_t)load32(d + 2) | (uint64_t)load32(d + 6) << 32;
+        n = 10;
+    }
+    if (src_copy(s, &check, 1) != 1 || check != ((hash_xxh32(d, n, 0) >> 8) & 0xff))
+        return 0;
+    r->independent = (flags >> 5) & 1;
+    r->block_checksum = (flags >> 4) & 1;
+    r->has_size = (flags >> 3) & 1;
+    r->content_checksum = (flags >> 2) & 1;
+    r->produced = 0;
+    size_t block_max = (size_t)1 << (8 + 2 * ((bd >> 4) & 7)); // 64 KB, 256 KB, 1 MB or 4 MB
+    if (block_max > r->block_max)
+    {
+        memory_free(r->block);
+        memory_free(r->out);
+        r->block = memory_allocate(block_max);
+        r->out = memory_allocate(LZ4_HISTORY + block_max);
+        r->block_max = block_max;
+    }
+    r->out_pos = r->out_end = 0;
+    hash_init(&r->content, HASH_XXH32, 0);
+    return 1;
+}
+
+/* Start the next frame, skipping skippable ones; 1 started, 0 at the end of the input, -1 on bad data */
+static int lz4_next_frame(CompressStream *s, Lz4Reader *r)
+{
+    while (1)
+    {
+        uint8_t b[4];
+        size_t got = src_copy(s, b, 4);
+        if (got == 0 && r->frames > 0)
+            return 0;
+        if (got != 4)
+            return -1;
+        uint32_t magic = load32(b), skip;
+        if (magic == LZ4_MAGIC)
+        {
+            r->frames++;
+            return lz4_frame_header(s, r) ? 1 : -1;
+        }
+        if ((magic & 0xfffffff0u) != 0x184D2A50u || !lz4_u32(s, &skip) || src_copy(s, NULL, skip) != skip)
+            return -1;
+    }
+}
+
+/* Read and decode one block (or the end mark and content checksum) */
+static int lz4_block(CompressStream *s, Lz4Reader *r)
+{
+    uint32_t size, check;
+    if (!lz4_u32(s, &size))
+        return 0;
+    if (size == 0)
+    {
+        uint8_t digest[4];
+        r->in_frame = 0;
+        if (r->content_checksum)
+        {
+            hash_final(&r->content, digest); // big-endian, where the frame stores it little-endian
+            if (!lz4_u32(s, &check) || check != ((uint32_t)digest[0] << 24 | (uint32_t)digest[1] << 16 |
+                                                 (uint32_t)digest[2] << 8 | digest[3]))
+                return 0;
+        }
+        return !r->has_size || r->produced == r->content_size;
+    }
+    int raw = size >> 31;
+    size &= 0x7fffffffu;
+    if (size > r->block_max || src_copy(s, r->block, size) != size)
+        return 0;
+    if (r->block_checksum && (!lz4_u32(s, &check) || check != hash_xxh32(r->block, size, 0)))
+        return 0;
+    size_t start = r->out_end;
+    if (r->independent)
+        start = 0;
+    else if (start > LZ4_HISTORY)
+    {
+        memmove(r->out, r->out + start - LZ4_HISTORY, LZ4_HISTORY);
+        start = LZ4_HISTORY;
+    }
+    size_t end = start + size;
+    if (raw)
+        memcpy(r->out + start, r->block, size);
+    else
+        end = lz4_decode_block(r->block, size, r->out, start, start + r->block_max, r->independent ? start : 0);
+    if (end == (size_t)-1)
+        return 0;
+    if (r->content_checksum)
+        hash_update(&r->content, r->out + start, end - start);
+    r->produced += end - start;
+    r->out_pos = start;
+    r->out_end = end;
+    return 1;
+}
+
+static long lz4_read(CompressStream *s, Lz4Reader *r, uint8_t *out, size_t cap)
+{
+    while (r->out_pos == r->out_end)
+    {
+        if (!r->in_frame)
+        {
+            int started = lz4_next_frame(s, r);
+            if (started <= 0)
+                return started;
+            r->in_frame = 1;
+        }
+        if (!lz4_block(s, r))
+            return -1;
+    }
+    size_t n = r->out_end - r->out_pos;
+    if (n > cap)
+        n = cap;
+    memcpy(out, r->out + r->out_pos, n);
+    r->out_pos += n;
+    return (long)n;
+}
+
+/* --- streams --- */
+
+/* COMPRESS_GZIP or COMPRESS_LZ4 if data starts with that magic number, else COMPRESS_NONE */
+CompressFormat compress_sniff(const uint8_t *data, size_t len)
+{
+    if (len >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+        return COMPRESS_GZIP;
+    if (len >= 4 && load32(data) == LZ4_MAGIC)
+        return COMPRESS_LZ4;
+    return COMPRESS_NONE;
+}
+
+/*
+ * compress_stream_open: Decode format from the bytes read returns
+ *
+ * COMPRESS_AUTO picks gzip or LZ4 from the magic number and otherwise
+ * passes the input through; see compress_stream_format.
+ */
+CompressStream *compress_stream_open(CompressFormat format, CompressReadFn read, void *ctx)
+{
+    CompressStream *s = memory_allocate(sizeof(CompressStream));
+    memset(s, 0, sizeof(CompressStream));
+    s->read = read;
+    s->ctx = ctx;
+    s->in = memory_allocate(COMPRESS_CHUNK);
+    if (format == COMPRESS_AUTO)
+    {
+        src_ensure(s, 4);
+        format = compress_sniff(s->in + s->in_pos, s->in_len - s->in_pos);
+    }
+    s->format = format;
+    if (format == COMPRESS_GZIP || format == COMPRESS_DEFLATE)
+    {
+        s->inflate = memory_allocate(sizeof(Inflater));
+        memset(s->inflate, 0, offsetof(Inflater, window));
+        s->inflate->gzip = format == COMPRESS_GZIP;
+        s->inflate->mode = format == COMPRESS_GZIP ? INFLATE_HEADER : INFLATE_BLOCK;
+    }
+    else if (format == COMPRESS_LZ4)
+    {
+        s->lz4 = memory_allocate(sizeof(Lz4Reader));
+        memset(s->lz4, 0, sizeof(Lz4Reader));
+    }
+    return s;
+}
+
+CompressFormat compress_stream_format(const CompressStream *s)
+{
+    return s->format;
+}
+
+/* Read up to cap decoded bytes; returns the count, 0 at the end, or -1 for corrupt input */
+long compress_stream_read(CompressStream *s, uint8_t *out, size_t cap)
+{
+    if (s->failed)
+        return -1;
+    long n;
+    if (s->inflate)
+        n = inflate_read(s, s->inflate, out, cap);
+    else if (s->lz4)
+        n = lz4_read(s, s->lz4, out, cap);
+    else
+    {
+        size_t got = s->in_pos < s->in_len ? src_copy(s, out, cap < s->in_len - s->in_pos ? cap : s->in_len - s->in_pos)
+                                           : s->read(s->ctx, out, cap);
+        n = (long)got;
+    }
+    if (n < 0)
+        s->failed = 1;
+    return n;
+}
+
+void compress_stream_close(CompressStream *s)
+{
+    if (!s)
+        return;
+    if (s->lz4)
+    {
+        memory_free(s->lz4->block);
+        memory_free(s->lz4->out);
+        memory_free(s->lz4);
+    }
+    memory_free(s->inflate);
+    memory_free(s->in);
+    memory_free(s);
+}
+
+typedef struct
+{
+    const uint8_t *data;
+    size_t len, pos;
+} MemorySource;
+
+static size_t memory_source_read(void *ctx, uint8_t *buf, size_t cap)
+{
+    MemorySource *m = ctx;
+    size_t n = m->len - m->pos < cap ? m->len - m->pos : cap;
+    memcpy(buf, m->data + m->pos, n);
+    m->pos += n;
+    return n;
+}
+
+/* Decode a whole buffer; returns memory_allocate'd bytes, or NULL for corrupt data */
+uint8_t *compress_decode(CompressFormat format, const uint8_t *src, size_t len, size_t *out_len)
+{
+    MemorySource m = {src, len, 0};
+    CompressStream *s = compress_stream_open(format, memory_source_read, &m);
+    size_t cap = len * 3 + 1024, n = 0;
+    uint8_t *out = memory_allocate(cap);
+    long got;
+    while ((got = compress_stream_read(s, out + n, cap - n)) > 0)
+    {
+        n += (size_t)got;
+        if (n == cap)
+        {
+            cap *= 2;
+            out = memory_reallocate(out, cap);
+        }
+    }
+    compress_stream_close(s);
+    if (got < 0)
+    {
+        memory_free(out);
+        return NULL;
+    }
+    *out_len = n;
+    return out;
+}
+
+/* --- DEFLATE encoding --- */
+
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_CHAIN 64          // candidates tried per position
+#define DEFLATE_LAZY 32           // shorter matches wait a byte in case a longer one starts there
+#define DEFLATE_NICE 128          // a match this long ends the search
+#define DEFLATE_BLOCK_SYMBOLS 16384 // literals and matches per block
+
+typedef struct
+{
+    uint8_t *data;
+    size_t len, cap;
+    uint64_t bits;
+    int count;
+} BitWriter;
+
+static void bw_reserve(BitWriter *w, size_t n)
+{
+    if (w->len + n <= w->cap)
+        return;
+    while (w->len + n > w->cap)
+        w->cap *= 2;
+    w->data = memory_reallocate(w->data, w->cap);
+}
+
+/* Append n (<= 32) bits, least significant first */
+static void bw_put(BitWriter *w, uint32_t value, int n)
+{
+    w->bits |= (uint64_t)value << w->count;
+    w->count += n;
+    if (w->count >= 32)
+    {
+        bw_reserve(w, 4);
+        store32(w->data + w->len, (uint32_t)w->bits);
+        w->len += 4;
+        w->bits >>= 32;
+        w->count -= 32;
+    }
+}
+
+/* Pad to a byte boundary and flush */
+static void bw_align(BitWriter *w)
+{
+    bw_reserve(w, 8);
+    for (; w->count > 0; w->count -= 8, w->bits >>= 8)
+        w->data[w->len++] = (uint8_t)w->bits;
+    w->count = 0;
+    w->bits = 0;
+}
+
+static void bw_bytes(BitWriter *w, const void *p, size_t n)
+{
+    bw_reserve(w, n);
+    memcpy(w->data + w->len, p, n);
+    w->len += n;
+}
+
+typedef struct
+{
+    uint16_t litlen; // a literal byte, or a match length when dist is set
+    uint16_t dist;
+} Lz77Symbol;
+
+static uint8_t len_symbol[259];      // match length -> length code - 257
+static uint8_t dist_symbol[512];     // distance - 1 (< 256), then 256 + (distance - 1) >> 7
+static int deflate_tables_ready = 0;
+
+static void deflate_tables_init(void)
+{
+    if (deflate_tables_ready)
+        return;
+    for (int sym = 0; sym < 29; sym++)
+    {
+        for (int len = len_base[sym]; len < len_base[sym] + (1 << len_extra[sym]) && len <= 258; len++)
+            len_symbol[len] = (uint8_t)sym;
+    }
+    len_symbol[258] = 28;
+    for (int sym = 0; sym < 30; sym++)
+    {
+        for (int d = dist_base[sym]; d < dist_base[sym] + (1 << dist_extra[sym]); d++)
+        {
+            if (d <= 256)
+                dist_symbol[d - 1] = (uint8_t)sym;
+            else
+                dist_symbol[256 + ((d - 1) >> 7)] = (uint8_t)sym;
+        }
+    }
+    deflate_tables_ready = 1;
+}
+
+static int dist_code(unsigned dist)
+{
+    return dist <= 256 ? dist_symbol[dist - 1] : dist_symbol[256 + ((dist - 1) >> 7)];
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * Huffman code lengths for freq[0..n) no longer than limit bits. The tree
+ * is built with two queues over the symbols sorted by frequency; codes
+ * that come out too long are folded back as zlib and miniz do, and the
+ * lengths handed out again shortest to most frequent. Lone symbols are
+ * paired with a dummy so every code has two entries.
+ */
+static void huff_lengths(const uint32_t *freq, int n, int limit, uint8_t *lens)
+{
+    uint64_t sorted[288];
+    uint64_t weight[2 * 288];
+    int parent[2 * 288], depth[2 * 288], count[2 * 288] = {0};
+    int used = 0;
+    for (int i = 0; i < n; i++)
+    {
+        lens[i] = 0;
+        if (freq[i])
+            sorted[used++] = (uint64_t)freq[i] << 16 | (uint64_t)i;
+    }
+    if (used < 2)
+    {
+        int only = used ? (int)(sorted[0] & 0xffff) : 0;
+        lens[only] = 1;
+        lens[only ? 0 : 1] = 1;
+        return;
+    }
+    qsort(sorted, (size_t)used, sizeof(uint64_t), compare_u64);
+    for (int i = 0; i < used; i++)
+        weight[i] = sorted[i] >> 16;
+    int leaf = 0, inner = used;
+    for (int node = used; node < 2 * used - 1; node++)
+    {
+        for (int k = 0; k < 2; k++)
+        {
+            int pick = leaf < used && (inner == node || weight[leaf] <= weight[inner]) ? leaf++ : inner++;
+            parent[pick] = node;
+            weight[node] = k ? weight[node] + weight[pick] : weight[pick];
+        }
+    }
+    depth[2 * used - 2] = 0;
+    for (int node = 2 * used - 3; node >= 0; node--)
+        depth[node] = depth[parent[node]] + 1;
+    for (int i = 0; i < used; i++)
+        count[depth[i] > limit ? limit : depth[i]]++;
+    uint32_t total = 0;
+    for (int len = 1; len <= limit; len++)
+        total += (uint32_t)count[len] << (limit - len);
+    while (total > 1u << limit)
+    {
+        count[limit]--;
+        for (int len = limit - 1; len > 0; len--)
+        {
+            if (count[len])
+            {
+                count[len]--;
+                count[len + 1] += 2;
+                break;
+            }
+        }
+        total--;
+    }
+    int i = 0;
+    for (int len = limit; len > 0; len--)
+    {
+        for (int k = 0; k < count[len]; k++)
+            lens[sorted[i++] & 0xffff] = (uint8_t)len;
+    }
+}
+
+/* Canonical codes for a set of lengths, bit-reversed for the LSB-first writer */
+static void huff_codes(const uint8_t *lens, int n, uint16_t *codes)
+{
+    int count[16] = {0}, next[16];
+    for (int i = 0; i < n; i++)
+        count[lens[i]]++;
+    count[0] = 0;
+    int code = 0;
+    for (int len = 1; len < 16; len++)
+    {
+        code = (code + count[len - 1]) << 1;
+        next[len] = code;
+    }
+    for (int i = 0; i < n; i++)
+        codes[i] = lens[i] ? (uint16_t)reverse_bits(next[lens[i]]++, lens[i]) : 0;
+}
+
+/* Bits to send syms with the given codes, extra bits included */
+static uint64_t deflate_cost(const uint32_t *lit_freq, const uint32_t *dist_freq, const uint8_t *lit_lens,
+                             const uint8_t *dist_lens)
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < 286; i++)
+        bits += (uint64_t)lit_freq[i] * (lit_lens[i] + (i > 256 ? len_extra[i - 257] : 0));
+    for (int i = 0; i < 30; i++)
+        bits += (uint64_t)dist_freq[i] * (dist_lens[i] + dist_extra[i]);
+    return bits;
+}
+
+/*
+ * Write one block holding syms (covering raw[0..raw_len)) as whichever of
+ * stored, fixed-code or dynamic-code comes out smallest.
+ */
+static void deflate_block(BitWriter *w, const Lz77Symbol *syms, size_t count, const uint8_t *raw, size_t raw_len,
+                          int last)
+{
+    uint32_t lit_freq[286] = {0}, dist_freq[30] = {0};
+    for (size_t i = 0; i < count; i++)
+    {
+        if (syms[i].dist)
+        {
+            lit_freq[257 + len_symbol[syms[i].litlen]]++;
+            dist_freq[dist_code(syms[i].dist)]++;
+        }
+        else
+            lit_freq[syms[i].litlen]++;
+    }
+    lit_freq[256] = 1;
+
+    uint8_t fixed[288 + 32], lens[286 + 30];
+    fixed_lengths(fixed);
+    huff_lengths(lit_freq, 286, 15, lens);
+    huff_lengths(dist_freq, 30, 15, lens + 286);
+    int hlit = 286, hdist = 30;
+    while (hlit > 257 && !lens[hlit - 1])
+        hlit--;
+    while (hdist > 1 && !lens[286 + hdist - 1])
+        hdist--;
+
+    // run-length code the lengths with symbols 16 (repeat previous), 17 and 18 (runs of zeros)
+    uint8_t all[286 + 30], rle[286 + 30], rle_extra[286 + 30];
+    uint32_t cl_freq[19] = {0};
+    int total = hlit + hdist, runs = 0;
+    memcpy(all, lens, (size_t)hlit);
+    memcpy(all + hlit, lens + 286, (size_t)hdist);
+    for (int i = 0; i < total;)
+    {
+        int run = 1;
+        while (i + run < total && all[i + run] == all[i])
+            run++;
+        if (all[i] == 0 && run >= 3)
+        {
+            int take = run > 138 ? 138 : run;
+            rle[runs] = take >= 11 ? 18 : 17;
+            rle_extra[runs++] = (uint8_t)(take >= 11 ? take - 11 : take - 3);
+            i += take;
+        }
+        else if (all[i] != 0 && run >= 4)
+        {
+            int take = run - 1 > 6 ? 6 : run - 1;
+            rle[runs++] = all[i];
+            rle[runs] = 16;
+            rle_extra[runs++] = (uint8_t)(take - 3);
+            i += take + 1;
+        }
+        else
+            rle[runs++] = all[i++];
+    }
+    for (int i = 0; i < runs; i++)
+        cl_freq[rle[i]]++;
+    uint8_t cl_lens[19];
+    huff_lengths(cl_freq, 19, 7, cl_lens);
+    int hclen = 19;
+    while (hclen > 4 && !cl_lens[code_length_order[hclen - 1]])
+        hclen--;
+
+    uint64_t dynamic_bits = 17 + 3 * (uint64_t)hclen + deflate_cost(lit_freq, dist_freq, lens, lens + 286);
+    for (int i = 0; i < runs; i++)
+        dynamic_bits += cl_lens[rle[i]] + (rle[i] == 16 ? 2 : rle[i] == 17 ? 3 : rle[i] == 18 ? 7 : 0);
+    uint64_t fixed_bits = 3 + deflate_cost(lit_freq, dist_freq, fixed, fixed + 288);
+    uint64_t stored_bits = (raw_len / 65535 + 1) * 40 + 8 * (uint64_t)raw_len;
+
+    if (stored_bits <= dynamic_bits && stored_bits <= fixed_bits)
+    {
+        size_t at = 0;
+        do
+        {
+            size_t n = raw_len - at > 65535 ? 65535 : raw_len - at;
+            bw_put(w, last && at + n == raw_len, 3);
+            bw_align(w);
+            uint8_t head[4] = {(uint8_t)n, (uint8_t)(n >> 8), (uint8_t)~n, (uint8_t)(~n >> 8)};
+            bw_bytes(w, head, 4);
+            bw_bytes(w, raw + at, n);
+            at += n;
+        } while (at < raw_len);
+        return;
+    }
+
+    const uint8_t *lit_lens = fixed, *dist_lens = fixed + 288;
+    uint16_t lit_codes[288], dist_codes[32];
+    if (dynamic_bits < fixed_bits)
+    {
+        uint16_t cl_codes[19];
+        huff_codes(cl_lens, 19, cl_codes);
+        bw_put(w, last | 4, 3);
+        bw_put(w, (uint32_t)(hlit - 257), 5);
+        bw_put(w, (uint32_t)(hdist - 1), 5);
+        bw_put(w, (uint32_t)(hclen - 4), 4);
+        for (int i = 0; i < hclen; i++)
+            bw_put(w, cl_lens[code_length_order[i]], 3);
+        for (int i = 0; i < runs; i++)
+        {
+            bw_put(w, cl_codes[rle[i]], cl_lens[rle[i]]);
+            if (rle[i] >= 16)
+                bw_put(w, rle_extra[i], rle[i] == 16 ? 2 : rle[i] == 17 ? 3 : 7);
+        }
+        lit_lens = lens;
+        dist_lens = lens + 286;
+        huff_codes(lit_lens, 286, lit_codes);
+        huff_codes(dist_lens, 30, dist_codes);
+    }
+    else
+    {
+        bw_put(w, last | 2, 3);
+        huff_codes(lit_lens, 288, lit_codes);
+        huff_codes(dist_lens, 32, dist_codes);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned v = syms[i].litlen, d = syms[i].dist;
+        if (!d)
+        {
+            bw_put(w, lit_codes[v], lit_lens[v]);
+            continue;
+        }
+        int ls = len_symbol[v], ds = dist_code(d);
+        bw_put(w, lit_codes[257 + ls], lit_lens[257 + ls]);
+        bw_put(w, v - len_base[ls], len_extra[ls]);
+        bw_put(w, dist_codes[ds], dist_lens[ds]);
+        bw_put(w, d - dist_base[ds], dist_extra[ds]);
+    }
+    bw_put(w, lit_codes[256], lit_lens[256]);
+}
+
+typedef struct
+{
+    const uint8_t *src;
+    size_t len;
+    size_t *head; // position + 1 of the latest string with each hash, 0 for none
+    size_t *prev; // the previous position + 1 with the same hash, by position in the window
+} Lz77;
+
+static void lz77_insert(Lz77 *m, size_t pos)
+{
+    if (pos + 3 > m->len)
+        return;
+    const uint8_t *p = m->src + pos;
+    uint32_t h = ((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+    m->prev[pos & (DEFLATE_WINDOW - 1)] = m->head[h];
+    m->head[h] = pos + 1;
+}
+
+/* The longest earlier match for pos within the window (0 if under 3 bytes) */
+static size_t lz77_longest(const Lz77 *m, size_t pos, size_t *dist)
+{
+    size_t max = m->len - pos < 258 ? m->len - pos : 258, best = 0;
+    if (max < 3)
+        return 0;
+    const uint8_t *p = m->src + pos;
+    uint32_t h = ((uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2]) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+    size_t cand = m->head[h];
+    for (int chain = DEFLATE_CHAIN; cand && chain > 0; chain--)
+    {
+        size_t at = cand - 1;
+        if (pos - at > DEFLATE_WINDOW)
+            break;
+        const uint8_t *q = m->src + at;
+        if (q[best] == p[best])
+        {
+            size_t n = 0;
+            while (n < max && q[n] == p[n])
+                n++;
+            if (n > best)
+            {
+                best = n;
+                *dist = pos - at;
+                if (n >= DEFLATE_NICE || n == max)
+                    break;
+            }
+        }
+        size_t next = m->prev[at & (DEFLATE_WINDOW - 1)];
+        if (next >= cand)
+            break;
+        cand = next;
+    }
+    return best >= 3 ? best : 0;
+}
+
+/* Raw DEFLATE of src: hash-chain LZ77 with one step of lazy matching, then per-block codes */
+static void deflate_encode(BitWriter *w, const uint8_t *src, size_t len)
+{
+    deflate_tables_init();
+    Lz77 m = {src, len, memory_allocate(sizeof(size_t) << DEFLATE_HASH_BITS),
+              memory_allocate(sizeof(size_t) * DEFLATE_WINDOW)};
+    memset(m.head, 0, sizeof(size_t) << DEFLATE_HASH_BITS);
+    Lz77Symbol *syms = memory_allocate(sizeof(Lz77Symbol) * DEFLATE_BLOCK_SYMBOLS);
+    size_t count = 0, block_start = 0, pos = 0, pending_len = 0, pending_dist = 0;
+    while (pos < len)
+    {
+        if (count >= DEFLATE_BLOCK_SYMBOLS - 2)
+        {
+            size_t covered = pending_len ? pos - 1 : pos; // a pending match starts at pos - 1
+            deflate_block(w, syms, count, src + block_start, covered - block_start, 0);
+            count = 0;
+            block_start = covered;
+        }
+        size_t dist = 0, found = lz77_longest(&m, pos, &dist);
+        lz77_insert(&m, pos);
+        if (pending_len)
+        {
+            if (found > pending_len)
+            {
+                // the match one byte on is longer: the byte before it goes out as a literal
+                syms[count++] = (Lz77Symbol){src[pos - 1], 0};
+                pending_len = found;
+                pending_dist = dist;
+                pos++;
+                continue;
+            }
+            syms[count++] = (Lz77Symbol){(uint16_t)pending_len, (uint16_t)pending_dist};
+            size_t end = pos - 1 + pending_len;
+            for (pos++; pos < end; pos++)
+                lz77_insert(&m, pos);
+            pending_len = 0;
+            continue;
+        }
+        if (found >= DEFLATE_LAZY)
+        {
+            syms[count++] = (Lz77Symbol){(uint16_t)found, (uint16_t)dist};
+            size_t end = pos + found;
+            for (pos++; pos < end; pos++)
+                lz77_insert(&m, pos);
+        }
+        else if (found)
+        {
+            pending_len = found;
+            pending_dist = dist;
+            pos++;
+        }
+        else
+            syms[count++] = (Lz77Symbol){src[pos++], 0};
+    }
+    if (pending_len)
+        syms[count++] = (Lz77Symbol){(uint16_t)pending_len, (uint16_t)pending_dist};
+    deflate_block(w, syms, count, src + block_start, len - block_start, 1);
+    bw_align(w);
+    memory_free(syms);
+    memory_free(m.head);
+    memory_free(m.prev);
+}
+
+/* --- LZ4 encoding --- */
+
+#define LZ4_HASH_BITS 16
+#define LZ4_MFLIMIT 12     // no match may start within this many bytes of the end
+#define LZ4_LASTLITERALS 5 // and the last five bytes are always literals
+
+static uint8_t *lz4_put_length(uint8_t *op, size_t n)
+{
+    for (; n >= 255; n -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t)n;
+    return op;
+}
+
+/* One sequence: run literals, then a match (none for the final literals) */
+static uint8_t *lz4_sequence(uint8_t *op, const uint8_t *lit, size_t run, size_t offset, size_t match)
+{
+    uint8_t *token = op++;
+    *token = (uint8_t)((run >= 15 ? 15 : run) << 4);
+    if (run >= 15)
+        op = lz4_put_length(op, run - 15);
+    memcpy(op, lit, run);
+    op += run;
+    if (!match)
+        return op;
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    match -= 4;
+    *token |= (uint8_t)(match >= 15 ? 15 : match);
+    if (match >= 15)
+        op = lz4_put_length(op, match - 15);
+    return op;
+}
+
+/*
+ * Greedy LZ4 block: one hash probe per position, skipping ahead faster
+ * the longer nothing matches (the reference encoder's acceleration), and
+ * extending each match backwards over pending literals.
+ */
+static size_t lz4_encode_block(const uint8_t *src, size_t len, uint8_t *dst, uint32_t *table)
+{
+    memset(table, 0, sizeof(uint32_t) << LZ4_HASH_BITS);
+    uint8_t *op = dst;
+    size_t ip = 0, anchor = 0;
+    if (len > LZ4_MFLIMIT)
+    {
+        size_t limit = len - LZ4_MFLIMIT, match_limit = len - LZ4_LASTLITERALS;
+        unsigned misses = 0;
+        while (ip < limit)
+        {
+            uint32_t seq;
+            memcpy(&seq, src + ip, 4);
+            uint32_t h = seq * 2654435761u >> (32 - LZ4_HASH_BITS);
+            size_t ref = table[h];
+            table[h] = (uint32_t)ip + 1;
+            if (ref && ip - (ref - 1) <= 65535 && memcmp(src + ref - 1, src + ip, 4) == 0)
+            {
+                ref--;
+                size_t n = 4;
+                while (ip + n < match_limit && src[ref + n] == src[ip + n])
+                    n++;
+                while (ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+                {
+                    ip--;
+                    ref--;
+                    n++;
+                }
+                op = lz4_sequence(op, src + anchor, ip - anchor, ip - ref, n);
+                ip += n;
+                anchor = ip;
+                misses = 0;
+            }
+            else
+                ip += 1 + (misses++ >> 6);
+        }
+    }
+    op = lz4_sequence(op, src + anchor, len - anchor, 0, 0);
+    return (size_t)(op - dst);
+}
+
+/* An LZ4 frame: independent blocks sized to the input, content checksum, no content size */
+static uint8_t *lz4_encode(const uint8_t *src, size_t len, size_t *out_len)
+{
+    int code = 4; // 64 KB blocks, growing to 4 MB for larger inputs
+    while (code < 7 && len > (size_t)1 << (8 + 2 * code))
+        code++;
+    size_t block_max = (size_t)1 << (8 + 2 * code), blocks = len / block_max + 1;
+    uint8_t *out = memory_allocate(15 + len + len / 255 + 20 * blocks);
+    uint32_t *table = memory_allocate(sizeof(uint32_t) << LZ4_HASH_BITS);
+    store32(out, LZ4_MAGIC);
+    out[4] = 0x64; // version 01, independent blocks, content checksum
+    out[5] = (uint8_t)(code << 4);
+    out[6] = (uint8_t)(hash_xxh32(out + 4, 2, 0) >> 8);
+    uint8_t *op = out + 7;
+    for (size_t at = 0; at < len; at += block_max)
+    {
+        size_t n = len - at < block_max ? len - at : block_max;
+        size_t packed = lz4_encode_block(src + at, n, op + 4, table);
+        if (packed >= n)
+        {
+            store32(op, (uint32_t)n | 0x80000000u); // incompressible: stored raw
+            memcpy(op + 4, src + at, n);
+            packed = n;
+        }
+        else
+            store32(op, (uint32_t)packed);
+        op += 4 + packed;
+    }
+    store32(op, 0);
+    store32(op + 4, hash_xxh32(src, len, 0));
+    *out_len = (size_t)(op + 8 - out);
+    memory_free(table);
+    return out;
+}
+
+/* Encode src as format (gzip, deflate or lz4); returns memory_allocate'd bytes, NULL for other formats */
+uint8_t *compress_encode(CompressFormat format, const uint8_t *src, size_t len, size_t *out_len)
+{
+    if (format == COMPRESS_LZ4)
+        return lz4_encode(src, len, out_len);
+    if (format != COMPRESS_GZIP && format != COMPRESS_DEFLATE)
+        return NULL;
+    BitWriter w = {memory_allocate(len / 2 + 64), 0, len / 2 + 64, 0, 0};
+    if (format == COMPRESS_GZIP)
+    {
+        static const uint8_t header[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff}; // no name or time, OS unknown
+        bw_bytes(&w, header, 10);
+    }
+    deflate_encode(&w, src, len);
+    if (format == COMPRESS_GZIP)
+    {
+        uint8_t trailer[8];
+        store32(trailer, hash_crc32(0, src, len));
+        store32(trailer + 4, (uint32_t)len);
+        bw_bytes(&w, trailer, 8);
+    }
+    *out_len = w.len;
+    return w.data;
+}
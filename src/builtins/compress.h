@@ -0,0 +1,40 @@
+#ifndef SHARPSCRIPT_COMPRESS_H
+#define SHARPSCRIPT_COMPRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * gzip, raw DEFLATE and LZ4 frames behind system.compress,
+ * system.decompress and file.lines. Decoding is a pull stream: a
+ * CompressStream asks its read callback for compressed bytes only as the
+ * caller asks for output, so a large .gz file is never held whole.
+ * COMPRESS_AUTO sniffs the first bytes (gzip 1f 8b, LZ4 04 22 4d 18) and
+ * passes anything else through unchanged.
+ */
+typedef enum
+{
+    COMPRESS_AUTO,
+    COMPRESS_NONE,
+    COMPRESS_GZIP,
+    COMPRESS_DEFLATE,
+    COMPRESS_LZ4
+} CompressFormat;
+
+/* Fill buf with up to cap bytes; 0 at the end of the input */
+typedef size_t (*CompressReadFn)(void *ctx, uint8_t *buf, size_t cap);
+
+typedef struct CompressStream CompressStream;
+
+int compress_format_parse(const char *name, CompressFormat *format);
+CompressFormat compress_sniff(const uint8_t *data, size_t len);
+
+CompressStream *compress_stream_open(CompressFormat format, CompressReadFn read, void *ctx);
+long compress_stream_read(CompressStream *s, uint8_t *out, size_t cap);
+CompressFormat compress_stream_format(const CompressStream *s);
+void compress_stream_close(CompressStream *s);
+
+uint8_t *compress_encode(CompressFormat format, const uint8_t *src, size_t len, size_t *out_len);
+uint8_t *compress_decode(CompressFormat format, const uint8_t *src, size_t len, size_t *out_len);
+
+#endif
@@ -0,0 +1,1120 @@
+#include "datetime.h"
+#include "../include/memory.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define ZONE_ABBREV 16
+#define ZONE_DIR "/usr/share/zoneinfo"
+#define ZONE_FILE_MAX (1 << 20)
+
+#define FORMAT_CACHE 16   // compiled parse formats kept
+#define FORMAT_MAX_OPS 64
+#define FORMAT_MAX_TEXT 256 // literal characters per format
+
+static const char *month_names[12] = {"January", "February", "March",     "April",   "May",      "June",
+                                      "July",    "August",   "September", "October", "November", "December"};
+static const char *weekday_names[7] = {"Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday"};
+
+/* Calendar arithmetic on days since 1970-01-01 (proleptic Gregorian, after Hinnant) */
+
+static int64_t floor_div(int64_t a, int64_t b)
+{
+    return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+static int is_leap(int64_t year)
+{
+    return year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+}
+
+static int month_days(int64_t year, int month)
+{
+    static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return month == 2 && is_leap(year) ? 29 : days[month - 1];
+}
+
+static int64_t days_from_civil(int64_t year, int month, int day)
+{
+    year -= month <= 2;
+    int64_t era = floor_div(year, 400);
+    int64_t yoe = year - era * 400;
+    int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static void civil_from_days(int64_t days, int *year, int *month, int *day)
+{
+    days += 719468;
+    int64_t era = floor_div(days, 146097);
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *year = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+static int weekday_of(int64_t days)
+{
+    return (int)(days + 4 - floor_div(days + 4, 7) * 7); // 1970-01-01 was a Thursday
+}
+
+/*
+ * Time zones
+ */
+
+/* The wall clock as seconds and nanoseconds since the epoch */
+void datetime_now(int64_t *seconds, int *nanos)
+{
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    // 100 ns ticks since 1601-01-01
+    int64_t ticks = (int64_t)((uint64_t)ft.dwHighDateTime << 32 | ft.dwLowDateTime) - 116444736000000000LL;
+    *seconds = ticks / 10000000;
+    *nanos = (int)(ticks % 10000000) * 100;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    *seconds = ts.tv_sec;
+    *nanos = (int)ts.tv_nsec;
+#endif
+}
+
+typedef struct
+{
+    int32_t offset; // seconds east of UTC
+    uint8_t is_dst;
+    char abbrev[ZONE_ABBREV];
+} ZoneType;
+
+/* A POSIX TZ transition date: Mm.w.d, Jn (1-365, no leap day) or n (0-365) */
+typedef struct
+{
+    char kind;
+    int month, week, weekday, day;
+    int32_t time; // local seconds after midnight, may be negative or past 24h
+} RuleDate;
+
+/* A POSIX TZ string such as "CET-1CEST,M3.5.0,M10.5.0/3" */
+typedef struct
+{
+    ZoneType std, dst;
+    int has_dst;
+    RuleDate start, end;
+} PosixRule;
+
+struct TimeZone
+{
+    char *name;
+    int valid;
+    int64_t *times; // transitions, ascending
+    uint8_t *type_of;
+    int count;
+    ZoneType *types;
+    int type_count;
+    PosixRule rule; // after the last transition
+    int has_rule;
+    TimeZone *next;
+};
+
+static TimeZone *zones; // every zone asked for, including unknown names
+
+static const char *read_digits(const char *p, int max, int *value)
+{
+    int n = 0, v = 0;
+    while (n < max && isdigit((unsigned char)p[n]))
+        v = v * 10 + (p[n++] - '0');
+    *value = v;
+    return n ? p + n : NULL;
+}
+
+static const char *rule_abbrev(const char *p, char *out)
+{
+    size_t n = 0;
+    if (*p == '<')
+    {
+        for (p++; *p && *p != '>'; p++)
+            if (n < ZONE_ABBREV - 1)
+                out[n++] = *p;
+        if (*p++ != '>')
+            return NULL;
+    }
+    else
+        for (; isalpha((unsigned char)*p); p++)
+            if (n < ZONE_ABBREV - 1)
+                out[n++] = *p;
+    out[n] = '\0';
+    return n ? p : NULL;
+}
+
+/* [+-]hh[:mm[:ss]], hours up to 167 */
+static const char *rule_time(const char *p, int32_t *seconds)
+{
+    int sign = 1, h, m = 0, s = 0;
+    if (*p == '+' || *p == '-')
+        sign = *p++ == '-' ? -1 : 1;
+    if (!(p = read_digits(p, 3, &h)) || h > 167)
+        return NULL;
+    if (*p == ':' && (!(p = read_digits(p + 1, 2, &m)) || m > 59))
+        return NULL;
+    if (*p == ':' && (!(p = read_digits(p + 1, 2, &s)) || s > 59))
+        return NULL;
+    *seconds = sign * (h * 3600 + m * 60 + s);
+    return p;
+}
+
+static const char *rule_date(const char *p, RuleDate *d)
+{
+    memset(d, 0, sizeof(*d));
+    d->time = 7200;
+    d->kind = *p == 'M' || *p == 'J' ? *p++ : 'D';
+    if (d->kind == 'M')
+    {
+        if (!(p = read_digits(p, 2, &d->month)) || *p != '.' || !(p = read_digits(p + 1, 1, &d->week)) ||
+            *p != '.' || !(p = read_digits(p + 1, 1, &d->weekday)))
+            return NULL;
+        if (d->month < 1 || d->month > 12 || d->week < 1 || d->week > 5 || d->weekday > 6)
+            return NULL;
+    }
+    else if (!(p = read_digits(p, 3, &d->day)) || d->day > 365 || (d->kind == 'J' && d->day < 1))
+        return NULL;
+    if (*p == '/')
+        p = rule_time(p + 1, &d->time);
+    return p;
+}
+
+static int rule_parse(const char *p, PosixRule *r)
+{
+    int32_t offset;
+    memset(r, 0, sizeof(*r));
+    if (!(p = rule_abbrev(p, r->std.abbrev)) || !(p = rule_time(p, &offset)))
+        return 0;
+    r->std.offset = -offset; // POSIX offsets count west of UTC
+    if (!*p)
+        return 1;
+    if (!(p = rule_abbrev(p, r->dst.abbrev)))
+        return 0;
+    r->has_dst = 1;
+    r->dst.is_dst = 1;
+    r->dst.offset = r->std.offset + 3600;
+    if (*p && *p != ',')
+    {
+        if (!(p = rule_time(p, &offset)))
+            return 0;
+        r->dst.offset = -offset;
+    }
+    if (!*p)
+    {
+        // no dates given: the US rules
+        r->start = (RuleDate){'M', 3, 2, 0, 0, 7200};
+        r->end = (RuleDate){'M', 11, 1, 0, 0, 7200};
+        return 1;
+    }
+    if (*p != ',' || !(p = rule_date(p + 1, &r->start)) || *p != ',' || !(p = rule_date(p + 1, &r->end)))
+        return 0;
+    return *p == '\0';
+}
+
+/* Local seconds since the epoch at which a rule date falls in a year */
+static int64_t rule_date_local(const RuleDate *d, int year)
+{
+    int64_t days = days_from_civil(year, 1, 1);
+    if (d->kind == 'M')
+    {
+        int64_t first = days_from_civil(year, d->month, 1);
+        int day = 1 + (d->weekday - weekday_of(first) + 7) % 7 + (d->week - 1) * 7;
+        while (day > month_days(year, d->month))
+            day -= 7; // week 5 is the last one
+        days = first + day - 1;
+    }
+    else if (d->kind == 'J')
+        days += d->day - 1 + (is_leap(year) && d->day >= 60);
+    else
+        days += d->day;
+    return days * 86400 + d->time;
+}
+
+static const ZoneType *rule_type(const PosixRule *r, int64_t t)
+{
+    if (!r->has_dst)
+        return &r->std;
+    int year, month, day;
+    civil_from_days(floor_div(t + r->std.offset, 86400), &year, &month, &day);
+    int64_t start = rule_date_local(&r->start, year) - r->std.offset;
+    int64_t end = rule_date_local(&r->end, year) - r->dst.offset;
+    int dst = start < end ? t >= start && t < end : t < end || t >= start; // southern zones wrap the year
+    return dst ? &r->dst : &r->std;
+}
+
+static uint32_t be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/*
+ * Read a TZif file (RFC 8536). Version 2 and later files repeat the data
+ * with 64-bit times after the version 1 block and end with a POSIX TZ
+ * string for times past the last transition.
+ */
+static int zone_read_tzif(TimeZone *z, const uint8_t *data, size_t len)
+{
+    const uint8_t *p = data, *end = data + len;
+    size_t time_size = 4;
+    for (int pass = 0;; pass++)
+    {
+        if ((size_t)(end - p) < 44 || memcmp(p, "TZif", 4) != 0)
+            return 0;
+        uint32_t isut = be32(p + 20), isstd = be32(p + 24), leaps = be32(p + 28);
+        uint32_t count = be32(p + 32), types = be32(p + 36), chars = be32(p + 40);
+        if (count > 100000 || types == 0 || types > 256 || chars == 0 || chars > 65536 || leaps > 100000 ||
+            isut > types || isstd > types)
+            return 0;
+        size_t body = count * time_size + count + types * 6 + chars + leaps * (time_size + 4) + isstd + isut;
+        if ((size_t)(end - p) - 44 < body)
+            return 0;
+        if (pass == 0 && p[4] >= '2')
+        {
+            p += 44 + body; // skip the 32-bit data
+            time_size = 8;
+            continue;
+        }
+
+        const uint8_t *q = p + 44;
+        z->count = (int)count;
+        z->type_count = (int)types;
+        z->times = memory_allocate((count ? count : 1) * sizeof(int64_t));
+        z->type_of = memory_allocate(count ? count : 1);
+        z->types = memory_allocate(types * sizeof(ZoneType));
+        for (uint32_t i = 0; i < count; i++, q += time_size)
+            z->times[i] = time_size == 8 ? (int64_t)((uint64_t)be32(q) << 32 | be32(q + 4)) : (int32_t)be32(q);
+        for (uint32_t i = 0; i < count; i++)
+            if ((z->type_of[i] = *q++) >= types)
+                return 0;
+        const uint8_t *abbrevs = q + types * 6;
+        for (uint32_t i = 0; i < types; i++, q += 6)
+        {
+            ZoneType *type = &z->types[i];
+            type->offset = (int32_t)be32(q);
+            type->is_dst = q[4];
+            size_t at = q[5], n = 0;
+            if (at >= chars)
+                return 0;
+            while (at + n < chars && abbrevs[at + n] && n < ZONE_ABBREV - 1)
+                n++;
+            memcpy(type->abbrev, abbrevs + at, n);
+            type->abbrev[n] = '\0';
+        }
+        q = p + 44 + body;
+        if (time_size == 8 && q < end && *q == '\n')
+        {
+            const uint8_t *nl = memchr(q + 1, '\n', (size_t)(end - q - 1));
+            if (nl && nl > q + 1 && nl - q < 128)
+            {
+                char footer[128];
+                memcpy(footer, q + 1, (size_t)(nl - q - 1));
+                footer[nl - q - 1] = '\0';
+                z->has_rule = rule_parse(footer, &z->rule);
+            }
+        }
+        return 1;
+    }
+}
+
+static int zone_read_file(TimeZone *z, const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    uint8_t *data = memory_allocate(ZONE_FILE_MAX);
+    size_t len = fread(data, 1, ZONE_FILE_MAX, f);
+    fclose(f);
+    int ok = zone_read_tzif(z, data, len);
+    memory_free(data);
+    return ok;
+}
+
+static int zone_fixed(TimeZone *z, int32_t offset, const char *abbrev)
+{
+    z->types = memory_allocate(sizeof(ZoneType));
+    memset(z->types, 0, sizeof(ZoneType));
+    z->types->offset = offset;
+    snprintf(z->types->abbrev, ZONE_ABBREV, "%s", abbrev);
+    z->type_count = 1;
+    return 1;
+}
+
+/* An IANA name under the tzdata directory, a TZif path, or a POSIX TZ string */
+static int zone_read_named(TimeZone *z, const char *name)
+{
+    if (name[0] == '/')
+        return zone_read_file(z, name);
+    if (!strstr(name, ".."))
+    {
+        char path[4096];
+        const char *dir = getenv("TZDIR");
+        snprintf(path, sizeof(path), "%s/%s", dir && *dir ? dir : ZONE_DIR, name);
+        if (zone_read_file(z, path))
+            return 1;
+    }
+    return z->has_rule = rule_parse(name, &z->rule);
+}
+
+static int zone_load(TimeZone *z, const char *name)
+{
+    if (strcmp(name, "UTC") == 0 || strcmp(name, "Z") == 0)
+        return zone_fixed(z, 0, "UTC");
+    if (strcmp(name, "local") == 0)
+    {
+        const char *tz = getenv("TZ");
+        if (tz && *tz == ':')
+            tz++;
+        if (tz && *tz)
+            return zone_read_named(z, tz);
+        return zone_read_file(z, "/etc/localtime") || zone_fixed(z, 0, "UTC");
+    }
+    if (name[0] == '+' || name[0] == '-')
+    {
+        // +hh, +hhmm or +hh:mm
+        int h, m = 0;
+        const char *p = read_digits(name + 1, 2, &h);
+        if (p && *p == ':')
+            p++;
+        if (p && *p)
+            p = read_digits(p, 2, &m);
+        if (!p || *p || p - name < 3 || h > 23 || m > 59)
+            return 0;
+        char abbrev[8];
+        snprintf(abbrev, sizeof(abbrev), "%c%02d%02d", name[0], h, m);
+        return zone_fixed(z, (name[0] == '-' ? -1 : 1) * (h * 3600 + m * 60), abbrev);
+    }
+    return zone_read_named(z, name);
+}
+
+/*
+ * Look up a zone by name: "UTC", "local" ($TZ, else /etc/localtime), a
+ * fixed offset like "+05:30", an IANA name like "Europe/Berlin" or a POSIX
+ * TZ string. Each name is resolved once; later calls return the cached zone.
+ *
+ * @return: The zone, or NULL for an unknown name
+ */
+const TimeZone *datetime_zone(const char *name)
+{
+    for (TimeZone *z = zones; z; z = z->next)
+        if (strcmp(z->name, name) == 0)
+            return z->valid ? z : NULL;
+    TimeZone *z = memory_allocate(sizeof(TimeZone));
+    memset(z, 0, sizeof(TimeZone));
+    z->name = memory_strdup(name);
+    z->valid = zone_load(z, name);
+    if (!z->valid)
+    {
+        // keep only the name, so the lookup is not retried
+        memory_free(z->times);
+        memory_free(z->type_of);
+        memory_free(z->types);
+        z->times = NULL;
+        z->type_of = NULL;
+        z->types = NULL;
+    }
+    z->next = zones;
+    zones = z;
+    return z->valid ? z : NULL;
+}
+
+static const ZoneType *zone_type(const TimeZone *z, int64_t t)
+{
+    if (z->count == 0 || t >= z->times[z->count - 1])
+    {
+        if (z->has_rule)
+            return rule_type(&z->rule, t);
+        return &z->types[z->count ? z->type_of[z->count - 1] : 0];
+    }
+    if (t < z->times[0])
+        return &z->types[0];
+    int lo = 0, hi = z->count - 1; // times[lo] <= t < times[hi]
+    while (hi - lo > 1)
+    {
+        int mid = (lo + hi) / 2;
+        if (z->times[mid] <= t)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return &z->types[z->type_of[lo]];
+}
+
+/*
+ * UTC offset of a zone at an instant
+ *
+ * @param abbrev: Set to the zone's abbreviation then ("CEST"), if not NULL
+ * @return: Seconds east of UTC
+ */
+int datetime_offset(const TimeZone *zone, int64_t seconds, const char **abbrev)
+{
+    const ZoneType *type = zone_type(zone, seconds);
+    if (abbrev)
+        *abbrev = type->abbrev;
+    return type->offset;
+}
+
+/*
+ * The instant a wall-clock time names in a zone. A time repeated when the
+ * clocks go back is the earlier instant; a time skipped when they go
+ * forward is read with the offset from before the change, so 02:30 on a
+ * spring-forward night becomes 03:30.
+ */
+static int64_t zone_local_to_utc(const TimeZone *z, int64_t local)
+{
+    if (z->count == 0 && !z->has_rule)
+        return local - z->types[0].offset;
+    int32_t before = datetime_offset(z, local - 86400, NULL);
+    int32_t after = datetime_offset(z, local + 86400, NULL);
+    if (before == after)
+        return local - before; // no change of offset within a day either side
+    int64_t first = local - before, second = local - after;
+    int first_ok = datetime_offset(z, first, NULL) == before;
+    int second_ok = datetime_offset(z, second, NULL) == after;
+    if (first_ok && second_ok)
+        return first < second ? first : second;
+    return second_ok && !first_ok ? second : first;
+}
+
+/* Split an instant into its calendar fields in a zone */
+void datetime_split(int64_t seconds, int nanos, const TimeZone *zone, DateTimeParts *parts)
+{
+    parts->offset = datetime_offset(zone, seconds, &parts->abbrev);
+    int64_t local = seconds + parts->offset;
+    int64_t days = floor_div(local, 86400);
+    int rest = (int)(local - days * 86400);
+    civil_from_days(days, &parts->year, &parts->month, &parts->day);
+    parts->hour = rest / 3600;
+    parts->minute = rest / 60 % 60;
+    parts->second = rest % 60;
+    parts->nanos = nanos;
+    parts->weekday = weekday_of(days);
+    parts->yearday = (int)(days - days_from_civil(parts->year, 1, 1)) + 1;
+}
+
+/*
+ * Parsing
+ */
+
+/* Fields read from a timestamp, before they are resolved to an instant */
+typedef struct
+{
+    int year, month, day, yearday;
+    int hour, minute, second, nanos;
+    int pm; // -1 without %p
+    int offset, has_offset;
+    int64_t epoch;
+    int has_epoch;
+} Fields;
+
+static void fields_init(Fields *f)
+{
+    memset(f, 0, sizeof(*f));
+    f->year = 1970;
+    f->month = f->day = 1;
+    f->pm = -1;
+}
+
+static int fields_resolve(Fields *f, const TimeZone *zone, int64_t *seconds, int *nanos)
+{
+    *nanos = f->nanos;
+    if (f->has_epoch)
+    {
+        *seconds = f->epoch;
+        return 1;
+    }
+    if (f->pm >= 0)
+    {
+        if (f->hour < 1 || f->hour > 12)
+            return 0;
+        f->hour = f->hour % 12 + (f->pm ? 12 : 0);
+    }
+    if (f->month < 1 || f->month > 12 || f->day < 1 || f->day > month_days(f->year, f->month) || f->minute > 59 ||
+        f->second > 60 || f->hour > 24 || (f->hour == 24 && (f->minute || f->second || f->nanos)))
+        return 0;
+    int64_t days;
+    if (f->yearday)
+    {
+        if (f->yearday > 365 + is_leap(f->year))
+            return 0;
+        days = days_from_civil(f->year, 1, 1) + f->yearday - 1;
+    }
+    else
+        days = days_from_civil(f->year, f->month, f->day);
+    int64_t local = days * 86400 + f->hour * 3600 + f->minute * 60 + f->second;
+    *seconds = f->has_offset ? local - f->offset : zone_local_to_utc(zone, local);
+    return 1;
+}
+
+static int digits(const char *p, int n, int *value)
+{
+    int v = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (!isdigit((unsigned char)p[i]))
+            return 0;
+        v = v * 10 + (p[i] - '0');
+    }
+    *value = v;
+    return 1;
+}
+
+/* Fraction digits as nanoseconds; digits past the ninth are dropped */
+static const char *read_fraction(const char *p, int *nanos)
+{
+    int n = 0, v = 0;
+    for (; isdigit((unsigned char)p[n]); n++)
+        if (n < 9)
+            v = v * 10 + (p[n] - '0');
+    for (int i = n; i < 9; i++)
+        v *= 10;
+    *nanos = v;
+    return n ? p + n : NULL;
+}
+
+/* Z, +hh, +hhmm or +hh:mm */
+static const char *read_offset(const char *p, int *offset)
+{
+    int h, m = 0;
+    if (*p == 'Z' || *p == 'z')
+    {
+        *offset = 0;
+        return p + 1;
+    }
+    if ((*p != '+' && *p != '-') || !digits(p + 1, 2, &h) || h > 23)
+        return NULL;
+    int sign = *p == '-' ? -1 : 1;
+    p += 3;
+    if (*p == ':' && digits(p + 1, 2, &m))
+        p += 3;
+    else if (digits(p, 2, &m))
+        p += 2;
+    if (m > 59)
+        return NULL;
+    *offset = sign * (h * 3600 + m * 60);
+    return p;
+}
+
+/*
+ * ISO-8601 / RFC 3339: 2024-03-10, 2024-03-10T14:30, 2024-03-10 14:30:05.250+01:00,
+ * or the basic form 20240310T143005Z
+ */
+static int parse_iso(const char *s, Fields *f)
+{
+    if (!digits(s, 4, &f->year))
+        return 0;
+    s += 4;
+    int extended = *s == '-';
+    if (extended ? !digits(s + 1, 2, &f->month) || s[3] != '-' || !digits(s + 4, 2, &f->day)
+                 : !digits(s, 2, &f->month) || !digits(s + 2, 2, &f->day))
+        return 0;
+    s += extended ? 6 : 4;
+    if (!*s)
+        return 1;
+    if ((*s != 'T' && *s != 't' && *s != ' ') || !digits(s + 1, 2, &f->hour))
+        return 0;
+    s += 3;
+    if (extended ? *s == ':' && digits(s + 1, 2, &f->minute) : digits(s, 2, &f->minute))
+    {
+        s += extended ? 3 : 2;
+        if (extended ? *s == ':' && digits(s + 1, 2, &f->second) : digits(s, 2, &f->second))
+        {
+            s += extended ? 3 : 2;
+            if ((*s == '.' || *s == ',') && !(s = read_fraction(s + 1, &f->nanos)))
+                return 0;
+        }
+    }
+    if (*s)
+    {
+        if (!(s = read_offset(s, &f->offset)))
+            return 0;
+        f->has_offset = 1;
+    }
+    return *s == '\0';
+}
+
+/* One step of a compiled format */
+typedef struct
+{
+    char field;     // conversion letter, 0 for literal text, ' ' for a run of whitespace
+    uint8_t width;  // digits of numeric fields (0 when variable); characters of literals and whitespace
+    uint16_t text;  // literal's first character in CompiledFormat.literals
+    uint16_t at;    // position in the timestamp, when the format is fixed-width
+} FormatOp;
+
+typedef struct
+{
+    char *format;
+    FormatOp ops[FORMAT_MAX_OPS];
+    int count;
+    char literals[FORMAT_MAX_TEXT];
+    int literal_length;
+    int fixed_length; // timestamp length when every field is fixed-width, else -1
+} CompiledFormat;
+
+static CompiledFormat format_cache[FORMAT_CACHE];
+static int format_next; // slot replaced on a miss
+
+static int format_literal(CompiledFormat *c, char ch)
+{
+    if (c->literal_length == FORMAT_MAX_TEXT)
+        return 0;
+    FormatOp *last = c->count ? &c->ops[c->count - 1] : NULL;
+    if (!last || last->field != 0 || last->width == 255)
+    {
+        if (c->count == FORMAT_MAX_OPS)
+            return 0;
+        last = &c->ops[c->count++];
+        last->field = 0;
+        last->width = 0;
+        last->text = (uint16_t)c->literal_length;
+    }
+    c->literals[c->literal_length++] = ch;
+    last->width++;
+    return 1;
+}
+
+static int format_field(CompiledFormat *c, char field, int width)
+{
+    if (c->count == FORMAT_MAX_OPS)
+        return 0;
+    c->ops[c->count].field = field;
+    c->ops[c->count].width = (uint8_t)width;
+    c->count++;
+    return 1;
+}
+
+static int format_add(CompiledFormat *c, const char *f)
+{
+    while (*f)
+    {
+        if (isspace((unsigned char)*f))
+        {
+            const char *start = f;
+            while (isspace((unsigned char)*f))
+                f++;
+            if (!format_field(c, ' ', f - start < 255 ? (int)(f - start) : 255))
+                return 0;
+            continue;
+        }
+        if (*f != '%')
+        {
+            if (!format_literal(c, *f++))
+                return 0;
+            continue;
+        }
+        f++;
+        int width = 0;
+        if ((*f == '3' || *f == '6' || *f == '9') && f[1] == 'f')
+            width = *f++ - '0';
+        int ok;
+        switch (*f)
+        {
+        case 'T': ok = format_add(c, "%H:%M:%S"); break;
+        case 'D': ok = format_add(c, "%m/%d/%y"); break;
+        case 'F': ok = format_add(c, "%Y-%m-%d"); break;
+        case 'R': ok = format_add(c, "%H:%M"); break;
+        case '%': ok = format_literal(c, '%'); break;
+        case 'n':
+        case 't': ok = format_field(c, ' ', 1); break;
+        case 'Y': ok = format_field(c, 'Y', 4); break;
+        case 'm':
+        case 'd':
+        case 'H':
+        case 'M':
+        case 'S':
+        case 'y':
+        case 'I': ok = format_field(c, *f, 2); break;
+        case 'j': ok = format_field(c, 'j', 3); break;
+        case 'f': ok = format_field(c, 'f', width); break;
+        case 'h':
+        case 'B': ok = format_field(c, 'b', 0); break;
+        case 'A': ok = format_field(c, 'a', 0); break;
+        case 'e':
+        case 'b':
+        case 'a':
+        case 'p':
+        case 'z':
+        case 'Z':
+        case 's': ok = format_field(c, *f, 0); break;
+        default: return 0;
+        }
+        if (!ok)
+            return 0;
+        f++;
+    }
+    return 1;
+}
+
+/* The compiled form of a parse format, from the cache when it was seen before */
+static const CompiledFormat *format_compile(const char *format)
+{
+    for (int i = 0; i < FORMAT_CACHE; i++)
+        if (format_cache[i].format && strcmp(format_cache[i].format, format) == 0)
+            return format_cache[i].count >= 0 ? &format_cache[i] : NULL;
+    CompiledFormat *c = &format_cache[format_next];
+    format_next = (format_next + 1) % FORMAT_CACHE;
+    memory_free(c->format);
+    c->format = memory_strdup(format);
+    c->count = c->literal_length = 0;
+    if (!format_add(c, format))
+    {
+        c->count = -1; // remembered as invalid
+        return NULL;
+    }
+    int at = 0;
+    for (int i = 0; i < c->count && at >= 0; i++)
+    {
+        FormatOp *op = &c->ops[i];
+        op->at = (uint16_t)at;
+        at = op->field && (op->width == 0 || op->field == 'e') ? -1 : at + op->width;
+    }
+    c->fixed_length = at;
+    return c;
+}
+
+/* Store a numeric field; %3f, %6f and %9f pass their digits with width */
+static int numeric_field(Fields *f, char field, int value, int width)
+{
+    switch (field)
+    {
+    case 'Y': f->year = value; break;
+    case 'm': f->month = value; break;
+    case 'd':
+    case 'e': f->day = value; break;
+    case 'H':
+    case 'I': f->hour = value; break;
+    case 'M': f->minute = value; break;
+    case 'S': f->second = value; break;
+    case 'y': f->year = value + (value < 69 ? 2000 : 1900); break;
+    case 'j':
+        if (value < 1)
+            return 0;
+        f->yearday = value;
+        break;
+    case 'f':
+        for (; width < 9; width++)
+            value *= 10;
+        f->nanos = value;
+        break;
+    }
+    return 1;
+}
+
+/* The fast path: every field at a known position, digits read in place */
+static int parse_fixed(const CompiledFormat *c, const char *text, Fields *f)
+{
+    for (int i = 0; i < c->count; i++)
+    {
+        const FormatOp *op = &c->ops[i];
+        const char *p = text + op->at;
+        int value;
+        if (op->field == 0)
+        {
+            if (memcmp(p, c->literals + op->text, op->width) != 0)
+                return 0;
+        }
+        else if (op->field == ' ')
+        {
+            for (int k = 0; k < op->width; k++)
+                if (!isspace((unsigned char)p[k]))
+                    return 0;
+        }
+        else if (!digits(p, op->width, &value) || !numeric_field(f, op->field, value, op->width))
+            return 0;
+        if (op->field == 'I')
+            f->pm = 0; // no %p in a fixed-width format: 12-hour times read as AM
+    }
+    return 1;
+}
+
+static int prefix_matches(const char *p, const char *name, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        if (tolower((unsigned char)p[i]) != tolower((unsigned char)name[i]))
+            return 0;
+    return 1;
+}
+
+/* A name from a table, full or as its first three letters, in any case */
+static const char *read_name(const char *p, const char **names, int count, int *index)
+{
+    for (int i = 0; i < count; i++)
+    {
+        size_t full = strlen(names[i]);
+        if (prefix_matches(p, names[i], full))
+        {
+            *index = i;
+            return p + full;
+        }
+    }
+    for (int i = 0; i < count; i++)
+        if (prefix_matches(p, names[i], 3))
+        {
+            *index = i;
+            return p + 3;
+        }
+    return NULL;
+}
+
+static int parse_scan(const CompiledFormat *c, const char *p, Fields *f)
+{
+    int value;
+    for (int i = 0; i < c->count; i++)
+    {
+        const FormatOp *op = &c->ops[i];
+        switch (op->field)
+        {
+        case 0:
+            if (strncmp(p, c->literals + op->text, op->width) != 0)
+                return 0;
+            p += op->width;
+            break;
+        case ' ':
+            while (isspace((unsigned char)*p))
+                p++;
+            break;
+        case 'f':
+            if (op->width ? !digits(p, op->width, &value) || !numeric_field(f, 'f', value, op->width)
+                          : !(p = read_fraction(p, &f->nanos)))
+                return 0;
+            p += op->width;
+            break;
+        case 'b':
+            if (!(p = read_name(p, month_names, 12, &value)))
+                return 0;
+            f->month = value + 1;
+            break;
+        case 'a':
+            if (!(p = read_name(p, weekday_names, 7, &value)))
+                return 0;
+            break;
+        case 'p':
+            if ((toupper((unsigned char)p[0]) != 'A' && toupper((unsigned char)p[0]) != 'P') ||
+                toupper((unsigned char)p[1]) != 'M')
+                return 0;
+            f->pm = toupper((unsigned char)p[0]) == 'P';
+            p += 2;
+            break;
+        case 'z':
+            if (!(p = read_offset(p, &f->offset)))
+                return 0;
+            f->has_offset = 1;
+            break;
+        case 'Z':
+        {
+            // matched but only UTC names set the offset; abbreviations like CST are ambiguous
+            const char *start = p;
+            while (isalpha((unsigned char)*p))
+                p++;
+            if (p == start)
+                return 0;
+            if (!f->has_offset && ((p - start == 3 && (strncmp(start, "UTC", 3) == 0 || strncmp(start, "GMT", 3) == 0)) ||
+                                   (p - start == 1 && *start == 'Z')))
+                f->has_offset = 1;
+            break;
+        }
+        case 's':
+        {
+            int sign = *p == '-' ? -1 : 1;
+            int n = 0;
+            int64_t epoch = 0;
+            if (*p == '-' || *p == '+')
+                p++;
+            for (; isdigit((unsigned char)*p) && n < 18; n++)
+                epoch = epoch * 10 + (*p++ - '0');
+            if (!n)
+                return 0;
+            f->epoch = sign * epoch;
+            f->has_epoch = 1;
+            break;
+        }
+        default:
+        {
+            if (op->field == 'e' && *p == ' ')
+                p++;
+            int max = op->field == 'e' ? 2 : op->width, n = 0;
+            for (value = 0; n < max && isdigit((unsigned char)p[n]); n++)
+                value = value * 10 + (p[n] - '0');
+            if (!n || !numeric_field(f, op->field, value, n))
+                return 0;
+            if (op->field == 'I' && f->pm < 0)
+                f->pm = 0;
+            p += n;
+        }
+        }
+    }
+    return *p == '\0';
+}
+
+/*
+ * Parse a timestamp into an instant
+ *
+ * @param format: strftime-style format, or NULL for ISO-8601. Fields are
+ *        %Y %m %d %e %H %I %M %S %f (%3f, %6f, %9f for a set number of
+ *        digits) %y %j %b/%B %a/%A %p %z %Z %s and the shorthands %T %D %F %R;
+ *        whitespace matches any run of whitespace
+ * @param zone: Zone of timestamps that carry no offset
+ * @return: 1 with seconds since the epoch and the fraction, 0 if the text
+ *          does not match
+ */
+int datetime_parse(const char *text, const char *format, const TimeZone *zone, int64_t *seconds, int *nanos)
+{
+    Fields f;
+    fields_init(&f);
+    if (!format)
+        return parse_iso(text, &f) && fields_resolve(&f, zone, seconds, nanos);
+    const CompiledFormat *c = format_compile(format);
+    if (!c)
+        return 0;
+    if (c->fixed_length < 0 || strlen(text) != (size_t)c->fixed_length || !parse_fixed(c, text, &f))
+    {
+        fields_init(&f); // a text of the fixed length can still need scanning ("2024-3-10  14:30")
+        if (!parse_scan(c, text, &f))
+            return 0;
+    }
+    return fields_resolve(&f, zone, seconds, nanos);
+}
+
+/*
+ * Formatting
+ */
+
+typedef struct
+{
+    char *data;
+    size_t length, capacity;
+} Text;
+
+static void text_put(Text *t, const char *s, size_t n)
+{
+    if (t->length + n + 1 > t->capacity)
+    {
+        t->capacity = (t->length + n + 1) * 2;
+        t->data = memory_reallocate(t->data, t->capacity);
+    }
+    memcpy(t->data + t->length, s, n);
+    t->length += n;
+    t->data[t->length] = '\0';
+}
+
+static void text_number(Text *t, long long value, int width, char pad)
+{
+    char buf[32];
+    int n = pad == '0' ? snprintf(buf, sizeof(buf), "%0*lld", width, value)
+                       : snprintf(buf, sizeof(buf), "%*lld", width, value);
+    text_put(t, buf, (size_t)n);
+}
+
+static void text_offset(Text *t, int offset, int colon)
+{
+    char buf[16];
+    int a = offset < 0 ? -offset : offset;
+    int n = snprintf(buf, sizeof(buf), colon ? "%c%02d:%02d" : "%c%02d%02d", offset < 0 ? '-' : '+', a / 3600,
+                     a / 60 % 60);
+    text_put(t, buf, (size_t)n);
+}
+
+static void text_fraction(Text *t, int nanos, int digits)
+{
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%09d", nanos);
+    text_put(t, buf, (size_t)digits);
+}
+
+static void format_parts(Text *t, const DateTimeParts *p, int64_t seconds, const char *f)
+{
+    for (; *f; f++)
+    {
+        if (*f != '%' || !f[1])
+        {
+            text_put(t, f, 1);
+            continue;
+        }
+        f++;
+        int width = 6;
+        if ((*f == '3' || *f == '6' || *f == '9') && f[1] == 'f')
+            width = *f++ - '0';
+        int colon = *f == ':' && f[1] == 'z';
+        if (colon)
+            f++;
+        switch (*f)
+        {
+        case 'Y': text_number(t, p->year, 4, '0'); break;
+        case 'y': text_number(t, (p->year % 100 + 100) % 100, 2, '0'); break;
+        case 'm': text_number(t, p->month, 2, '0'); break;
+        case 'd': text_number(t, p->day, 2, '0'); break;
+        case 'e': text_number(t, p->day, 2, ' '); break;
+        case 'j': text_number(t, p->yearday, 3, '0'); break;
+        case 'H': text_number(t, p->hour, 2, '0'); break;
+        case 'I': text_number(t, p->hour % 12 ? p->hour % 12 : 12, 2, '0'); break;
+        case 'M': text_number(t, p->minute, 2, '0'); break;
+        case 'S': text_number(t, p->second, 2, '0'); break;
+        case 'f': text_fraction(t, p->nanos, width); break;
+        case 'p': text_put(t, p->hour < 12 ? "AM" : "PM", 2); break;
+        case 'b':
+        case 'h': text_put(t, month_names[p->month - 1], 3); break;
+        case 'B': text_put(t, month_names[p->month - 1], strlen(month_names[p->month - 1])); break;
+        case 'a': text_put(t, weekday_names[p->weekday], 3); break;
+        case 'A': text_put(t, weekday_names[p->weekday], strlen(weekday_names[p->weekday])); break;
+        case 'u': text_number(t, p->weekday ? p->weekday : 7, 1, '0'); break;
+        case 'w': text_number(t, p->weekday, 1, '0'); break;
+        case 'z': text_offset(t, p->offset, colon); break;
+        case 'Z': text_put(t, p->abbrev, strlen(p->abbrev)); break;
+        case 's': text_number(t, seconds, 1, '0'); break;
+        case 'T': format_parts(t, p, seconds, "%H:%M:%S"); break;
+        case 'D': format_parts(t, p, seconds, "%m/%d/%y"); break;
+        case 'F': format_parts(t, p, seconds, "%Y-%m-%d"); break;
+        case 'R': format_parts(t, p, seconds, "%H:%M"); break;
+        case 'n': text_put(t, "\n", 1); break;
+        case 't': text_put(t, "\t", 1); break;
+        case '%': text_put(t, "%", 1); break;
+        default: text_put(t, f - 1, 2); break; // unknown: kept as written
+        }
+    }
+}
+
+/*
+ * Format an instant as text in a zone
+ *
+ * @param format: strftime-style format (the parse fields plus %u, %w and
+ *        %:z for +hh:mm), or NULL for ISO-8601 with the shortest of 0, 3, 6
+ *        or 9 fraction digits and "Z" for UTC
+ * @return: The text, allocated with memory_allocate
+ */
+char *datetime_format(int64_t seconds, int nanos, const char *format, const TimeZone *zone)
+{
+    DateTimeParts parts;
+    Text t = {NULL, 0, 0};
+    datetime_split(seconds, nanos, zone, &parts);
+    text_put(&t, "", 0);
+    if (format)
+    {
+        format_parts(&t, &parts, seconds, format);
+        return t.data;
+    }
+    format_parts(&t, &parts, seconds, "%Y-%m-%dT%H:%M:%S");
+    if (nanos)
+    {
+        text_put(&t, ".", 1);
+        text_fraction(&t, nanos, nanos % 1000000 == 0 ? 3 : nanos % 1000 == 0 ? 6 : 9);
+    }
+    if (parts.offset == 0)
+        text_put(&t, "Z", 1);
+    else
+        text_offset(&t, parts.offset, 1);
+    return t.data;
+}
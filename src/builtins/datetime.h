@@ -0,0 +1,39 @@
+#ifndef SHARPSCRIPT_DATETIME_H
+#define SHARPSCRIPT_DATETIME_H
+
+#include <stdint.h>
+
+/*
+ * Calendar time behind system.time: ISO-8601 and strftime-style parsing
+ * and formatting in any time zone. Zones come from the system tzdata
+ * (TZif files under $TZDIR or /usr/share/zoneinfo, with the POSIX rule in
+ * the file's footer for dates past its last transition); each is read
+ * once and cached for the life of the process. "UTC", "local" and fixed
+ * offsets such as "+05:30" need no file. Parse formats are compiled once
+ * and cached as well, and a format made only of fixed-width fields
+ * ("%Y-%m-%d %H:%M:%S") is matched by position without scanning.
+ */
+typedef struct TimeZone TimeZone;
+
+/* An instant as seen in a zone */
+typedef struct
+{
+    int year, month, day; // month 1-12
+    int hour, minute, second;
+    int nanos;
+    int weekday; // 0 = Sunday
+    int yearday; // 1-366
+    int offset;  // seconds east of UTC
+    const char *abbrev;
+} DateTimeParts;
+
+void datetime_now(int64_t *seconds, int *nanos);
+
+const TimeZone *datetime_zone(const char *name);
+int datetime_offset(const TimeZone *zone, int64_t seconds, const char **abbrev);
+void datetime_split(int64_t seconds, int nanos, const TimeZone *zone, DateTimeParts *parts);
+
+int datetime_parse(const char *text, const char *format, const TimeZone *zone, int64_t *seconds, int *nanos);
+char *datetime_format(int64_t seconds, int nanos, const char *format, const TimeZone *zone);
+
+#endif
@@ -0,0 +1,105 @@
+#include "deque.h"
+#include "../include/memory.h"
+#include <string.h>
+
+struct Deque
+{
+    int refs;
+    void **items;
+    unsigned head;     // position of the front item
+    unsigned count;
+    unsigned capacity; // power of two
+    void (*free_value)(void *);
+};
+
+Deque *deque_create(void (*free_value)(void *))
+{
+    Deque *d = memory_allocate(sizeof(Deque));
+    d->refs = 1;
+    d->head = 0;
+    d->count = 0;
+    d->capacity = 16;
+    d->items = memory_allocate(sizeof(void *) * d->capacity);
+    d->free_value = free_value;
+    return d;
+}
+
+Deque *deque_retain(Deque *d)
+{
+    d->refs++;
+    return d;
+}
+
+void deque_release(Deque *d)
+{
+    if (!d || --d->refs > 0)
+        return;
+    for (unsigned i = 0; i < d->count; i++)
+        d->free_value(d->items[(d->head + i) & (d->capacity - 1)]);
+    memory_free(d->items);
+    memory_free(d);
+}
+
+int deque_count(const Deque *d)
+{
+    return (int)d->count;
+}
+
+/* Double the ring, unwrapping it so the front is at 0 */
+static void deque_grow(Deque *d)
+{
+    void **items = memory_allocate(sizeof(void *) * d->capacity * 2);
+    unsigned first = d->capacity - d->head; // items before the wrap
+    if (first > d->count)
+        first = d->count;
+    memcpy(items, d->items + d->head, sizeof(void *) * first);
+    memcpy(items + first, d->items, sizeof(void *) * (d->count - first));
+    memory_free(d->items);
+    d->items = items;
+    d->head = 0;
+    d->capacity *= 2;
+}
+
+void deque_push_back(Deque *d, void *value)
+{
+    if (d->count == d->capacity)
+        deque_grow(d);
+    d->items[(d->head + d->count++) & (d->capacity - 1)] = value;
+}
+
+void deque_push_front(Deque *d, void *value)
+{
+    if (d->count == d->capacity)
+        deque_grow(d);
+    d->head = (d->head - 1) & (d->capacity - 1);
+    d->items[d->head] = value;
+    d->count++;
+}
+
+/* Pops return the value (now owned by the caller), or NULL when empty */
+void *deque_pop_back(Deque *d)
+{
+    if (!d->count)
+        return NULL;
+    return d->items[(d->head + --d->count) & (d->capacity - 1)];
+}
+
+void *deque_pop_front(Deque *d)
+{
+    if (!d->count)
+        return NULL;
+    void *value = d->items[d->head];
+    d->head = (d->head + 1) & (d->capacity - 1);
+    d->count--;
+    return value;
+}
+
+/* Item at index from the front (negative counts from the back), or NULL */
+void *deque_get(const Deque *d, int index)
+{
+    if (index < 0)
+        index += (int)d->count;
+    if (index < 0 || (unsigned)index >= d->count)
+        return NULL;
+    return d->items[(d->head + (unsigned)index) & (d->capacity - 1)];
+}
@@ -0,0 +1,23 @@
+#ifndef SHARPSCRIPT_DEQUE_H
+#define SHARPSCRIPT_DEQUE_H
+
+/*
+ * Double-ended queues behind VAL_DEQUE: a ring buffer with a power-of-two
+ * capacity, so pushes and pops at either end are O(1) and indexing is a
+ * mask. Values are opaque and freed with the function given at creation;
+ * deques are shared by reference count.
+ */
+typedef struct Deque Deque;
+
+Deque *deque_create(void (*free_value)(void *));
+Deque *deque_retain(Deque *d);
+void deque_release(Deque *d);
+
+int deque_count(const Deque *d);
+void deque_push_back(Deque *d, void *value);
+void deque_push_front(Deque *d, void *value);
+void *deque_pop_back(Deque *d);
+void *deque_pop_front(Deque *d);
+void *deque_get(const Deque *d, int index);
+
+#endif
@@ -0,0 +1,334 @@
+#include "encoding.h"
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define ENCODING_X86
+#include <immintrin.h>
+#define ENCODING_TARGET __attribute__((target("avx2")))
+#endif
+
+#define BASE64_INVALID -1
+#define BASE64_SPACE -2 // skipped between quads (line breaks in MIME bodies)
+
+static const char base64_alphabet[2][65] = {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/",
+                                            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"};
+static const char hex_digits[] = "0123456789abcdef";
+
+static int8_t base64_value[2][256]; // sextet per character, or BASE64_INVALID/BASE64_SPACE; built on first use
+static int8_t hex_value[256];
+static int tables_ready = 0;
+
+static void tables_init(void)
+{
+    if (tables_ready)
+        return;
+    for (int url = 0; url < 2; url++)
+    {
+        memset(base64_value[url], BASE64_INVALID, 256);
+        for (int i = 0; i < 64; i++)
+            base64_value[url][(uint8_t)base64_alphabet[url][i]] = (int8_t)i;
+        base64_value[url][' '] = base64_value[url]['\t'] = BASE64_SPACE;
+        base64_value[url]['\r'] = base64_value[url]['\n'] = BASE64_SPACE;
+    }
+    memset(hex_value, -1, 256);
+    for (int i = 0; i < 10; i++)
+        hex_value['0' + i] = (int8_t)i;
+    for (int i = 0; i < 6; i++)
+        hex_value['a' + i] = hex_value['A' + i] = (int8_t)(10 + i);
+    tables_ready = 1;
+}
+
+#ifdef ENCODING_X86
+/*
+ * 24 bytes to 32 characters per step (Muła and Lemire): each 128-bit lane
+ * takes 12 bytes, a shuffle spreads every 3 into 4 byte slots, two
+ * multiplies shift the sextets into place and a 16-entry table adds the
+ * offset of the sextet's character range. Reads 4 bytes past each step,
+ * so steps run while 28 bytes remain.
+ */
+static size_t ENCODING_TARGET base64_encode_avx2(const uint8_t *src, size_t len, int url, char *out)
+{
+    const __m256i spread = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10, 1, 0, 2, 1, 4, 3, 5, 4, 7,
+                                            6, 8, 7, 10, 9, 11, 10);
+    const char plus = url ? '-' : '+', slash = url ? '_' : '/';
+    const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, plus - 62, slash - 63, 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, plus - 62, slash - 63, 'A', 0, 0);
+    const __m256i mask_hi = _mm256_set1_epi32(0x0fc0fc00), mul_hi = _mm256_set1_epi32(0x04000040);
+    const __m256i mask_lo = _mm256_set1_epi32(0x003f03f0), mul_lo = _mm256_set1_epi32(0x01000010);
+    const __m256i v51 = _mm256_set1_epi8(51), v26 = _mm256_set1_epi8(26), v13 = _mm256_set1_epi8(13);
+    size_t done = 0;
+    for (; len - done >= 28; done += 24, out += 32)
+    {
+        __m256i in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)(src + done))),
+            _mm_loadu_si128((const __m128i *)(src + done + 12)), 1);
+        in = _mm256_shuffle_epi8(in, spread);
+        __m256i hi = _mm256_mulhi_epu16(_mm256_and_si256(in, mask_hi), mul_hi);
+        __m256i lo = _mm256_mullo_epi16(_mm256_and_si256(in, mask_lo), mul_lo);
+        __m256i sextets = _mm256_or_si256(hi, lo);
+        // 0..25 -> 13, 26..51 -> 0, 52..61 -> 1..10, 62 -> 11, 63 -> 12: the slot of the range's offset
+        __m256i range = _mm256_subs_epu8(sextets, v51);
+        range = _mm256_or_si256(range, _mm256_and_si256(_mm256_cmpgt_epi8(v26, sextets), v13));
+        __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(shift, range), sextets);
+        _mm256_storeu_si256((__m256i *)out, chars);
+    }
+    return done;
+}
+
+/*
+ * 32 characters to 24 bytes per step. The high and low nibble of each
+ * character index two bit-set tables whose AND is zero only for the
+ * standard alphabet; a third table by high nibble gives the offset back to
+ * the sextet. URL-safe input is mapped onto the standard alphabet first.
+ * Stops at the first step holding anything else (padding, whitespace or an
+ * invalid character) and returns the characters consumed.
+ */
+static size_t ENCODING_TARGET base64_decode_avx2(const uint8_t *src, size_t len, int url, uint8_t *out)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A,
+                                            0x1B, 0x1B, 0x1B, 0x1A, 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 19, 4,
+                                              -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i gather = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1, 2, 1, 0, 6, 5, 4,
+                                            10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f), plus = _mm256_set1_epi8('+'), slash = _mm256_set1_epi8('/');
+    const __m256i minus = _mm256_set1_epi8('-'), underscore = _mm256_set1_epi8('_');
+    const __m256i merge_pairs = _mm256_set1_epi32(0x01400140), merge_words = _mm256_set1_epi32(0x00011000);
+    const __m256i squeeze = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    size_t done = 0;
+    for (; len - done >= 32; done += 32, out += 24)
+    {
+        __m256i str = _mm256_loadu_si256((const __m256i *)(src + done));
+        if (url)
+        {
+            __m256i standard = _mm256_or_si256(_mm256_cmpeq_epi8(str, plus), _mm256_cmpeq_epi8(str, slash));
+            if (!_mm256_testz_si256(standard, standard))
+                break;
+            str = _mm256_blendv_epi8(str, plus, _mm256_cmpeq_epi8(str, minus));
+            str = _mm256_blendv_epi8(str, slash, _mm256_cmpeq_epi8(str, underscore));
+        }
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(str, mask_2f));
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        if (!_mm256_testz_si256(lo, hi))
+            break;
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(str, mask_2f), hi_nibbles));
+        __m256i sextets = _mm256_add_epi8(str, roll);
+        // pack 4 sextets into 3 bytes per 32-bit word, then squeeze out the gaps
+        __m256i words = _mm256_madd_epi16(_mm256_maddubs_epi16(sextets, merge_pairs), merge_words);
+        words = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(words, gather), squeeze);
+        _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(words));
+        _mm_storel_epi64((__m128i *)(out + 16), _mm256_extracti128_si256(words, 1));
+    }
+    return done;
+}
+
+/* 16 bytes to 32 characters: split the nibbles into byte pairs and look each up */
+static size_t ENCODING_TARGET hex_encode_avx2(const uint8_t *src, size_t len, char *out)
+{
+    const __m256i digits = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e',
+                                            'f', '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd',
+                                            'e', 'f');
+    const __m256i low_nibble = _mm256_set1_epi16(0x0f);
+    size_t done = 0;
+    for (; len - done >= 16; done += 16, out += 32)
+    {
+        __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(src + done)));
+        __m256i pairs = _mm256_or_si256(_mm256_srli_epi16(x, 4), _mm256_slli_epi16(_mm256_and_si256(x, low_nibble), 8));
+        _mm256_storeu_si256((__m256i *)out, _mm256_shuffle_epi8(digits, pairs));
+    }
+    return done;
+}
+
+/* 32 characters to 16 bytes; stops at the first step with a non-hex character */
+static size_t ENCODING_TARGET hex_decode_avx2(const uint8_t *src, size_t len, uint8_t *out)
+{
+    const __m256i zero = _mm256_set1_epi8('0'), lower = _mm256_set1_epi8(0x20), a = _mm256_set1_epi8('a');
+    const __m256i v9 = _mm256_set1_epi8(9), v5 = _mm256_set1_epi8(5), v10 = _mm256_set1_epi8(10);
+    const __m256i merge = _mm256_set1_epi16(0x0110); // high * 16 + low
+    size_t done = 0;
+    for (; len - done >= 32; done += 32, out += 16)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i *)(src + done));
+        __m256i digit = _mm256_sub_epi8(c, zero);
+        __m256i letter = _mm256_sub_epi8(_mm256_or_si256(c, lower), a);
+        __m256i is_digit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, v9), digit);
+        __m256i is_letter = _mm256_cmpeq_epi8(_mm256_min_epu8(letter, v5), letter);
+        if (_mm256_movemask_epi8(_mm256_or_si256(is_digit, is_letter)) != -1)
+            break;
+        __m256i nibbles = _mm256_blendv_epi8(_mm256_add_epi8(letter, v10), digit, is_digit);
+        __m256i bytes = _mm256_maddubs_epi16(nibbles, merge);
+        bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(bytes, bytes), 0x08);
+        _mm_storeu_si128((__m128i *)out, _mm256_castsi256_si128(bytes));
+    }
+    return done;
+}
+#endif
+
+/* Characters for len bytes, with or without '=' padding */
+size_t base64_encoded_size(size_t len, int pad)
+{
+    return pad ? (len + 2) / 3 * 4 : len / 3 * 4 + (len % 3 ? len % 3 + 1 : 0);
+}
+
+/*
+ * base64_encode: Write the base64 text of src to out (no terminator)
+ *
+ * url selects the "-_" alphabet; pad appends '=' to a whole quad.
+ * Returns: Characters written (base64_encoded_size)
+ */
+size_t base64_encode(const uint8_t *src, size_t len, int url, int pad, char *out)
+{
+    const char *alphabet = base64_alphabet[url != 0];
+    size_t i = 0;
+    char *o = out;
+#ifdef ENCODING_X86
+    if (__builtin_cpu_supports("avx2"))
+    {
+        i = base64_encode_avx2(src, len, url, o);
+        o += i / 3 * 4;
+    }
+#endif
+    for (; len - i >= 3; i += 3)
+    {
+        uint32_t v = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 | src[i + 2];
+        *o++ = alphabet[v >> 18];
+        *o++ = alphabet[(v >> 12) & 63];
+        *o++ = alphabet[(v >> 6) & 63];
+        *o++ = alphabet[v & 63];
+    }
+    if (len - i)
+    {
+        uint32_t v = (uint32_t)src[i] << 16 | (len - i == 2 ? (uint32_t)src[i + 1] << 8 : 0);
+        *o++ = alphabet[v >> 18];
+        *o++ = alphabet[(v >> 12) & 63];
+        if (len - i == 2)
+            *o++ = alphabet[(v >> 6) & 63];
+        else if (pad)
+            *o++ = '=';
+        if (pad)
+            *o++ = '=';
+    }
+    return (size_t)(o - out);
+}
+
+/*
+ * base64_decode: Decode base64 text into out (room for len / 4 * 3 + 3 bytes)
+ *
+ * Whitespace between characters is skipped and padding is optional, but
+ * once '=' appears only padding and whitespace may follow.
+ * Returns: 1 and the byte count in *out_len, or 0 for invalid text
+ */
+int base64_decode(const char *src, size_t len, int url, uint8_t *out, size_t *out_len)
+{
+    tables_init();
+    const int8_t *value = base64_value[url != 0];
+    const uint8_t *p = (const uint8_t *)src, *end = p + len;
+    uint8_t *o = out;
+#ifdef ENCODING_X86
+    int simd = __builtin_cpu_supports("avx2");
+#endif
+    while (1)
+    {
+#ifdef ENCODING_X86
+        if (simd)
+        {
+            size_t used = base64_decode_avx2(p, (size_t)(end - p), url, o);
+            p += used;
+            o += used / 4 * 3;
+        }
+#endif
+        // one quad at a time past whatever stopped the fast path
+        uint32_t quad = 0;
+        int n = 0;
+        while (n < 4 && p < end)
+        {
+            int v = value[*p];
+            if (v == BASE64_INVALID)
+                break;
+            p++;
+            if (v != BASE64_SPACE)
+            {
+                quad = quad << 6 | (uint32_t)v;
+                n++;
+            }
+        }
+        if (n == 4)
+        {
+            *o++ = (uint8_t)(quad >> 16);
+            *o++ = (uint8_t)(quad >> 8);
+            *o++ = (uint8_t)quad;
+            continue;
+        }
+        if (p < end)
+        {
+            if (*p != '=' || n < 2)
+                return 0;
+            int pads = 0;
+            for (; p < end; p++)
+            {
+                if (*p == '=')
+                    pads++;
+                else if (value[*p] != BASE64_SPACE)
+                    return 0;
+            }
+            if (n + pads != 4)
+                return 0;
+        }
+        if (n == 1)
+            return 0;
+        if (n == 2)
+            *o++ = (uint8_t)(quad >> 4);
+        else if (n == 3)
+        {
+            *o++ = (uint8_t)(quad >> 10);
+            *o++ = (uint8_t)(quad >> 2);
+        }
+        break;
+    }
+    *out_len = (size_t)(o - out);
+    return 1;
+}
+
+/* Write 2 * len lowercase hex digits to out (no terminator) */
+void hex_encode(const uint8_t *src, size_t len, char *out)
+{
+    size_t i = 0;
+#ifdef ENCODING_X86
+    if (__builtin_cpu_supports("avx2"))
+        i = hex_encode_avx2(src, len, out);
+#endif
+    for (; i < len; i++)
+    {
+        out[2 * i] = hex_digits[src[i] >> 4];
+        out[2 * i + 1] = hex_digits[src[i] & 15];
+    }
+}
+
+/* Decode len (even) hex digits of either case into len / 2 bytes; returns 0 for invalid text */
+int hex_decode(const char *src, size_t len, uint8_t *out)
+{
+    if (len % 2)
+        return 0;
+    tables_init();
+    const uint8_t *p = (const uint8_t *)src;
+    size_t i = 0;
+#ifdef ENCODING_X86
+    if (__builtin_cpu_supports("avx2"))
+        i = hex_decode_avx2(p, len, out);
+#endif
+    for (; i < len; i += 2)
+    {
+        int hi = hex_value[p[i]], lo = hex_value[p[i + 1]];
+        if (hi < 0 || lo < 0)
+            return 0;
+        out[i / 2] = (uint8_t)(hi << 4 | lo);
+    }
+    return 1;
+}
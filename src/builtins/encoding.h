@@ -0,0 +1,21 @@
+#ifndef SHARPSCRIPT_ENCODING_H
+#define SHARPSCRIPT_ENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Base64 (RFC 4648, standard and URL-safe alphabets) and hex text for
+ * system.base64, system.base64url and system.hex. Long runs go through
+ * AVX2 kernels when the CPU has them (24 bytes to 32 characters per step
+ * for base64, 16 bytes to 32 characters for hex); the scalar code handles
+ * the ends, whitespace between base64 quads and anything invalid.
+ */
+size_t base64_encoded_size(size_t len, int pad);
+size_t base64_encode(const uint8_t *src, size_t len, int url, int pad, char *out);
+int base64_decode(const char *src, size_t len, int url, uint8_t *out, size_t *out_len);
+
+void hex_encode(const uint8_t *src, size_t len, char *out);
+int hex_decode(const char *src, size_t len, uint8_t *out);
+
+#endif
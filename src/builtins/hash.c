@@ -0,0 +1,656 @@
+#include "hash.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define HASH_X86
+#include <immintrin.h>
+#define CRC_TARGET __attribute__((target("sse4.2")))
+#define SHA_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+#define HASH_FILE_CHUNK 65536
+
+int hash_kind_parse(const char *name, HashKind *kind)
+{
+    if (strcmp(name, "crc32c") == 0)
+        *kind = HASH_CRC32C;
+    else if (strcmp(name, "xxh32") == 0)
+        *kind = HASH_XXH32;
+    else if (strcmp(name, "crc32") == 0)
+        *kind = HASH_CRC32;
+    else if (strcmp(name, "xxh64") == 0)
+        *kind = HASH_XXH64;
+    else if (strcmp(name, "sha256") == 0)
+        *kind = HASH_SHA256;
+    else
+        return 0;
+    return 1;
+}
+
+size_t hash_digest_size(HashKind kind)
+{
+    switch (kind)
+    {
+    case HASH_CRC32C:
+    case HASH_CRC32:
+    case HASH_XXH32:
+        return 4;
+    case HASH_XXH64:
+        return 8;
+    default:
+        return 32;
+    }
+}
+
+static uint64_t read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+
+static void put_be(uint8_t *out, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++)
+        out[i] = (uint8_t)(value >> (8 * (bytes - 1 - i)));
+}
+
+/* --- CRC-32C (Castagnoli, reflected polynomial 0x82F63B78) and CRC-32 (IEEE, 0xEDB88320) --- */
+
+static uint32_t crc_table[8][256]; // CRC-32C slicing-by-8, built on first use
+static int crc_table_ready = 0;
+static uint32_t crc32_table[8][256]; // the same for the IEEE polynomial (gzip, zip, PNG)
+static int crc32_table_ready = 0;
+
+static void crc_tables_build(uint32_t table[8][256], uint32_t poly)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? (c >> 1) ^ poly : c >> 1;
+        table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (int t = 1; t < 8; t++)
+            table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xff];
+    }
+}
+
+static void crc32c_init(void)
+{
+    if (crc_table_ready)
+        return;
+    crc_tables_build(crc_table, 0x82F63B78u);
+    crc_table_ready = 1;
+}
+
+/* Advance a (pre-inverted) CRC register eight bytes at a time */
+static uint32_t crc_slice8(uint32_t table[8][256], uint32_t crc, const uint8_t *p, size_t len)
+{
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        uint32_t lo = read32(p) ^ crc, hi = read32(p + 4);
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+              table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^ table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+    }
+    for (; len; len--)
+        crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+    return crc;
+}
+
+#ifdef HASH_X86
+#define CRC_LANE 8192 // bytes per stream when three run side by side
+
+static uint32_t crc_lane_shift[4][256]; // the register after CRC_LANE zero bytes, by byte
+static int crc_lane_shift_ready = 0;
+
+/* The CRC register is linear, so the shift is tabulated from its effect on each bit */
+static void crc32c_lane_init(void)
+{
+    if (crc_lane_shift_ready)
+        return;
+    crc32c_init();
+    uint32_t basis[32];
+    for (int bit = 0; bit < 32; bit++)
+    {
+        uint32_t r = 1u << bit;
+        for (int i = 0; i < CRC_LANE; i++)
+            r = (r >> 8) ^ crc_table[0][r & 0xff];
+        basis[bit] = r;
+    }
+    for (int k = 0; k < 4; k++)
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            uint32_t v = 0;
+            for (int bit = 0; bit < 8; bit++)
+            {
+                if (b >> bit & 1)
+                    v ^= basis[8 * k + bit];
+            }
+            crc_lane_shift[k][b] = v;
+        }
+    }
+    crc_lane_shift_ready = 1;
+}
+
+static uint32_t crc_shift_lane(uint32_t r)
+{
+    return crc_lane_shift[0][r & 0xff] ^ crc_lane_shift[1][(r >> 8) & 0xff] ^ crc_lane_shift[2][(r >> 16) & 0xff] ^
+           crc_lane_shift[3][r >> 24];
+}
+
+/*
+ * crc32 has a latency of three cycles but issues every cycle, so long
+ * inputs run three streams of CRC_LANE bytes at once and join them with
+ * crc(a || b) = shift(crc(a), |b|) ^ crc(b) started from zero.
+ */
+static uint32_t CRC_TARGET crc32c_sse42(uint32_t crc, const uint8_t *p, size_t len)
+{
+    if (len >= 3 * CRC_LANE)
+    {
+        crc32c_lane_init();
+        for (; len >= 3 * CRC_LANE; len -= 3 * CRC_LANE, p += 3 * CRC_LANE)
+        {
+            uint64_t c0 = crc, c1 = 0, c2 = 0;
+            for (size_t i = 0; i < CRC_LANE; i += 8)
+            {
+                uint64_t v0, v1, v2;
+                memcpy(&v0, p + i, 8);
+                memcpy(&v1, p + CRC_LANE + i, 8);
+                memcpy(&v2, p + 2 * CRC_LANE + i, 8);
+                c0 = _mm_crc32_u64(c0, v0);
+                c1 = _mm_crc32_u64(c1, v1);
+                c2 = _mm_crc32_u64(c2, v2);
+            }
+            crc = crc_shift_lane(crc_shift_lane((uint32_t)c0) ^ (uint32_t)c1) ^ (uint32_t)c2;
+        }
+    }
+    uint64_t c = crc;
+    for (; len >= 8; len -= 8, p += 8)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t)c;
+    for (; len; len--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return crc;
+}
+#endif
+
+/*
+ * hash_crc32c: Continue a CRC-32C over more bytes
+ *
+ * Start from crc 0; passing the result of one call as crc to the next gives
+ * the CRC of the concatenated data.
+ */
+uint32_t hash_crc32c(uint32_t crc, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    crc = ~crc;
+#ifdef HASH_X86
+    if (__builtin_cpu_supports("sse4.2"))
+        return ~crc32c_sse42(crc, p, len);
+#endif
+    crc32c_init();
+    return ~crc_slice8(crc_table, crc, p, len);
+}
+
+/* hash_crc32: The same for the IEEE CRC-32 of gzip and zip (no instruction for it, so always tables) */
+uint32_t hash_crc32(uint32_t crc, const void *data, size_t len)
+{
+    if (!crc32_table_ready)
+    {
+        crc_tables_build(crc32_table, 0xEDB88320u);
+        crc32_table_ready = 1;
+    }
+    return ~crc_slice8(crc32_table, ~crc, data, len);
+}
+
+/* --- xxHash64 --- */
+
+#define XXH_P1 11400714785074694791ULL
+#define XXH_P2 14029467366897019727ULL
+#define XXH_P3 1609587929392839161ULL
+#define XXH_P4 9650029242287828579ULL
+#define XXH_P5 2870177450012600261ULL
+
+static inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input)
+{
+    acc += input * XXH_P2;
+    return rotl64(acc, 31) * XXH_P1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t v)
+{
+    acc ^= xxh_round(0, v);
+    return acc * XXH_P1 + XXH_P4;
+}
+
+/* Consume whole 32-byte stripes; returns the bytes used */
+static size_t xxh_stripes(uint64_t v[4], const uint8_t *p, size_t len)
+{
+    size_t used = 0;
+    for (; len - used >= 32; used += 32)
+    {
+        v[0] = xxh_round(v[0], read64(p + used));
+        v[1] = xxh_round(v[1], read64(p + used + 8));
+        v[2] = xxh_round(v[2], read64(p + used + 16));
+        v[3] = xxh_round(v[3], read64(p + used + 24));
+    }
+    return used;
+}
+
+/* Fold in the last (< 32) bytes and avalanche */
+static uint64_t xxh_finish(uint64_t h, const uint8_t *p, size_t len)
+{
+    for (; len >= 8; len -= 8, p += 8)
+        h = rotl64(h ^ xxh_round(0, read64(p)), 27) * XXH_P1 + XXH_P4;
+    if (len >= 4)
+    {
+        h = rotl64(h ^ (uint64_t)read32(p) * XXH_P1, 23) * XXH_P2 + XXH_P3;
+        p += 4;
+        len -= 4;
+    }
+    for (; len; len--)
+        h = rotl64(h ^ *p++ * XXH_P5, 11) * XXH_P1;
+    h ^= h >> 33;
+    h *= XXH_P2;
+    h ^= h >> 29;
+    h *= XXH_P3;
+    return h ^ (h >> 32);
+}
+
+static uint64_t xxh_converge(const uint64_t v[4])
+{
+    uint64_t h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+    for (int i = 0; i < 4; i++)
+        h = xxh_merge(h, v[i]);
+    return h;
+}
+
+static void xxh_seed(uint64_t v[4], uint64_t seed)
+{
+    v[0] = seed + XXH_P1 + XXH_P2;
+    v[1] = seed + XXH_P2;
+    v[2] = seed;
+    v[3] = seed - XXH_P1;
+}
+
+uint64_t hash_xxh64(const void *data, size_t len, uint64_t seed)
+{
+    const uint8_t *p = data;
+    uint64_t h;
+    size_t used = 0;
+    if (len >= 32)
+    {
+        uint64_t v[4];
+        xxh_seed(v, seed);
+        used = xxh_stripes(v, p, len);
+        h = xxh_converge(v);
+    }
+    else
+        h = seed + XXH_P5;
+    return xxh_finish(h + len, p + used, len - used);
+}
+
+/* --- xxHash32 (the LZ4 frame checksum) --- */
+
+#define XXH32_P1 2654435761u
+#define XXH32_P2 2246822519u
+#define XXH32_P3 3266489917u
+#define XXH32_P4 668265263u
+#define XXH32_P5 374761393u
+
+static inline uint32_t rotl32(uint32_t x, int r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t xxh32_round(uint32_t acc, uint32_t input)
+{
+    return rotl32(acc + input * XXH32_P2, 13) * XXH32_P1;
+}
+
+/* Consume whole 16-byte stripes; returns the bytes used */
+static size_t xxh32_stripes(uint32_t v[4], const uint8_t *p, size_t len)
+{
+    size_t used = 0;
+    for (; len - used >= 16; used += 16)
+    {
+        v[0] = xxh32_round(v[0], read32(p + used));
+        v[1] = xxh32_round(v[1], read32(p + used + 4));
+        v[2] = xxh32_round(v[2], read32(p + used + 8));
+        v[3] = xxh32_round(v[3], read32(p + used + 12));
+    }
+    return used;
+}
+
+static void xxh32_seed(uint32_t v[4], uint32_t seed)
+{
+    v[0] = seed + XXH32_P1 + XXH32_P2;
+    v[1] = seed + XXH32_P2;
+    v[2] = seed;
+    v[3] = seed - XXH32_P1;
+}
+
+/* Converge the lanes (or start from the seed below one stripe), fold in the tail and avalanche */
+static uint32_t xxh32_finish(const uint32_t v[4], uint32_t seed, uint64_t total, const uint8_t *p, size_t len)
+{
+    uint32_t h = total >= 16 ? rotl32(v[0], 1) + rotl32(v[1], 7) + rotl32(v[2], 12) + rotl32(v[3], 18)
+                             : seed + XXH32_P5;
+    h += (uint32_t)total;
+    for (; len >= 4; len -= 4, p += 4)
+        h = rotl32(h + read32(p) * XXH32_P3, 17) * XXH32_P4;
+    for (; len; len--)
+        h = rotl32(h + *p++ * XXH32_P5, 11) * XXH32_P1;
+    h ^= h >> 15;
+    h *= XXH32_P2;
+    h ^= h >> 13;
+    h *= XXH32_P3;
+    h ^= h >> 16;
+    return h;
+}
+
+uint64_t hash_mix64(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t hash_bytes(const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return hash_mix64(h);
+}
+
+uint64_t hash_string(const char *s)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    uint64_t h = 14695981039346656037ULL;
+    while (*p)
+    {
+        h ^= *p++;
+        h *= 1099511628211ULL;
+    }
+    return hash_mix64(h);
+}
+
+uint32_t hash_xxh32(const void *data, size_t len, uint32_t seed)
+{
+    const uint8_t *p = data;
+    uint32_t v[4];
+    xxh32_seed(v, seed);
+    size_t used = xxh32_stripes(v, p, len);
+    return xxh32_finish(v, seed, len, p + used, len - used);
+}
+
+/* --- SHA-256 --- */
+
+static const uint32_t sha_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static inline uint32_t rotr32(uint32_t x, int r)
+{
+    return (x >> r) | (x << (32 - r));
+}
+
+static void sha256_blocks_scalar(uint32_t state[8], const uint8_t *p, size_t blocks)
+{
+    for (; blocks; blocks--, p += 64)
+    {
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++)
+            w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 | (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+        for (int i = 16; i < 64; i++)
+        {
+            uint32_t s0 = rotr32(w[i - 15], 7) ^ rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr32(w[i - 2], 17) ^ rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t t1 = h + (rotr32(e, 6) ^ rotr32(e, 11) ^ rotr32(e, 25)) + ((e & f) ^ (~e & g)) + sha_k[i] + w[i];
+            uint32_t t2 = (rotr32(a, 2) ^ rotr32(a, 13) ^ rotr32(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#ifdef HASH_X86
+/*
+ * SHA-NI keeps the state as ABEF and CDGH halves; each sha256rnds2 does two
+ * rounds, and sha256msg1/msg2 extend the message schedule four words at a time.
+ */
+static void SHA_TARGET sha256_blocks_shani(uint32_t state[8], const uint8_t *p, size_t blocks)
+{
+    const __m128i swap = _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1); // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                   // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);                                         // CDGH
+
+    for (; blocks; blocks--, p += 64)
+    {
+        __m128i abef = state0, cdgh = state1;
+        __m128i w[4];
+        for (int i = 0; i < 16; i++)
+        {
+            __m128i m;
+            if (i < 4)
+                m = w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16 * i)), swap);
+            else
+            {
+                // w[i] from w[i-4], w[i-3], w[i-2], w[i-1] (held at i % 4 and on)
+                __m128i t = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                t = _mm_add_epi32(t, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+                m = w[i & 3] = _mm_sha256msg2_epu32(t, w[(i + 3) & 3]);
+            }
+            m = _mm_add_epi32(m, _mm_loadu_si128((const __m128i *)&sha_k[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(m, 0x0E));
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);        // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);     // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);  // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);     // HGFE
+    _mm_storeu_si128((__m128i *)&state[0], state0);
+    _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+#endif
+
+static void sha256_blocks(uint32_t state[8], const uint8_t *p, size_t blocks)
+{
+#ifdef HASH_X86
+    if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1"))
+    {
+        sha256_blocks_shani(state, p, blocks);
+        return;
+    }
+#endif
+    sha256_blocks_scalar(state, p, blocks);
+}
+
+/* --- incremental interface --- */
+
+void hash_init(HashState *s, HashKind kind, uint64_t seed)
+{
+    static const uint32_t sha_iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                       0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    s->kind = kind;
+    s->total = 0;
+    s->fill = 0;
+    switch (kind)
+    {
+    case HASH_CRC32C:
+    case HASH_CRC32:
+        s->u.crc = (uint32_t)seed;
+        break;
+    case HASH_XXH32:
+        xxh32_seed(s->u.xxh32.v, (uint32_t)seed);
+        s->u.xxh32.seed = (uint32_t)seed;
+        break;
+    case HASH_XXH64:
+        xxh_seed(s->u.xxh.v, seed);
+        s->u.xxh.seed = seed;
+        break;
+    default:
+        memcpy(s->u.sha, sha_iv, sizeof(sha_iv));
+        break;
+    }
+}
+
+void hash_update(HashState *s, const void *data, size_t len)
+{
+    const uint8_t *p = data;
+    s->total += len;
+    if (s->kind == HASH_CRC32C || s->kind == HASH_CRC32)
+    {
+        s->u.crc = s->kind == HASH_CRC32C ? hash_crc32c(s->u.crc, p, len) : hash_crc32(s->u.crc, p, len);
+        return;
+    }
+    size_t block = s->kind == HASH_XXH64 ? 32 : s->kind == HASH_XXH32 ? 16 : 64;
+    if (s->fill)
+    {
+        size_t take = block - s->fill < len ? block - s->fill : len;
+        memcpy(s->block + s->fill, p, take);
+        s->fill += take;
+        p += take;
+        len -= take;
+        if (s->fill < block)
+            return;
+        if (s->kind == HASH_XXH64)
+            xxh_stripes(s->u.xxh.v, s->block, block);
+        else if (s->kind == HASH_XXH32)
+            xxh32_stripes(s->u.xxh32.v, s->block, block);
+        else
+            sha256_blocks(s->u.sha, s->block, 1);
+        s->fill = 0;
+    }
+    size_t used;
+    if (s->kind == HASH_XXH64)
+        used = xxh_stripes(s->u.xxh.v, p, len);
+    else if (s->kind == HASH_XXH32)
+        used = xxh32_stripes(s->u.xxh32.v, p, len);
+    else
+    {
+        used = len / 64 * 64;
+        sha256_blocks(s->u.sha, p, len / 64);
+    }
+    memcpy(s->block, p + used, len - used);
+    s->fill = len - used;
+}
+
+/* Write the digest (big-endian) and return its size in bytes */
+size_t hash_final(HashState *s, uint8_t *digest)
+{
+    switch (s->kind)
+    {
+    case HASH_CRC32C:
+    case HASH_CRC32:
+        put_be(digest, s->u.crc, 4);
+        return 4;
+    case HASH_XXH32:
+        put_be(digest, xxh32_finish(s->u.xxh32.v, s->u.xxh32.seed, s->total, s->block, s->fill), 4);
+        return 4;
+    case HASH_XXH64:
+    {
+        uint64_t h = s->total >= 32 ? xxh_converge(s->u.xxh.v) : s->u.xxh.seed + XXH_P5;
+        put_be(digest, xxh_finish(h + s->total, s->block, s->fill), 8);
+        return 8;
+    }
+    default:
+    {
+        uint64_t bits = s->total * 8;
+        uint8_t pad[128] = {0x80};
+        size_t padlen = (s->fill < 56 ? 56 : 120) - s->fill;
+        put_be(pad + padlen, bits, 8);
+        hash_update(s, pad, padlen + 8);
+        for (int i = 0; i < 8; i++)
+            put_be(digest + 4 * i, s->u.sha[i], 4);
+        return 32;
+    }
+    }
+}
+
+/* Hash a file in fixed-size chunks; returns 0 if it cannot be read */
+int hash_file(const char *path, HashKind kind, uint64_t seed, uint8_t *digest)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return 0;
+    uint8_t *chunk = memory_allocate(HASH_FILE_CHUNK);
+    HashState s;
+    hash_init(&s, kind, seed);
+    size_t got;
+    while ((got = fread(chunk, 1, HASH_FILE_CHUNK, f)) > 0)
+        hash_update(&s, chunk, got);
+    int ok = !ferror(f);
+    fclose(f);
+    memory_free(chunk);
+    if (ok)
+        hash_final(&s, digest);
+    return ok;
+}
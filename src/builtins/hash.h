@@ -0,0 +1,69 @@
+#ifndef SHARPSCRIPT_HASH_H
+#define SHARPSCRIPT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Checksums and hashes behind system.hash: CRC-32C (SSE4.2 crc32 when the
+ * CPU has it), CRC-32, xxHash32, xxHash64 and SHA-256 (SHA-NI when present). Each can be fed
+ * incrementally through a HashState, which is how files are hashed in
+ * chunks. Digests are the usual big-endian byte strings.
+ */
+typedef enum
+{
+    HASH_CRC32C,
+    HASH_CRC32,
+    HASH_XXH32,
+    HASH_XXH64,
+    HASH_SHA256
+} HashKind;
+
+#define HASH_MAX_DIGEST 32
+
+typedef struct
+{
+    HashKind kind;
+    uint64_t total;    // bytes fed so far
+    uint8_t block[64]; // partial block (SHA-256) or stripe (xxHash)
+    size_t fill;
+    union
+    {
+        uint32_t crc;
+        struct
+        {
+            uint64_t v[4];
+            uint64_t seed;
+        } xxh;
+        struct
+        {
+            uint32_t v[4];
+            uint32_t seed;
+        } xxh32;
+        uint32_t sha[8];
+    } u;
+} HashState;
+
+int hash_kind_parse(const char *name, HashKind *kind);
+size_t hash_digest_size(HashKind kind);
+
+uint32_t hash_crc32c(uint32_t crc, const void *data, size_t len);
+uint32_t hash_crc32(uint32_t crc, const void *data, size_t len);
+uint32_t hash_xxh32(const void *data, size_t len, uint32_t seed);
+uint64_t hash_xxh64(const void *data, size_t len, uint64_t seed);
+
+/*
+ * Table hashing for the interpreter's registries and containers: 64-bit
+ * FNV-1a finished with the MurmurHash3 mixer, so every output bit (low bits
+ * for masks, top bits for HyperLogLog) depends on every input bit.
+ */
+uint64_t hash_mix64(uint64_t h);
+uint64_t hash_bytes(const void *data, size_t len);
+uint64_t hash_string(const char *s);
+
+void hash_init(HashState *s, HashKind kind, uint64_t seed);
+void hash_update(HashState *s, const void *data, size_t len);
+size_t hash_final(HashState *s, uint8_t *digest);
+int hash_file(const char *path, HashKind kind, uint64_t seed, uint8_t *digest);
+
+#endif
@@ -0,0 +1,145 @@
+#include "heap.h"
+#include "../include/memory.h"
+
+struct Heap
+{
+    int refs;
+    void **items; // items[0] pops first; children of i are 2i + 1 and 2i + 2
+    int count;
+    int capacity;
+    int limit;        // 0 for unbounded
+    void *comparator; // opaque, freed with free_value
+    void (*free_value)(void *);
+};
+
+/*
+ * heap_create: An empty heap
+ *
+ * comparator is stored for the caller (see heap_comparator) and freed with
+ * the heap when not NULL. limit bounds the size, 0 for none.
+ */
+Heap *heap_create(void (*free_value)(void *), void *comparator, int limit)
+{
+    Heap *h = memory_allocate(sizeof(Heap));
+    h->refs = 1;
+    h->count = 0;
+    h->capacity = 16;
+    h->items = memory_allocate(sizeof(void *) * h->capacity);
+    h->limit = limit > 0 ? limit : 0;
+    h->comparator = comparator;
+    h->free_value = free_value;
+    return h;
+}
+
+Heap *heap_retain(Heap *h)
+{
+    h->refs++;
+    return h;
+}
+
+void heap_release(Heap *h)
+{
+    if (!h || --h->refs > 0)
+        return;
+    for (int i = 0; i < h->count; i++)
+        h->free_value(h->items[i]);
+    if (h->comparator)
+        h->free_value(h->comparator);
+    memory_free(h->items);
+    memory_free(h);
+}
+
+int heap_count(const Heap *h)
+{
+    return h->count;
+}
+
+void *heap_comparator(const Heap *h)
+{
+    return h->comparator;
+}
+
+/* Move the item at i down until neither child pops before it */
+static void sift_down(Heap *h, int i, HeapCompare compare, void *context)
+{
+    void *item = h->items[i];
+    for (;;)
+    {
+        int child = 2 * i + 1;
+        if (child >= h->count)
+            break;
+        if (child + 1 < h->count && compare(context, h->items[child + 1], h->items[child]) < 0)
+            child++;
+        if (compare(context, h->items[child], item) >= 0)
+            break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    h->items[i] = item;
+}
+
+/*
+ * heap_push: Add a value (the heap takes it over)
+ *
+ * When the heap is at its limit, whichever of the value and the top pops
+ * first is freed instead.
+ * Returns: 1 if the value was kept
+ */
+int heap_push(Heap *h, void *value, HeapCompare compare, void *context)
+{
+    if (h->limit && h->count >= h->limit)
+    {
+        if (compare(context, value, h->items[0]) <= 0)
+        {
+            h->free_value(value);
+            return 0;
+        }
+        h->free_value(h->items[0]);
+        h->items[0] = value;
+        sift_down(h, 0, compare, context);
+        return 1;
+    }
+    if (h->count == h->capacity)
+    {
+        h->capacity *= 2;
+        h->items = memory_reallocate(h->items, sizeof(void *) * h->capacity);
+    }
+    int i = h->count++;
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (compare(context, value, h->items[parent]) >= 0)
+            break;
+        h->items[i] = h->items[parent];
+        i = parent;
+    }
+    h->items[i] = value;
+    return 1;
+}
+
+/*
+ * heap_pop: Remove the value that comes first
+ *
+ * Returns: The value (now owned by the caller), or NULL when empty
+ */
+void *heap_pop(Heap *h, HeapCompare compare, void *context)
+{
+    if (!h->count)
+        return NULL;
+    void *top = h->items[0];
+    h->items[0] = h->items[--h->count];
+    if (h->count)
+        sift_down(h, 0, compare, context);
+    return top;
+}
+
+void *heap_peek(const Heap *h)
+{
+    return h->count ? h->items[0] : NULL;
+}
+
+/* Item at a position of the heap array (heap order, not sorted) */
+void *heap_at(const Heap *h, int index)
+{
+    return index >= 0 && index < h->count ? h->items[index] : NULL;
+}
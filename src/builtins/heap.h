@@ -0,0 +1,27 @@
+#ifndef SHARPSCRIPT_HEAP_H
+#define SHARPSCRIPT_HEAP_H
+
+/*
+ * Binary heaps behind VAL_HEAP. The order comes from a comparison callback
+ * supplied on every call, so the interpreter can order values with a script
+ * comparator. A heap with a limit keeps only the limit values that would be
+ * popped last: a min-heap limited to K holds the K largest values pushed.
+ * Values are opaque and freed with the function given at creation; heaps are
+ * shared by reference count.
+ */
+typedef int (*HeapCompare)(void *context, void *a, void *b); // < 0 when a pops before b
+
+typedef struct Heap Heap;
+
+Heap *heap_create(void (*free_value)(void *), void *comparator, int limit);
+Heap *heap_retain(Heap *h);
+void heap_release(Heap *h);
+
+int heap_count(const Heap *h);
+void *heap_comparator(const Heap *h);
+int heap_push(Heap *h, void *value, HeapCompare compare, void *context);
+void *heap_pop(Heap *h, HeapCompare compare, void *context);
+void *heap_peek(const Heap *h);
+void *heap_at(const Heap *h, int index);
+
+#endif
@@ -1,4 +1,7 @@
 #include "io.h"
+#include "bignum.h"
+#include "buffer.h"
+#include "compress.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -15,7 +18,22 @@ Value *io_read_file(const char *path)
     fread(buf, 1, sz, f);
     buf[sz] = '\0';
     fclose(f);
-    Value *s = value_create_string(buf);
+    // gzip and LZ4 files read as their decompressed text
+    size_t plain_len;
+    CompressFormat format = compress_sniff((uint8_t *)buf, (size_t)sz);
+    uint8_t *plain = format != COMPRESS_NONE ? compress_decode(format, (uint8_t *)buf, (size_t)sz, &plain_len) : NULL;
+    if (format != COMPRESS_NONE && !plain)
+    {
+        free(buf);
+        return value_create_null(); // corrupt
+    }
+    if (plain)
+    {
+        plain = memory_reallocate(plain, plain_len + 1);
+        plain[plain_len] = '\0';
+    }
+    Value *s = value_create_string(plain ? (char *)plain : buf);
+    memory_free(plain);
     free(buf);
     return s;
 }
@@ -35,7 +53,133 @@ Value *io_write_file(const char *path, Value *data)
             int n = snprintf(buf, sizeof(buf), "%g", data->data.number);
             fwrite(buf, 1, n, f);
         }
+        else if (data->type == VAL_INT)
+        {
+            char buf[32];
+            int n = snprintf(buf, sizeof(buf), "%lld", data->data.integer);
+            fwrite(buf, 1, n, f);
+        }
+        else if (data->type == VAL_BUFFER)
+            fwrite(buffer_data(data->data.buffer), 1, buffer_length(data->data.buffer), f);
+        else if (data->type == VAL_BIGNUM)
+        {
+            char *text = bignum_to_string(data->data.bignum);
+            fwrite(text, 1, strlen(text), f);
+            memory_free(text);
+        }
     }
     fclose(f);
     return value_create_null();
 }
+
+#define LINES_CHUNK 65536
+
+struct LineReader
+{
+    int refs;
+    char *path;
+    FILE *file;
+    CompressStream *stream;
+    uint8_t *chunk; // decoded bytes not yet returned as lines
+    size_t pos, len;
+    int failed; // the compressed data turned out corrupt
+};
+
+static size_t lines_source(void *ctx, uint8_t *buf, size_t cap)
+{
+    return fread(buf, 1, cap, ctx);
+}
+
+/* Open path for reading line by line; NULL if it cannot be opened */
+LineReader *io_lines_open(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    LineReader *r = memory_allocate(sizeof(LineReader));
+    r->refs = 1;
+    r->path = memory_strdup(path);
+    r->file = f;
+    r->stream = compress_stream_open(COMPRESS_AUTO, lines_source, f);
+    r->chunk = memory_allocate(LINES_CHUNK);
+    r->pos = r->len = 0;
+    r->failed = 0;
+    return r;
+}
+
+LineReader *io_lines_retain(LineReader *r)
+{
+    r->refs++;
+    return r;
+}
+
+void io_lines_release(LineReader *r)
+{
+    if (!r || --r->refs > 0)
+        return;
+    compress_stream_close(r->stream);
+    if (r->file)
+        fclose(r->file);
+    memory_free(r->chunk);
+    memory_free(r->path);
+    memory_free(r);
+}
+
+const char *io_lines_path(const LineReader *r)
+{
+    return r->path;
+}
+
+int io_lines_failed(const LineReader *r)
+{
+    return r->failed;
+}
+
+/*
+ * io_lines_next: The next line without its "\n" or "\r\n"
+ *
+ * A last line without a newline is still returned.
+ * Returns: memory_allocate'd string, or NULL at the end of the file (or of
+ * its valid data; see io_lines_failed)
+ */
+char *io_lines_next(LineReader *r)
+{
+    char *line = NULL;
+    size_t line_len = 0;
+    while (1)
+    {
+        if (r->pos == r->len)
+        {
+            long got = r->file ? compress_stream_read(r->stream, r->chunk, LINES_CHUNK) : 0;
+            if (got <= 0)
+            {
+                r->failed |= got < 0;
+                if (r->file)
+                {
+                    fclose(r->file);
+                    r->file = NULL;
+                }
+                break;
+            }
+            r->pos = 0;
+            r->len = (size_t)got;
+        }
+        const uint8_t *start = r->chunk + r->pos;
+        const uint8_t *nl = memchr(start, '\n', r->len - r->pos);
+        size_t take = nl ? (size_t)(nl - start) : r->len - r->pos;
+        line = memory_reallocate(line, line_len + take + 1);
+        memcpy(line + line_len, start, take);
+        line_len += take;
+        r->pos += take + (nl != NULL);
+        if (nl)
+        {
+            if (line_len && line[line_len - 1] == '\r')
+                line_len--;
+            line[line_len] = '\0';
+            return line;
+        }
+    }
+    if (line)
+        line[line_len] = '\0';
+    return line;
+}
@@ -6,4 +6,18 @@
 Value *io_read_file(const char *path);
 Value *io_write_file(const char *path, Value *data);
 
+/*
+ * Lines of a text file read a chunk at a time for file.lines; gzip and LZ4
+ * files are decompressed on the way. A reader is shared by reference and
+ * consumed as it is read.
+ */
+typedef struct LineReader LineReader;
+
+LineReader *io_lines_open(const char *path);
+LineReader *io_lines_retain(LineReader *r);
+void io_lines_release(LineReader *r);
+const char *io_lines_path(const LineReader *r);
+char *io_lines_next(LineReader *r);
+int io_lines_failed(const LineReader *r);
+
 #endif
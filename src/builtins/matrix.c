@@ -0,0 +1,465 @@
+#include "matrix.h"
+#include "../include/memory.h"
+#include <math.h>
+#include <string.h>
+
+#ifndef _WIN32
+#define MATRIX_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MATRIX_AVX2
+#include <immintrin.h>
+#define MATRIX_TARGET __attribute__((target("avx2,fma")))
+#endif
+
+/*
+ * Blocking for the product c = a * b: a KC x NC block of b is packed into
+ * NR-wide column panels (small enough to stay in L2), and an MR x NR tile of
+ * c is accumulated in registers while streaming MR rows of a against one
+ * panel. The AVX2/FMA kernel keeps the whole 4 x 8 tile in eight registers.
+ */
+#define MATRIX_KC 256
+#define MATRIX_NC 128
+#define MATRIX_MR 4
+#define MATRIX_NR 8
+
+/* Edge length of the square blocks used by the transpose */
+#define MATRIX_TRANSPOSE_BLOCK 32
+
+Matrix *matrix_create(int rows, int cols)
+{
+    size_t count = (size_t)rows * cols;
+    Matrix *m = memory_allocate(sizeof(Matrix));
+    m->rows = rows;
+    m->cols = cols;
+    m->refs = 1;
+    m->data = memory_allocate(sizeof(double) * (count ? count : 1));
+    memset(m->data, 0, sizeof(double) * count);
+    return m;
+}
+
+Matrix *matrix_retain(Matrix *m)
+{
+    m->refs++;
+    return m;
+}
+
+void matrix_release(Matrix *m)
+{
+    if (!m || --m->refs > 0)
+        return;
+    memory_free(m->data);
+    memory_free(m);
+}
+
+/* Copy a kc x nc block of b into zero-padded NR-wide panels, each kc x NR */
+static void pack_b(const double *b, int ldb, int kc, int nc, double *packed)
+{
+    for (int jp = 0; jp < nc; jp += MATRIX_NR)
+    {
+        int width = nc - jp < MATRIX_NR ? nc - jp : MATRIX_NR;
+        double *panel = packed + (size_t)jp * kc;
+        for (int p = 0; p < kc; p++)
+        {
+            const double *row = b + (size_t)p * ldb + jp;
+            double *dst = panel + p * MATRIX_NR;
+            int c = 0;
+            for (; c < width; c++)
+                dst[c] = row[c];
+            for (; c < MATRIX_NR; c++)
+                dst[c] = 0.0;
+        }
+    }
+}
+
+/* c[r][j] += sum over p of a[r][p] * panel[p][j], clipped to rows x cols */
+static void kernel_scalar(int kc, const double *a, int lda, const double *panel, double *c, int ldc, int rows, int cols)
+{
+    double acc[MATRIX_MR][MATRIX_NR] = {{0}};
+    for (int p = 0; p < kc; p++)
+    {
+        const double *bp = panel + p * MATRIX_NR;
+        for (int r = 0; r < rows; r++)
+        {
+            double ar = a[(size_t)r * lda + p];
+            for (int j = 0; j < MATRIX_NR; j++)
+                acc[r][j] += ar * bp[j];
+        }
+    }
+    for (int r = 0; r < rows; r++)
+    {
+        for (int j = 0; j < cols; j++)
+            c[(size_t)r * ldc + j] += acc[r][j];
+    }
+}
+
+#ifdef MATRIX_AVX2
+MATRIX_TARGET
+static void kernel_avx2(int kc, const double *a, int lda, const double *panel, double *c, int ldc, int rows, int cols)
+{
+    // missing rows at the bottom edge repeat row 0; their results are dropped
+    const double *a0 = a;
+    const double *a1 = rows > 1 ? a + lda : a;
+    const double *a2 = rows > 2 ? a + 2 * (size_t)lda : a;
+    const double *a3 = rows > 3 ? a + 3 * (size_t)lda : a;
+    __m256d c00 = _mm256_setzero_pd(), c01 = _mm256_setzero_pd();
+    __m256d c10 = _mm256_setzero_pd(), c11 = _mm256_setzero_pd();
+    __m256d c20 = _mm256_setzero_pd(), c21 = _mm256_setzero_pd();
+    __m256d c30 = _mm256_setzero_pd(), c31 = _mm256_setzero_pd();
+    for (int p = 0; p < kc; p++)
+    {
+        __m256d b0 = _mm256_loadu_pd(panel + p * MATRIX_NR);
+        __m256d b1 = _mm256_loadu_pd(panel + p * MATRIX_NR + 4);
+        __m256d x = _mm256_broadcast_sd(a0 + p);
+        c00 = _mm256_fmadd_pd(x, b0, c00);
+        c01 = _mm256_fmadd_pd(x, b1, c01);
+        x = _mm256_broadcast_sd(a1 + p);
+        c10 = _mm256_fmadd_pd(x, b0, c10);
+        c11 = _mm256_fmadd_pd(x, b1, c11);
+        x = _mm256_broadcast_sd(a2 + p);
+        c20 = _mm256_fmadd_pd(x, b0, c20);
+        c21 = _mm256_fmadd_pd(x, b1, c21);
+        x = _mm256_broadcast_sd(a3 + p);
+        c30 = _mm256_fmadd_pd(x, b0, c30);
+        c31 = _mm256_fmadd_pd(x, b1, c31);
+    }
+
+    if (rows == MATRIX_MR && cols == MATRIX_NR)
+    {
+        __m256d tile[MATRIX_MR][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}};
+        for (int r = 0; r < MATRIX_MR; r++)
+        {
+            double *cr = c + (size_t)r * ldc;
+            _mm256_storeu_pd(cr, _mm256_add_pd(_mm256_loadu_pd(cr), tile[r][0]));
+            _mm256_storeu_pd(cr + 4, _mm256_add_pd(_mm256_loadu_pd(cr + 4), tile[r][1]));
+        }
+        return;
+    }
+    double acc[MATRIX_MR][MATRIX_NR];
+    _mm256_storeu_pd(acc[0], c00);
+    _mm256_storeu_pd(acc[0] + 4, c01);
+    _mm256_storeu_pd(acc[1], c10);
+    _mm256_storeu_pd(acc[1] + 4, c11);
+    _mm256_storeu_pd(acc[2], c20);
+    _mm256_storeu_pd(acc[2] + 4, c21);
+    _mm256_storeu_pd(acc[3], c30);
+    _mm256_storeu_pd(acc[3] + 4, c31);
+    for (int r = 0; r < rows; r++)
+    {
+        for (int j = 0; j < cols; j++)
+            c[(size_t)r * ldc + j] += acc[r][j];
+    }
+}
+#endif
+
+static int matrix_has_avx2(void)
+{
+#ifdef MATRIX_AVX2
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return 0;
+#endif
+}
+
+/* Accumulate rows [r0, r1) of c += a * b */
+static void multiply_rows(const Matrix *a, const Matrix *b, Matrix *c, int r0, int r1)
+{
+    int k = a->cols;
+    int n = b->cols;
+    int avx2 = matrix_has_avx2();
+    double *packed = memory_allocate(sizeof(double) * MATRIX_KC * (MATRIX_NC + MATRIX_NR));
+
+    for (int jc = 0; jc < n; jc += MATRIX_NC)
+    {
+        int nc = n - jc < MATRIX_NC ? n - jc : MATRIX_NC;
+        for (int pc = 0; pc < k; pc += MATRIX_KC)
+        {
+            int kc = k - pc < MATRIX_KC ? k - pc : MATRIX_KC;
+            pack_b(b->data + (size_t)pc * n + jc, n, kc, nc, packed);
+            for (int i = r0; i < r1; i += MATRIX_MR)
+            {
+                int rows = r1 - i < MATRIX_MR ? r1 - i : MATRIX_MR;
+                const double *ap = a->data + (size_t)i * k + pc;
+                for (int jp = 0; jp < nc; jp += MATRIX_NR)
+                {
+                    int cols = nc - jp < MATRIX_NR ? nc - jp : MATRIX_NR;
+                    double *cp = c->data + (size_t)i * n + jc + jp;
+#ifdef MATRIX_AVX2
+                    if (avx2)
+                    {
+                        kernel_avx2(kc, ap, k, packed + (size_t)jp * kc, cp, n, rows, cols);
+                        continue;
+                    }
+#endif
+                    kernel_scalar(kc, ap, k, packed + (size_t)jp * kc, cp, n, rows, cols);
+                }
+            }
+        }
+    }
+    memory_free(packed);
+    (void)avx2;
+}
+
+#ifdef MATRIX_THREADS
+typedef struct
+{
+    const Matrix *a;
+    const Matrix *b;
+    Matrix *c;
+    int r0;
+    int r1;
+} MatrixJob;
+
+static void *matrix_worker(void *arg)
+{
+    MatrixJob *job = arg;
+    multiply_rows(job->a, job->b, job->c, job->r0, job->r1);
+    return NULL;
+}
+#endif
+
+/*
+ * matrix_multiply: c = a * b
+ *
+ * c must already be a->rows x b->cols and a->cols must equal b->rows. Large
+ * products give each CPU a band of rows of c.
+ */
+void matrix_multiply(const Matrix *a, const Matrix *b, Matrix *c)
+{
+    memset(c->data, 0, sizeof(double) * (size_t)c->rows * c->cols);
+    if (!a->rows || !a->cols || !b->cols)
+        return;
+#ifdef MATRIX_THREADS
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 8 ? 8 : (int)cpus;
+    double work = (double)a->rows * a->cols * b->cols;
+    if (work >= MATRIX_THREAD_THRESHOLD && threads > 1 && a->rows >= 2 * MATRIX_MR)
+    {
+        pthread_t ids[8];
+        MatrixJob jobs[8];
+        int started = 0;
+        // bands are whole multiples of the register tile height
+        int band = (a->rows + threads - 1) / threads;
+        band = (band + MATRIX_MR - 1) / MATRIX_MR * MATRIX_MR;
+        int count = 0;
+        for (int r = 0; r < a->rows && count < threads; r += band)
+        {
+            jobs[count].a = a;
+            jobs[count].b = b;
+            jobs[count].c = c;
+            jobs[count].r0 = r;
+            jobs[count].r1 = r + band < a->rows ? r + band : a->rows;
+            // the calling thread takes the first band itself
+            if (count > 0 && pthread_create(&ids[count], NULL, matrix_worker, &jobs[count]) == 0)
+                started |= 1 << count;
+            count++;
+        }
+        for (int t = 1; t < count; t++)
+        {
+            if (!(started & (1 << t)))
+                matrix_worker(&jobs[t]); // thread creation failed: do it here
+        }
+        matrix_worker(&jobs[0]);
+        for (int t = 1; t < count; t++)
+        {
+            if (started & (1 << t))
+                pthread_join(ids[t], NULL);
+        }
+        return;
+    }
+#endif
+    multiply_rows(a, b, c, 0, a->rows);
+}
+
+/*
+ * matrix_transpose: t = a^T, walking square blocks so both the reads and the
+ * writes stay within a few cache lines
+ */
+void matrix_transpose(const Matrix *a, Matrix *t)
+{
+    for (int ib = 0; ib < a->rows; ib += MATRIX_TRANSPOSE_BLOCK)
+    {
+        int ie = ib + MATRIX_TRANSPOSE_BLOCK < a->rows ? ib + MATRIX_TRANSPOSE_BLOCK : a->rows;
+        for (int jb = 0; jb < a->cols; jb += MATRIX_TRANSPOSE_BLOCK)
+        {
+            int je = jb + MATRIX_TRANSPOSE_BLOCK < a->cols ? jb + MATRIX_TRANSPOSE_BLOCK : a->cols;
+            for (int i = ib; i < ie; i++)
+            {
+                for (int j = jb; j < je; j++)
+                    t->data[(size_t)j * a->rows + i] = a->data[(size_t)i * a->cols + j];
+            }
+        }
+    }
+}
+
+#ifdef MATRIX_AVX2
+MATRIX_TARGET
+static int combine_avx2(MatrixOp op, const double *a, int a_step, const double *b, int b_step, double *out, int count)
+{
+    __m256d va = _mm256_broadcast_sd(a);
+    __m256d vb = _mm256_broadcast_sd(b);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        if (a_step)
+            va = _mm256_loadu_pd(a + i);
+        if (b_step)
+            vb = _mm256_loadu_pd(b + i);
+        __m256d r;
+        switch (op)
+        {
+        case MATRIX_ADD:
+            r = _mm256_add_pd(va, vb);
+            break;
+        case MATRIX_SUB:
+            r = _mm256_sub_pd(va, vb);
+            break;
+        case MATRIX_MUL:
+            r = _mm256_mul_pd(va, vb);
+            break;
+        default:
+            r = _mm256_div_pd(va, vb);
+            break;
+        }
+        _mm256_storeu_pd(out + i, r);
+    }
+    return i;
+}
+#endif
+
+/*
+ * matrix_combine: out[i] = a[i * a_step] op b[i * b_step]
+ *
+ * A step of 0 repeats a scalar operand; steps are 0 or 1. Each lane is one
+ * IEEE operation, so the vector path matches the scalar one exactly.
+ */
+void matrix_combine(MatrixOp op, const double *a, int a_step, const double *b, int b_step, double *out, int count)
+{
+    int i = 0;
+#ifdef MATRIX_AVX2
+    if (count >= 4 && __builtin_cpu_supports("avx2"))
+        i = combine_avx2(op, a, a_step, b, b_step, out, count);
+#endif
+    for (; i < count; i++)
+    {
+        double x = a[i * a_step];
+        double y = b[i * b_step];
+        switch (op)
+        {
+        case MATRIX_ADD:
+            out[i] = x + y;
+            break;
+        case MATRIX_SUB:
+            out[i] = x - y;
+            break;
+        case MATRIX_MUL:
+            out[i] = x * y;
+            break;
+        case MATRIX_DIV:
+            out[i] = x / y;
+            break;
+        }
+    }
+}
+
+#ifdef MATRIX_AVX2
+MATRIX_TARGET
+static int axpy_avx2(double *y, double alpha, const double *x, int count)
+{
+    __m256d va = _mm256_set1_pd(alpha);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+    return i;
+}
+#endif
+
+/* y += alpha * x */
+static void axpy(double *y, double alpha, const double *x, int count, int avx2)
+{
+    int i = 0;
+#ifdef MATRIX_AVX2
+    if (avx2)
+        i = axpy_avx2(y, alpha, x, count);
+#endif
+    for (; i < count; i++)
+        y[i] += alpha * x[i];
+    (void)avx2;
+}
+
+static void swap_rows(double *data, int cols, int r1, int r2)
+{
+    double *a = data + (size_t)r1 * cols;
+    double *b = data + (size_t)r2 * cols;
+    for (int j = 0; j < cols; j++)
+    {
+        double t = a[j];
+        a[j] = b[j];
+        b[j] = t;
+    }
+}
+
+/*
+ * matrix_solve: Solve a * x = b by Gaussian elimination with partial pivoting
+ *
+ * a is n x n and b (and x) n x k, so several right-hand sides are solved at
+ * once. Row updates run through a vectorized axpy.
+ *
+ * Returns: 1 on success, 0 if a is singular
+ */
+int matrix_solve(const Matrix *a, const Matrix *b, Matrix *x)
+{
+    int n = a->rows;
+    int k = b->cols;
+    int avx2 = matrix_has_avx2();
+    double *lu = memory_allocate(sizeof(double) * ((size_t)n * n + 1));
+    memcpy(lu, a->data, sizeof(double) * (size_t)n * n);
+    memcpy(x->data, b->data, sizeof(double) * (size_t)n * k);
+
+    for (int i = 0; i < n; i++)
+    {
+        int pivot = i;
+        for (int r = i + 1; r < n; r++)
+        {
+            if (fabs(lu[(size_t)r * n + i]) > fabs(lu[(size_t)pivot * n + i]))
+                pivot = r;
+        }
+        if (lu[(size_t)pivot * n + i] == 0.0)
+        {
+            memory_free(lu);
+            return 0;
+        }
+        if (pivot != i)
+        {
+            swap_rows(lu, n, i, pivot);
+            swap_rows(x->data, k, i, pivot);
+        }
+        double *row = lu + (size_t)i * n;
+        for (int r = i + 1; r < n; r++)
+        {
+            double *target = lu + (size_t)r * n;
+            double f = target[i] / row[i];
+            if (f == 0.0)
+                continue;
+            target[i] = 0.0;
+            axpy(target + i + 1, -f, row + i + 1, n - i - 1, avx2);
+            axpy(x->data + (size_t)r * k, -f, x->data + (size_t)i * k, k, avx2);
+        }
+    }
+
+    // back substitution on every right-hand side at once
+    for (int i = n - 1; i >= 0; i--)
+    {
+        double *xi = x->data + (size_t)i * k;
+        for (int j = i + 1; j < n; j++)
+            axpy(xi, -lu[(size_t)i * n + j], x->data + (size_t)j * k, k, avx2);
+        double d = lu[(size_t)i * n + i];
+        for (int c = 0; c < k; c++)
+            xi[c] /= d;
+    }
+    memory_free(lu);
+    return 1;
+}
@@ -0,0 +1,37 @@
+#ifndef SHARPSCRIPT_MATRIX_H
+#define SHARPSCRIPT_MATRIX_H
+
+/*
+ * Dense row-major matrices of doubles behind VAL_MATRIX. Matrices are
+ * immutable once built, so values share one buffer through a reference
+ * count instead of copying it.
+ */
+typedef struct Matrix
+{
+    int rows;
+    int cols;
+    int refs;
+    double *data; // rows * cols elements, row-major
+} Matrix;
+
+typedef enum
+{
+    MATRIX_ADD,
+    MATRIX_SUB,
+    MATRIX_MUL,
+    MATRIX_DIV
+} MatrixOp;
+
+/* Products with at least this many multiply-adds are split across threads */
+#define MATRIX_THREAD_THRESHOLD (1 << 22)
+
+Matrix *matrix_create(int rows, int cols);
+Matrix *matrix_retain(Matrix *m);
+void matrix_release(Matrix *m);
+
+void matrix_multiply(const Matrix *a, const Matrix *b, Matrix *c);
+void matrix_transpose(const Matrix *a, Matrix *t);
+void matrix_combine(MatrixOp op, const double *a, int a_step, const double *b, int b_step, double *out, int count);
+int matrix_solve(const Matrix *a, const Matrix *b, Matrix *x);
+
+#endif
@@ -0,0 +1,237 @@
+#include "native.h"
+#include "hash.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+/*
+ * Registry of native functions, keyed by their fully qualified name
+ * (e.g. "fast.sum"). Open addressing with linear probing; entries are
+ * allocated individually so call sites can cache the pointer.
+ */
+static NativeEntry **native_table = NULL;
+static int native_count = 0;
+static int native_capacity = 0;
+
+/* Bumped whenever the registry is freed, so stale cached entries are ignored */
+static unsigned native_generation = 1;
+
+/* Handles of loaded extension libraries, released with the registry */
+static void **native_libraries = NULL;
+static int native_library_count = 0;
+static int native_library_capacity = 0;
+
+static void native_table_insert(NativeEntry *entry)
+{
+    unsigned long mask = (unsigned long)native_capacity - 1;
+    unsigned long i = hash_string(entry->name) & mask;
+    while (native_table[i])
+        i = (i + 1) & mask;
+    native_table[i] = entry;
+}
+
+static void native_table_grow(void)
+{
+    NativeEntry **old = native_table;
+    int old_capacity = native_capacity;
+    native_capacity = old_capacity ? old_capacity * 2 : 64;
+    native_table = memory_allocate(sizeof(NativeEntry *) * native_capacity);
+    memset(native_table, 0, sizeof(NativeEntry *) * native_capacity);
+    for (int i = 0; i < old_capacity; i++)
+    {
+        if (old[i])
+            native_table_insert(old[i]);
+    }
+    memory_free(old);
+}
+
+/*
+ * native_lookup: Find a registered native function
+ *
+ * Returns: The registry entry, or NULL if no function has that name
+ */
+NativeEntry *native_lookup(const char *name)
+{
+    if (!native_table)
+        return NULL;
+    unsigned long mask = (unsigned long)native_capacity - 1;
+    unsigned long i = hash_string(name) & mask;
+    while (native_table[i])
+    {
+        if (strcmp(native_table[i]->name, name) == 0)
+            return native_table[i];
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+/*
+ * native_register: Register (or replace) a native function
+ *
+ * Re-registering a name updates the existing entry in place, so call sites
+ * that already cached the entry pick up the new implementation.
+ */
+void native_register(const char *name, NativeFunction fn, int min_args)
+{
+    if (!name || !fn)
+        return;
+    NativeEntry *existing = native_lookup(name);
+    if (existing)
+    {
+        existing->fn = fn;
+        existing->min_args = min_args;
+        return;
+    }
+    // keep the load factor below one half
+    if ((native_count + 1) * 2 > native_capacity)
+        native_table_grow();
+
+    NativeEntry *entry = memory_allocate(sizeof(NativeEntry));
+    entry->name = memory_strdup(name);
+    entry->fn = fn;
+    entry->min_args = min_args;
+    native_table_insert(entry);
+    native_count++;
+}
+
+/*
+ * native_invoke: Call a native function with evaluated arguments
+ *
+ * Calls with fewer than min_args arguments return null, mirroring the
+ * argument count checks of the interpreter builtins.
+ */
+Value *native_invoke(Interpreter *interp, NativeEntry *entry, Value **args, int arg_count)
+{
+    if (arg_count < entry->min_args)
+        return value_create_null();
+    Value *result = entry->fn(interp, args, arg_count);
+    return result ? result : value_create_null();
+}
+
+static void native_add_library(void *handle)
+{
+    if (native_library_count >= native_library_capacity)
+    {
+        native_library_capacity = native_library_capacity ? native_library_capacity * 2 : 4;
+        native_libraries = memory_reallocate(native_libraries, sizeof(void *) * native_library_capacity);
+    }
+    native_libraries[native_library_count++] = handle;
+}
+
+/*
+ * native_load_library: Load an extension module and run its registration hook
+ *
+ * The module must export sharpscript_module_init, which receives
+ * native_register and returns 0 on success. A bare file name that exists in
+ * the working directory is loaded from there rather than the library path.
+ *
+ * Returns: 1 on success, 0 on failure
+ */
+int native_load_library(const char *path)
+{
+    if (!path)
+        return 0;
+
+    char *full = NULL;
+    FILE *f = fopen(path, "rb");
+    if (f && !strchr(path, '/') && !strchr(path, '\\'))
+    {
+        full = memory_allocate(strlen(path) + 3);
+        sprintf(full, "./%s", path);
+    }
+    else
+    {
+        full = memory_strdup(path);
+    }
+    if (f)
+        fclose(f);
+
+#ifdef _WIN32
+    HMODULE handle = LoadLibraryA(full);
+    if (!handle)
+    {
+        fprintf(stderr, "Native module error: could not load %s\n", full);
+        memory_free(full);
+        return 0;
+    }
+    NativeModuleInit init = (NativeModuleInit)(void (*)(void))GetProcAddress(handle, NATIVE_MODULE_INIT);
+#else
+    void *handle = dlopen(full, RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+    {
+        fprintf(stderr, "Native module error: %s\n", dlerror());
+        memory_free(full);
+        return 0;
+    }
+    NativeModuleInit init;
+    *(void **)(&init) = dlsym(handle, NATIVE_MODULE_INIT);
+#endif
+
+    if (!init)
+    {
+        fprintf(stderr, "Native module error: %s does not export %s\n", full, NATIVE_MODULE_INIT);
+#ifdef _WIN32
+        FreeLibrary(handle);
+#else
+        dlclose(handle);
+#endif
+        memory_free(full);
+        return 0;
+    }
+
+    native_add_library((void *)handle);
+    int status = init(native_register);
+    if (status != 0)
+        fprintf(stderr, "Native module error: %s initialisation failed (%d)\n", full, status);
+    memory_free(full);
+    return status == 0;
+}
+
+/*
+ * native_registry_free: Drop all registered functions and unload modules
+ */
+void native_registry_free(void)
+{
+    for (int i = 0; i < native_capacity; i++)
+    {
+        if (native_table[i])
+        {
+            memory_free(native_table[i]->name);
+            memory_free(native_table[i]);
+        }
+    }
+    memory_free(native_table);
+    native_table = NULL;
+    native_count = 0;
+    native_capacity = 0;
+    native_generation++;
+
+    for (int i = 0; i < native_library_count; i++)
+    {
+#ifdef _WIN32
+        FreeLibrary((HMODULE)native_libraries[i]);
+#else
+        dlclose(native_libraries[i]);
+#endif
+    }
+    memory_free(native_libraries);
+    native_libraries = NULL;
+    native_library_count = 0;
+    native_library_capacity = 0;
+}
+
+/*
+ * native_registry_generation: Identify the current set of registry entries
+ *
+ * Returns: A value that changes each time the registry is freed; call sites
+ * caching a NativeEntry pointer must check it before reusing the pointer
+ */
+unsigned native_registry_generation(void)
+{
+    return native_generation;
+}
@@ -0,0 +1,31 @@
+#ifndef SHARPSCRIPT_NATIVE_H
+#define SHARPSCRIPT_NATIVE_H
+
+#include "../include/interpreter.h"
+
+/*
+ * Native functions receive already evaluated arguments (owned by the caller)
+ * and return a newly allocated Value.
+ */
+typedef Value *(*NativeFunction)(Interpreter *interp, Value **args, int arg_count);
+typedef void (*NativeRegisterFunction)(const char *name, NativeFunction fn, int min_args);
+
+typedef struct NativeEntry
+{
+    char *name;
+    NativeFunction fn;
+    int min_args;
+} NativeEntry;
+
+/* Symbol every extension module must export */
+#define NATIVE_MODULE_INIT "sharpscript_module_init"
+typedef int (*NativeModuleInit)(NativeRegisterFunction register_fn);
+
+void native_register(const char *name, NativeFunction fn, int min_args);
+NativeEntry *native_lookup(const char *name);
+Value *native_invoke(Interpreter *interp, NativeEntry *entry, Value **args, int arg_count);
+int native_load_library(const char *path);
+void native_registry_free(void);
+unsigned native_registry_generation(void);
+
+#endif
@@ -0,0 +1,471 @@
+#include "ordmap.h"
+#include "../include/memory.h"
+#include <string.h>
+
+/* Nodes other than the root keep at least this many keys */
+#define ORDMAP_MIN (ORDMAP_MAX / 2)
+
+/*
+ * Internal nodes hold count separators and count + 1 children; keys in
+ * children[i] are at least keys[i - 1] and below keys[i]. Separators own
+ * copies of their strings, so removing a leaf entry never leaves one dangling.
+ * Both arrays have a spare slot so a node can overflow before it splits.
+ */
+typedef struct OrdNode
+{
+    int leaf;
+    int count;
+    SetKey keys[ORDMAP_MAX + 1];
+    union
+    {
+        struct OrdNode *children[ORDMAP_MAX + 2];
+        void *values[ORDMAP_MAX + 1];
+    } u;
+    struct OrdNode *prev; // leaf chain
+    struct OrdNode *next;
+} OrdNode;
+
+struct OrderedMap
+{
+    int refs;
+    int count;
+    OrdNode *root;
+    void (*free_value)(void *);
+};
+
+static OrdNode *node_create(int leaf)
+{
+    OrdNode *n = memory_allocate(sizeof(OrdNode));
+    n->leaf = leaf;
+    n->count = 0;
+    n->prev = NULL;
+    n->next = NULL;
+    return n;
+}
+
+static SetKey key_copy(const SetKey *key)
+{
+    SetKey copy = *key;
+    if (key->kind == SET_KEY_STRING)
+        copy.u.string = memory_strdup(key->u.string);
+    return copy;
+}
+
+static void key_free(SetKey *key)
+{
+    if (key->kind == SET_KEY_STRING)
+        memory_free((char *)key->u.string);
+}
+
+/*
+ * ordmap_compare: Order two keys: numbers by value, then strings bytewise
+ *
+ * Returns: Negative, zero or positive like strcmp
+ */
+int ordmap_compare(const SetKey *a, const SetKey *b)
+{
+    int a_string = a->kind == SET_KEY_STRING;
+    int b_string = b->kind == SET_KEY_STRING;
+    if (a_string || b_string)
+        return a_string && b_string ? strcmp(a->u.string, b->u.string) : a_string - b_string;
+    if (a->kind == SET_KEY_INT && b->kind == SET_KEY_INT)
+        return (a->u.integer > b->u.integer) - (a->u.integer < b->u.integer);
+    double x = a->kind == SET_KEY_INT ? (double)a->u.integer : a->u.number;
+    double y = b->kind == SET_KEY_INT ? (double)b->u.integer : b->u.number;
+    if (x != y)
+        return x < y ? -1 : 1;
+    if (a->kind == b->kind)
+        return 0;
+    // an integer rounded onto a double key: only doubles past the int64 range are integral
+    const SetKey *number = a->kind == SET_KEY_NUMBER ? a : b;
+    int integer_first = number->u.number > 0;
+    return (a->kind == SET_KEY_INT) == integer_first ? -1 : 1;
+}
+
+/* First position whose key is >= key (strict: > key) */
+static int node_search(const OrdNode *n, const SetKey *key, int strict)
+{
+    int lo = 0, hi = n->count;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        int c = ordmap_compare(&n->keys[mid], key);
+        if (c < 0 || (strict && c == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Leaf that would hold key */
+static OrdNode *find_leaf(OrdNode *n, const SetKey *key)
+{
+    while (!n->leaf)
+        n = n->u.children[node_search(n, key, 1)];
+    return n;
+}
+
+OrderedMap *ordmap_create(void (*free_value)(void *))
+{
+    OrderedMap *m = memory_allocate(sizeof(OrderedMap));
+    m->refs = 1;
+    m->count = 0;
+    m->root = node_create(1);
+    m->free_value = free_value;
+    return m;
+}
+
+OrderedMap *ordmap_retain(OrderedMap *m)
+{
+    m->refs++;
+    return m;
+}
+
+static void node_free(OrderedMap *m, OrdNode *n)
+{
+    for (int i = 0; i < n->count; i++)
+    {
+        key_free(&n->keys[i]);
+        if (n->leaf)
+            m->free_value(n->u.values[i]);
+    }
+    if (!n->leaf)
+    {
+        for (int i = 0; i <= n->count; i++)
+            node_free(m, n->u.children[i]);
+    }
+    memory_free(n);
+}
+
+void ordmap_release(OrderedMap *m)
+{
+    if (!m || --m->refs > 0)
+        return;
+    node_free(m, m->root);
+    memory_free(m);
+}
+
+int ordmap_count(const OrderedMap *m)
+{
+    return m->count;
+}
+
+void *ordmap_get(const OrderedMap *m, const SetKey *key)
+{
+    OrdNode *leaf = find_leaf(m->root, key);
+    int i = node_search(leaf, key, 0);
+    if (i < leaf->count && ordmap_compare(&leaf->keys[i], key) == 0)
+        return leaf->u.values[i];
+    return NULL;
+}
+
+/*
+ * Insert into the subtree at n
+ *
+ * Returns: The new right sibling if n split (its first key copied to
+ * *separator), or NULL
+ */
+static OrdNode *node_insert(OrderedMap *m, OrdNode *n, const SetKey *key, void *value, int *added,
+                            SetKey *separator)
+{
+    if (n->leaf)
+    {
+        int i = node_search(n, key, 0);
+        if (i < n->count && ordmap_compare(&n->keys[i], key) == 0)
+        {
+            m->free_value(n->u.values[i]);
+            n->u.values[i] = value;
+            *added = 0;
+            return NULL;
+        }
+        memmove(&n->keys[i + 1], &n->keys[i], sizeof(SetKey) * (n->count - i));
+        memmove(&n->u.values[i + 1], &n->u.values[i], sizeof(void *) * (n->count - i));
+        n->keys[i] = key_copy(key);
+        n->u.values[i] = value;
+        n->count++;
+        *added = 1;
+        if (n->count <= ORDMAP_MAX)
+            return NULL;
+
+        OrdNode *right = node_create(1);
+        int keep = n->count / 2;
+        right->count = n->count - keep;
+        memcpy(right->keys, &n->keys[keep], sizeof(SetKey) * right->count);
+        memcpy(right->u.values, &n->u.values[keep], sizeof(void *) * right->count);
+        n->count = keep;
+        right->next = n->next;
+        right->prev = n;
+        if (n->next)
+            n->next->prev = right;
+        n->next = right;
+        *separator = key_copy(&right->keys[0]);
+        return right;
+    }
+
+    int i = node_search(n, key, 1);
+    SetKey promoted;
+    OrdNode *split = node_insert(m, n->u.children[i], key, value, added, &promoted);
+    if (!split)
+        return NULL;
+    memmove(&n->keys[i + 1], &n->keys[i], sizeof(SetKey) * (n->count - i));
+    memmove(&n->u.children[i + 2], &n->u.children[i + 1], sizeof(OrdNode *) * (n->count - i));
+    n->keys[i] = promoted;
+    n->u.children[i + 1] = split;
+    n->count++;
+    if (n->count <= ORDMAP_MAX)
+        return NULL;
+
+    // the middle separator moves up; its right half goes to the new node
+    OrdNode *right = node_create(0);
+    int keep = n->count / 2;
+    right->count = n->count - keep - 1;
+    memcpy(right->keys, &n->keys[keep + 1], sizeof(SetKey) * right->count);
+    memcpy(right->u.children, &n->u.children[keep + 1], sizeof(OrdNode *) * (right->count + 1));
+    *separator = n->keys[keep];
+    n->count = keep;
+    return right;
+}
+
+/*
+ * ordmap_set: Insert or replace the value for a key (the map takes over value)
+ *
+ * Returns: 1 if the key was new
+ */
+int ordmap_set(OrderedMap *m, const SetKey *key, void *value)
+{
+    int added = 0;
+    SetKey separator;
+    OrdNode *split = node_insert(m, m->root, key, value, &added, &separator);
+    if (split)
+    {
+        OrdNode *root = node_create(0);
+        root->count = 1;
+        root->keys[0] = separator;
+        root->u.children[0] = m->root;
+        root->u.children[1] = split;
+        m->root = root;
+    }
+    m->count += added;
+    return added;
+}
+
+/* Remove the separator at i and the child after it from an internal node */
+static void remove_separator(OrdNode *n, int i)
+{
+    key_free(&n->keys[i]);
+    memmove(&n->keys[i], &n->keys[i + 1], sizeof(SetKey) * (n->count - i - 1));
+    memmove(&n->u.children[i + 1], &n->u.children[i + 2], sizeof(OrdNode *) * (n->count - i - 1));
+    n->count--;
+}
+
+/* Append right (the child after separator i) to left and drop right */
+static void merge_children(OrdNode *parent, int i)
+{
+    OrdNode *left = parent->u.children[i];
+    OrdNode *right = parent->u.children[i + 1];
+    if (left->leaf)
+    {
+        memcpy(&left->keys[left->count], right->keys, sizeof(SetKey) * right->count);
+        memcpy(&left->u.values[left->count], right->u.values, sizeof(void *) * right->count);
+        left->count += right->count;
+        left->next = right->next;
+        if (right->next)
+            right->next->prev = left;
+        remove_separator(parent, i);
+    }
+    else
+    {
+        // the separator comes down between the two halves
+        left->keys[left->count] = parent->keys[i];
+        memcpy(&left->keys[left->count + 1], right->keys, sizeof(SetKey) * right->count);
+        memcpy(&left->u.children[left->count + 1], right->u.children, sizeof(OrdNode *) * (right->count + 1));
+        left->count += right->count + 1;
+        memmove(&parent->keys[i], &parent->keys[i + 1], sizeof(SetKey) * (parent->count - i - 1));
+        memmove(&parent->u.children[i + 1], &parent->u.children[i + 2], sizeof(OrdNode *) * (parent->count - i - 1));
+        parent->count--;
+    }
+    memory_free(right);
+}
+
+/* Refill child i of n after it fell below ORDMAP_MIN keys */
+static void rebalance(OrdNode *n, int i)
+{
+    OrdNode *child = n->u.children[i];
+    OrdNode *left = i > 0 ? n->u.children[i - 1] : NULL;
+    OrdNode *right = i < n->count ? n->u.children[i + 1] : NULL;
+
+    if (left && left->count > ORDMAP_MIN)
+    {
+        // borrow the last entry of the left sibling
+        memmove(&child->keys[1], child->keys, sizeof(SetKey) * child->count);
+        if (child->leaf)
+        {
+            memmove(&child->u.values[1], child->u.values, sizeof(void *) * child->count);
+            child->keys[0] = left->keys[left->count - 1];
+            child->u.values[0] = left->u.values[left->count - 1];
+            key_free(&n->keys[i - 1]);
+            n->keys[i - 1] = key_copy(&child->keys[0]);
+        }
+        else
+        {
+            memmove(&child->u.children[1], child->u.children, sizeof(OrdNode *) * (child->count + 1));
+            child->keys[0] = n->keys[i - 1];
+            child->u.children[0] = left->u.children[left->count];
+            n->keys[i - 1] = left->keys[left->count - 1];
+        }
+        left->count--;
+        child->count++;
+    }
+    else if (right && right->count > ORDMAP_MIN)
+    {
+        // borrow the first entry of the right sibling
+        if (child->leaf)
+        {
+            child->keys[child->count] = right->keys[0];
+            child->u.values[child->count] = right->u.values[0];
+            memmove(right->keys, &right->keys[1], sizeof(SetKey) * (right->count - 1));
+            memmove(right->u.values, &right->u.values[1], sizeof(void *) * (right->count - 1));
+            key_free(&n->keys[i]);
+            n->keys[i] = key_copy(&right->keys[0]);
+        }
+        else
+        {
+            child->keys[child->count] = n->keys[i];
+            child->u.children[child->count + 1] = right->u.children[0];
+            n->keys[i] = right->keys[0];
+            memmove(right->keys, &right->keys[1], sizeof(SetKey) * (right->count - 1));
+            memmove(right->u.children, &right->u.children[1], sizeof(OrdNode *) * right->count);
+        }
+        right->count--;
+        child->count++;
+    }
+    else if (left)
+        merge_children(n, i - 1);
+    else if (right)
+        merge_children(n, i);
+}
+
+static int node_remove(OrderedMap *m, OrdNode *n, const SetKey *key)
+{
+    if (n->leaf)
+    {
+        int i = node_search(n, key, 0);
+        if (i >= n->count || ordmap_compare(&n->keys[i], key) != 0)
+            return 0;
+        key_free(&n->keys[i]);
+        m->free_value(n->u.values[i]);
+        memmove(&n->keys[i], &n->keys[i + 1], sizeof(SetKey) * (n->count - i - 1));
+        memmove(&n->u.values[i], &n->u.values[i + 1], sizeof(void *) * (n->count - i - 1));
+        n->count--;
+        return 1;
+    }
+    int i = node_search(n, key, 1);
+    if (!node_remove(m, n->u.children[i], key))
+        return 0;
+    if (n->u.children[i]->count < ORDMAP_MIN)
+        rebalance(n, i);
+    return 1;
+}
+
+/*
+ * ordmap_remove: Remove a key and free its value
+ *
+ * Returns: 1 if the key was present
+ */
+int ordmap_remove(OrderedMap *m, const SetKey *key)
+{
+    if (!node_remove(m, m->root, key))
+        return 0;
+    m->count--;
+    if (!m->root->leaf && m->root->count == 0)
+    {
+        OrdNode *old = m->root;
+        m->root = old->u.children[0];
+        memory_free(old);
+    }
+    return 1;
+}
+
+/* ---- cursors ---- */
+
+/* Move past the end of a leaf onto the next non-empty one */
+static void cursor_settle(OrderedCursor *cursor)
+{
+    OrdNode *leaf = cursor->leaf;
+    while (leaf && cursor->index >= leaf->count)
+    {
+        leaf = leaf->next;
+        cursor->index = 0;
+    }
+    cursor->leaf = leaf;
+}
+
+void ordmap_first(const OrderedMap *m, OrderedCursor *cursor)
+{
+    OrdNode *n = m->root;
+    while (!n->leaf)
+        n = n->u.children[0];
+    cursor->leaf = n;
+    cursor->index = 0;
+    cursor_settle(cursor);
+}
+
+void ordmap_last(const OrderedMap *m, OrderedCursor *cursor)
+{
+    OrdNode *n = m->root;
+    while (!n->leaf)
+        n = n->u.children[n->count];
+    cursor->leaf = n->count ? n : NULL;
+    cursor->index = n->count - 1;
+}
+
+/*
+ * ordmap_ceil: Position at the first key >= key (strict: > key)
+ */
+void ordmap_ceil(const OrderedMap *m, const SetKey *key, int strict, OrderedCursor *cursor)
+{
+    OrdNode *leaf = find_leaf(m->root, key);
+    cursor->leaf = leaf;
+    cursor->index = node_search(leaf, key, strict);
+    cursor_settle(cursor);
+}
+
+/*
+ * ordmap_floor: Position at the last key <= key (strict: < key)
+ */
+void ordmap_floor(const OrderedMap *m, const SetKey *key, int strict, OrderedCursor *cursor)
+{
+    OrdNode *leaf = find_leaf(m->root, key);
+    int i = node_search(leaf, key, !strict) - 1;
+    if (i < 0)
+    {
+        leaf = leaf->prev;
+        i = leaf ? leaf->count - 1 : 0;
+    }
+    cursor->leaf = leaf;
+    cursor->index = i;
+}
+
+/*
+ * ordmap_entry: Read the entry at a cursor
+ *
+ * Returns: 1 with key and value set (both still owned by the map), 0 past the end
+ */
+int ordmap_entry(const OrderedCursor *cursor, SetKey *key, void **value)
+{
+    OrdNode *leaf = cursor->leaf;
+    if (!leaf)
+        return 0;
+    *key = leaf->keys[cursor->index];
+    *value = leaf->u.values[cursor->index];
+    return 1;
+}
+
+void ordmap_next(OrderedCursor *cursor)
+{
+    if (!cursor->leaf)
+        return;
+    cursor->index++;
+    cursor_settle(cursor);
+}
@@ -0,0 +1,42 @@
+#ifndef SHARPSCRIPT_ORDMAP_H
+#define SHARPSCRIPT_ORDMAP_H
+
+#include "set.h"
+
+/*
+ * Sorted maps behind VAL_ORDMAP: a B+tree keyed by numbers and strings
+ * (SetKey, see set.h), numbers ordered before strings. Entries live in
+ * leaves of up to ORDMAP_MAX keys linked in both directions, so range scans
+ * walk leaves without revisiting the upper levels. Values are opaque; the
+ * map frees them with the function given at creation. Maps are shared by
+ * reference count like sets.
+ */
+#define ORDMAP_MAX 32
+
+typedef struct OrderedMap OrderedMap;
+
+/* Position of an entry; invalidated by any change to the map */
+typedef struct
+{
+    void *leaf;
+    int index;
+} OrderedCursor;
+
+OrderedMap *ordmap_create(void (*free_value)(void *));
+OrderedMap *ordmap_retain(OrderedMap *m);
+void ordmap_release(OrderedMap *m);
+
+int ordmap_count(const OrderedMap *m);
+int ordmap_compare(const SetKey *a, const SetKey *b);
+int ordmap_set(OrderedMap *m, const SetKey *key, void *value);
+void *ordmap_get(const OrderedMap *m, const SetKey *key);
+int ordmap_remove(OrderedMap *m, const SetKey *key);
+
+void ordmap_first(const OrderedMap *m, OrderedCursor *cursor);
+void ordmap_last(const OrderedMap *m, OrderedCursor *cursor);
+void ordmap_ceil(const OrderedMap *m, const SetKey *key, int strict, OrderedCursor *cursor);
+void ordmap_floor(const OrderedMap *m, const SetKey *key, int strict, OrderedCursor *cursor);
+int ordmap_entry(const OrderedCursor *cursor, SetKey *key, void **value);
+void ordmap_next(OrderedCursor *cursor);
+
+#endif
@@ -0,0 +1,222 @@
+#include "random.h"
+#include "../include/memory.h"
+#include <string.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RANDOM_AVX2
+#include <immintrin.h>
+#define RANDOM_TARGET __attribute__((target("avx2")))
+#endif
+
+/* Fills shorter than this draw from the generator directly */
+#define RANDOM_LANE_THRESHOLD 64
+
+static inline uint64_t rotl(uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+/* splitmix64, used to expand a seed into the four state words */
+static uint64_t splitmix(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/*
+ * random_create: A generator seeded from the clock and its own address
+ */
+RandomState *random_create(void)
+{
+    RandomState *r = memory_allocate(sizeof(RandomState));
+    uint64_t seed = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32) ^ (uint64_t)(uintptr_t)r;
+    random_seed(r, seed);
+    return r;
+}
+
+void random_free(RandomState *r)
+{
+    memory_free(r);
+}
+
+void random_seed(RandomState *r, uint64_t seed)
+{
+    for (int i = 0; i < 4; i++)
+        r->s[i] = splitmix(&seed);
+}
+
+uint64_t random_next(RandomState *r)
+{
+    uint64_t *s = r->s;
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+}
+
+/* Top 52 bits as a double in [0, 1): set them as the mantissa of [1, 2) and subtract 1 */
+static inline double to_unit(uint64_t x)
+{
+    uint64_t bits = (x >> 12) | 0x3ff0000000000000ULL;
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d - 1.0;
+}
+
+double random_double(RandomState *r)
+{
+    return to_unit(random_next(r));
+}
+
+/*
+ * random_int: Uniform integer in [lo, hi] (swapped if hi < lo)
+ *
+ * Lemire's multiply-and-reject where 128-bit products exist, so no range is
+ * biased and most draws need no division.
+ */
+long long random_int(RandomState *r, long long lo, long long hi)
+{
+    if (hi < lo)
+    {
+        long long t = lo;
+        lo = hi;
+        hi = t;
+    }
+    uint64_t range = (uint64_t)hi - (uint64_t)lo + 1; // 0 means all 2^64 values
+    if (range == 0)
+        return (long long)random_next(r);
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 m = (unsigned __int128)random_next(r) * range;
+    uint64_t low = (uint64_t)m;
+    if (low < range)
+    {
+        uint64_t threshold = -range % range;
+        while (low < threshold)
+        {
+            m = (unsigned __int128)random_next(r) * range;
+            low = (uint64_t)m;
+        }
+    }
+    return (long long)((uint64_t)lo + (uint64_t)(m >> 64));
+#else
+    // reject the top partial copy of the range, then reduce
+    uint64_t limit = UINT64_MAX - UINT64_MAX % range;
+    uint64_t x;
+    do
+        x = random_next(r);
+    while (x >= limit);
+    return (long long)((uint64_t)lo + x % range);
+#endif
+}
+
+/* Advance 2^128 steps: the jumped streams never overlap in practice */
+static void random_jump(RandomState *r)
+{
+    static const uint64_t jump[] = {0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL, 0xa9582618e03fc9aaULL,
+                                    0x39abdc4529b1661cULL};
+    uint64_t s[4] = {0, 0, 0, 0};
+    for (int i = 0; i < 4; i++)
+    {
+        for (int b = 0; b < 64; b++)
+        {
+            if (jump[i] & (1ULL << b))
+            {
+                for (int k = 0; k < 4; k++)
+                    s[k] ^= r->s[k];
+            }
+            random_next(r);
+        }
+    }
+    memcpy(r->s, s, sizeof(s));
+}
+
+#ifdef RANDOM_AVX2
+static inline __m256i RANDOM_TARGET rotl4(__m256i x, int k)
+{
+    return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+}
+
+/* Four streams side by side, one per 64-bit lane; multiplies by 5 and 9 are shift-adds */
+static size_t RANDOM_TARGET fill_lanes_avx2(RandomState *lanes, double *out, size_t blocks)
+{
+    __m256i s0 = _mm256_set_epi64x(lanes[3].s[0], lanes[2].s[0], lanes[1].s[0], lanes[0].s[0]);
+    __m256i s1 = _mm256_set_epi64x(lanes[3].s[1], lanes[2].s[1], lanes[1].s[1], lanes[0].s[1]);
+    __m256i s2 = _mm256_set_epi64x(lanes[3].s[2], lanes[2].s[2], lanes[1].s[2], lanes[0].s[2]);
+    __m256i s3 = _mm256_set_epi64x(lanes[3].s[3], lanes[2].s[3], lanes[1].s[3], lanes[0].s[3]);
+    const __m256i exponent = _mm256_set1_epi64x(0x3ff0000000000000LL);
+    const __m256d one = _mm256_set1_pd(1.0);
+    for (size_t i = 0; i < blocks; i++)
+    {
+        __m256i x = _mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1);
+        x = rotl4(x, 7);
+        x = _mm256_add_epi64(_mm256_slli_epi64(x, 3), x);
+        __m256i bits = _mm256_or_si256(_mm256_srli_epi64(x, 12), exponent);
+        _mm256_storeu_pd(out + 4 * i, _mm256_sub_pd(_mm256_castsi256_pd(bits), one));
+
+        __m256i t = _mm256_slli_epi64(s1, 17);
+        s2 = _mm256_xor_si256(s2, s0);
+        s3 = _mm256_xor_si256(s3, s1);
+        s1 = _mm256_xor_si256(s1, s2);
+        s0 = _mm256_xor_si256(s0, s3);
+        s2 = _mm256_xor_si256(s2, t);
+        s3 = rotl4(s3, 45);
+    }
+    uint64_t w[4][4];
+    _mm256_storeu_si256((__m256i *)w[0], s0);
+    _mm256_storeu_si256((__m256i *)w[1], s1);
+    _mm256_storeu_si256((__m256i *)w[2], s2);
+    _mm256_storeu_si256((__m256i *)w[3], s3);
+    for (int lane = 0; lane < 4; lane++)
+    {
+        for (int k = 0; k < 4; k++)
+            lanes[lane].s[k] = w[k][lane];
+    }
+    return blocks;
+}
+#endif
+
+/*
+ * random_fill: Fill out with count doubles in [0, 1)
+ *
+ * Long fills interleave four streams (the generator and three copies jumped
+ * 2^128 steps apart), out[4i + k] coming from stream k, so the AVX2 path and
+ * the scalar fallback produce the same numbers. The generator continues from
+ * the first stream, and each later fill restarts the other streams from the
+ * jump points after it, past everything they have produced.
+ */
+void random_fill(RandomState *r, double *out, size_t count)
+{
+    size_t i = 0;
+    if (count >= RANDOM_LANE_THRESHOLD)
+    {
+        RandomState lanes[4];
+        lanes[0] = *r;
+        for (int k = 1; k < 4; k++)
+        {
+            lanes[k] = lanes[k - 1];
+            random_jump(&lanes[k]);
+        }
+        size_t blocks = count / 4, done = 0;
+#ifdef RANDOM_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            done = fill_lanes_avx2(lanes, out, blocks);
+#endif
+        for (; done < blocks; done++)
+        {
+            for (int k = 0; k < 4; k++)
+                out[4 * done + k] = to_unit(random_next(&lanes[k]));
+        }
+        *r = lanes[0];
+        i = blocks * 4;
+    }
+    for (; i < count; i++)
+        out[i] = random_double(r);
+}
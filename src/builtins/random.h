@@ -0,0 +1,25 @@
+#ifndef SHARPSCRIPT_RANDOM_H
+#define SHARPSCRIPT_RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * xoshiro256** generator behind system.random. Each interpreter owns its
+ * state, so interpreters on different threads never share or lock one.
+ */
+typedef struct RandomState
+{
+    uint64_t s[4];
+} RandomState;
+
+RandomState *random_create(void);
+void random_free(RandomState *r);
+void random_seed(RandomState *r, uint64_t seed);
+
+uint64_t random_next(RandomState *r);
+double random_double(RandomState *r);
+long long random_int(RandomState *r, long long lo, long long hi);
+void random_fill(RandomState *r, double *out, size_t count);
+
+#endif
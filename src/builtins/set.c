@@ -0,0 +1,280 @@
+#include "set.h"
+#include "hash.h"
+#include "../include/memory.h"
+#include <string.h>
+
+#define SET_MIN_SLOTS 16
+
+/* Index slots: 0 is empty; a deleted slot keeps its probe chain intact */
+#define SLOT_EMPTY 0u
+#define SLOT_DELETED UINT32_MAX
+
+typedef struct
+{
+    uint64_t hash;
+    SetKey key;
+    int live;
+} SetEntry;
+
+typedef struct
+{
+    uint32_t entry; // position in entries + 1, or SLOT_EMPTY / SLOT_DELETED
+    uint32_t tag;   // high hash bits, compared before touching the entry
+} SetSlot;
+
+struct SetTable
+{
+    int refs;
+    SetEntry *entries; // insertion order, including removed entries until the next rebuild
+    int used;          // entries in use (live or removed)
+    int capacity;
+    int live;
+    SetSlot *slots;
+    uint32_t mask;     // slot count - 1
+    uint32_t filled;   // slots not empty (live or deleted)
+};
+
+static uint64_t key_hash(const SetKey *key)
+{
+    if (key->kind == SET_KEY_STRING)
+        return hash_string(key->u.string);
+    uint64_t bits;
+    if (key->kind == SET_KEY_INT)
+        bits = (uint64_t)key->u.integer;
+    else
+    {
+        double d = key->u.number == 0.0 ? 0.0 : key->u.number; // -0 and 0 are one key
+        memcpy(&bits, &d, sizeof(bits));
+        bits ^= 0x9e3779b97f4a7c15ULL; // keep doubles apart from the integers with the same bits
+    }
+    return hash_mix64(bits);
+}
+
+static int key_equal(const SetKey *a, const SetKey *b)
+{
+    if (a->kind != b->kind)
+        return 0;
+    switch (a->kind)
+    {
+    case SET_KEY_INT:
+        return a->u.integer == b->u.integer;
+    case SET_KEY_NUMBER:
+        return a->u.number == b->u.number || (a->u.number != a->u.number && b->u.number != b->u.number);
+    default:
+        return strcmp(a->u.string, b->u.string) == 0;
+    }
+}
+
+SetTable *set_create(int capacity)
+{
+    SetTable *s = memory_allocate(sizeof(SetTable));
+    s->refs = 1;
+    s->capacity = capacity > 8 ? capacity : 8;
+    s->entries = memory_allocate(sizeof(SetEntry) * s->capacity);
+    s->used = 0;
+    s->live = 0;
+    // keep the index at most half full
+    uint32_t slots = SET_MIN_SLOTS;
+    while (slots < (uint32_t)s->capacity * 2)
+        slots *= 2;
+    s->slots = memory_allocate(sizeof(SetSlot) * slots);
+    memset(s->slots, 0, sizeof(SetSlot) * slots);
+    s->mask = slots - 1;
+    s->filled = 0;
+    return s;
+}
+
+SetTable *set_retain(SetTable *s)
+{
+    s->refs++;
+    return s;
+}
+
+void set_release(SetTable *s)
+{
+    if (!s || --s->refs > 0)
+        return;
+    for (int i = 0; i < s->used; i++)
+    {
+        if (s->entries[i].live && s->entries[i].key.kind == SET_KEY_STRING)
+            memory_free((char *)s->entries[i].key.u.string);
+    }
+    memory_free(s->entries);
+    memory_free(s->slots);
+    memory_free(s);
+}
+
+int set_count(const SetTable *s)
+{
+    return s->live;
+}
+
+/* Slot holding key, or -1 */
+static long find_slot(const SetTable *s, const SetKey *key, uint64_t hash)
+{
+    uint32_t tag = (uint32_t)(hash >> 32);
+    for (uint32_t i = (uint32_t)hash & s->mask;; i = (i + 1) & s->mask)
+    {
+        SetSlot slot = s->slots[i];
+        if (slot.entry == SLOT_EMPTY)
+            return -1;
+        if (slot.entry != SLOT_DELETED && slot.tag == tag && key_equal(&s->entries[slot.entry - 1].key, key))
+            return (long)i;
+    }
+}
+
+/* Rebuild the index for slots slots, dropping removed entries */
+static void rebuild(SetTable *s, uint32_t slots)
+{
+    int live = 0;
+    for (int i = 0; i < s->used; i++)
+    {
+        if (s->entries[i].live)
+            s->entries[live++] = s->entries[i];
+    }
+    s->used = live;
+    memory_free(s->slots);
+    s->slots = memory_allocate(sizeof(SetSlot) * slots);
+    memset(s->slots, 0, sizeof(SetSlot) * slots);
+    s->mask = slots - 1;
+    s->filled = (uint32_t)live;
+    for (int i = 0; i < live; i++)
+    {
+        uint64_t hash = s->entries[i].hash;
+        uint32_t j = (uint32_t)hash & s->mask;
+        while (s->slots[j].entry != SLOT_EMPTY)
+            j = (j + 1) & s->mask;
+        s->slots[j].entry = (uint32_t)i + 1;
+        s->slots[j].tag = (uint32_t)(hash >> 32);
+    }
+}
+
+/*
+ * set_add: Add a key (strings are copied)
+ *
+ * Returns: 1 if the key was new, 0 if it was already present
+ */
+int set_add(SetTable *s, const SetKey *key)
+{
+    uint64_t hash = key_hash(key);
+    if (find_slot(s, key, hash) >= 0)
+        return 0;
+
+    if ((s->filled + 1) * 2 > s->mask + 1)
+    {
+        // grow when mostly live, otherwise just clear out the deleted slots
+        uint32_t slots = s->mask + 1;
+        if ((uint32_t)(s->live + 1) * 4 > slots)
+            slots *= 2;
+        rebuild(s, slots);
+    }
+    if (s->used == s->capacity)
+    {
+        if (s->live < s->used)
+            rebuild(s, s->mask + 1);
+        if (s->used == s->capacity)
+        {
+            s->capacity *= 2;
+            s->entries = memory_reallocate(s->entries, sizeof(SetEntry) * s->capacity);
+        }
+    }
+
+    SetEntry *e = &s->entries[s->used];
+    e->hash = hash;
+    e->key = *key;
+    if (key->kind == SET_KEY_STRING)
+        e->key.u.string = memory_strdup(key->u.string);
+    e->live = 1;
+
+    uint32_t i = (uint32_t)hash & s->mask;
+    while (s->slots[i].entry != SLOT_EMPTY && s->slots[i].entry != SLOT_DELETED)
+        i = (i + 1) & s->mask;
+    if (s->slots[i].entry == SLOT_EMPTY)
+        s->filled++;
+    s->slots[i].entry = (uint32_t)s->used + 1;
+    s->slots[i].tag = (uint32_t)(hash >> 32);
+    s->used++;
+    s->live++;
+    return 1;
+}
+
+int set_contains(const SetTable *s, const SetKey *key)
+{
+    return find_slot(s, key, key_hash(key)) >= 0;
+}
+
+/*
+ * set_remove: Remove a key
+ *
+ * Returns: 1 if the key was present
+ */
+int set_remove(SetTable *s, const SetKey *key)
+{
+    long slot = find_slot(s, key, key_hash(key));
+    if (slot < 0)
+        return 0;
+    SetEntry *e = &s->entries[s->slots[slot].entry - 1];
+    if (e->key.kind == SET_KEY_STRING)
+        memory_free((char *)e->key.u.string);
+    e->live = 0;
+    s->slots[slot].entry = SLOT_DELETED;
+    s->live--;
+    return 1;
+}
+
+/*
+ * set_next: Step through the keys in insertion order
+ *
+ * Start with *cursor = 0.
+ * Returns: 1 with *key set (strings borrowed from the set), 0 at the end
+ */
+int set_next(const SetTable *s, int *cursor, SetKey *key)
+{
+    while (*cursor < s->used)
+    {
+        const SetEntry *e = &s->entries[(*cursor)++];
+        if (e->live)
+        {
+            *key = e->key;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+SetTable *set_union(const SetTable *a, const SetTable *b)
+{
+    SetTable *out = set_create(a->live + b->live);
+    SetKey key;
+    int cursor = 0;
+    while (set_next(a, &cursor, &key))
+        set_add(out, &key);
+    cursor = 0;
+    while (set_next(b, &cursor, &key))
+        set_add(out, &key);
+    return out;
+}
+
+/* Keys of a that are (keep = 1) or are not (keep = 0) in b */
+static SetTable *set_filter(const SetTable *a, const SetTable *b, int keep)
+{
+    SetTable *out = set_create(a->live);
+    SetKey key;
+    int cursor = 0;
+    while (set_next(a, &cursor, &key))
+    {
+        if (set_contains(b, &key) == keep)
+            set_add(out, &key);
+    }
+    return out;
+}
+
+SetTable *set_intersection(const SetTable *a, const SetTable *b)
+{
+    return set_filter(a, b, 1);
+}
+
+SetTable *set_difference(const SetTable *a, const SetTable *b)
+{
+    return set_filter(a, b, 0);
+}
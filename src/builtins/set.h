@@ -0,0 +1,46 @@
+#ifndef SHARPSCRIPT_SET_H
+#define SHARPSCRIPT_SET_H
+
+#include <stdint.h>
+
+/*
+ * Hash sets of numbers and strings behind VAL_SET. Elements are kept in
+ * insertion order in a dense array; an open-addressing index (linear
+ * probing) maps hashes to positions in it. Sets are shared by reference
+ * count, so adding through any copy of a set value updates all of them.
+ */
+typedef enum
+{
+    SET_KEY_INT,    // integers and integral doubles
+    SET_KEY_NUMBER, // other doubles
+    SET_KEY_STRING
+} SetKeyKind;
+
+typedef struct
+{
+    SetKeyKind kind;
+    union
+    {
+        long long integer;
+        double number;
+        const char *string; // borrowed when passed in; the set keeps its own copy
+    } u;
+} SetKey;
+
+typedef struct SetTable SetTable;
+
+SetTable *set_create(int capacity);
+SetTable *set_retain(SetTable *s);
+void set_release(SetTable *s);
+
+int set_count(const SetTable *s);
+int set_add(SetTable *s, const SetKey *key);
+int set_contains(const SetTable *s, const SetKey *key);
+int set_remove(SetTable *s, const SetKey *key);
+int set_next(const SetTable *s, int *cursor, SetKey *key);
+
+SetTable *set_union(const SetTable *a, const SetTable *b);
+SetTable *set_intersection(const SetTable *a, const SetTable *b);
+SetTable *set_difference(const SetTable *a, const SetTable *b);
+
+#endif
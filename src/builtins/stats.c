@@ -0,0 +1,616 @@
+#include "stats.h"
+#include "../include/memory.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Defaults and limits for the sketch parameters */
+#define STATS_HDR_MAX_DIGITS 5
+#define STATS_TDIGEST_MIN_COMPRESSION 20.0
+#define STATS_HLL_MIN_PRECISION 4
+#define STATS_HLL_MAX_PRECISION 18
+
+typedef struct
+{
+    double mean;
+    double weight;
+} Centroid;
+
+struct StatsSketch
+{
+    StatsKind kind;
+    int refs;
+    double total; // values added (weights for the digest)
+    union
+    {
+        struct
+        {
+            double min;
+            double width;
+            int buckets;
+            uint64_t *counts;
+        } histogram;
+        struct
+        {
+            int min_exponent; // frexp exponent of the lowest trackable value
+            int sub_buckets;  // linear buckets per power of two
+            int buckets;
+            uint64_t zeros;   // values at or below zero
+            uint64_t *counts;
+        } hdr;
+        struct
+        {
+            double compression;
+            double min;
+            double max;
+            Centroid *centroids; // sorted by mean after each merge
+            int count;
+            Centroid *buffer;    // unmerged values
+            int buffered;
+            int buffer_capacity;
+        } digest;
+        struct
+        {
+            int precision;
+            uint8_t *registers;
+        } hll;
+        struct
+        {
+            int width;
+            int depth;
+            uint64_t *counters; // depth rows of width counters
+        } cms;
+    } u;
+};
+
+/* ---- exact percentiles ---- */
+
+/* Rearrange values so values[k] is the k-th smallest (Hoare partition, median of three pivot) */
+static void quickselect(double *values, int count, int k)
+{
+    int lo = 0, hi = count - 1;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        double a = values[lo], b = values[mid], c = values[hi];
+        double pivot = a < b ? (b < c ? b : (a < c ? c : a)) : (a < c ? a : (b < c ? c : b));
+        int i = lo, j = hi;
+        while (i <= j)
+        {
+            while (values[i] < pivot)
+                i++;
+            while (values[j] > pivot)
+                j--;
+            if (i <= j)
+            {
+                double t = values[i];
+                values[i] = values[j];
+                values[j] = t;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j)
+            hi = j;
+        else if (k >= i)
+            lo = i;
+        else
+            return;
+    }
+}
+
+/*
+ * stats_percentile: The p-th percentile (0..100) of values, interpolating
+ * linearly between the two nearest ranks
+ *
+ * values is reordered in place; selection is linear on average, so no sort.
+ * Returns: The percentile, or NaN when count is 0
+ */
+double stats_percentile(double *values, int count, double p)
+{
+    if (count <= 0)
+        return NAN;
+    if (p < 0.0)
+        p = 0.0;
+    if (p > 100.0)
+        p = 100.0;
+    double rank = p / 100.0 * (count - 1);
+    int k = (int)rank;
+    double fraction = rank - k;
+    quickselect(values, count, k);
+    double low = values[k];
+    if (fraction == 0.0 || k + 1 >= count)
+        return low;
+    // everything after k is at least values[k]; the next rank is their minimum
+    double high = values[k + 1];
+    for (int i = k + 2; i < count; i++)
+    {
+        if (values[i] < high)
+            high = values[i];
+    }
+    return low + (high - low) * fraction;
+}
+
+/* ---- construction ---- */
+
+static StatsSketch *stats_alloc(StatsKind kind)
+{
+    StatsSketch *s = memory_allocate(sizeof(StatsSketch));
+    memset(s, 0, sizeof(StatsSketch));
+    s->kind = kind;
+    s->refs = 1;
+    return s;
+}
+
+static uint64_t *zeroed_counts(size_t count)
+{
+    uint64_t *counts = memory_allocate(sizeof(uint64_t) * (count ? count : 1));
+    memset(counts, 0, sizeof(uint64_t) * count);
+    return counts;
+}
+
+/*
+ * stats_histogram_create: buckets equal-width buckets over [min, max)
+ *
+ * Values outside the range are counted in the first or last bucket.
+ * Returns: The sketch, or NULL for an empty range or no buckets
+ */
+StatsSketch *stats_histogram_create(double min, double max, int buckets)
+{
+    if (!(max > min) || buckets <= 0 || !isfinite(min) || !isfinite(max))
+        return NULL;
+    StatsSketch *s = stats_alloc(STATS_HISTOGRAM);
+    s->u.histogram.min = min;
+    s->u.histogram.width = (max - min) / buckets;
+    s->u.histogram.buckets = buckets;
+    s->u.histogram.counts = zeroed_counts(buckets);
+    return s;
+}
+
+/*
+ * stats_hdr_create: Log-linear histogram for positive values in [lowest, highest]
+ *
+ * Every power of two is split into enough linear buckets to keep digits
+ * significant decimal digits, so a reported value is within 10^-digits
+ * (relative) of the values in its bucket, whatever their magnitude.
+ * Returns: The sketch, or NULL for an invalid range or precision
+ */
+StatsSketch *stats_hdr_create(double lowest, double highest, int digits)
+{
+    if (!(lowest > 0.0) || !(highest > lowest) || !isfinite(highest) || digits < 1 ||
+        digits > STATS_HDR_MAX_DIGITS)
+        return NULL;
+    int sub = 1;
+    while (sub < 2 * pow(10.0, digits))
+        sub *= 2;
+    int low_exp, high_exp;
+    frexp(lowest, &low_exp);
+    frexp(highest, &high_exp);
+    StatsSketch *s = stats_alloc(STATS_HDR);
+    s->u.hdr.min_exponent = low_exp;
+    s->u.hdr.sub_buckets = sub;
+    s->u.hdr.buckets = (high_exp - low_exp + 1) * sub;
+    s->u.hdr.counts = zeroed_counts(s->u.hdr.buckets);
+    return s;
+}
+
+StatsSketch *stats_tdigest_create(double compression)
+{
+    if (!(compression >= STATS_TDIGEST_MIN_COMPRESSION))
+        compression = STATS_TDIGEST_MIN_COMPRESSION;
+    StatsSketch *s = stats_alloc(STATS_TDIGEST);
+    s->u.digest.compression = compression;
+    s->u.digest.min = INFINITY;
+    s->u.digest.max = -INFINITY;
+    // at most about compression centroids survive a merge
+    s->u.digest.centroids = memory_allocate(sizeof(Centroid) * ((size_t)compression * 2 + 8));
+    s->u.digest.buffer_capacity = (int)(compression * 5);
+    s->u.digest.buffer = memory_allocate(sizeof(Centroid) * s->u.digest.buffer_capacity);
+    return s;
+}
+
+StatsSketch *stats_hll_create(int precision)
+{
+    if (precision < STATS_HLL_MIN_PRECISION)
+        precision = STATS_HLL_MIN_PRECISION;
+    if (precision > STATS_HLL_MAX_PRECISION)
+        precision = STATS_HLL_MAX_PRECISION;
+    StatsSketch *s = stats_alloc(STATS_HLL);
+    s->u.hll.precision = precision;
+    s->u.hll.registers = memory_allocate((size_t)1 << precision);
+    memset(s->u.hll.registers, 0, (size_t)1 << precision);
+    return s;
+}
+
+/*
+ * stats_countmin_create: depth rows of width counters
+ *
+ * Estimates exceed the true count by at most e/width of the total with
+ * probability 1 - e^-depth.
+ */
+StatsSketch *stats_countmin_create(int width, int depth)
+{
+    if (width <= 0 || depth <= 0)
+        return NULL;
+    StatsSketch *s = stats_alloc(STATS_COUNTMIN);
+    s->u.cms.width = width;
+    s->u.cms.depth = depth;
+    s->u.cms.counters = zeroed_counts((size_t)width * depth);
+    return s;
+}
+
+StatsSketch *stats_retain(StatsSketch *s)
+{
+    s->refs++;
+    return s;
+}
+
+void stats_release(StatsSketch *s)
+{
+    if (!s || --s->refs > 0)
+        return;
+    switch (s->kind)
+    {
+    case STATS_HISTOGRAM:
+        memory_free(s->u.histogram.counts);
+        break;
+    case STATS_HDR:
+        memory_free(s->u.hdr.counts);
+        break;
+    case STATS_TDIGEST:
+        memory_free(s->u.digest.centroids);
+        memory_free(s->u.digest.buffer);
+        break;
+    case STATS_HLL:
+        memory_free(s->u.hll.registers);
+        break;
+    case STATS_COUNTMIN:
+        memory_free(s->u.cms.counters);
+        break;
+    }
+    memory_free(s);
+}
+
+StatsKind stats_kind(const StatsSketch *s)
+{
+    return s->kind;
+}
+
+const char *stats_kind_name(const StatsSketch *s)
+{
+    static const char *names[] = {"histogram", "hdr", "tdigest", "hll", "countmin"};
+    return names[s->kind];
+}
+
+/* Histograms and the digest summarize numbers; the other sketches take hashed keys */
+int stats_takes_numbers(const StatsSketch *s)
+{
+    return s->kind == STATS_HISTOGRAM || s->kind == STATS_HDR || s->kind == STATS_TDIGEST;
+}
+
+/* ---- t-digest ---- */
+
+static int centroid_compare(const void *a, const void *b)
+{
+    double x = ((const Centroid *)a)->mean;
+    double y = ((const Centroid *)b)->mean;
+    return x < y ? -1 : x > y;
+}
+
+/* Scale function k1: centroids near the tails stay small */
+static double digest_k(double compression, double q)
+{
+    return compression / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+
+/* Merge the buffered values into the centroid list */
+static void digest_flush(StatsSketch *s)
+{
+    if (!s->u.digest.buffered)
+        return;
+    int n = s->u.digest.count + s->u.digest.buffered;
+    Centroid *all = memory_allocate(sizeof(Centroid) * n);
+    memcpy(all, s->u.digest.centroids, sizeof(Centroid) * s->u.digest.count);
+    memcpy(all + s->u.digest.count, s->u.digest.buffer, sizeof(Centroid) * s->u.digest.buffered);
+    qsort(all, n, sizeof(Centroid), centroid_compare);
+
+    double total = s->total;
+    double compression = s->u.digest.compression;
+    Centroid *out = s->u.digest.centroids;
+    int count = 0;
+    Centroid current = all[0];
+    double before = 0.0; // weight of the centroids already emitted
+    double k_low = digest_k(compression, 0.0);
+    for (int i = 1; i < n; i++)
+    {
+        double proposed = current.weight + all[i].weight;
+        if (digest_k(compression, (before + proposed) / total) - k_low <= 1.0)
+        {
+            current.mean += (all[i].mean - current.mean) * all[i].weight / proposed;
+            current.weight = proposed;
+        }
+        else
+        {
+            out[count++] = current;
+            before += current.weight;
+            k_low = digest_k(compression, before / total);
+            current = all[i];
+        }
+    }
+    out[count++] = current;
+    s->u.digest.count = count;
+    s->u.digest.buffered = 0;
+    memory_free(all);
+}
+
+static double digest_percentile(StatsSketch *s, double p)
+{
+    digest_flush(s);
+    int n = s->u.digest.count;
+    Centroid *c = s->u.digest.centroids;
+    if (!n)
+        return NAN;
+    if (n == 1)
+        return c[0].mean;
+    double index = p / 100.0 * s->total;
+    double min = s->u.digest.min, max = s->u.digest.max;
+
+    // tails: interpolate between the extreme values and the outer centroids
+    if (index < c[0].weight / 2.0)
+        return min + (c[0].mean - min) * index / (c[0].weight / 2.0);
+    if (index > s->total - c[n - 1].weight / 2.0)
+    {
+        double tail = c[n - 1].weight / 2.0;
+        return max - (max - c[n - 1].mean) * (s->total - index) / tail;
+    }
+    double position = c[0].weight / 2.0; // cumulative weight at the centre of centroid i
+    for (int i = 0; i + 1 < n; i++)
+    {
+        double gap = (c[i].weight + c[i + 1].weight) / 2.0;
+        if (index <= position + gap)
+            return c[i].mean + (c[i + 1].mean - c[i].mean) * (index - position) / gap;
+        position += gap;
+    }
+    return c[n - 1].mean;
+}
+
+/* ---- updates ---- */
+
+static int hdr_index(const StatsSketch *s, double value)
+{
+    int exponent;
+    double mantissa = frexp(value, &exponent); // value = mantissa * 2^exponent, mantissa in [0.5, 1)
+    int sub = s->u.hdr.sub_buckets;
+    long index = (long)(exponent - s->u.hdr.min_exponent) * sub + (long)((mantissa - 0.5) * 2.0 * sub);
+    if (index < 0)
+        return 0;
+    if (index >= s->u.hdr.buckets)
+        return s->u.hdr.buckets - 1;
+    return (int)index;
+}
+
+/* Midpoint of an HDR bucket */
+static double hdr_value(const StatsSketch *s, int index)
+{
+    int sub = s->u.hdr.sub_buckets;
+    int exponent = s->u.hdr.min_exponent + index / sub;
+    double mantissa = 0.5 + ((index % sub) + 0.5) / (2.0 * sub);
+    return ldexp(mantissa, exponent);
+}
+
+static double hdr_lower(const StatsSketch *s, int index)
+{
+    int sub = s->u.hdr.sub_buckets;
+    return ldexp(0.5 + (index % sub) / (2.0 * sub), s->u.hdr.min_exponent + index / sub);
+}
+
+/*
+ * stats_add_number: Record value count times in a histogram or digest
+ *
+ * NaN is ignored.
+ */
+void stats_add_number(StatsSketch *s, double value, uint64_t count)
+{
+    if (value != value || !count)
+        return;
+    switch (s->kind)
+    {
+    case STATS_HISTOGRAM:
+    {
+        double slot = floor((value - s->u.histogram.min) / s->u.histogram.width);
+        int index = slot < 0 ? 0 : slot >= s->u.histogram.buckets ? s->u.histogram.buckets - 1 : (int)slot;
+        s->u.histogram.counts[index] += count;
+        break;
+    }
+    case STATS_HDR:
+        if (value <= 0.0)
+            s->u.hdr.zeros += count;
+        else
+            s->u.hdr.counts[hdr_index(s, value)] += count;
+        break;
+    case STATS_TDIGEST:
+        if (value < s->u.digest.min)
+            s->u.digest.min = value;
+        if (value > s->u.digest.max)
+            s->u.digest.max = value;
+        s->u.digest.buffer[s->u.digest.buffered].mean = value;
+        s->u.digest.buffer[s->u.digest.buffered].weight = (double)count;
+        s->total += (double)count;
+        if (++s->u.digest.buffered == s->u.digest.buffer_capacity)
+            digest_flush(s);
+        return;
+    default:
+        return;
+    }
+    s->total += (double)count;
+}
+
+/*
+ * stats_add_hash: Record a key (by its 64-bit hash) in a HyperLogLog or count-min sketch
+ */
+void stats_add_hash(StatsSketch *s, uint64_t hash, uint64_t count)
+{
+    if (!count)
+        return;
+    if (s->kind == STATS_HLL)
+    {
+        int p = s->u.hll.precision;
+        uint64_t index = hash >> (64 - p);
+        uint64_t rest = hash << p;
+        // rank of the first set bit in the remaining 64 - p bits
+        int rank = rest ? __builtin_clzll(rest) + 1 : 64 - p + 1;
+        if (rank > s->u.hll.registers[index])
+            s->u.hll.registers[index] = (uint8_t)rank;
+    }
+    else if (s->kind == STATS_COUNTMIN)
+    {
+        // double hashing: row i uses h1 + i * h2
+        uint64_t h1 = hash & 0xffffffffULL;
+        uint64_t h2 = (hash >> 32) | 1;
+        for (int i = 0; i < s->u.cms.depth; i++)
+            s->u.cms.counters[(size_t)i * s->u.cms.width + (h1 + i * h2) % s->u.cms.width] += count;
+    }
+    else
+        return;
+    s->total += (double)count;
+}
+
+/* ---- queries ---- */
+
+static double hll_estimate(const StatsSketch *s)
+{
+    int m = 1 << s->u.hll.precision;
+    double sum = 0.0;
+    int zeros = 0;
+    for (int i = 0; i < m; i++)
+    {
+        sum += ldexp(1.0, -s->u.hll.registers[i]);
+        zeros += s->u.hll.registers[i] == 0;
+    }
+    double alpha = m == 16 ? 0.673 : m == 32 ? 0.697 : m == 64 ? 0.709 : 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * (double)m / sum;
+    // small cardinalities: linear counting over the empty registers
+    if (estimate <= 2.5 * m && zeros)
+        estimate = m * log((double)m / zeros);
+    return estimate;
+}
+
+/*
+ * stats_count: Values recorded, or the distinct-count estimate for HyperLogLog
+ */
+double stats_count(const StatsSketch *s)
+{
+    if (s->kind == STATS_HLL)
+        return hll_estimate(s);
+    return s->total;
+}
+
+/*
+ * stats_sketch_percentile: Estimate the p-th percentile (0..100)
+ *
+ * Histograms report the position within the bucket, interpolated linearly
+ * (HDR buckets report their midpoint). Returns NaN for empty sketches and
+ * for sketches that do not track values.
+ */
+double stats_sketch_percentile(StatsSketch *s, double p)
+{
+    if (p < 0.0)
+        p = 0.0;
+    if (p > 100.0)
+        p = 100.0;
+    if (s->kind == STATS_TDIGEST)
+        return digest_percentile(s, p);
+    if ((s->kind != STATS_HISTOGRAM && s->kind != STATS_HDR) || s->total <= 0.0)
+        return NAN;
+
+    // the first bucket whose cumulative count reaches the rank
+    double rank = p / 100.0 * s->total;
+    double seen = 0.0;
+    if (s->kind == STATS_HDR)
+    {
+        seen = (double)s->u.hdr.zeros;
+        if (rank <= seen && seen > 0.0)
+            return 0.0;
+        for (int i = 0; i < s->u.hdr.buckets; i++)
+        {
+            seen += (double)s->u.hdr.counts[i];
+            if (s->u.hdr.counts[i] && seen >= rank)
+                return hdr_value(s, i);
+        }
+        return NAN;
+    }
+    for (int i = 0; i < s->u.histogram.buckets; i++)
+    {
+        double c = (double)s->u.histogram.counts[i];
+        if (c > 0.0 && seen + c >= rank)
+            return s->u.histogram.min + s->u.histogram.width * (i + (rank - seen) / c);
+        seen += c;
+    }
+    return s->u.histogram.min + s->u.histogram.width * s->u.histogram.buckets;
+}
+
+/*
+ * stats_estimate: Estimated number of times a key was added to a count-min sketch
+ */
+double stats_estimate(const StatsSketch *s, uint64_t hash)
+{
+    if (s->kind != STATS_COUNTMIN)
+        return NAN;
+    uint64_t h1 = hash & 0xffffffffULL;
+    uint64_t h2 = (hash >> 32) | 1;
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < s->u.cms.depth; i++)
+    {
+        uint64_t c = s->u.cms.counters[(size_t)i * s->u.cms.width + (h1 + i * h2) % s->u.cms.width];
+        if (c < best)
+            best = c;
+    }
+    return (double)best;
+}
+
+/*
+ * stats_buckets: Lower bounds and counts of a histogram's buckets
+ *
+ * Fixed histograms report every bucket; HDR histograms report only the
+ * non-empty ones (values at or below zero as a bucket starting at 0).
+ * Returns: The number of buckets; the arrays are allocated for the caller
+ */
+int stats_buckets(const StatsSketch *s, double **lower, uint64_t **counts)
+{
+    int n = 0;
+    *lower = NULL;
+    *counts = NULL;
+    if (s->kind == STATS_HISTOGRAM)
+    {
+        n = s->u.histogram.buckets;
+        *lower = memory_allocate(sizeof(double) * n);
+        *counts = memory_allocate(sizeof(uint64_t) * n);
+        for (int i = 0; i < n; i++)
+        {
+            (*lower)[i] = s->u.histogram.min + s->u.histogram.width * i;
+            (*counts)[i] = s->u.histogram.counts[i];
+        }
+    }
+    else if (s->kind == STATS_HDR)
+    {
+        int used = s->u.hdr.zeros ? 1 : 0;
+        for (int i = 0; i < s->u.hdr.buckets; i++)
+            used += s->u.hdr.counts[i] != 0;
+        *lower = memory_allocate(sizeof(double) * (used + 1));
+        *counts = memory_allocate(sizeof(uint64_t) * (used + 1));
+        if (s->u.hdr.zeros)
+        {
+            (*lower)[n] = 0.0;
+            (*counts)[n++] = s->u.hdr.zeros;
+        }
+        for (int i = 0; i < s->u.hdr.buckets; i++)
+        {
+            if (s->u.hdr.counts[i])
+            {
+                (*lower)[n] = hdr_lower(s, i);
+                (*counts)[n++] = s->u.hdr.counts[i];
+            }
+        }
+    }
+    return n;
+}
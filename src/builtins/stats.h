@@ -0,0 +1,46 @@
+#ifndef SHARPSCRIPT_STATS_H
+#define SHARPSCRIPT_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Streaming statistics behind system.stats.*: exact percentiles by
+ * quickselect, and bounded-memory summaries that are updated one value at a
+ * time. A sketch is shared by reference (VAL_SKETCH) so updates made through
+ * any copy of the value are seen by all of them.
+ */
+typedef enum
+{
+    STATS_HISTOGRAM, // fixed-width buckets between a minimum and a maximum
+    STATS_HDR,       // log-linear buckets with bounded relative error
+    STATS_TDIGEST,   // merging t-digest for quantiles
+    STATS_HLL,       // HyperLogLog distinct count
+    STATS_COUNTMIN   // count-min frequency estimates
+} StatsKind;
+
+typedef struct StatsSketch StatsSketch;
+
+double stats_percentile(double *values, int count, double p);
+
+StatsSketch *stats_histogram_create(double min, double max, int buckets);
+StatsSketch *stats_hdr_create(double lowest, double highest, int digits);
+StatsSketch *stats_tdigest_create(double compression);
+StatsSketch *stats_hll_create(int precision);
+StatsSketch *stats_countmin_create(int width, int depth);
+StatsSketch *stats_retain(StatsSketch *s);
+void stats_release(StatsSketch *s);
+
+StatsKind stats_kind(const StatsSketch *s);
+const char *stats_kind_name(const StatsSketch *s);
+int stats_takes_numbers(const StatsSketch *s);
+
+void stats_add_number(StatsSketch *s, double value, uint64_t count);
+void stats_add_hash(StatsSketch *s, uint64_t hash, uint64_t count);
+
+double stats_count(const StatsSketch *s);
+double stats_sketch_percentile(StatsSketch *s, double p);
+double stats_estimate(const StatsSketch *s, uint64_t hash);
+int stats_buckets(const StatsSketch *s, double **lower, uint64_t **counts);
+
+#endif
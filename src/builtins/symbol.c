@@ -0,0 +1,62 @@
+#include "symbol.h"
+#include "hash.h"
+#include "../include/memory.h"
+#include <string.h>
+
+#define SYMBOL_MIN_SLOTS 64
+
+static Symbol **slots; // power-of-two table, NULL for empty
+static size_t slot_count;
+static size_t symbols;
+
+static void symbol_grow(void)
+{
+    size_t count = slot_count ? slot_count * 2 : SYMBOL_MIN_SLOTS;
+    Symbol **grown = memory_allocate(count * sizeof(Symbol *));
+    memset(grown, 0, count * sizeof(Symbol *));
+    for (size_t i = 0; i < slot_count; i++)
+    {
+        if (!slots[i])
+            continue;
+        size_t at = slots[i]->hash & (count - 1);
+        while (grown[at])
+            at = (at + 1) & (count - 1);
+        grown[at] = slots[i];
+    }
+    memory_free(slots);
+    slots = grown;
+    slot_count = count;
+}
+
+/*
+ * The symbol for a name, created on first use
+ *
+ * @param name: Name without the leading colon (copied)
+ * @return: The one Symbol for that name
+ */
+const Symbol *symbol_intern(const char *name)
+{
+    size_t length = strlen(name);
+    uint64_t hash = hash_xxh64(name, length, 0);
+    if ((symbols + 1) * 4 > slot_count * 3) // keep the load under 3/4
+        symbol_grow();
+    size_t at = hash & (slot_count - 1);
+    for (; slots[at]; at = (at + 1) & (slot_count - 1))
+    {
+        Symbol *s = slots[at];
+        if (s->hash == hash && s->length == length && memcmp(s->name, name, length) == 0)
+            return s;
+    }
+    Symbol *s = memory_allocate(sizeof(Symbol));
+    s->name = memory_strdup(name);
+    s->length = length;
+    s->hash = hash;
+    slots[at] = s;
+    symbols++;
+    return s;
+}
+
+size_t symbol_count(void)
+{
+    return symbols;
+}
@@ -0,0 +1,25 @@
+#ifndef SHARPSCRIPT_SYMBOL_H
+#define SHARPSCRIPT_SYMBOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Interned names behind VAL_SYMBOL (:name literals). Every name maps to
+ * one Symbol for the life of the process, so two symbols are equal
+ * exactly when their pointers are, and a symbol value owns nothing.
+ * The table is open addressing (linear probing) over xxHash64 and is
+ * never shrunk; symbols are meant for the fixed vocabulary of a script
+ * (tags, states, map keys), not for text read at run time.
+ */
+typedef struct Symbol
+{
+    const char *name;
+    size_t length;
+    uint64_t hash;
+} Symbol;
+
+const Symbol *symbol_intern(const char *name);
+size_t symbol_count(void);
+
+#endif
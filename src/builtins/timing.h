@@ -0,0 +1,12 @@
+#ifndef SHARPSCRIPT_TIMING_H
+#define SHARPSCRIPT_TIMING_H
+
+#include <stdint.h>
+
+/*
+ * Monotonic clock behind system.clock and system.bench: nanoseconds since an
+ * arbitrary fixed point, unaffected by changes to the wall clock.
+ */
+uint64_t timing_now_ns(void);
+
+#endif
@@ -0,0 +1,237 @@
+#include "units.h"
+#include "hash.h"
+#include "../include/memory.h"
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define UNITS_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define UNITS_SIMD_AVX
+#include <immintrin.h>
+#endif
+
+typedef enum
+{
+    DIM_LENGTH,
+    DIM_MASS,
+    DIM_TEMPERATURE,
+    DIM_TIME,
+    DIM_VOLUME,
+    DIM_SPEED,
+    DIM_DATA
+} UnitDimension;
+
+typedef struct
+{
+    const char *name;
+    UnitDimension dimension;
+    double scale;   // base units per unit
+    double inverse; // units per base unit (kept separately so exact ratios stay exact)
+    double offset;
+    int user;       // defined from a script (name is owned)
+} UnitDef;
+
+/*
+ * Built-in units. The base units are m, kg, C, s, l, m/s and B. Inverses of
+ * zero are filled in as 1 / scale.
+ */
+static UnitDef builtin_units[] = {
+    {"m", DIM_LENGTH, 1.0, 1.0, 0.0, 0},
+    {"km", DIM_LENGTH, 1000.0, 0.001, 0.0, 0},
+    {"cm", DIM_LENGTH, 0.01, 100.0, 0.0, 0},
+    {"mm", DIM_LENGTH, 0.001, 1000.0, 0.0, 0},
+    {"mi", DIM_LENGTH, 1609.344, 0.0, 0.0, 0},
+    {"yd", DIM_LENGTH, 0.9144, 0.0, 0.0, 0},
+    {"ft", DIM_LENGTH, 0.3048, 0.0, 0.0, 0},
+    {"in", DIM_LENGTH, 0.0254, 0.0, 0.0, 0},
+    {"nmi", DIM_LENGTH, 1852.0, 0.0, 0.0, 0},
+    {"kg", DIM_MASS, 1.0, 1.0, 0.0, 0},
+    {"g", DIM_MASS, 0.001, 1000.0, 0.0, 0},
+    {"mg", DIM_MASS, 0.000001, 1000000.0, 0.0, 0},
+    {"t", DIM_MASS, 1000.0, 0.001, 0.0, 0},
+    {"lb", DIM_MASS, 1.0 / 2.20462, 2.20462, 0.0, 0},
+    {"oz", DIM_MASS, 1.0 / 35.27396, 35.27396, 0.0, 0},
+    {"C", DIM_TEMPERATURE, 1.0, 1.0, 0.0, 0},
+    {"F", DIM_TEMPERATURE, 5.0 / 9.0, 9.0 / 5.0, -160.0 / 9.0, 0},
+    {"K", DIM_TEMPERATURE, 1.0, 1.0, -273.15, 0},
+    {"s", DIM_TIME, 1.0, 1.0, 0.0, 0},
+    {"ms", DIM_TIME, 0.001, 1000.0, 0.0, 0},
+    {"min", DIM_TIME, 60.0, 0.0, 0.0, 0},
+    {"h", DIM_TIME, 3600.0, 0.0, 0.0, 0},
+    {"day", DIM_TIME, 86400.0, 0.0, 0.0, 0},
+    {"l", DIM_VOLUME, 1.0, 1.0, 0.0, 0},
+    {"ml", DIM_VOLUME, 0.001, 1000.0, 0.0, 0},
+    {"gal", DIM_VOLUME, 3.785411784, 0.0, 0.0, 0},
+    {"m/s", DIM_SPEED, 1.0, 1.0, 0.0, 0},
+    {"km/h", DIM_SPEED, 1.0 / 3.6, 3.6, 0.0, 0},
+    {"mph", DIM_SPEED, 0.44704, 0.0, 0.0, 0},
+    {"B", DIM_DATA, 1.0, 1.0, 0.0, 0},
+    {"KB", DIM_DATA, 1024.0, 0.0, 0.0, 0},
+    {"MB", DIM_DATA, 1048576.0, 0.0, 0.0, 0},
+    {"GB", DIM_DATA, 1073741824.0, 0.0, 0.0, 0},
+};
+
+/* Open addressing table of every known unit, built on first use */
+static UnitDef **unit_table = NULL;
+static int unit_count = 0;
+static int unit_capacity = 0;
+
+static UnitDef **units_slot(const char *name)
+{
+    unsigned long mask = (unsigned long)unit_capacity - 1;
+    unsigned long i = hash_string(name) & mask;
+    while (unit_table[i] && strcmp(unit_table[i]->name, name) != 0)
+        i = (i + 1) & mask;
+    return &unit_table[i];
+}
+
+static void units_grow(void)
+{
+    UnitDef **old = unit_table;
+    int old_capacity = unit_capacity;
+    unit_capacity = old_capacity ? old_capacity * 2 : 128;
+    unit_table = memory_allocate(sizeof(UnitDef *) * unit_capacity);
+    memset(unit_table, 0, sizeof(UnitDef *) * unit_capacity);
+    for (int i = 0; i < old_capacity; i++)
+    {
+        if (old[i])
+            *units_slot(old[i]->name) = old[i];
+    }
+    memory_free(old);
+}
+
+static void units_insert(UnitDef *unit)
+{
+    // keep the load factor below one half
+    if ((unit_count + 1) * 2 > unit_capacity)
+        units_grow();
+    UnitDef **slot = units_slot(unit->name);
+    if (!*slot)
+        unit_count++;
+    else if ((*slot)->user)
+    {
+        memory_free((char *)(*slot)->name);
+        memory_free(*slot);
+    }
+    *slot = unit;
+}
+
+static void units_init(void)
+{
+    if (unit_table)
+        return;
+    for (size_t i = 0; i < sizeof(builtin_units) / sizeof(builtin_units[0]); i++)
+    {
+        if (builtin_units[i].inverse == 0.0)
+            builtin_units[i].inverse = 1.0 / builtin_units[i].scale;
+        units_insert(&builtin_units[i]);
+    }
+}
+
+static UnitDef *units_find(const char *name)
+{
+    units_init();
+    return *units_slot(name);
+}
+
+/*
+ * units_conversion: Compose the affine map between two units
+ *
+ * Going through the base unit, from -> base is x * scale + offset and
+ * base -> to is (x - offset) * inverse, which folds into y = x * a + b.
+ *
+ * Returns: 1 if both units exist and share a dimension, 0 otherwise
+ */
+int units_conversion(const char *from, const char *to, double *a, double *b)
+{
+    UnitDef *f = units_find(from);
+    UnitDef *t = units_find(to);
+    if (!f || !t || f->dimension != t->dimension)
+        return 0;
+    *a = f->scale * t->inverse;
+    *b = (f->offset - t->offset) * t->inverse;
+    return 1;
+}
+
+#ifdef UNITS_SIMD_AVX
+__attribute__((target("avx")))
+static int units_convert_avx(const double *in, double *out, int count, double a, double b)
+{
+    __m256d va = _mm256_set1_pd(a);
+    __m256d vb = _mm256_set1_pd(b);
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(in + i), va), vb));
+    return i;
+}
+#endif
+
+/*
+ * units_convert_array: Apply y = x * a + b to a block of numbers
+ *
+ * Multiply and add stay separate operations (no fused multiply-add), so the
+ * vector paths give exactly the same results as the scalar one.
+ */
+void units_convert_array(const double *in, double *out, int count, double a, double b)
+{
+    int i = 0;
+#ifdef UNITS_SIMD_AVX
+    if (__builtin_cpu_supports("avx"))
+        i = units_convert_avx(in, out, count, a, b);
+#endif
+#ifdef UNITS_SIMD_SSE2
+    __m128d va = _mm_set1_pd(a);
+    __m128d vb = _mm_set1_pd(b);
+    for (; i + 2 <= count; i += 2)
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(in + i), va), vb));
+#endif
+    for (; i < count; i++)
+        out[i] = in[i] * a + b;
+}
+
+/*
+ * units_define: Add (or replace) a unit as 1 name = scale base + offset
+ *
+ * The new unit joins the base unit's dimension; its mapping to the dimension
+ * base is composed from the base unit's own mapping.
+ *
+ * Returns: 1 on success, 0 if base is unknown, scale is zero, or name is built in
+ */
+int units_define(const char *name, const char *base, double scale, double offset)
+{
+    UnitDef *b = units_find(base);
+    UnitDef *existing = units_find(name);
+    if (!b || scale == 0.0 || (existing && !existing->user))
+        return 0;
+    UnitDef *unit = memory_allocate(sizeof(UnitDef));
+    unit->name = memory_strdup(name);
+    unit->dimension = b->dimension;
+    unit->scale = b->scale * scale;
+    unit->inverse = b->inverse / scale;
+    unit->offset = b->scale * offset + b->offset;
+    unit->user = 1;
+    units_insert(unit);
+    return 1;
+}
+
+/*
+ * units_reset: Drop script-defined units and the lookup table
+ */
+void units_reset(void)
+{
+    for (int i = 0; i < unit_capacity; i++)
+    {
+        if (unit_table[i] && unit_table[i]->user)
+        {
+            memory_free((char *)unit_table[i]->name);
+            memory_free(unit_table[i]);
+        }
+    }
+    memory_free(unit_table);
+    unit_table = NULL;
+    unit_count = 0;
+    unit_capacity = 0;
+}
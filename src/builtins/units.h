@@ -0,0 +1,14 @@
+#ifndef SHARPSCRIPT_UNITS_H
+#define SHARPSCRIPT_UNITS_H
+
+/*
+ * Unit registry behind system.convert. Every unit belongs to a dimension and
+ * maps to the dimension's base unit as base = value * scale + offset, so a
+ * conversion between two units is a single affine map y = x * a + b.
+ */
+int units_conversion(const char *from, const char *to, double *a, double *b);
+void units_convert_array(const double *in, double *out, int count, double a, double b);
+int units_define(const char *name, const char *base, double scale, double offset);
+void units_reset(void);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef SHARPSCRIPT_VECMATH_H
+#define SHARPSCRIPT_VECMATH_H
+
+/*
+ * Elementwise math over arrays of doubles, used when the system.sin ...
+ * system.pow builtins receive an array.
+ */
+typedef enum
+{
+    VECMATH_SIN,
+    VECMATH_COS,
+    VECMATH_TAN,
+    VECMATH_ASIN,
+    VECMATH_ACOS,
+    VECMATH_ATAN,
+    VECMATH_LOG10,
+    VECMATH_LN,
+    VECMATH_EXP,
+    VECMATH_SQRT,
+    VECMATH_POW
+} VecMathOp;
+
+/* Arrays at least this long are split across threads */
+#define VECMATH_THREAD_THRESHOLD 65536
+
+double vecmath_scalar(VecMathOp op, double a, double b);
+void vecmath_apply(VecMathOp op, const double *a, int a_step, const double *b, int b_step, double *out, int count);
+
+#endif
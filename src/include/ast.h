@@ -34,7 +34,9 @@ typedef enum
     AST_LAMBDA,
     AST_MATCH,
     AST_TRY_CATCH,
-    AST_FOR_IN
+    AST_FOR_IN,
+    AST_INCLUDE, // placeholder for an include being parsed in parallel, replaced before evaluation
+    AST_SYMBOL   // :name literal
 } ASTNodeType;
 
 typedef struct ASTNode
@@ -45,6 +47,10 @@ typedef struct ASTNode
         struct
         {
             double value;
+            long long integer; // exact value of integer literals
+            int is_integer;
+            char *text;        // digits of a bigint (suffix n) or decimal (suffix m) literal
+            int is_decimal;
         } number;
         struct
         {
@@ -107,6 +113,8 @@ typedef struct ASTNode
             char *name;
             struct ASTNode **args;
             int arg_count;
+            struct NativeEntry *native; // resolved on first call
+            unsigned native_generation; // registry generation native came from
         } call;
         struct
         {
@@ -178,10 +186,21 @@ typedef struct ASTNode
             struct ASTNode *collection;
             struct ASTNode *body;
         } for_in;
+        struct
+        {
+            char *path;
+        } include;
+        struct
+        {
+            char *name;
+            const struct Symbol *interned; // resolved on first evaluation
+        } symbol;
     } data;
 } ASTNode;
 
 ASTNode *ast_create_number(double value);
+ASTNode *ast_create_integer(long long value);
+ASTNode *ast_create_bignum(const char *text, int is_decimal);
 ASTNode *ast_create_string(const char *value);
 ASTNode *ast_create_boolean(int value);
 ASTNode *ast_create_null(void);
@@ -208,6 +227,8 @@ ASTNode *ast_create_lambda(char **params, int param_count, ASTNode *body);
 ASTNode *ast_create_match(ASTNode *expr, ASTNode **cases, ASTNode **bodies, int case_count, ASTNode *default_case);
 ASTNode *ast_create_try_catch(ASTNode *try_block, const char *error_var, ASTNode *catch_block, ASTNode *finally_block);
 ASTNode *ast_create_for_in(const char *var, ASTNode *collection, ASTNode *body);
+ASTNode *ast_create_include(const char *path);
+ASTNode *ast_create_symbol(const char *name);
 
 void ast_free(ASTNode *node);
 
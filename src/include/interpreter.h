@@ -21,7 +21,19 @@ typedef enum
     VAL_BREAK,
     VAL_CONTINUE,
     VAL_RETURN,
-    VAL_ERROR
+    VAL_ERROR,
+    VAL_INT,   // 64-bit integer; arithmetic promotes to VAL_NUMBER on overflow
+    VAL_BIGNUM, // arbitrary-precision integer or decimal (see builtins/bignum.h)
+    VAL_MATRIX, // dense matrix of doubles, shared by reference (see builtins/matrix.h)
+    VAL_SKETCH, // histogram or streaming sketch, shared by reference (see builtins/stats.h)
+    VAL_SET,    // hash set of numbers and strings, shared by reference (see builtins/set.h)
+    VAL_ORDMAP, // B+tree map sorted by key, shared by reference (see builtins/ordmap.h)
+    VAL_HEAP,   // binary heap priority queue, shared by reference (see builtins/heap.h)
+    VAL_DEQUE,  // ring buffer double-ended queue, shared by reference (see builtins/deque.h)
+    VAL_BITSET, // compressed bitset, shared by reference (see builtins/bitset.h)
+    VAL_BUFFER, // view of a byte block, shared by reference (see builtins/buffer.h)
+    VAL_LINES,  // lines of a (possibly compressed) file, read lazily (see builtins/io.h)
+    VAL_SYMBOL  // interned :name, compared by pointer (see builtins/symbol.h)
 } ValueType;
 
 typedef struct Value
@@ -30,6 +42,18 @@ typedef struct Value
     union
     {
         double number;
+        long long integer;
+        struct BigNum *bignum;
+        struct Matrix *matrix;
+        struct StatsSketch *sketch;
+        struct SetTable *set;
+        struct OrderedMap *ordmap;
+        struct Heap *heap;
+        struct Deque *deque;
+        struct Bitset *bitset;
+        struct Buffer *buffer;
+        struct LineReader *lines;
+        const struct Symbol *symbol;
         char *string;
         int boolean;
         struct
@@ -94,17 +118,55 @@ typedef struct Environment
     struct Environment *parent;
 } Environment;
 
+/* Bounded command history: a ring buffer, oldest entry at head */
+#define HISTORY_DEFAULT_CAPACITY 1000
+
+typedef struct
+{
+    Value **entries; // allocated on first add
+    int head;
+    int count;
+    int capacity;    // maximum number of entries kept
+} History;
+
 typedef struct
 {
     Environment *global;
     Environment *current;
     jmp_buf jmp_buf;
     Value *current_error;
+    int redefine; // redeclarations replace existing variables (watch mode reloads)
+    History history;
+    struct CalcMemory *memory; // system.store/system.recall values
+    struct RandomState *random; // system.random state, per interpreter
 } Interpreter;
 
 Interpreter *interpreter_create(void);
 void interpreter_free(Interpreter *interp);
 Value *interpreter_eval(Interpreter *interp, ASTNode *node);
+Value *value_create_number(double num);
+Value *value_create_int(long long num);
+Value *value_create_bignum(struct BigNum *num);
+Value *value_create_matrix(struct Matrix *m);
+Value *value_create_sketch(struct StatsSketch *s);
+Value *value_create_set(struct SetTable *s);
+Value *value_create_ordmap(struct OrderedMap *m);
+Value *value_create_heap(struct Heap *h);
+Value *value_create_deque(struct Deque *d);
+Value *value_create_bitset(struct Bitset *b);
+Value *value_create_buffer(struct Buffer *b);
+Value *value_create_lines(struct LineReader *r);
+Value *value_create_symbol(const struct Symbol *s);
+int value_is_number(Value *val);
+double value_as_number(Value *val);
+Value *value_create_string(const char *str);
+Value *value_create_boolean(int b);
+Value *value_create_null(void);
+Value *value_create_array(void);
+Value *value_create_map(void);
+void value_array_push(Value *arr, Value *elem);
+void value_map_set(Value *map, const char *key, Value *value);
+Value *value_clone(Value *val);
 void value_free(Value *val);
 void env_declare(Environment *env, const char *name, Value *value, int is_const);
 void throw_error(Interpreter *interp, Value *error);
@@ -75,6 +75,7 @@ typedef enum
     TOKEN_NULL,
     TOKEN_INCLUDE,
     TOKEN_INVOLVE,
+    TOKEN_INVOLVE_NATIVE,
     TOKEN_MATCH,
     TOKEN_CASE,
     TOKEN_DEFAULT,
@@ -82,6 +83,13 @@ typedef enum
     TOKEN_CATCH,
     TOKEN_FINALLY,
     TOKEN_IN,
+    TOKEN_BIT_AND, // &
+    TOKEN_BIT_OR,  // |
+    TOKEN_BIT_XOR, // ^
+    TOKEN_BIT_NOT, // ~
+    TOKEN_SHL,     // <<
+    TOKEN_SHR,     // >>
+    TOKEN_SYMBOL,  // :name
     TOKEN_EOF,
     TOKEN_ERROR
 } TokenType;
@@ -101,6 +109,7 @@ typedef struct
     int line;
     int column;
     int length;
+    TokenType previous; // last token returned, to tell :name from a colon
 } Lexer;
 
 Lexer *lexer_create(const char *source);
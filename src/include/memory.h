@@ -7,5 +7,6 @@ void* memory_allocate(size_t size);
 void* memory_reallocate(void* ptr, size_t size);
 void memory_free(void* ptr);
 char* memory_strdup(const char* str);
+size_t memory_allocation_count(void);
 
 #endif // MEMORY_H
\ No newline at end of file
@@ -4,17 +4,30 @@
 #include "lexer.h"
 #include "ast.h"
 
-typedef struct
+// Tokens the parser can look past current_token (power of two)
+#define PARSER_LOOKAHEAD 4
+
+typedef struct Parser
 {
     Lexer *lexer;
     Token *current_token;
+    Token *lookahead[PARSER_LOOKAHEAD]; // ring buffer of tokens lexed ahead of current_token
+    int lookahead_head;
+    int lookahead_count;
     char **include_paths;
     int include_count;
     int include_capacity;
+    struct Parser *parent; // parser of the including file, NULL for the root
+    struct IncludeCache *cache; // set while includes are parsed in parallel
+    ASTNode **deferred;         // include placeholders in the order they were parsed
+    int deferred_count;
+    int deferred_capacity;
 } Parser;
 
 Parser *parser_create(Lexer *lexer);
 void parser_free(Parser *parser);
 ASTNode *parser_parse(Parser *parser);
+ASTNode *parser_parse_parallel(Parser *parser);
+void parser_add_include(Parser *parser, const char *path);
 
 #endif // PARSER_H
\ No newline at end of file
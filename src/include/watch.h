@@ -0,0 +1,11 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+/*
+ * Run a script, then keep the interpreter alive and reload the script or any
+ * file it includes whenever one of them changes on disk. memory_file (may be
+ * NULL) is attached as the calculator memory store.
+ */
+void watch_run(const char *filename, const char *memory_file);
+
+#endif // WATCH_H
@@ -26,15 +26,94 @@
 #include "builtins/io.h"
 #include "builtins/docs.h"
 #include "builtins/errors.h"
+#include "builtins/native.h"
+#include "builtins/calcmem.h"
+#include "builtins/units.h"
+#include "builtins/vecmath.h"
+#include "builtins/bignum.h"
+#include "builtins/matrix.h"
+#include "builtins/stats.h"
+#include "builtins/random.h"
+#include "builtins/timing.h"
+#include "builtins/set.h"
+#include "builtins/ordmap.h"
+#include "builtins/heap.h"
+#include "builtins/deque.h"
+#include "builtins/bitset.h"
+#include "builtins/buffer.h"
+#include "builtins/hash.h"
+#include "builtins/compress.h"
+#include "builtins/encoding.h"
+#include "builtins/datetime.h"
+#include "builtins/symbol.h"
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 
-/* Global variables for interpreter state management */
-static Environment *calc_mem = NULL; /* Calculator memory environment */
-static Value **history = NULL;       /* Command history storage */
-static int history_count = 0;        /* Number of commands in history */
-static int history_capacity = 0;     /* Current capacity of history array */
+/*
+ * Values pinned by a for-in loop that borrows a variable instead of copying
+ * it. Replacing or dropping a pinned value hands it to the loop (released),
+ * which frees it when it finishes, so the loop keeps iterating what it
+ * started on.
+ */
+typedef struct ValuePin
+{
+    Value *value;
+    int released;
+    struct ValuePin *next;
+} ValuePin;
+
+static ValuePin *pinned_values = NULL;
+
+static ValuePin *value_pin(Value *value)
+{
+    ValuePin *pin = memory_allocate(sizeof(ValuePin));
+    pin->value = value;
+    pin->released = 0;
+    pin->next = pinned_values;
+    pinned_values = pin;
+    return pin;
+}
+
+/*
+ * Free a value a variable no longer holds, unless a loop has it pinned
+ */
+static void value_release(Value *value)
+{
+    int pinned = 0;
+    for (ValuePin *pin = pinned_values; pin; pin = pin->next)
+    {
+        if (pin->value == value)
+        {
+            pin->released = 1; // nested loops over one value all see it
+            pinned = 1;
+        }
+    }
+    if (!pinned)
+        value_free(value);
+}
+
+/*
+ * Drop pins down to (not including) stop, newest first
+ *
+ * A released value is freed with the last pin that holds it. try/catch
+ * unwinds to its saved pin list when an error skips the loops in between.
+ */
+static void value_unpin_to(ValuePin *stop)
+{
+    while (pinned_values && pinned_values != stop)
+    {
+        ValuePin *pin = pinned_values;
+        pinned_values = pin->next;
+        int held = 0;
+        for (ValuePin *other = pinned_values; other && !held; other = other->next)
+            held = other->value == pin->value;
+        if (pin->released && !held)
+            value_free(pin->value);
+        memory_free(pin);
+    }
+}
 
 /*
  * Create a new environment with optional parent scope
@@ -71,7 +150,7 @@ static void env_free(Environment *env)
     for (int i = 0; i < env->count; i++)
     {
         memory_free(env->names[i]);
-        value_free(env->values[i]);
+        value_release(env->values[i]);
         if (env->types[i])
             memory_free(env->types[i]);
     }
@@ -96,6 +175,8 @@ static const char *type_name(Value *val)
     switch (val ? val->type : VAL_NULL)
     {
     case VAL_NUMBER:
+    case VAL_INT:
+    case VAL_BIGNUM:
         return "number";
     case VAL_STRING:
         return "string";
@@ -109,6 +190,26 @@ static const char *type_name(Value *val)
         return "array";
     case VAL_MAP:
         return "map";
+    case VAL_MATRIX:
+        return "matrix";
+    case VAL_SKETCH:
+        return "sketch";
+    case VAL_SET:
+        return "set";
+    case VAL_ORDMAP:
+        return "ordmap";
+    case VAL_HEAP:
+        return "heap";
+    case VAL_DEQUE:
+        return "deque";
+    case VAL_BITSET:
+        return "bitset";
+    case VAL_BUFFER:
+        return "buffer";
+    case VAL_LINES:
+        return "lines";
+    case VAL_SYMBOL:
+        return "symbol";
     default:
         return "unknown";
     }
@@ -147,7 +248,7 @@ static void env_set(Environment *env, const char *name, Value *value)
                     return;
                 }
             }
-            value_free(env->values[i]);
+            value_release(env->values[i]);
             env->values[i] = value;
             return;
         }
@@ -257,6 +358,39 @@ void env_declare(Environment *env, const char *name, Value *value, int is_const)
     env->count++;
 }
 
+/*
+ * Declare a variable, honouring the interpreter's redefine mode
+ *
+ * @param interp: Interpreter instance
+ * @param env: Environment to declare in
+ * @param name: Variable name
+ * @param value: Initial value
+ * @param is_const: 1 for const variables, 0 for mutable
+ *
+ * In redefine mode (used when watch mode reloads a file) an existing
+ * declaration in the same environment is replaced instead of rejected.
+ */
+static void interp_declare(Interpreter *interp, Environment *env, const char *name, Value *value, int is_const)
+{
+    if (interp->redefine)
+    {
+        for (int i = 0; i < env->count; i++)
+        {
+            if (strcmp(env->names[i], name) == 0)
+            {
+                value_release(env->values[i]);
+                env->values[i] = value;
+                env->is_const[i] = is_const ? 1 : 0;
+                if (env->types[i])
+                    memory_free(env->types[i]);
+                env->types[i] = memory_strdup(type_name(value));
+                return;
+            }
+        }
+    }
+    env_declare(env, name, value, is_const);
+}
+
 /*
  * Add or update type annotation for an existing variable
  *
@@ -287,7 +421,7 @@ static void env_annotate(Environment *env, const char *name, const char *type_na
  * @param num: Numeric value
  * @return: Newly allocated Value containing the number
  */
-static Value *value_create_number(double num)
+Value *value_create_number(double num)
 {
     Value *val = memory_allocate(sizeof(Value));
     val->type = VAL_NUMBER;
@@ -295,6 +429,297 @@ static Value *value_create_number(double num)
     return val;
 }
 
+/*
+ * Create a new 64-bit integer value
+ *
+ * @param num: Integer value
+ * @return: Newly allocated Value containing the integer
+ */
+Value *value_create_int(long long num)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_INT;
+    val->data.integer = num;
+    return val;
+}
+
+/*
+ * Create a new arbitrary-precision value
+ *
+ * @param num: Big integer or decimal (ownership is taken)
+ * @return: Newly allocated Value wrapping the number
+ */
+Value *value_create_bignum(struct BigNum *num)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_BIGNUM;
+    val->data.bignum = num;
+    return val;
+}
+
+/*
+ * Create a new matrix value
+ *
+ * @param m: Matrix (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the matrix
+ */
+Value *value_create_matrix(struct Matrix *m)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_MATRIX;
+    val->data.matrix = m;
+    return val;
+}
+
+/*
+ * Create a new sketch value
+ *
+ * @param s: Sketch (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the sketch
+ */
+Value *value_create_sketch(struct StatsSketch *s)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_SKETCH;
+    val->data.sketch = s;
+    return val;
+}
+
+/*
+ * Create a new set value
+ *
+ * @param s: Set (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the set
+ */
+Value *value_create_set(struct SetTable *s)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_SET;
+    val->data.set = s;
+    return val;
+}
+
+/*
+ * Create a new ordered map value
+ *
+ * @param m: Ordered map (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the map
+ */
+Value *value_create_ordmap(struct OrderedMap *m)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_ORDMAP;
+    val->data.ordmap = m;
+    return val;
+}
+
+/*
+ * Create a new heap value
+ *
+ * @param h: Heap (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the heap
+ */
+Value *value_create_heap(struct Heap *h)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_HEAP;
+    val->data.heap = h;
+    return val;
+}
+
+/*
+ * Create a new deque value
+ *
+ * @param d: Deque (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the deque
+ */
+Value *value_create_deque(struct Deque *d)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_DEQUE;
+    val->data.deque = d;
+    return val;
+}
+
+/*
+ * Create a new bitset value
+ *
+ * @param b: Bitset (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the bitset
+ */
+Value *value_create_bitset(struct Bitset *b)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_BITSET;
+    val->data.bitset = b;
+    return val;
+}
+
+/*
+ * Create a new buffer value
+ *
+ * @param b: Buffer view (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the buffer
+ */
+Value *value_create_buffer(struct Buffer *b)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_BUFFER;
+    val->data.buffer = b;
+    return val;
+}
+
+/*
+ * Create a new lines value
+ *
+ * @param r: Line reader (the caller's reference is taken over)
+ * @return: Newly allocated Value wrapping the reader
+ */
+Value *value_create_lines(struct LineReader *r)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_LINES;
+    val->data.lines = r;
+    return val;
+}
+
+/*
+ * Create a new symbol value
+ *
+ * @param s: Interned symbol (owned by the symbol table)
+ * @return: Newly allocated Value naming the symbol
+ */
+Value *value_create_symbol(const struct Symbol *s)
+{
+    Value *val = memory_allocate(sizeof(Value));
+    val->type = VAL_SYMBOL;
+    val->data.symbol = s;
+    return val;
+}
+
+/*
+ * Convert a number or string to a set key
+ *
+ * @param val: Value to convert
+ * @param key: Set to the key; strings are borrowed from val
+ * @return: 1 on success, 0 for values that cannot be set elements
+ *
+ * Integral doubles become integer keys, so 3 and 3.0 are the same element.
+ */
+static int set_key_from_value(Value *val, SetKey *key)
+{
+    if (val->type == VAL_STRING)
+    {
+        key->kind = SET_KEY_STRING;
+        key->u.string = val->data.string;
+        return 1;
+    }
+    if (val->type == VAL_INT)
+    {
+        key->kind = SET_KEY_INT;
+        key->u.integer = val->data.integer;
+        return 1;
+    }
+    if (value_is_number(val))
+    {
+        double d = value_as_number(val);
+        if (d == floor(d) && d >= -9223372036854775808.0 && d < 9223372036854775808.0)
+        {
+            key->kind = SET_KEY_INT;
+            key->u.integer = (long long)d;
+        }
+        else
+        {
+            key->kind = SET_KEY_NUMBER;
+            key->u.number = d;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Convert a set key back to a value
+ */
+static Value *set_key_value(const SetKey *key)
+{
+    switch (key->kind)
+    {
+    case SET_KEY_INT:
+        return value_create_int(key->u.integer);
+    case SET_KEY_NUMBER:
+        return value_create_number(key->u.number);
+    default:
+        return value_create_string(key->u.string);
+    }
+}
+
+/*
+ * Check whether a value is numeric (a double, 64-bit integer or bignum)
+ */
+int value_is_number(Value *val)
+{
+    return val && (val->type == VAL_NUMBER || val->type == VAL_INT || val->type == VAL_BIGNUM);
+}
+
+/*
+ * Read a numeric value as a double
+ *
+ * @param val: Value to read (can be NULL)
+ * @return: The number, or 0 for non-numeric values
+ */
+double value_as_number(Value *val)
+{
+    if (!val)
+        return 0.0;
+    if (val->type == VAL_INT)
+        return (double)val->data.integer;
+    if (val->type == VAL_BIGNUM)
+        return bignum_to_double(val->data.bignum);
+    return val->type == VAL_NUMBER ? val->data.number : 0.0;
+}
+
+/*
+ * Read a numeric value as a 64-bit integer, truncating doubles toward zero
+ *
+ * Doubles outside the int64 range saturate instead of invoking undefined behavior.
+ */
+static long long value_as_int(Value *val)
+{
+    if (val && val->type == VAL_INT)
+        return val->data.integer;
+    double d = value_as_number(val);
+    if (d != d)
+        return 0;
+    if (d >= 9223372036854775808.0)
+        return LLONG_MAX;
+    if (d < -9223372036854775808.0)
+        return LLONG_MIN;
+    return (long long)d;
+}
+
+/*
+ * Convert a numeric value to a bignum
+ *
+ * Doubles convert through their shortest decimal form and become decimals.
+ *
+ * @return: New bignum, or NULL for non-numbers, infinities and NaN
+ */
+static BigNum *value_to_bignum(Value *val)
+{
+    switch (val->type)
+    {
+    case VAL_BIGNUM:
+        return bignum_clone(val->data.bignum);
+    case VAL_INT:
+        return bignum_from_int(val->data.integer, 0);
+    case VAL_NUMBER:
+        return bignum_from_double(val->data.number, 1);
+    default:
+        return NULL;
+    }
+}
+
 /*
  * Create a new string value
  *
@@ -303,7 +728,7 @@ static Value *value_create_number(double num)
  *
  * The input string is duplicated using memory_strdup to ensure proper memory management.
  */
-static Value *value_create_string(const char *str)
+Value *value_create_string(const char *str)
 {
     Value *val = memory_allocate(sizeof(Value));
     val->type = VAL_STRING;
@@ -324,7 +749,7 @@ static Value *value_create_string(const char *str)
  * @param b: Boolean value (0 or non-zero)
  * @return: Newly allocated Value containing the boolean
  */
-static Value *value_create_boolean(int b)
+Value *value_create_boolean(int b)
 {
     Value *val = memory_allocate(sizeof(Value));
     val->type = VAL_BOOLEAN;
@@ -339,7 +764,7 @@ static Value *value_create_boolean(int b)
  *
  * Null represents the absence of a value in SharpScript.
  */
-static Value *value_create_null(void)
+Value *value_create_null(void)
 {
     Value *val = memory_allocate(sizeof(Value));
     val->type = VAL_NULL;
@@ -371,7 +796,7 @@ static Value *value_create_function(ASTNode *func, Environment *closure)
  *
  * Arrays in SharpScript are dynamic and can hold any type of Value.
  */
-static Value *value_create_array(void)
+Value *value_create_array(void)
 {
     Value *val = memory_allocate(sizeof(Value));
     val->type = VAL_ARRAY;
@@ -389,7 +814,7 @@ static Value *value_create_array(void)
  * Maps in SharpScript store key-value pairs where keys are strings and values
  * can be any type of Value.
  */
-static Value *value_create_map(void)
+Value *value_create_map(void)
 {
     Value *val = memory_allocate(sizeof(Value));
     val->type = VAL_MAP;
@@ -400,6 +825,52 @@ static Value *value_create_map(void)
     return val;
 }
 
+/*
+ * Append a value to an array, growing its storage when needed
+ *
+ * @param arr: Array value to append to
+ * @param elem: Element to append (ownership passes to the array)
+ */
+void value_array_push(Value *arr, Value *elem)
+{
+    if (arr->data.array.count >= arr->data.array.capacity)
+    {
+        arr->data.array.capacity *= 2;
+        arr->data.array.elements = memory_reallocate(
+            arr->data.array.elements,
+            sizeof(Value *) * arr->data.array.capacity);
+    }
+    arr->data.array.elements[arr->data.array.count++] = elem;
+}
+
+/*
+ * Set a key in a map, replacing the value of an existing key
+ *
+ * @param map: Map value to update
+ * @param key: Key (copied)
+ * @param value: Value to store (ownership passes to the map)
+ */
+void value_map_set(Value *map, const char *key, Value *value)
+{
+    for (int i = 0; i < map->data.map.count; i++)
+    {
+        if (strcmp(map->data.map.keys[i], key) == 0)
+        {
+            value_free(map->data.map.values[i]);
+            map->data.map.values[i] = value;
+            return;
+        }
+    }
+    if (map->data.map.count >= map->data.map.capacity)
+    {
+        map->data.map.capacity *= 2;
+        map->data.map.keys = memory_reallocate(map->data.map.keys, sizeof(char *) * map->data.map.capacity);
+        map->data.map.values = memory_reallocate(map->data.map.values, sizeof(Value *) * map->data.map.capacity);
+    }
+    map->data.map.keys[map->data.map.count] = memory_strdup(key);
+    map->data.map.values[map->data.map.count++] = value;
+}
+
 // error creation moved to builtins/errors.c
 
 /*
@@ -414,6 +885,19 @@ static Value *value_create_map(void)
  */
 static int values_equal(Value *a, Value *b)
 {
+    if ((a->type == VAL_BIGNUM || b->type == VAL_BIGNUM) && value_is_number(a) && value_is_number(b))
+    {
+        BigNum *x = value_to_bignum(a);
+        BigNum *y = value_to_bignum(b);
+        int equal = x && y && bignum_compare(x, y) == 0;
+        bignum_free(x);
+        bignum_free(y);
+        return equal;
+    }
+    if (a->type == VAL_INT && b->type == VAL_NUMBER)
+        return (double)a->data.integer == b->data.number;
+    if (a->type == VAL_NUMBER && b->type == VAL_INT)
+        return a->data.number == (double)b->data.integer;
     if (a->type != b->type)
         return 0;
 
@@ -421,6 +905,76 @@ static int values_equal(Value *a, Value *b)
     {
     case VAL_NUMBER:
         return a->data.number == b->data.number;
+    case VAL_INT:
+        return a->data.integer == b->data.integer;
+    case VAL_MATRIX:
+        return a->data.matrix == b->data.matrix ||
+               (a->data.matrix->rows == b->data.matrix->rows && a->data.matrix->cols == b->data.matrix->cols &&
+                memcmp(a->data.matrix->data, b->data.matrix->data,
+                       sizeof(double) * (size_t)a->data.matrix->rows * a->data.matrix->cols) == 0);
+    case VAL_SKETCH:
+        // Sketches are shared, so copies of one sketch are equal
+        return a->data.sketch == b->data.sketch;
+    case VAL_SET:
+    {
+        // Sets are equal when they hold the same elements, in any order
+        if (set_count(a->data.set) != set_count(b->data.set))
+            return 0;
+        SetKey key;
+        int cursor = 0;
+        while (set_next(a->data.set, &cursor, &key))
+        {
+            if (!set_contains(b->data.set, &key))
+                return 0;
+        }
+        return 1;
+    }
+    case VAL_ORDMAP:
+    {
+        // Ordered maps are equal when their sorted entries match pairwise
+        if (ordmap_count(a->data.ordmap) != ordmap_count(b->data.ordmap))
+            return 0;
+        OrderedCursor ca, cb;
+        SetKey ka, kb;
+        void *va, *vb;
+        ordmap_first(a->data.ordmap, &ca);
+        ordmap_first(b->data.ordmap, &cb);
+        while (ordmap_entry(&ca, &ka, &va) && ordmap_entry(&cb, &kb, &vb))
+        {
+            if (ordmap_compare(&ka, &kb) != 0 || !values_equal(va, vb))
+                return 0;
+            ordmap_next(&ca);
+            ordmap_next(&cb);
+        }
+        return 1;
+    }
+    case VAL_HEAP:
+        // Heaps are shared, so copies of one heap are equal
+        return a->data.heap == b->data.heap;
+    case VAL_DEQUE:
+    {
+        int count = deque_count(a->data.deque);
+        if (count != deque_count(b->data.deque))
+            return 0;
+        for (int i = 0; i < count; i++)
+        {
+            if (!values_equal(deque_get(a->data.deque, i), deque_get(b->data.deque, i)))
+                return 0;
+        }
+        return 1;
+    }
+    case VAL_BITSET:
+        return bitset_equal(a->data.bitset, b->data.bitset);
+    case VAL_BUFFER:
+    {
+        size_t length = buffer_length(a->data.buffer);
+        return length == buffer_length(b->data.buffer) &&
+               memcmp(buffer_data(a->data.buffer), buffer_data(b->data.buffer), length) == 0;
+    }
+    case VAL_LINES:
+        return a->data.lines == b->data.lines;
+    case VAL_SYMBOL:
+        return a->data.symbol == b->data.symbol;
     case VAL_STRING:
         return strcmp(a->data.string, b->data.string) == 0;
     case VAL_BOOLEAN:
@@ -509,6 +1063,36 @@ void value_free(Value *val)
     case VAL_STRING:
         memory_free(val->data.string);
         break;
+    case VAL_BIGNUM:
+        bignum_free(val->data.bignum);
+        break;
+    case VAL_MATRIX:
+        matrix_release(val->data.matrix);
+        break;
+    case VAL_SKETCH:
+        stats_release(val->data.sketch);
+        break;
+    case VAL_SET:
+        set_release(val->data.set);
+        break;
+    case VAL_ORDMAP:
+        ordmap_release(val->data.ordmap);
+        break;
+    case VAL_HEAP:
+        heap_release(val->data.heap);
+        break;
+    case VAL_DEQUE:
+        deque_release(val->data.deque);
+        break;
+    case VAL_BITSET:
+        bitset_release(val->data.bitset);
+        break;
+    case VAL_BUFFER:
+        buffer_release(val->data.buffer);
+        break;
+    case VAL_LINES:
+        io_lines_release(val->data.lines);
+        break;
     case VAL_ERROR:
         if (val->data.error.name)
             memory_free(val->data.error.name);
@@ -562,11 +1146,30 @@ static int value_is_truthy(Value *val)
         return val->data.boolean;
     if (val->type == VAL_NUMBER)
         return val->data.number != 0;
+    if (val->type == VAL_INT)
+        return val->data.integer != 0;
+    if (val->type == VAL_BIGNUM)
+        return !bignum_is_zero(val->data.bignum);
     if (val->type == VAL_STRING)
         return strlen(val->data.string) > 0;
     return 1;
 }
 
+/*
+ * Print a double without a decimal part when it is integral
+ */
+static void number_print(double num)
+{
+    if (floor(num) == num)
+    {
+        printf("%.0f", num);
+    }
+    else
+    {
+        printf("%g", num);
+    }
+}
+
 /*
  * Print a value to stdout
  *
@@ -591,15 +1194,109 @@ static void value_print(Value *val)
     switch (val->type)
     {
     case VAL_NUMBER:
-        if (floor(val->data.number) == val->data.number)
-        {
-            printf("%.0f", val->data.number);
+        number_print(val->data.number);
+        break;
+    case VAL_MATRIX:
+    {
+        Matrix *m = val->data.matrix;
+        printf("[");
+        for (int i = 0; i < m->rows; i++)
+        {
+            printf(i ? ", [" : "[");
+            for (int j = 0; j < m->cols; j++)
+            {
+                if (j)
+                    printf(", ");
+                number_print(m->data[(size_t)i * m->cols + j]);
+            }
+            printf("]");
         }
-        else
+        printf("]");
+        break;
+    }
+    case VAL_SET:
+    {
+        SetKey key;
+        int cursor = 0, first = 1;
+        printf("{");
+        while (set_next(val->data.set, &cursor, &key))
+        {
+            Value *element = set_key_value(&key);
+            printf(first ? "" : ", ");
+            value_print(element);
+            value_free(element);
+            first = 0;
+        }
+        printf("}"); // Print sets as {elem1, elem2, ...}
+        break;
+    }
+    case VAL_ORDMAP:
+    {
+        OrderedCursor cursor;
+        SetKey key;
+        void *value;
+        printf("{");
+        for (ordmap_first(val->data.ordmap, &cursor); ordmap_entry(&cursor, &key, &value); ordmap_next(&cursor))
+        {
+            if (key.kind == SET_KEY_STRING)
+                printf("\"%s\": ", key.u.string);
+            else
+            {
+                Value *k = set_key_value(&key);
+                value_print(k);
+                value_free(k);
+                printf(": ");
+            }
+            value_print(value);
+            OrderedCursor after = cursor;
+            ordmap_next(&after);
+            if (after.leaf)
+                printf(", ");
+        }
+        printf("}"); // Print ordered maps as {key: value, ...} in key order
+        break;
+    }
+    case VAL_HEAP:
+        printf("<heap: %d values>", heap_count(val->data.heap));
+        break;
+    case VAL_DEQUE:
+        printf("[");
+        for (int i = 0; i < deque_count(val->data.deque); i++)
         {
-            printf("%g", val->data.number);
+            if (i)
+                printf(", ");
+            value_print(deque_get(val->data.deque, i));
         }
+        printf("]"); // Print deques like arrays, front first
+        break;
+    case VAL_BITSET:
+        printf("<bitset: %llu bits set>", (unsigned long long)bitset_count(val->data.bitset));
+        break;
+    case VAL_BUFFER:
+        printf("<buffer: %zu bytes>", buffer_length(val->data.buffer));
+        break;
+    case VAL_LINES:
+        printf("<lines: %s>", io_lines_path(val->data.lines));
+        break;
+    case VAL_SYMBOL:
+        printf(":%s", val->data.symbol->name);
         break;
+    case VAL_SKETCH:
+        if (stats_kind(val->data.sketch) == STATS_HLL)
+            printf("<hll: ~%.0f distinct>", stats_count(val->data.sketch));
+        else
+            printf("<%s: %.0f values>", stats_kind_name(val->data.sketch), stats_count(val->data.sketch));
+        break;
+    case VAL_INT:
+        printf("%lld", val->data.integer);
+        break;
+    case VAL_BIGNUM:
+    {
+        char *text = bignum_to_string(val->data.bignum);
+        printf("%s", text);
+        memory_free(text);
+        break;
+    }
     case VAL_STRING:
         printf("%s", val->data.string);
         break;
@@ -653,7 +1350,7 @@ static void value_print(Value *val)
  * - Maps: recursively clones all values and duplicates keys
  * - Other types: shallow copy of the value structure
  */
-static Value *value_clone(Value *val)
+Value *value_clone(Value *val)
 {
     if (!val)
         return NULL;
@@ -664,6 +1361,36 @@ static Value *value_clone(Value *val)
     case VAL_STRING:
         copy->data.string = memory_strdup(val->data.string);
         break;
+    case VAL_BIGNUM:
+        copy->data.bignum = bignum_clone(val->data.bignum);
+        break;
+    case VAL_MATRIX:
+        copy->data.matrix = matrix_retain(val->data.matrix);
+        break;
+    case VAL_SKETCH:
+        copy->data.sketch = stats_retain(val->data.sketch);
+        break;
+    case VAL_SET:
+        copy->data.set = set_retain(val->data.set);
+        break;
+    case VAL_ORDMAP:
+        copy->data.ordmap = ordmap_retain(val->data.ordmap);
+        break;
+    case VAL_HEAP:
+        copy->data.heap = heap_retain(val->data.heap);
+        break;
+    case VAL_DEQUE:
+        copy->data.deque = deque_retain(val->data.deque);
+        break;
+    case VAL_BITSET:
+        copy->data.bitset = bitset_retain(val->data.bitset);
+        break;
+    case VAL_BUFFER:
+        copy->data.buffer = buffer_retain(val->data.buffer);
+        break;
+    case VAL_LINES:
+        copy->data.lines = io_lines_retain(val->data.lines);
+        break;
     case VAL_ERROR:
         copy->data.error.name = val->data.error.name ? memory_strdup(val->data.error.name) : NULL;
         copy->data.error.message = val->data.error.message ? memory_strdup(val->data.error.message) : NULL;
@@ -702,6 +1429,71 @@ static Value *value_clone(Value *val)
     }
     return copy;
 }
+/*
+ * History ring buffer
+ *
+ * Entries live in a fixed-size circular array owned by the interpreter:
+ * adding is O(1) and, once the capacity is reached, overwrites the oldest
+ * entry. Logical index 0 is the oldest entry still kept.
+ */
+static Value *history_at(History *h, int index)
+{
+    return h->entries[(h->head + index) % h->capacity];
+}
+
+static void history_add(History *h, Value *v)
+{
+    if (h->capacity <= 0)
+    {
+        value_free(v);
+        return;
+    }
+    if (!h->entries)
+        h->entries = memory_allocate(sizeof(Value *) * h->capacity);
+    if (h->count < h->capacity)
+    {
+        h->entries[(h->head + h->count) % h->capacity] = v;
+        h->count++;
+        return;
+    }
+    // full: the new entry takes the oldest one's slot
+    value_free(h->entries[h->head]);
+    h->entries[h->head] = v;
+    h->head = (h->head + 1) % h->capacity;
+}
+
+static void history_clear(History *h)
+{
+    for (int i = 0; i < h->count; i++)
+        value_free(history_at(h, i));
+    h->head = 0;
+    h->count = 0;
+}
+
+/*
+ * history_resize: Change the capacity, keeping the newest entries that fit
+ */
+static void history_resize(History *h, int capacity)
+{
+    if (capacity < 0)
+        capacity = 0;
+    int keep = h->count < capacity ? h->count : capacity;
+    Value **entries = NULL;
+    if (h->entries && capacity > 0)
+    {
+        entries = memory_allocate(sizeof(Value *) * capacity);
+        for (int i = 0; i < keep; i++)
+            entries[i] = history_at(h, h->count - keep + i);
+    }
+    for (int i = 0; i < h->count - keep; i++)
+        value_free(history_at(h, i));
+    memory_free(h->entries);
+    h->entries = entries;
+    h->head = 0;
+    h->count = entries ? keep : 0;
+    h->capacity = capacity;
+}
+
 /*
     "get rect microsoft" -- my friend
 */
@@ -720,10 +1512,13 @@ Interpreter *interpreter_create(void)
     Interpreter *interp = memory_allocate(sizeof(Interpreter));
     interp->global = env_create(NULL);
     interp->current = interp->global;
-    calc_mem = env_create(NULL);
-    history_capacity = 16;
-    history_count = 0;
-    history = memory_allocate(sizeof(Value *) * history_capacity);
+    interp->redefine = 0;
+    interp->memory = calcmem_create();
+    interp->random = random_create();
+    interp->history.entries = NULL;
+    interp->history.head = 0;
+    interp->history.count = 0;
+    interp->history.capacity = HISTORY_DEFAULT_CAPACITY;
     return interp;
 }
 
@@ -736,18 +1531,337 @@ Interpreter *interpreter_create(void)
  */
 void interpreter_free(Interpreter *interp)
 {
-    for (int i = 0; i < history_count; i++)
-    {
-        value_free(history[i]);
-    }
-    memory_free(history);
-    env_free(calc_mem);
+    history_clear(&interp->history);
+    memory_free(interp->history.entries);
+    calcmem_free(interp->memory);
+    random_free(interp->random);
+    units_reset();
     env_free(interp->global);
+    native_registry_free();
     memory_free(interp);
 }
 
 static Value *eval_node(Interpreter *interp, ASTNode *node);
 
+/*
+ * Evaluate an operand that is only read, without copying a variable
+ *
+ * @param owned: Set to 1 if the result is a temporary the caller must free,
+ *               0 if it is the variable's own value (which must not be kept
+ *               past anything that could reassign the variable)
+ * @return: The operand's value
+ *
+ * Reading a variable through eval_node deep-copies it, which makes a loop
+ * over a[i] quadratic; callers that only look inside a container borrow it.
+ */
+static Value *eval_borrowed(Interpreter *interp, ASTNode *node, int *owned)
+{
+    if (node->type == AST_IDENTIFIER)
+    {
+        Value *val = env_get(interp->current, node->data.identifier.name);
+        if (val)
+        {
+            *owned = 0;
+            return val;
+        }
+    }
+    *owned = 1;
+    return eval_node(interp, node);
+}
+
+/*
+ * Apply an arithmetic or comparison operator with at least one bignum operand
+ *
+ * @return: Newly allocated result, or NULL to fall back to double arithmetic
+ *          (division by zero, non-finite or non-numeric operands)
+ */
+static Value *bignum_op(TokenType op, Value *left, Value *right)
+{
+    BigNum *a = value_to_bignum(left);
+    BigNum *b = value_to_bignum(right);
+    BigNum *r = NULL;
+    Value *result = NULL;
+    if (a && b)
+    {
+        switch (op)
+        {
+        case TOKEN_ADD:
+            r = bignum_add(a, b);
+            break;
+        case TOKEN_SUB:
+            r = bignum_sub(a, b);
+            break;
+        case TOKEN_MUL:
+            r = bignum_mul(a, b);
+            break;
+        case TOKEN_DIV:
+            r = bignum_div(a, b);
+            break;
+        case TOKEN_MOD:
+            r = bignum_mod(a, b);
+            break;
+        case TOKEN_LT:
+            result = value_create_boolean(bignum_compare(a, b) < 0);
+            break;
+        case TOKEN_GT:
+            result = value_create_boolean(bignum_compare(a, b) > 0);
+            break;
+        case TOKEN_LTE:
+            result = value_create_boolean(bignum_compare(a, b) <= 0);
+            break;
+        case TOKEN_GTE:
+            result = value_create_boolean(bignum_compare(a, b) >= 0);
+            break;
+        default:
+            break;
+        }
+    }
+    if (r)
+        result = value_create_bignum(r);
+    bignum_free(a);
+    bignum_free(b);
+    return result;
+}
+
+/*
+ * Apply an arithmetic operator with at least one matrix operand
+ *
+ * @return: Newly allocated result; null for mismatched shapes or operators
+ *          matrices do not support
+ *
+ * + and - work elementwise on equal shapes, * between two matrices is the
+ * matrix product, and a number combines with every element for +, -, * and /.
+ */
+static Value *matrix_op(TokenType op, Value *left, Value *right)
+{
+    MatrixOp mop;
+    switch (op)
+    {
+    case TOKEN_ADD:
+        mop = MATRIX_ADD;
+        break;
+    case TOKEN_SUB:
+        mop = MATRIX_SUB;
+        break;
+    case TOKEN_MUL:
+        mop = MATRIX_MUL;
+        break;
+    case TOKEN_DIV:
+        mop = MATRIX_DIV;
+        break;
+    default:
+        return value_create_null();
+    }
+
+    if (left->type == VAL_MATRIX && right->type == VAL_MATRIX)
+    {
+        Matrix *a = left->data.matrix;
+        Matrix *b = right->data.matrix;
+        if (mop == MATRIX_MUL)
+        {
+            if (a->cols != b->rows)
+                return value_create_null();
+            Matrix *c = matrix_create(a->rows, b->cols);
+            matrix_multiply(a, b, c);
+            return value_create_matrix(c);
+        }
+        if (mop == MATRIX_DIV || a->rows != b->rows || a->cols != b->cols)
+            return value_create_null();
+        Matrix *c = matrix_create(a->rows, a->cols);
+        matrix_combine(mop, a->data, 1, b->data, 1, c->data, a->rows * a->cols);
+        return value_create_matrix(c);
+    }
+
+    // matrix with a number on either side
+    Value *mv = left->type == VAL_MATRIX ? left : right;
+    Value *other = left->type == VAL_MATRIX ? right : left;
+    if (!value_is_number(other))
+        return value_create_null();
+    Matrix *m = mv->data.matrix;
+    double scalar = value_as_number(other);
+    Matrix *c = matrix_create(m->rows, m->cols);
+    if (mv == left)
+        matrix_combine(mop, m->data, 1, &scalar, 0, c->data, m->rows * m->cols);
+    else
+        matrix_combine(mop, &scalar, 0, m->data, 1, c->data, m->rows * m->cols);
+    return value_create_matrix(c);
+}
+
+/*
+ * Apply a bitwise operator to two bitsets
+ *
+ * @return: New bitset for &, |, ^ and - (bits of left not in right); null
+ *          for other operators
+ */
+static Value *bitset_op(TokenType op, Value *left, Value *right)
+{
+    BitsetOp bop;
+    switch (op)
+    {
+    case TOKEN_BIT_AND:
+        bop = BITSET_AND;
+        break;
+    case TOKEN_BIT_OR:
+        bop = BITSET_OR;
+        break;
+    case TOKEN_BIT_XOR:
+        bop = BITSET_XOR;
+        break;
+    case TOKEN_SUB:
+        bop = BITSET_ANDNOT;
+        break;
+    default:
+        return value_create_null();
+    }
+    return value_create_bitset(bitset_combine(bop, left->data.bitset, right->data.bitset));
+}
+
+/*
+ * Apply an arithmetic, comparison or bitwise operator to two numbers
+ *
+ * @param op: Operator token
+ * @param left: Left operand (not freed)
+ * @param right: Right operand (not freed)
+ * @return: Newly allocated result, or null for operators this does not handle
+ *
+ * Matrix operands go to matrix_op and pairs of bitsets to bitset_op. A
+ * bignum operand makes the operation
+ * exact (see bignum_op). When both operands are integers, +, - and * stay
+ * integers unless the result overflows 64 bits, / stays an integer only when
+ * the division is exact, and comparisons are exact. Everything else is computed in double precision.
+ * Bitwise operators truncate their operands to integers; shift counts are
+ * taken modulo 64.
+ */
+static Value *numeric_op(TokenType op, Value *left, Value *right)
+{
+    if (left->type == VAL_MATRIX || right->type == VAL_MATRIX)
+        return matrix_op(op, left, right);
+    if (left->type == VAL_BITSET && right->type == VAL_BITSET)
+        return bitset_op(op, left, right);
+
+    switch (op)
+    {
+    case TOKEN_BIT_AND:
+        return value_create_int(value_as_int(left) & value_as_int(right));
+    case TOKEN_BIT_OR:
+        return value_create_int(value_as_int(left) | value_as_int(right));
+    case TOKEN_BIT_XOR:
+        return value_create_int(value_as_int(left) ^ value_as_int(right));
+    case TOKEN_SHL:
+        return value_create_int((long long)((unsigned long long)value_as_int(left) << (value_as_int(right) & 63)));
+    case TOKEN_SHR:
+        return value_create_int(value_as_int(left) >> (value_as_int(right) & 63));
+    default:
+        break;
+    }
+
+    if (left->type == VAL_BIGNUM || right->type == VAL_BIGNUM)
+    {
+        Value *result = bignum_op(op, left, right);
+        if (result)
+            return result;
+    }
+
+    if (left->type == VAL_INT && right->type == VAL_INT)
+    {
+        long long a = left->data.integer;
+        long long b = right->data.integer;
+        long long r;
+        switch (op)
+        {
+        case TOKEN_ADD:
+            if (!__builtin_add_overflow(a, b, &r))
+                return value_create_int(r);
+            break;
+        case TOKEN_SUB:
+            if (!__builtin_sub_overflow(a, b, &r))
+                return value_create_int(r);
+            break;
+        case TOKEN_MUL:
+            if (!__builtin_mul_overflow(a, b, &r))
+                return value_create_int(r);
+            break;
+        case TOKEN_DIV:
+            if (b != 0 && !(a == LLONG_MIN && b == -1) && a % b == 0)
+                return value_create_int(a / b);
+            break;
+        case TOKEN_MOD:
+            if (b != 0)
+                return value_create_int(b == -1 ? 0 : a % b);
+            break;
+        case TOKEN_LT:
+            return value_create_boolean(a < b);
+        case TOKEN_GT:
+            return value_create_boolean(a > b);
+        case TOKEN_LTE:
+            return value_create_boolean(a <= b);
+        case TOKEN_GTE:
+            return value_create_boolean(a >= b);
+        default:
+            break;
+        }
+    }
+
+    double a = value_as_number(left);
+    double b = value_as_number(right);
+    switch (op)
+    {
+    case TOKEN_ADD:
+        return value_create_number(a + b);
+    case TOKEN_SUB:
+        return value_create_number(a - b);
+    case TOKEN_MUL:
+        return value_create_number(a * b);
+    case TOKEN_DIV:
+        return value_create_number(a / b);
+    case TOKEN_MOD:
+        return value_create_number(fmod(a, b));
+    case TOKEN_LT:
+        return value_create_boolean(a < b);
+    case TOKEN_GT:
+        return value_create_boolean(a > b);
+    case TOKEN_LTE:
+        return value_create_boolean(a <= b);
+    case TOKEN_GTE:
+        return value_create_boolean(a >= b);
+    default:
+        return value_create_null();
+    }
+}
+
+/*
+ * Convert an operand of string concatenation to text
+ *
+ * @param val: Operand value
+ * @return: Newly allocated text (numbers, booleans and null are formatted)
+ */
+static char *concat_operand_text(Value *val)
+{
+    char buffer[64];
+    switch (val->type)
+    {
+    case VAL_STRING:
+        return memory_strdup(val->data.string);
+    case VAL_SYMBOL:
+        return memory_strdup(val->data.symbol->name);
+    case VAL_BIGNUM:
+        return bignum_to_string(val->data.bignum);
+    case VAL_NUMBER:
+        snprintf(buffer, sizeof(buffer), "%g", val->data.number);
+        break;
+    case VAL_INT:
+        snprintf(buffer, sizeof(buffer), "%lld", val->data.integer);
+        break;
+    case VAL_BOOLEAN:
+        strcpy(buffer, val->data.boolean ? "true" : "false");
+        break;
+    default:
+        strcpy(buffer, "null");
+        break;
+    }
+    return memory_strdup(buffer);
+}
+
 /*
  * Evaluate a binary operation node
  *
@@ -760,6 +1874,7 @@ static Value *eval_node(Interpreter *interp, ASTNode *node);
  * - Subtraction, multiplication, division, modulo
  * - Comparison operations (==, !=, <, <=, >, >=)
  * - Logical operations (&&, ||)
+ * - Bitwise operations (&, |, ^, <<, >>)
  *
  * For addition, supports automatic string conversion for mixed types.
  */
@@ -773,96 +1888,57 @@ static Value *eval_binary_op(Interpreter *interp, ASTNode *node)
         /* String concatenation: if either operand is a string, convert both to strings */
         if (left->type == VAL_STRING || right->type == VAL_STRING)
         {
-            char buffer[1024];
-            char left_str[512], right_str[512];
-
-            /* Convert left operand to string */
-            if (left->type == VAL_STRING)
-                strcpy(left_str, left->data.string);
-            else if (left->type == VAL_NUMBER)
-                sprintf(left_str, "%g", left->data.number);
-            else if (left->type == VAL_BOOLEAN)
-                strcpy(left_str, left->data.boolean ? "true" : "false");
-            else
-                strcpy(left_str, "null");
-
-            /* Convert right operand to string */
-            if (right->type == VAL_STRING)
-                strcpy(right_str, right->data.string);
-            else if (right->type == VAL_NUMBER)
-                sprintf(right_str, "%g", right->data.number);
-            else if (right->type == VAL_BOOLEAN)
-                strcpy(right_str, right->data.boolean ? "true" : "false");
-            else
-                strcpy(right_str, "null");
+            char *left_str = concat_operand_text(left);
+            char *right_str = concat_operand_text(right);
 
             /* Concatenate and return result */
-            sprintf(buffer, "%s%s", left_str, right_str);
+            size_t left_len = strlen(left_str);
+            char *buffer = memory_allocate(left_len + strlen(right_str) + 1);
+            memcpy(buffer, left_str, left_len);
+            strcpy(buffer + left_len, right_str);
             Value *result = value_create_string(buffer);
+            memory_free(buffer);
+            memory_free(left_str);
+            memory_free(right_str);
             value_free(left);
             value_free(right);
             return result;
         }
 
         /* Numeric addition */
-        double result = left->data.number + right->data.number;
-        value_free(left);
-        value_free(right);
-        return value_create_number(result);
-    }
-
-    if (node->data.binary_op.op == TOKEN_SUB)
-    {
-        /* Numeric subtraction */
-        double result = left->data.number - right->data.number;
-        value_free(left);
-        value_free(right);
-        return value_create_number(result);
-    }
-
-    if (node->data.binary_op.op == TOKEN_MUL)
-    {
-        /* Numeric multiplication */
-        double result = left->data.number * right->data.number;
-        value_free(left);
-        value_free(right);
-        return value_create_number(result);
-    }
-
-    if (node->data.binary_op.op == TOKEN_DIV)
-    {
-        /* Numeric division */
-        double result = left->data.number / right->data.number;
+        Value *result = numeric_op(TOKEN_ADD, left, right);
         value_free(left);
         value_free(right);
-        return value_create_number(result);
-    }
-
-    if (node->data.binary_op.op == TOKEN_MOD)
-    {
-        /* Numeric modulo (remainder) operation */
-        double result = fmod(left->data.number, right->data.number);
-        value_free(left);
-        value_free(right);
-        return value_create_number(result);
+        return result;
     }
 
     if (node->data.binary_op.op == TOKEN_EQ)
     {
         /* Equality comparison: supports numbers, strings, and booleans */
         int result = 0;
-        if (left->type == VAL_NUMBER && right->type == VAL_NUMBER)
+        if (value_is_number(left) && value_is_number(right))
         {
-            result = left->data.number == right->data.number;
+            result = values_equal(left, right);
         }
         else if (left->type == VAL_STRING && right->type == VAL_STRING)
         {
             result = strcmp(left->data.string, right->data.string) == 0;
         }
+        else if (left->type == VAL_SYMBOL && right->type == VAL_SYMBOL)
+        {
+            result = left->data.symbol == right->data.symbol;
+        }
         else if (left->type == VAL_BOOLEAN && right->type == VAL_BOOLEAN)
         {
             result = left->data.boolean == right->data.boolean;
         }
+        else if ((left->type == VAL_MATRIX || left->type == VAL_SET || left->type == VAL_ORDMAP ||
+                  left->type == VAL_HEAP || left->type == VAL_DEQUE || left->type == VAL_BITSET ||
+                  left->type == VAL_BUFFER || left->type == VAL_LINES) &&
+                 right->type == left->type)
+        {
+            result = values_equal(left, right);
+        }
         value_free(left);
         value_free(right);
         return value_create_boolean(result);
@@ -872,54 +1948,29 @@ static Value *eval_binary_op(Interpreter *interp, ASTNode *node)
     {
         /* Not-equal comparison: supports numbers, strings, and booleans */
         int result = 1;
-        if (left->type == VAL_NUMBER && right->type == VAL_NUMBER)
+        if (value_is_number(left) && value_is_number(right))
         {
-            result = left->data.number != right->data.number;
+            result = !values_equal(left, right);
         }
         else if (left->type == VAL_STRING && right->type == VAL_STRING)
         {
             result = strcmp(left->data.string, right->data.string) != 0;
         }
+        else if (left->type == VAL_SYMBOL && right->type == VAL_SYMBOL)
+        {
+            result = left->data.symbol != right->data.symbol;
+        }
         else if (left->type == VAL_BOOLEAN && right->type == VAL_BOOLEAN)
         {
             result = left->data.boolean != right->data.boolean;
         }
-        value_free(left);
-        value_free(right);
-        return value_create_boolean(result);
-    }
-
-    if (node->data.binary_op.op == TOKEN_LT)
-    {
-        /* Less-than comparison: numeric only */
-        int result = left->data.number < right->data.number;
-        value_free(left);
-        value_free(right);
-        return value_create_boolean(result);
-    }
-
-    if (node->data.binary_op.op == TOKEN_GT)
-    {
-        /* Greater-than comparison: numeric only */
-        int result = left->data.number > right->data.number;
-        value_free(left);
-        value_free(right);
-        return value_create_boolean(result);
-    }
-
-    if (node->data.binary_op.op == TOKEN_LTE)
-    {
-        /* Less-than-or-equal comparison: numeric only */
-        int result = left->data.number <= right->data.number;
-        value_free(left);
-        value_free(right);
-        return value_create_boolean(result);
-    }
-
-    if (node->data.binary_op.op == TOKEN_GTE)
-    {
-        /* Greater-than-or-equal comparison: numeric only */
-        int result = left->data.number >= right->data.number;
+        else if ((left->type == VAL_MATRIX || left->type == VAL_SET || left->type == VAL_ORDMAP ||
+                  left->type == VAL_HEAP || left->type == VAL_DEQUE || left->type == VAL_BITSET ||
+                  left->type == VAL_BUFFER || left->type == VAL_LINES) &&
+                 right->type == left->type)
+        {
+            result = !values_equal(left, right);
+        }
         value_free(left);
         value_free(right);
         return value_create_boolean(result);
@@ -943,405 +1994,2986 @@ static Value *eval_binary_op(Interpreter *interp, ASTNode *node)
         return value_create_boolean(result);
     }
 
+    /* Arithmetic, ordering and bitwise operators */
+    Value *result = numeric_op(node->data.binary_op.op, left, right);
     value_free(left);
     value_free(right);
-    return value_create_null();
+    return result;
 }
 
 /*
- * Evaluate a built-in function call
+ * Build a matrix from an array of row arrays
+ *
+ * @param val: Array of equally long arrays (or a flat array, read as one row)
+ * @return: New matrix (non-numbers read as 0), or NULL for ragged or non-array input
+ */
+static Matrix *matrix_from_value(Value *val)
+{
+    if (val->type == VAL_MATRIX)
+        return matrix_retain(val->data.matrix);
+    if (val->type != VAL_ARRAY)
+        return NULL;
+    int rows = val->data.array.count;
+    if (rows == 0 || val->data.array.elements[0]->type != VAL_ARRAY)
+    {
+        Matrix *m = matrix_create(1, rows);
+        for (int j = 0; j < rows; j++)
+            m->data[j] = value_as_number(val->data.array.elements[j]);
+        return m;
+    }
+    int cols = val->data.array.elements[0]->data.array.count;
+    for (int i = 0; i < rows; i++)
+    {
+        Value *row = val->data.array.elements[i];
+        if (row->type != VAL_ARRAY || row->data.array.count != cols)
+            return NULL;
+    }
+    Matrix *m = matrix_create(rows, cols);
+    for (int i = 0; i < rows; i++)
+    {
+        Value **row = val->data.array.elements[i]->data.array.elements;
+        for (int j = 0; j < cols; j++)
+            m->data[(size_t)i * cols + j] = value_as_number(row[j]);
+    }
+    return m;
+}
+
+/*
+ * Convert one row of a matrix to an array of numbers
+ */
+static Value *matrix_row_array(Matrix *m, int row)
+{
+    Value *arr = value_create_array();
+    for (int j = 0; j < m->cols; j++)
+        value_array_push(arr, value_create_number(m->data[(size_t)row * m->cols + j]));
+    return arr;
+}
+
+/*
+ * Gather the numbers of a math builtin operand
+ *
+ * @param v: Number or array operand
+ * @param count: Set to the element count for arrays
+ * @return: Newly allocated buffer (non-numbers read as 0.0)
+ */
+static double *math_operand(Value *v, int *count)
+{
+    if (v->type != VAL_ARRAY)
+    {
+        double *one = memory_allocate(sizeof(double));
+        one[0] = value_as_number(v);
+        *count = 1;
+        return one;
+    }
+    *count = v->data.array.count;
+    double *numbers = memory_allocate(sizeof(double) * (*count + 1));
+    for (int i = 0; i < *count; i++)
+    {
+        Value *e = v->data.array.elements[i];
+        numbers[i] = value_as_number(e);
+    }
+    return numbers;
+}
+
+/*
+ * Apply a math builtin to evaluated operands
+ *
+ * @param op: Function to apply
+ * @param a: First operand (number or array)
+ * @param b: Second operand for system.pow, NULL otherwise
+ * @return: A number, or an array when either operand is an array
+ *
+ * With two array operands the result has the length of the shorter one; a
+ * number paired with an array is applied to every element.
+ */
+static Value *eval_math(VecMathOp op, Value *a, Value *b)
+{
+    int a_array = a->type == VAL_ARRAY;
+    int b_array = b && b->type == VAL_ARRAY;
+    if (!a_array && !b_array)
+    {
+        double av = value_as_number(a);
+        double bv = value_as_number(b);
+        return value_create_number(vecmath_scalar(op, av, bv));
+    }
+
+    int a_count, b_count = 0;
+    double *an = math_operand(a, &a_count);
+    double *bn = b ? math_operand(b, &b_count) : NULL;
+    int count = a_array ? a_count : b_count;
+    if (a_array && b_array && b_count < count)
+        count = b_count;
+
+    double *out = memory_allocate(sizeof(double) * (count + 1));
+    vecmath_apply(op, an, a_array ? 1 : 0, bn, b_array ? 1 : 0, out, count);
+
+    Value *result = value_create_array();
+    for (int i = 0; i < count; i++)
+        value_array_push(result, value_create_number(out[i]));
+    memory_free(an);
+    memory_free(bn);
+    memory_free(out);
+    return result;
+}
+
+/*
+ * Get the parameter list of a named function or lambda node
+ */
+static char **function_params(ASTNode *fn, int *count)
+{
+    if (fn->type == AST_LAMBDA)
+    {
+        *count = fn->data.lambda.param_count;
+        return fn->data.lambda.params;
+    }
+    *count = fn->data.function.param_count;
+    return fn->data.function.params;
+}
+
+/*
+ * Call a function value with evaluated arguments
  *
  * @param interp: Interpreter instance
- * @param name: Built-in function name
- * @param args: Array of argument AST nodes
- * @param arg_count: Number of arguments
- * @return: Result of the built-in function
+ * @param func: Function value (named function or lambda)
+ * @param args: Argument values, owned by the call afterwards
+ * @param arg_count: Number of arguments (extra arguments are freed)
+ * @return: The returned value; a lambda with an expression body returns its value
  *
- * Handles system built-in functions including print, output, help, and error.
+ * Missing arguments take the parameter's default, evaluated in the caller's
+ * environment, or null.
  */
-static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args, int arg_count)
+static Value *call_function(Interpreter *interp, Value *func, Value **args, int arg_count)
 {
-    if (strcmp(name, "system.print") == 0)
+    ASTNode *func_node = func->data.function.function;
+    int param_count;
+    char **params = function_params(func_node, &param_count);
+    ASTNode **defaults = func_node->type == AST_LAMBDA ? NULL : func_node->data.function.defaults;
+    ASTNode *body = func_node->type == AST_LAMBDA ? func_node->data.lambda.body : func_node->data.function.body;
+    Environment *func_env = env_create(func->data.function.closure);
+
+    for (int i = 0; i < param_count; i++)
     {
-        /* Print arguments to stdout with spaces between them */
-        for (int i = 0; i < arg_count; i++)
+        if (i < arg_count)
+            env_set(func_env, params[i], args[i]);
+        else if (defaults && defaults[i])
+            env_set(func_env, params[i], eval_node(interp, defaults[i]));
+        else
+            env_set(func_env, params[i], value_create_null());
+    }
+    for (int i = param_count; i < arg_count; i++)
+        value_free(args[i]);
+
+    Environment *saved_env = interp->current;
+    interp->current = func_env;
+    Value *result = eval_node(interp, body);
+    interp->current = saved_env;
+    env_free(func_env);
+
+    if (result->type == VAL_RETURN)
+    {
+        Value *ret_val = result->data.return_val.value;
+        result->data.return_val.value = NULL;
+        value_free(result);
+        return ret_val ? ret_val : value_create_null();
+    }
+    if (func_node->type == AST_LAMBDA && body->type != AST_BLOCK)
+        return result;
+    value_free(result);
+    return value_create_null();
+}
+
+/*
+ * Add a number or string, or every element of an array, to a set
+ *
+ * @return: Number of elements that were new (other values are skipped)
+ */
+static int set_add_value(SetTable *s, Value *val)
+{
+    SetKey key;
+    if (val->type != VAL_ARRAY)
+        return set_key_from_value(val, &key) ? set_add(s, &key) : 0;
+    int added = 0;
+    for (int i = 0; i < val->data.array.count; i++)
+    {
+        if (set_key_from_value(val->data.array.elements[i], &key))
+            added += set_add(s, &key);
+    }
+    return added;
+}
+
+/*
+ * Get a set operand: a set (shared) or an array (converted)
+ *
+ * @return: A set reference for the caller to release, or NULL for other values
+ */
+static SetTable *set_from_value(Value *val)
+{
+    if (val->type == VAL_SET)
+        return set_retain(val->data.set);
+    if (val->type != VAL_ARRAY)
+        return NULL;
+    SetTable *s = set_create(val->data.array.count);
+    set_add_value(s, val);
+    return s;
+}
+
+/* Free callback for the values held by an ordered map */
+static void ordmap_value_free(void *value)
+{
+    value_free(value);
+}
+
+/*
+ * Convert a number or string to an ordered map key (NaN has no place in the order)
+ */
+static int ordmap_key_from_value(Value *val, SetKey *key)
+{
+    return set_key_from_value(val, key) && !(key->kind == SET_KEY_NUMBER && key->u.number != key->u.number);
+}
+
+/*
+ * Build the {"key": k, "value": v} map used for ordered map entries (as for-in over maps does)
+ */
+static Value *ordmap_entry_value(const SetKey *key, Value *value)
+{
+    Value *pair = value_create_map();
+    value_map_set(pair, "key", set_key_value(key));
+    value_map_set(pair, "value", value_clone(value));
+    return pair;
+}
+
+/*
+ * Build an ordered map from a value
+ *
+ * @param val: A map (string keys), an array of [key, value] pairs, or an ordered map (copied)
+ * @return: New ordered map; entries with unusable keys are skipped
+ */
+static OrderedMap *ordmap_from_value(Value *val)
+{
+    OrderedMap *m = ordmap_create(ordmap_value_free);
+    SetKey key;
+    if (val->type == VAL_MAP)
+    {
+        for (int i = 0; i < val->data.map.count; i++)
         {
-            Value *val = eval_node(interp, args[i]);
-            value_print(val);
-            value_free(val);
-            if (i < arg_count - 1)
-                printf(" ");
+            key.kind = SET_KEY_STRING;
+            key.u.string = val->data.map.keys[i];
+            ordmap_set(m, &key, value_clone(val->data.map.values[i]));
         }
-        printf("\n");
-        return value_create_null();
     }
+    else if (val->type == VAL_ARRAY)
+    {
+        for (int i = 0; i < val->data.array.count; i++)
+        {
+            Value *pair = val->data.array.elements[i];
+            if (pair->type == VAL_ARRAY && pair->data.array.count >= 2 &&
+                ordmap_key_from_value(pair->data.array.elements[0], &key))
+                ordmap_set(m, &key, value_clone(pair->data.array.elements[1]));
+        }
+    }
+    else if (val->type == VAL_ORDMAP)
+    {
+        OrderedCursor cursor;
+        void *value;
+        for (ordmap_first(val->data.ordmap, &cursor); ordmap_entry(&cursor, &key, &value); ordmap_next(&cursor))
+            ordmap_set(m, &key, value_clone(value));
+    }
+    return m;
+}
 
-    if (strcmp(name, "system.output") == 0)
+/* Free callback for the values held by heaps and deques */
+static void container_value_free(void *value)
+{
+    value_free(value);
+}
+
+/* Free callback for a temporary heap that only borrows its values */
+static void borrowed_value_free(void *value)
+{
+    (void)value;
+}
+
+/*
+ * Natural order of two values: numbers, then strings, then arrays
+ * (compared element by element); anything else ties
+ *
+ * @return: Negative, zero or positive like strcmp
+ */
+static int value_order(Value *a, Value *b)
+{
+    int a_rank = value_is_number(a) ? 0 : a->type == VAL_STRING ? 1 : a->type == VAL_ARRAY ? 2 : 3;
+    int b_rank = value_is_number(b) ? 0 : b->type == VAL_STRING ? 1 : b->type == VAL_ARRAY ? 2 : 3;
+    if (a_rank != b_rank)
+        return a_rank - b_rank;
+    switch (a_rank)
     {
-        /* Same as print - output arguments to stdout */
-        for (int i = 0; i < arg_count; i++)
+    case 0:
+        if (a->type == VAL_INT && b->type == VAL_INT)
+            return (a->data.integer > b->data.integer) - (a->data.integer < b->data.integer);
+        if (a->type == VAL_BIGNUM || b->type == VAL_BIGNUM)
         {
-            Value *val = eval_node(interp, args[i]);
-            value_print(val);
-            value_free(val);
-            if (i < arg_count - 1)
-                printf(" ");
+            BigNum *x = value_to_bignum(a);
+            BigNum *y = value_to_bignum(b);
+            int c = bignum_compare(x, y);
+            bignum_free(x);
+            bignum_free(y);
+            return c;
         }
-        printf("\n");
-        return value_create_null();
+        else
+        {
+            double x = value_as_number(a), y = value_as_number(b);
+            return (x > y) - (x < y);
+        }
+    case 1:
+        return strcmp(a->data.string, b->data.string);
+    case 2:
+        for (int i = 0; i < a->data.array.count && i < b->data.array.count; i++)
+        {
+            int c = value_order(a->data.array.elements[i], b->data.array.elements[i]);
+            if (c)
+                return c;
+        }
+        return a->data.array.count - b->data.array.count;
+    default:
+        return 0;
     }
+}
 
-    if (strcmp(name, "system.help") == 0)
+/* Context of heap comparisons: a script comparator, or NULL for value_order */
+typedef struct
+{
+    Interpreter *interp;
+    Value *comparator;
+} HeapOrder;
+
+/*
+ * Compare two heap values
+ *
+ * A comparator returning a number orders by its sign (negative pops a
+ * first); one returning a boolean pops a first when it is true.
+ */
+static int heap_order(void *context, void *a, void *b)
+{
+    HeapOrder *order = context;
+    if (!order->comparator)
+        return value_order(a, b);
+    Value *args[2] = {value_clone(a), value_clone(b)};
+    Value *result = call_function(order->interp, order->comparator, args, 2);
+    int c = 0;
+    if (result->type == VAL_BOOLEAN)
+        c = result->data.boolean ? -1 : 1;
+    else if (value_is_number(result))
     {
-        /* Display help documentation for a topic */
-        const char *topic = "help";
-        if (arg_count >= 1)
+        double d = value_as_number(result);
+        c = (d > 0) - (d < 0);
+    }
+    value_free(result);
+    return c;
+}
+
+/*
+ * Read a bit index
+ *
+ * @return: 1 if val is a number in [0, BITSET_MAX_INDEX], 0 otherwise
+ */
+static int bitset_index(Value *val, uint64_t *index)
+{
+    if (!value_is_number(val))
+        return 0;
+    double d = value_as_number(val);
+    if (!(d >= 0 && d <= (double)BITSET_MAX_INDEX))
+        return 0;
+    *index = (uint64_t)value_as_int(val);
+    return 1;
+}
+
+/*
+ * Build a bitset from an array of bit indexes, or copy a bitset
+ *
+ * @return: New bitset; elements that are not valid indexes are skipped
+ */
+static Bitset *bitset_from_value(Value *val)
+{
+    Bitset *b = bitset_create();
+    if (val->type == VAL_BITSET)
+    {
+        Bitset *copy = bitset_combine(BITSET_OR, b, val->data.bitset);
+        bitset_release(b);
+        return copy;
+    }
+    if (val->type == VAL_ARRAY)
+    {
+        uint64_t index;
+        for (int i = 0; i < val->data.array.count; i++)
         {
-            Value *t = eval_node(interp, args[0]);
-            if (t->type == VAL_STRING)
-                topic = t->data.string;
-            value_free(t);
+            if (bitset_index(val->data.array.elements[i], &index))
+                bitset_set(b, index);
         }
-        char *doc = docs_get(topic);
-        printf("%s\n", doc);
-        free(doc);
-        return value_create_null();
+    }
+    return b;
+}
+
+/*
+ * Read the value of a buffer type at offset
+ *
+ * @return: New value (integers for integer types, u64 above the int64 range
+ *          as a bigint, numbers for f32 and f64), or NULL if out of range
+ */
+static Value *buffer_get_value(Buffer *b, BufferType type, int big_endian, size_t offset)
+{
+    uint64_t bits;
+    if (!buffer_load(b, offset, buffer_type_size(type), big_endian, &bits))
+        return NULL;
+    switch (type)
+    {
+    case BUFFER_I8:
+        return value_create_int((int8_t)bits);
+    case BUFFER_I16:
+        return value_create_int((int16_t)bits);
+    case BUFFER_I32:
+        return value_create_int((int32_t)bits);
+    case BUFFER_I64:
+        return value_create_int((long long)bits);
+    case BUFFER_U64:
+        if (bits > (uint64_t)LLONG_MAX)
+        {
+            char text[32];
+            snprintf(text, sizeof(text), "%llu", (unsigned long long)bits);
+            return value_create_bignum(bignum_from_string(text, 0));
+        }
+        return value_create_int((long long)bits);
+    case BUFFER_F32:
+    {
+        uint32_t word = (uint32_t)bits;
+        float f;
+        memcpy(&f, &word, sizeof(f));
+        return value_create_number(f);
+    }
+    case BUFFER_F64:
+    {
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        return value_create_number(d);
+    }
+    default:
+        return value_create_int((long long)bits);
+    }
+}
+
+/*
+ * Write a value as a buffer type at offset
+ *
+ * Integer types keep the low bits of the value (doubles are truncated, and
+ * values up to 2^64 - 1 are accepted for u64); f32 and f64 store the number.
+ * @return: 1 on success, 0 if out of range
+ */
+static int buffer_put_value(Buffer *b, BufferType type, int big_endian, size_t offset, Value *val)
+{
+    uint64_t bits;
+    if (type == BUFFER_F32)
+    {
+        float f = (float)value_as_number(val);
+        uint32_t word;
+        memcpy(&word, &f, sizeof(word));
+        bits = word;
+    }
+    else if (type == BUFFER_F64)
+    {
+        double d = value_as_number(val);
+        memcpy(&bits, &d, sizeof(bits));
+    }
+    else if (val->type == VAL_BIGNUM)
+    {
+        char *text = bignum_to_string(val->data.bignum);
+        bits = text[0] == '-' ? (uint64_t)strtoll(text, NULL, 10) : strtoull(text, NULL, 10);
+        memory_free(text);
+    }
+    else if (val->type == VAL_NUMBER && val->data.number >= 9223372036854775808.0 &&
+             val->data.number < 18446744073709551616.0)
+        bits = (uint64_t)val->data.number;
+    else
+        bits = (uint64_t)value_as_int(val);
+    return buffer_store(b, offset, buffer_type_size(type), big_endian, bits);
+}
+
+/*
+ * Read a buffer offset or length argument
+ *
+ * @return: 1 if val is a non-negative number, 0 otherwise
+ */
+static int buffer_offset(Value *val, size_t *offset)
+{
+    if (!value_is_number(val) || value_as_number(val) < 0)
+        return 0;
+    *offset = (size_t)value_as_int(val);
+    return 1;
+}
+
+/*
+ * Build a buffer from a length, the bytes of a string, an array of byte
+ * values, or a copy of another buffer
+ *
+ * @return: New buffer, or NULL for other values
+ */
+static Buffer *buffer_from_value(Value *val)
+{
+    size_t length;
+    if (val->type == VAL_STRING)
+    {
+        length = strlen(val->data.string);
+        Buffer *b = buffer_create(length);
+        memcpy(buffer_data(b), val->data.string, length);
+        return b;
+    }
+    if (val->type == VAL_BUFFER)
+    {
+        length = buffer_length(val->data.buffer);
+        Buffer *b = buffer_create(length);
+        memcpy(buffer_data(b), buffer_data(val->data.buffer), length);
+        return b;
+    }
+    if (val->type == VAL_ARRAY)
+    {
+        Buffer *b = buffer_create((size_t)val->data.array.count);
+        uint8_t *data = buffer_data(b);
+        for (int i = 0; i < val->data.array.count; i++)
+            data[i] = (uint8_t)value_as_int(val->data.array.elements[i]);
+        return b;
+    }
+    if (buffer_offset(val, &length))
+        return buffer_create(length);
+    return NULL;
+}
+
+/*
+ * The bytes system.hash reads from a value
+ *
+ * @param text: Set to text the caller frees, when the bytes had to be made
+ * @return: Strings and buffers as they are, numbers and booleans as their
+ *          printed text; NULL for other values
+ */
+static const uint8_t *hash_input(Value *val, size_t *len, char **text)
+{
+    *text = NULL;
+    if (val->type == VAL_STRING)
+    {
+        *len = strlen(val->data.string);
+        return (const uint8_t *)val->data.string;
+    }
+    if (val->type == VAL_BUFFER)
+    {
+        *len = buffer_length(val->data.buffer);
+        return buffer_data(val->data.buffer);
+    }
+    if (value_is_number(val) || val->type == VAL_BOOLEAN)
+    {
+        *text = concat_operand_text(val);
+        *len = strlen(*text);
+        return (const uint8_t *)*text;
+    }
+    return NULL;
+}
+
+/*
+ * Read the algorithm and seed arguments of the system.hash builtins
+ *
+ * @param name: Algorithm value, or NULL for the default (xxh64)
+ * @param seed_val: Seed value, or NULL for 0
+ * @return: 1 if the algorithm is known, 0 otherwise
+ */
+static int hash_options(Value *name, Value *seed_val, HashKind *kind, uint64_t *seed)
+{
+    *kind = HASH_XXH64;
+    *seed = seed_val ? (uint64_t)value_as_int(seed_val) : 0;
+    return !name || name->type == VAL_NULL || (name->type == VAL_STRING && hash_kind_parse(name->data.string, kind));
+}
+
+/*
+ * Format a digest as lowercase hex
+ */
+static Value *hash_hex(const uint8_t *digest, size_t size)
+{
+    char text[2 * HASH_MAX_DIGEST + 1];
+    hex_encode(digest, size, text);
+    text[2 * size] = '\0';
+    return value_create_string(text);
+}
+
+/*
+ * Read epoch seconds from a script number
+ *
+ * Fractions are kept to the microsecond, about what a double holds for
+ * present-day times
+ * @return: 1 for a number, 0 otherwise
+ */
+static int time_input(Value *val, int64_t *seconds, int *nanos)
+{
+    if (val->type == VAL_INT)
+    {
+        *seconds = value_as_int(val);
+        *nanos = 0;
+        return 1;
+    }
+    double t = value_as_number(val);
+    if (!value_is_number(val) || !(t > -9.2e18 && t < 9.2e18))
+        return 0;
+    *seconds = (int64_t)floor(t);
+    long long micros = llround((t - floor(t)) * 1e6);
+    if (micros == 1000000)
+    {
+        (*seconds)++;
+        micros = 0;
+    }
+    *nanos = (int)micros * 1000;
+    return 1;
+}
+
+/*
+ * Epoch seconds as a script number: an integer for whole seconds
+ */
+static Value *time_value(int64_t seconds, int nanos)
+{
+    if (!nanos)
+        return value_create_int((long long)seconds);
+    return value_create_number((double)seconds + nanos / 1e9);
+}
+
+/*
+ * The zone a system.time builtin works in
+ *
+ * @param name: Zone name value, or NULL for UTC
+ * @return: The zone, or NULL for an unknown name or other values
+ */
+static const TimeZone *time_zone_arg(Value *name)
+{
+    if (!name || name->type == VAL_NULL)
+        return datetime_zone("UTC");
+    return name->type == VAL_STRING ? datetime_zone(name->data.string) : NULL;
+}
+
+/*
+ * Hash a value as a sketch key
+ *
+ * Integral numbers hash as 64-bit integers so 3 and 3.0 are the same key;
+ * other values hash their text.
+ */
+static uint64_t sketch_key_hash(Value *val)
+{
+    if (val->type == VAL_STRING)
+        return hash_string(val->data.string);
+    if (val->type == VAL_INT || val->type == VAL_NUMBER)
+    {
+        double d = value_as_number(val);
+        if (val->type == VAL_INT || (d == floor(d) && d >= -9.2e18 && d <= 9.2e18))
+        {
+            long long key = val->type == VAL_INT ? val->data.integer : (long long)d;
+            return hash_bytes(&key, sizeof(key));
+        }
+        return hash_bytes(&d, sizeof(d));
+    }
+    char *text = concat_operand_text(val);
+    uint64_t hash = hash_bytes(text, strlen(text));
+    memory_free(text);
+    return hash;
+}
+
+/*
+ * Add a value (or every element of an array) to a sketch
+ *
+ * @param s: Sketch to update
+ * @param val: Value or array of values
+ * @param count: Times to count each value
+ */
+static void sketch_add(StatsSketch *s, Value *val, uint64_t count)
+{
+    if (val->type == VAL_ARRAY)
+    {
+        for (int i = 0; i < val->data.array.count; i++)
+            sketch_add(s, val->data.array.elements[i], count);
+    }
+    else if (!stats_takes_numbers(s))
+        stats_add_hash(s, sketch_key_hash(val), count);
+    else if (value_is_number(val))
+        stats_add_number(s, value_as_number(val), count);
+}
+
+/*
+ * Evaluate one or several percentiles of an array or sketch
+ *
+ * @param source: Array of numbers or a histogram/t-digest sketch
+ * @param p: Percentile (0-100) or array of percentiles
+ * @return: A number, or an array for an array of percentiles; null for other
+ *          sources and for arrays without numbers (other elements are skipped)
+ */
+static Value *eval_percentile(Value *source, Value *p)
+{
+    if (source->type != VAL_ARRAY && source->type != VAL_SKETCH)
+        return value_create_null();
+    int count = 0, p_count;
+    double *values = NULL;
+    if (source->type == VAL_ARRAY)
+    {
+        // non-numbers are skipped, as system.stats.add skips them for sketches
+        values = memory_allocate(sizeof(double) * (source->data.array.count + 1));
+        for (int i = 0; i < source->data.array.count; i++)
+        {
+            if (value_is_number(source->data.array.elements[i]))
+                values[count++] = value_as_number(source->data.array.elements[i]);
+        }
+        if (!count)
+        {
+            memory_free(values);
+            return value_create_null();
+        }
+    }
+    double *ps = math_operand(p, &p_count);
+    Value *result = p->type == VAL_ARRAY ? value_create_array() : NULL;
+    for (int i = 0; i < p_count; i++)
+    {
+        double v = values ? stats_percentile(values, count, ps[i])
+                          : stats_sketch_percentile(source->data.sketch, ps[i]);
+        Value *number = v == v ? value_create_number(v) : value_create_null();
+        if (!result)
+        {
+            result = number;
+            break;
+        }
+        value_array_push(result, number);
+    }
+    memory_free(values);
+    memory_free(ps);
+    return result;
+}
+
+/*
+ * Evaluate a built-in function call
+ *
+ * @param interp: Interpreter instance
+ * @param name: Built-in function name
+ * @param args: Array of argument AST nodes
+ * @param arg_count: Number of arguments
+ * @return: Result of the built-in function
+ *
+ * Handles system built-in functions including print, output, help, and error.
+ */
+static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args, int arg_count)
+{
+    if (strcmp(name, "system.print") == 0)
+    {
+        /* Print arguments to stdout with spaces between them */
+        for (int i = 0; i < arg_count; i++)
+        {
+            Value *val = eval_node(interp, args[i]);
+            value_print(val);
+            value_free(val);
+            if (i < arg_count - 1)
+                printf(" ");
+        }
+        printf("\n");
+        return value_create_null();
+    }
+
+    if (strcmp(name, "system.output") == 0)
+    {
+        /* Same as print - output arguments to stdout */
+        for (int i = 0; i < arg_count; i++)
+        {
+            Value *val = eval_node(interp, args[i]);
+            value_print(val);
+            value_free(val);
+            if (i < arg_count - 1)
+                printf(" ");
+        }
+        printf("\n");
+        return value_create_null();
+    }
+
+    if (strcmp(name, "system.help") == 0)
+    {
+        /* Display help documentation for a topic */
+        const char *topic = "help";
+        if (arg_count >= 1)
+        {
+            Value *t = eval_node(interp, args[0]);
+            if (t->type == VAL_STRING)
+                topic = t->data.string;
+            value_free(t);
+        }
+        char *doc = docs_get(topic);
+        printf("%s\n", doc);
+        free(doc);
+        return value_create_null();
+    }
+
+    /*
+     * system.error: Print error message to stderr
+     *
+     * Takes multiple arguments and prints them as an error message.
+     * Each argument is evaluated and printed to stderr with spaces between them.
+     * Non-string values are converted to their string representation.
+     */
+    if (strcmp(name, "system.error") == 0)
+    {
+        fprintf(stderr, "Error: ");
+        for (int i = 0; i < arg_count; i++)
+        {
+            Value *val = eval_node(interp, args[i]);
+            if (val->type == VAL_STRING)
+                fprintf(stderr, "%s", val->data.string);
+            else
+            {
+                // Handle non-string types by converting to their string representation
+                if (val->type == VAL_NUMBER)
+                    fprintf(stderr, "%g", val->data.number);
+                else if (val->type == VAL_INT)
+                    fprintf(stderr, "%lld", val->data.integer);
+                else if (val->type == VAL_BIGNUM)
+                {
+                    char *text = bignum_to_string(val->data.bignum);
+                    fprintf(stderr, "%s", text);
+                    memory_free(text);
+                }
+                else if (val->type == VAL_BOOLEAN)
+                    fprintf(stderr, "%s", val->data.boolean ? "true" : "false");
+                else
+                    fprintf(stderr, "null");
+            }
+            value_free(val);
+            if (i < arg_count - 1)
+                fprintf(stderr, " ");
+        }
+        fprintf(stderr, "\n");
+        return value_create_null();
+    }
+
+    /*
+     * system.warning: Print warning message to stdout
+     *
+     * Takes multiple arguments and prints them as a warning message.
+     * Each argument is evaluated and printed to stdout with spaces between them.
+     * Uses value_print() for consistent formatting across all value types.
+     */
+    if (strcmp(name, "system.warning") == 0)
+    {
+        printf("Warning: ");
+        for (int i = 0; i < arg_count; i++)
+        {
+            Value *val = eval_node(interp, args[i]);
+            value_print(val);
+            value_free(val);
+            if (i < arg_count - 1)
+                printf(" ");
+        }
+        printf("\n");
+        return value_create_null();
+    }
+
+    /*
+     * system.input: Read user input from stdin
+     *
+     * Optional argument: prompt message to display
+     * Returns: String containing the user's input (without newline)
+     * If input fails, returns an empty string
+     */
+    if (strcmp(name, "system.input") == 0)
+    {
+        if (arg_count > 0)
+        {
+            Value *prompt = eval_node(interp, args[0]);
+            value_print(prompt);
+            value_free(prompt);
+        }
+
+        char buffer[1024];
+        if (fgets(buffer, sizeof(buffer), stdin))
+        {
+            buffer[strcspn(buffer, "\n")] = 0; // Remove trailing newline
+            return value_create_string(buffer);
+        }
+        return value_create_string("");
+    }
+
+    /*
+     * Math functions
+     * Each takes one numeric argument (system.pow takes two) and returns the result
+     * Non-numeric arguments are treated as 0.0
+     * An array argument is mapped elementwise in one vectorized call (see builtins/vecmath.c)
+     */
+    static const struct
+    {
+        const char *name;
+        VecMathOp op;
+    } math_builtins[] = {
+        {"system.sin", VECMATH_SIN},     // Sine (radians)
+        {"system.cos", VECMATH_COS},     // Cosine (radians)
+        {"system.tan", VECMATH_TAN},     // Tangent (radians)
+        {"system.asin", VECMATH_ASIN},   // Arcsine (returns radians)
+        {"system.acos", VECMATH_ACOS},   // Arccosine (returns radians)
+        {"system.atan", VECMATH_ATAN},   // Arctangent (returns radians)
+        {"system.log", VECMATH_LOG10},   // Base-10 logarithm
+        {"system.ln", VECMATH_LN},       // Natural logarithm
+        {"system.exp", VECMATH_EXP},     // e^x
+        {"system.sqrt", VECMATH_SQRT},   // Square root
+        {"system.pow", VECMATH_POW},     // a^b
+    };
+    for (size_t i = 0; i < sizeof(math_builtins) / sizeof(math_builtins[0]); i++)
+    {
+        if (strcmp(name, math_builtins[i].name) != 0)
+            continue;
+        VecMathOp op = math_builtins[i].op;
+        if (arg_count < (op == VECMATH_POW ? 2 : 1))
+            break;
+        Value *a = eval_node(interp, args[0]);
+        Value *b = op == VECMATH_POW ? eval_node(interp, args[1]) : NULL;
+        Value *result = eval_math(op, a, b);
+        value_free(a);
+        value_free(b);
+        return result;
+    }
+
+    /*
+     * system.store: Store a value in calculator memory
+     *
+     * Takes two arguments: name (string) and value to store
+     * The value is written through to the memory file when one is attached
+     */
+    if (strcmp(name, "system.store") == 0 && arg_count >= 2)
+    {
+        Value *n = eval_node(interp, args[0]);
+        Value *v = eval_node(interp, args[1]);
+        if (n->type == VAL_STRING)
+        {
+            calcmem_set(interp->memory, n->data.string, v);
+            v = NULL;
+        }
+        value_free(n);
+        value_free(v);
+        return value_create_null();
+    }
+    /*
+     * system.recall: Recall a value from calculator memory
+     *
+     * Takes one argument: name (string) of the stored value
+     * Returns: Copy of the stored value, or null if not found
+     */
+    if (strcmp(name, "system.recall") == 0 && arg_count >= 1)
+    {
+        Value *n = eval_node(interp, args[0]);
+        Value *val = n->type == VAL_STRING ? calcmem_get(interp->memory, n->data.string) : NULL;
+        value_free(n);
+        return val ? value_clone(val) : value_create_null();
+    }
+    if (strcmp(name, "system.memclear") == 0)
+    {
+        calcmem_clear(interp->memory);
+        return value_create_null();
+    }
+    /*
+     * system.memfile: Keep calculator memory in a file across runs
+     *
+     * Takes one argument: path of the memory file (created if missing)
+     * Returns: true if the file is now in use
+     */
+    if (strcmp(name, "system.memfile") == 0 && arg_count >= 1)
+    {
+        Value *p = eval_node(interp, args[0]);
+        int ok = p->type == VAL_STRING && calcmem_open(interp->memory, p->data.string);
+        value_free(p);
+        return value_create_boolean(ok);
+    }
+
+    /*
+     * system.convert: Convert between different units
+     *
+     * Takes three arguments: value (number or array of numbers), from_unit (string), to_unit (string)
+     * Units come from the registry in builtins/units.c (length, mass, temperature,
+     * time, volume, speed, data, plus units added with system.units.define)
+     * Arrays are converted in one pass; non-numeric elements become null
+     * Returns: Converted value(s), or null if the units are unknown or incompatible
+     */
+    if (strcmp(name, "system.convert") == 0 && arg_count >= 3)
+    {
+        Value *val = eval_node(interp, args[0]);
+        Value *from = eval_node(interp, args[1]);
+        Value *to = eval_node(interp, args[2]);
+        const char *fu = (from->type == VAL_STRING) ? from->data.string : "";
+        const char *tu = (to->type == VAL_STRING) ? to->data.string : "";
+        double a, b;
+        Value *result;
+        if (!units_conversion(fu, tu, &a, &b))
+        {
+            result = value_create_null();
+        }
+        else if (val->type == VAL_ARRAY)
+        {
+            int count = val->data.array.count;
+            double *numbers = memory_allocate(sizeof(double) * (count + 1));
+            for (int i = 0; i < count; i++)
+            {
+                Value *e = val->data.array.elements[i];
+                numbers[i] = value_as_number(e);
+            }
+            units_convert_array(numbers, numbers, count, a, b);
+
+            result = value_create_array();
+            for (int i = 0; i < count; i++)
+            {
+                if (value_is_number(val->data.array.elements[i]))
+                    value_array_push(result, value_create_number(numbers[i]));
+                else
+                    value_array_push(result, value_create_null());
+            }
+            memory_free(numbers);
+        }
+        else
+        {
+            double num = value_as_number(val);
+            result = value_create_number(num * a + b);
+        }
+        value_free(val);
+        value_free(from);
+        value_free(to);
+        return result;
+    }
+    /*
+     * system.units.define: Register a unit for system.convert
+     *
+     * Takes name, base unit, scale and optional offset: 1 name = scale * base + offset
+     * Returns: true if the unit was added (the base unit must exist)
+     */
+    if (strcmp(name, "system.units.define") == 0 && arg_count >= 3)
+    {
+        Value *n = eval_node(interp, args[0]);
+        Value *base = eval_node(interp, args[1]);
+        Value *scale = eval_node(interp, args[2]);
+        Value *offset = arg_count >= 4 ? eval_node(interp, args[3]) : value_create_number(0);
+        int ok = n->type == VAL_STRING && base->type == VAL_STRING && value_is_number(scale) &&
+                 value_is_number(offset) &&
+                 units_define(n->data.string, base->data.string, value_as_number(scale), value_as_number(offset));
+        value_free(n);
+        value_free(base);
+        value_free(scale);
+        value_free(offset);
+        return value_create_boolean(ok);
+    }
+
+    /*
+     * system.bigint: Convert a value to an arbitrary-precision integer
+     *
+     * Takes one argument: a number or a string of digits (fractions are truncated)
+     * Returns: The big integer, or null if the value is not a number
+     */
+    if (strcmp(name, "system.bigint") == 0 && arg_count >= 1)
+    {
+        Value *val = eval_node(interp, args[0]);
+        BigNum *num = val->type == VAL_STRING ? bignum_from_string(val->data.string, 0) : value_to_bignum(val);
+        value_free(val);
+        if (!num)
+            return value_create_null();
+        BigNum *integer = bignum_to_integer(num);
+        bignum_free(num);
+        return value_create_bignum(integer);
+    }
+
+    /*
+     * system.decimal: Convert a value to an exact decimal
+     *
+     * Takes a number or numeric string and an optional scale; with a scale the
+     * result has exactly that many fractional digits (rounded half to even)
+     * Returns: The decimal, or null if the value is not a number
+     */
+    if (strcmp(name, "system.decimal") == 0 && arg_count >= 1)
+    {
+        Value *val = eval_node(interp, args[0]);
+        BigNum *num = val->type == VAL_STRING ? bignum_from_string(val->data.string, 1) : value_to_bignum(val);
+        value_free(val);
+        if (!num)
+            return value_create_null();
+        BigNum *result = bignum_to_decimal(num);
+        bignum_free(num);
+        if (arg_count >= 2)
+        {
+            Value *scale = eval_node(interp, args[1]);
+            if (value_is_number(scale))
+            {
+                BigNum *rounded = bignum_round(result, (int)value_as_number(scale));
+                bignum_free(result);
+                result = rounded;
+            }
+            value_free(scale);
+        }
+        return value_create_bignum(result);
+    }
+
+    /*
+     * system.matrix: Build a dense matrix
+     *
+     * Takes an array of equally long row arrays (a flat array becomes one row)
+     * Returns: The matrix, or null for ragged input
+     */
+    if (strcmp(name, "system.matrix") == 0 && arg_count >= 1)
+    {
+        Value *val = eval_node(interp, args[0]);
+        Matrix *m = matrix_from_value(val);
+        value_free(val);
+        return m ? value_create_matrix(m) : value_create_null();
+    }
+
+    /*
+     * system.matrix.zeros / system.matrix.identity: Build a zero or identity matrix
+     *
+     * zeros takes rows and cols, identity takes the size
+     * Returns: The matrix, or null for negative sizes
+     */
+    if ((strcmp(name, "system.matrix.zeros") == 0 && arg_count >= 2) ||
+        (strcmp(name, "system.matrix.identity") == 0 && arg_count >= 1))
+    {
+        int identity = strcmp(name, "system.matrix.identity") == 0;
+        Value *r = eval_node(interp, args[0]);
+        Value *c = identity ? value_clone(r) : eval_node(interp, args[1]);
+        long long rows = value_as_int(r);
+        long long cols = value_as_int(c);
+        value_free(r);
+        value_free(c);
+        if (rows < 0 || cols < 0 || rows > INT_MAX || cols > INT_MAX)
+            return value_create_null();
+        Matrix *m = matrix_create((int)rows, (int)cols);
+        if (identity)
+        {
+            for (int i = 0; i < m->rows; i++)
+                m->data[(size_t)i * m->cols + i] = 1.0;
+        }
+        return value_create_matrix(m);
+    }
+
+    /*
+     * system.matrix.toArray: Convert a matrix to an array of row arrays
+     */
+    if (strcmp(name, "system.matrix.toArray") == 0 && arg_count >= 1)
+    {
+        Value *val = eval_node(interp, args[0]);
+        if (val->type != VAL_MATRIX)
+        {
+            value_free(val);
+            return value_create_null();
+        }
+        Value *arr = value_create_array();
+        for (int i = 0; i < val->data.matrix->rows; i++)
+            value_array_push(arr, matrix_row_array(val->data.matrix, i));
+        value_free(val);
+        return arr;
+    }
+
+    /*
+     * system.matrix.shape: Get the dimensions of a matrix
+     *
+     * Returns: [rows, cols], or null for non-matrices
+     */
+    if (strcmp(name, "system.matrix.shape") == 0 && arg_count >= 1)
+    {
+        Value *val = eval_node(interp, args[0]);
+        Value *shape = value_create_null();
+        if (val->type == VAL_MATRIX)
+        {
+            value_free(shape);
+            shape = value_create_array();
+            value_array_push(shape, value_create_int(val->data.matrix->rows));
+            value_array_push(shape, value_create_int(val->data.matrix->cols));
+        }
+        value_free(val);
+        return shape;
+    }
+
+    /*
+     * system.matrix.transpose: Transpose a matrix (arrays of rows are accepted too)
+     */
+    if (strcmp(name, "system.matrix.transpose") == 0 && arg_count >= 1)
+    {
+        Value *val = eval_node(interp, args[0]);
+        Matrix *m = matrix_from_value(val);
+        value_free(val);
+        if (!m)
+            return value_create_null();
+        Matrix *t = matrix_create(m->cols, m->rows);
+        matrix_transpose(m, t);
+        matrix_release(m);
+        return value_create_matrix(t);
+    }
+
+    /*
+     * system.matrix.hadamard: Elementwise product of two matrices of the same shape
+     */
+    if (strcmp(name, "system.matrix.hadamard") == 0 && arg_count >= 2)
+    {
+        Value *a = eval_node(interp, args[0]);
+        Value *b = eval_node(interp, args[1]);
+        Matrix *ma = matrix_from_value(a);
+        Matrix *mb = matrix_from_value(b);
+        Value *result = value_create_null();
+        if (ma && mb && ma->rows == mb->rows && ma->cols == mb->cols)
+        {
+            Matrix *c = matrix_create(ma->rows, ma->cols);
+            matrix_combine(MATRIX_MUL, ma->data, 1, mb->data, 1, c->data, ma->rows * ma->cols);
+            value_free(result);
+            result = value_create_matrix(c);
+        }
+        matrix_release(ma);
+        matrix_release(mb);
+        value_free(a);
+        value_free(b);
+        return result;
+    }
+
+    /*
+     * system.matrix.solve: Solve a * x = b
+     *
+     * Takes a square matrix and a right-hand side: a matrix with the same number
+     * of rows, or a flat array (one value per row)
+     * Returns: x in the shape of b, or null if a is singular or the shapes disagree
+     */
+    if (strcmp(name, "system.matrix.solve") == 0 && arg_count >= 2)
+    {
+        Value *a = eval_node(interp, args[0]);
+        Value *b = eval_node(interp, args[1]);
+        int vector = b->type == VAL_ARRAY && (b->data.array.count == 0 ||
+                                              b->data.array.elements[0]->type != VAL_ARRAY);
+        Matrix *ma = matrix_from_value(a);
+        Matrix *mb = NULL;
+        if (vector)
+        {
+            // a flat right-hand side is a column
+            Matrix *row = matrix_from_value(b);
+            mb = matrix_create(row->cols, 1);
+            memcpy(mb->data, row->data, sizeof(double) * row->cols);
+            matrix_release(row);
+        }
+        else
+            mb = matrix_from_value(b);
+        Value *result = value_create_null();
+        if (ma && mb && ma->rows == ma->cols && mb->rows == ma->rows)
+        {
+            Matrix *x = matrix_create(mb->rows, mb->cols);
+            if (matrix_solve(ma, mb, x))
+            {
+                value_free(result);
+                if (vector)
+                {
+                    result = value_create_array();
+                    for (int i = 0; i < x->rows; i++)
+                        value_array_push(result, value_create_number(x->data[i]));
+                    matrix_release(x);
+                }
+                else
+                    result = value_create_matrix(x);
+            }
+            else
+                matrix_release(x);
+        }
+        matrix_release(ma);
+        matrix_release(mb);
+        value_free(a);
+        value_free(b);
+        return result;
+    }
+
+    /*
+     * system.clock: Monotonic time in nanoseconds
+     *
+     * Only differences between two readings are meaningful
+     */
+    if (strcmp(name, "system.clock") == 0)
+        return value_create_int((long long)timing_now_ns());
+
+    /*
+     * system.bench: Time a function over many calls
+     *
+     * Takes a function of no arguments, the number of timed calls and
+     * optionally the number of untimed warmup calls (default a tenth of the
+     * iterations, at most 1000)
+     * Returns: Map of iterations, mean, median, p99, min and max nanoseconds
+     * per call, and allocations per call; null if the first argument is not a function
+     */
+    if (strcmp(name, "system.bench") == 0 && arg_count >= 2)
+    {
+        Value *fn = eval_node(interp, args[0]);
+        Value *n = eval_node(interp, args[1]);
+        long long iterations = value_as_int(n);
+        value_free(n);
+        long long warmup = iterations / 10 < 1000 ? iterations / 10 : 1000;
+        if (arg_count >= 3)
+        {
+            Value *w = eval_node(interp, args[2]);
+            warmup = value_as_int(w);
+            value_free(w);
+        }
+        if (fn->type != VAL_FUNCTION || iterations <= 0 || iterations > INT_MAX)
+        {
+            value_free(fn);
+            return value_create_null();
+        }
+
+        for (long long i = 0; i < warmup; i++)
+            value_free(call_function(interp, fn, NULL, 0));
+
+        double *samples = memory_allocate(sizeof(double) * iterations);
+        double total = 0.0;
+        size_t allocations = 0;
+        for (long long i = 0; i < iterations; i++)
+        {
+            size_t before = memory_allocation_count();
+            uint64_t start = timing_now_ns();
+            Value *result = call_function(interp, fn, NULL, 0);
+            uint64_t elapsed = timing_now_ns() - start;
+            allocations += memory_allocation_count() - before;
+            value_free(result);
+            samples[i] = (double)elapsed;
+            total += samples[i];
+        }
+        value_free(fn);
+
+        double min = samples[0], max = samples[0];
+        for (long long i = 1; i < iterations; i++)
+        {
+            if (samples[i] < min)
+                min = samples[i];
+            if (samples[i] > max)
+                max = samples[i];
+        }
+        Value *report = value_create_map();
+        value_map_set(report, "iterations", value_create_int(iterations));
+        value_map_set(report, "mean", value_create_number(total / iterations));
+        value_map_set(report, "median", value_create_number(stats_percentile(samples, (int)iterations, 50.0)));
+        value_map_set(report, "p99", value_create_number(stats_percentile(samples, (int)iterations, 99.0)));
+        value_map_set(report, "min", value_create_number(min));
+        value_map_set(report, "max", value_create_number(max));
+        value_map_set(report, "allocations", value_create_number((double)allocations / iterations));
+        memory_free(samples);
+        return report;
+    }
+
+    /*
+     * system.random: Uniform random numbers in [0, 1)
+     *
+     * With no arguments returns one number; with a count n returns an array
+     * of n numbers generated in one bulk pass
+     */
+    if (strcmp(name, "system.random") == 0)
+    {
+        if (arg_count == 0)
+            return value_create_number(random_double(interp->random));
+        Value *n = eval_node(interp, args[0]);
+        long long count = value_as_int(n);
+        value_free(n);
+        if (count < 0 || count > INT_MAX)
+            return value_create_null();
+        double *numbers = memory_allocate(sizeof(double) * (count + 1));
+        random_fill(interp->random, numbers, (size_t)count);
+        Value *arr = value_create_array();
+        for (long long i = 0; i < count; i++)
+            value_array_push(arr, value_create_number(numbers[i]));
+        memory_free(numbers);
+        return arr;
+    }
+
+    /*
+     * system.random.matrix: A rows x cols matrix of uniform numbers in [0, 1)
+     *
+     * Fills the packed matrix buffer directly, so it is the fastest way to
+     * draw many samples
+     */
+    if (strcmp(name, "system.random.matrix") == 0 && arg_count >= 2)
+    {
+        Value *r = eval_node(interp, args[0]);
+        Value *c = eval_node(interp, args[1]);
+        long long rows = value_as_int(r);
+        long long cols = value_as_int(c);
+        value_free(r);
+        value_free(c);
+        if (rows < 0 || cols < 0 || rows > INT_MAX || cols > INT_MAX)
+            return value_create_null();
+        Matrix *m = matrix_create((int)rows, (int)cols);
+        random_fill(interp->random, m->data, (size_t)rows * (size_t)cols);
+        return value_create_matrix(m);
+    }
+
+    /*
+     * system.randomInt: Uniform random integer in [lo, hi], both inclusive
+     *
+     * Takes an optional count n to return an array of n integers
+     */
+    if (strcmp(name, "system.randomInt") == 0 && arg_count >= 2)
+    {
+        Value *lo = eval_node(interp, args[0]);
+        Value *hi = eval_node(interp, args[1]);
+        long long low = value_as_int(lo);
+        long long high = value_as_int(hi);
+        value_free(lo);
+        value_free(hi);
+        if (arg_count < 3)
+            return value_create_int(random_int(interp->random, low, high));
+        Value *n = eval_node(interp, args[2]);
+        long long count = value_as_int(n);
+        value_free(n);
+        if (count < 0 || count > INT_MAX)
+            return value_create_null();
+        Value *arr = value_create_array();
+        for (long long i = 0; i < count; i++)
+            value_array_push(arr, value_create_int(random_int(interp->random, low, high)));
+        return arr;
+    }
+
+    /*
+     * system.seed: Seed this interpreter's random generator
+     *
+     * Takes a number or string; the same seed gives the same sequence
+     * Returns: null
+     */
+    if (strcmp(name, "system.seed") == 0 && arg_count >= 1)
+    {
+        Value *val = eval_node(interp, args[0]);
+        uint64_t seed;
+        if (val->type == VAL_STRING)
+            seed = hash_string(val->data.string);
+        else if (val->type == VAL_NUMBER && val->data.number != floor(val->data.number))
+            memcpy(&seed, &val->data.number, sizeof(seed));
+        else
+            seed = (uint64_t)value_as_int(val);
+        random_seed(interp->random, seed);
+        value_free(val);
+        return value_create_null();
+    }
+
+    /*
+     * system.set: Create a set of numbers and strings
+     *
+     * Takes an optional array (or set) of initial elements; duplicates are dropped
+     * Returns: New set
+     */
+    if (strcmp(name, "system.set") == 0)
+    {
+        SetTable *s = NULL;
+        if (arg_count >= 1)
+        {
+            Value *val = eval_node(interp, args[0]);
+            if (val->type == VAL_SET)
+                s = set_union(val->data.set, val->data.set);
+            else
+                s = set_from_value(val);
+            value_free(val);
+        }
+        return value_create_set(s ? s : set_create(0));
+    }
+
+    /*
+     * system.set.add: Add an element, or every element of an array, to a set
+     *
+     * Returns: true if anything was not already in the set
+     */
+    if (strcmp(name, "system.set.add") == 0 && arg_count >= 2)
+    {
+        Value *s = eval_node(interp, args[0]);
+        Value *val = eval_node(interp, args[1]);
+        int added = s->type == VAL_SET ? set_add_value(s->data.set, val) : 0;
+        value_free(s);
+        value_free(val);
+        return value_create_boolean(added > 0);
+    }
+
+    /*
+     * system.set.has / system.set.remove: Test for or remove an element
+     *
+     * Returns: true if the element was in the set
+     */
+    if ((strcmp(name, "system.set.has") == 0 || strcmp(name, "system.set.remove") == 0) && arg_count >= 2)
+    {
+        Value *s = eval_node(interp, args[0]);
+        Value *val = eval_node(interp, args[1]);
+        SetKey key;
+        int found = 0;
+        if (s->type == VAL_SET && set_key_from_value(val, &key))
+            found = strcmp(name, "system.set.has") == 0 ? set_contains(s->data.set, &key) : set_remove(s->data.set, &key);
+        value_free(s);
+        value_free(val);
+        return value_create_boolean(found);
+    }
+
+    /*
+     * system.set.union / .intersection / .difference: Combine two sets
+     *
+     * Arrays are accepted as operands; the result keeps the order of the
+     * first operand (then the second, for union)
+     * Returns: New set, or null if an operand is not a set or array
+     */
+    if ((strcmp(name, "system.set.union") == 0 || strcmp(name, "system.set.intersection") == 0 ||
+         strcmp(name, "system.set.difference") == 0) &&
+        arg_count >= 2)
+    {
+        Value *a = eval_node(interp, args[0]);
+        Value *b = eval_node(interp, args[1]);
+        SetTable *sa = set_from_value(a);
+        SetTable *sb = set_from_value(b);
+        Value *result = value_create_null();
+        if (sa && sb)
+        {
+            value_free(result);
+            if (strcmp(name, "system.set.union") == 0)
+                result = value_create_set(set_union(sa, sb));
+            else if (strcmp(name, "system.set.intersection") == 0)
+                result = value_create_set(set_intersection(sa, sb));
+            else
+                result = value_create_set(set_difference(sa, sb));
+        }
+        set_release(sa);
+        set_release(sb);
+        value_free(a);
+        value_free(b);
+        return result;
+    }
+
+    /*
+     * system.set.toArray: The elements of a set, in insertion order
+     */
+    if (strcmp(name, "system.set.toArray") == 0 && arg_count >= 1)
+    {
+        Value *s = eval_node(interp, args[0]);
+        Value *arr = s->type == VAL_SET ? value_create_array() : value_create_null();
+        if (s->type == VAL_SET)
+        {
+            SetKey key;
+            int cursor = 0;
+            while (set_next(s->data.set, &cursor, &key))
+                value_array_push(arr, set_key_value(&key));
+        }
+        value_free(s);
+        return arr;
+    }
+
+    /*
+     * system.ordmap: Create a map kept sorted by key
+     *
+     * Takes an optional map, array of [key, value] pairs or ordered map to copy
+     * Keys are numbers or strings; numbers sort before strings
+     * Returns: New ordered map
+     */
+    if (strcmp(name, "system.ordmap") == 0)
+    {
+        if (arg_count == 0)
+            return value_create_ordmap(ordmap_create(ordmap_value_free));
+        Value *val = eval_node(interp, args[0]);
+        OrderedMap *m = ordmap_from_value(val);
+        value_free(val);
+        return value_create_ordmap(m);
+    }
+
+    /*
+     * system.ordmap.set: Insert or replace the value for a key
+     *
+     * Returns: true if the key was new, false if it replaced a value (or is not a number or string)
+     */
+    if (strcmp(name, "system.ordmap.set") == 0 && arg_count >= 3)
+    {
+        Value *m = eval_node(interp, args[0]);
+        Value *k = eval_node(interp, args[1]);
+        Value *v = eval_node(interp, args[2]);
+        SetKey key;
+        int added = 0;
+        if (m->type == VAL_ORDMAP && ordmap_key_from_value(k, &key))
+            added = ordmap_set(m->data.ordmap, &key, v);
+        else
+            value_free(v);
+        value_free(m);
+        value_free(k);
+        return value_create_boolean(added);
+    }
+
+    /*
+     * system.ordmap.get / .has / .remove: Look up, test for or remove a key
+     *
+     * get takes an optional default returned for missing keys (otherwise null)
+     */
+    if ((strcmp(name, "system.ordmap.get") == 0 || strcmp(name, "system.ordmap.has") == 0 ||
+         strcmp(name, "system.ordmap.remove") == 0) &&
+        arg_count >= 2)
+    {
+        Value *m = eval_node(interp, args[0]);
+        Value *k = eval_node(interp, args[1]);
+        SetKey key;
+        Value *result;
+        int valid = m->type == VAL_ORDMAP && ordmap_key_from_value(k, &key);
+        if (strcmp(name, "system.ordmap.remove") == 0)
+            result = value_create_boolean(valid && ordmap_remove(m->data.ordmap, &key));
+        else
+        {
+            Value *found = valid ? ordmap_get(m->data.ordmap, &key) : NULL;
+            if (strcmp(name, "system.ordmap.has") == 0)
+                result = value_create_boolean(found != NULL);
+            else if (found)
+                result = value_clone(found);
+            else
+                result = arg_count >= 3 ? eval_node(interp, args[2]) : value_create_null();
+        }
+        value_free(m);
+        value_free(k);
+        return result;
+    }
+
+    /*
+     * system.ordmap.range: Entries with from <= key < to, as a new ordered map
+     *
+     * null for from or to leaves that end open
+     */
+    if (strcmp(name, "system.ordmap.range") == 0 && arg_count >= 3)
+    {
+        Value *m = eval_node(interp, args[0]);
+        Value *from = eval_node(interp, args[1]);
+        Value *to = eval_node(interp, args[2]);
+        Value *result = value_create_null();
+        SetKey lo, hi, key;
+        int has_lo = ordmap_key_from_value(from, &lo);
+        int has_hi = ordmap_key_from_value(to, &hi);
+        if (m->type == VAL_ORDMAP)
+        {
+            OrderedMap *out = ordmap_create(ordmap_value_free);
+            OrderedCursor cursor;
+            void *value;
+            if (has_lo)
+                ordmap_ceil(m->data.ordmap, &lo, 0, &cursor);
+            else
+                ordmap_first(m->data.ordmap, &cursor);
+            for (; ordmap_entry(&cursor, &key, &value); ordmap_next(&cursor))
+            {
+                if (has_hi && ordmap_compare(&key, &hi) >= 0)
+                    break;
+                ordmap_set(out, &key, value_clone(value));
+            }
+            value_free(result);
+            result = value_create_ordmap(out);
+        }
+        value_free(m);
+        value_free(from);
+        value_free(to);
+        return result;
+    }
+
+    /*
+     * system.ordmap.floor / .ceil: The greatest key <= k / the least key >= k
+     *
+     * Returns: The key, or null if there is none
+     */
+    if ((strcmp(name, "system.ordmap.floor") == 0 || strcmp(name, "system.ordmap.ceil") == 0) && arg_count >= 2)
+    {
+        Value *m = eval_node(interp, args[0]);
+        Value *k = eval_node(interp, args[1]);
+        Value *result = NULL;
+        SetKey key, found;
+        void *value;
+        if (m->type == VAL_ORDMAP && ordmap_key_from_value(k, &key))
+        {
+            OrderedCursor cursor;
+            if (strcmp(name, "system.ordmap.floor") == 0)
+                ordmap_floor(m->data.ordmap, &key, 0, &cursor);
+            else
+                ordmap_ceil(m->data.ordmap, &key, 0, &cursor);
+            if (ordmap_entry(&cursor, &found, &value))
+                result = set_key_value(&found);
+        }
+        value_free(m);
+        value_free(k);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.ordmap.first / .last: The smallest / largest key, or null when empty
+     */
+    if ((strcmp(name, "system.ordmap.first") == 0 || strcmp(name, "system.ordmap.last") == 0) && arg_count >= 1)
+    {
+        Value *m = eval_node(interp, args[0]);
+        Value *result = NULL;
+        if (m->type == VAL_ORDMAP)
+        {
+            OrderedCursor cursor;
+            SetKey key;
+            void *value;
+            if (strcmp(name, "system.ordmap.first") == 0)
+                ordmap_first(m->data.ordmap, &cursor);
+            else
+                ordmap_last(m->data.ordmap, &cursor);
+            if (ordmap_entry(&cursor, &key, &value))
+                result = set_key_value(&key);
+        }
+        value_free(m);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.ordmap.keys / .values: Keys or values in key order, as an array
+     */
+    if ((strcmp(name, "system.ordmap.keys") == 0 || strcmp(name, "system.ordmap.values") == 0) && arg_count >= 1)
+    {
+        Value *m = eval_node(interp, args[0]);
+        Value *arr = value_create_null();
+        if (m->type == VAL_ORDMAP)
+        {
+            int keys = strcmp(name, "system.ordmap.keys") == 0;
+            OrderedCursor cursor;
+            SetKey key;
+            void *value;
+            value_free(arr);
+            arr = value_create_array();
+            for (ordmap_first(m->data.ordmap, &cursor); ordmap_entry(&cursor, &key, &value); ordmap_next(&cursor))
+                value_array_push(arr, keys ? set_key_value(&key) : value_clone(value));
+        }
+        value_free(m);
+        return arr;
+    }
+
+    /*
+     * system.heap: Create a priority queue
+     *
+     * Takes an optional comparator (a, b) => number or boolean, negative or
+     * true when a should pop first (null or omitted: smallest first), and an
+     * optional limit: a full heap keeps the limit values that pop last, so
+     * system.heap(null, k) keeps the k largest values pushed
+     * Returns: New heap
+     */
+    if (strcmp(name, "system.heap") == 0)
+    {
+        Value *comparator = arg_count >= 1 ? eval_node(interp, args[0]) : NULL;
+        long long limit = 0;
+        if (arg_count >= 2)
+        {
+            Value *l = eval_node(interp, args[1]);
+            limit = value_as_int(l);
+            value_free(l);
+        }
+        if (comparator && comparator->type != VAL_FUNCTION)
+        {
+            value_free(comparator);
+            comparator = NULL;
+        }
+        return value_create_heap(heap_create(container_value_free, comparator,
+                                             limit < 0 || limit > INT_MAX ? 0 : (int)limit));
+    }
+
+    /*
+     * system.heap.push: Add a value to a heap
+     *
+     * Returns: true if the value was kept (false when a limited heap dropped it)
+     */
+    if (strcmp(name, "system.heap.push") == 0 && arg_count >= 2)
+    {
+        Value *h = eval_node(interp, args[0]);
+        Value *val = eval_node(interp, args[1]);
+        int kept = 0;
+        if (h->type == VAL_HEAP)
+        {
+            HeapOrder order = {interp, heap_comparator(h->data.heap)};
+            kept = heap_push(h->data.heap, val, heap_order, &order);
+        }
+        else
+            value_free(val);
+        value_free(h);
+        return value_create_boolean(kept);
+    }
+
+    /*
+     * system.heap.pop / .peek: Remove / read the value that comes first
+     *
+     * Returns: The value, or null when the heap is empty
+     */
+    if ((strcmp(name, "system.heap.pop") == 0 || strcmp(name, "system.heap.peek") == 0) && arg_count >= 1)
+    {
+        Value *h = eval_node(interp, args[0]);
+        Value *result = NULL;
+        if (h->type == VAL_HEAP && strcmp(name, "system.heap.pop") == 0)
+        {
+            HeapOrder order = {interp, heap_comparator(h->data.heap)};
+            result = heap_pop(h->data.heap, heap_order, &order);
+        }
+        else if (h->type == VAL_HEAP && heap_peek(h->data.heap))
+            result = value_clone(heap_peek(h->data.heap));
+        value_free(h);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.heap.toArray: The values of a heap in pop order, leaving the heap unchanged
+     */
+    if (strcmp(name, "system.heap.toArray") == 0 && arg_count >= 1)
+    {
+        Value *h = eval_node(interp, args[0]);
+        if (h->type != VAL_HEAP)
+        {
+            value_free(h);
+            return value_create_null();
+        }
+        HeapOrder order = {interp, heap_comparator(h->data.heap)};
+        Heap *copy = heap_create(borrowed_value_free, NULL, 0);
+        for (int i = 0; i < heap_count(h->data.heap); i++)
+            heap_push(copy, heap_at(h->data.heap, i), heap_order, &order);
+        Value *arr = value_create_array();
+        Value *next;
+        while ((next = heap_pop(copy, heap_order, &order)) != NULL)
+            value_array_push(arr, value_clone(next));
+        heap_release(copy);
+        value_free(h);
+        return arr;
+    }
+
+    /*
+     * system.deque: Create a double-ended queue
+     *
+     * Takes an optional array of initial values, front first
+     * Returns: New deque
+     */
+    if (strcmp(name, "system.deque") == 0)
+    {
+        Deque *d = deque_create(container_value_free);
+        if (arg_count >= 1)
+        {
+            Value *val = eval_node(interp, args[0]);
+            if (val->type == VAL_ARRAY)
+            {
+                for (int i = 0; i < val->data.array.count; i++)
+                    deque_push_back(d, value_clone(val->data.array.elements[i]));
+            }
+            value_free(val);
+        }
+        return value_create_deque(d);
+    }
+
+    /*
+     * system.deque.pushBack / .pushFront: Add a value at one end
+     *
+     * Returns: The new length
+     */
+    if ((strcmp(name, "system.deque.pushBack") == 0 || strcmp(name, "system.deque.pushFront") == 0) &&
+        arg_count >= 2)
+    {
+        Value *d = eval_node(interp, args[0]);
+        Value *val = eval_node(interp, args[1]);
+        if (d->type != VAL_DEQUE)
+        {
+            value_free(d);
+            value_free(val);
+            return value_create_null();
+        }
+        if (strcmp(name, "system.deque.pushBack") == 0)
+            deque_push_back(d->data.deque, val);
+        else
+            deque_push_front(d->data.deque, val);
+        Value *length = value_create_int(deque_count(d->data.deque));
+        value_free(d);
+        return length;
+    }
+
+    /*
+     * system.deque.popBack / .popFront / .peekBack / .peekFront: Remove or read a value at one end
+     *
+     * Returns: The value, or null when the deque is empty
+     */
+    if ((strcmp(name, "system.deque.popBack") == 0 || strcmp(name, "system.deque.popFront") == 0 ||
+         strcmp(name, "system.deque.peekBack") == 0 || strcmp(name, "system.deque.peekFront") == 0) &&
+        arg_count >= 1)
+    {
+        Value *d = eval_node(interp, args[0]);
+        Value *result = NULL;
+        if (d->type == VAL_DEQUE)
+        {
+            if (strcmp(name, "system.deque.popBack") == 0)
+                result = deque_pop_back(d->data.deque);
+            else if (strcmp(name, "system.deque.popFront") == 0)
+                result = deque_pop_front(d->data.deque);
+            else
+            {
+                int back = strcmp(name, "system.deque.peekBack") == 0;
+                Value *end = deque_get(d->data.deque, back ? -1 : 0);
+                result = end ? value_clone(end) : NULL;
+            }
+        }
+        value_free(d);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.bitset: Create a compressed bitset
+     *
+     * Takes an optional array of bit indexes to set, or a bitset to copy
+     * Returns: New bitset
+     */
+    if (strcmp(name, "system.bitset") == 0)
+    {
+        if (arg_count == 0)
+            return value_create_bitset(bitset_create());
+        Value *val = eval_node(interp, args[0]);
+        Bitset *b = bitset_from_value(val);
+        value_free(val);
+        return value_create_bitset(b);
+    }
+
+    /*
+     * system.bitset.set / system.bitset.clear: Set or clear one bit, or a range of bits
+     *
+     * Takes a bitset and an index, or a bitset, from, to (exclusive) and an
+     * optional step, which changes from, from + step, ... below to
+     * Returns: true if any bit changed
+     */
+    if ((strcmp(name, "system.bitset.set") == 0 || strcmp(name, "system.bitset.clear") == 0) && arg_count >= 2)
+    {
+        int set = strcmp(name, "system.bitset.set") == 0;
+        Value *b = eval_node(interp, args[0]);
+        Value *from = eval_node(interp, args[1]);
+        Value *to = arg_count >= 3 ? eval_node(interp, args[2]) : NULL;
+        Value *step = arg_count >= 4 ? eval_node(interp, args[3]) : NULL;
+        uint64_t lo, hi = 0, stride = 1;
+        int changed = 0;
+        if (b->type == VAL_BITSET && bitset_index(from, &lo) && (!to || bitset_index(to, &hi)) &&
+            (!step || (bitset_index(step, &stride) && stride > 0)))
+        {
+            Bitset *bits = b->data.bitset;
+            if (!to)
+                changed = set ? bitset_set(bits, lo) : bitset_clear(bits, lo);
+            else
+            {
+                uint64_t before = bitset_count(bits);
+                if (set)
+                    bitset_set_range(bits, lo, hi, stride);
+                else
+                    bitset_clear_range(bits, lo, hi, stride);
+                changed = bitset_count(bits) != before;
+            }
+        }
+        value_free(b);
+        value_free(from);
+        if (to)
+            value_free(to);
+        if (step)
+            value_free(step);
+        return value_create_boolean(changed);
+    }
+
+    /*
+     * system.bitset.test: Read one bit
+     *
+     * Returns: true if the bit is set
+     */
+    if (strcmp(name, "system.bitset.test") == 0 && arg_count >= 2)
+    {
+        Value *b = eval_node(interp, args[0]);
+        Value *idx = eval_node(interp, args[1]);
+        uint64_t index;
+        int found = b->type == VAL_BITSET && bitset_index(idx, &index) && bitset_test(b->data.bitset, index);
+        value_free(b);
+        value_free(idx);
+        return value_create_boolean(found);
+    }
+
+    /*
+     * system.bitset.next: Find the first set bit at or after an index
+     *
+     * Returns: The bit index, or null if no later bit is set
+     */
+    if (strcmp(name, "system.bitset.next") == 0 && arg_count >= 2)
+    {
+        Value *b = eval_node(interp, args[0]);
+        Value *from = eval_node(interp, args[1]);
+        uint64_t start, index;
+        Value *result = b->type == VAL_BITSET && bitset_index(from, &start) &&
+                                bitset_next(b->data.bitset, start, &index)
+                            ? value_create_int((long long)index)
+                            : value_create_null();
+        value_free(b);
+        value_free(from);
+        return result;
+    }
+
+    /*
+     * system.bitset.and / .or / .xor / .andNot: Combine two bitsets
+     *
+     * Returns: New bitset; the same as the &, |, ^ and - operators
+     */
+    if ((strcmp(name, "system.bitset.and") == 0 || strcmp(name, "system.bitset.or") == 0 ||
+         strcmp(name, "system.bitset.xor") == 0 || strcmp(name, "system.bitset.andNot") == 0) &&
+        arg_count >= 2)
+    {
+        Value *a = eval_node(interp, args[0]);
+        Value *b = eval_node(interp, args[1]);
+        Value *result = NULL;
+        if (a->type == VAL_BITSET && b->type == VAL_BITSET)
+        {
+            BitsetOp op = strcmp(name, "system.bitset.and") == 0   ? BITSET_AND
+                          : strcmp(name, "system.bitset.or") == 0  ? BITSET_OR
+                          : strcmp(name, "system.bitset.xor") == 0 ? BITSET_XOR
+                                                                   : BITSET_ANDNOT;
+            result = value_create_bitset(bitset_combine(op, a->data.bitset, b->data.bitset));
+        }
+        value_free(a);
+        value_free(b);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.bitset.toArray: The indexes of the set bits in ascending order
+     */
+    if (strcmp(name, "system.bitset.toArray") == 0 && arg_count >= 1)
+    {
+        Value *b = eval_node(interp, args[0]);
+        if (b->type != VAL_BITSET)
+        {
+            value_free(b);
+            return value_create_null();
+        }
+        Value *arr = value_create_array();
+        uint64_t index, from = 0;
+        while (bitset_next(b->data.bitset, from, &index))
+        {
+            value_array_push(arr, value_create_int((long long)index));
+            from = index + 1;
+        }
+        value_free(b);
+        return arr;
+    }
+
+    /*
+     * system.bitset.bytes: Memory held by a bitset
+     *
+     * Returns: Size in bytes, showing what the sparse chunks save
+     */
+    if (strcmp(name, "system.bitset.bytes") == 0 && arg_count >= 1)
+    {
+        Value *b = eval_node(interp, args[0]);
+        Value *result = b->type == VAL_BITSET ? value_create_int((long long)bitset_bytes(b->data.bitset))
+                                              : value_create_null();
+        value_free(b);
+        return result;
+    }
+
+    /*
+     * system.buffer: Create a byte buffer
+     *
+     * Takes a length (zero-filled), a string (its bytes), an array of byte
+     * values, or a buffer to copy
+     * Returns: New buffer, or null for other arguments
+     */
+    if (strcmp(name, "system.buffer") == 0 && arg_count >= 1)
+    {
+        Value *val = eval_node(interp, args[0]);
+        Buffer *b = buffer_from_value(val);
+        value_free(val);
+        return b ? value_create_buffer(b) : value_create_null();
+    }
+
+    /*
+     * system.buffer.get / system.buffer.put: Read or write one typed value
+     *
+     * Takes a buffer, a type name ("u8".."u64", "i8".."i64", "f32", "f64",
+     * with an optional "le" or "be" suffix; little-endian by default), a
+     * byte offset and, for put, the value
+     * Returns: The value read, or the offset just past the value written;
+     * null if it does not lie inside the buffer
+     */
+    if ((strcmp(name, "system.buffer.get") == 0 && arg_count >= 3) ||
+        (strcmp(name, "system.buffer.put") == 0 && arg_count >= 4))
+    {
+        Value *b = eval_node(interp, args[0]);
+        Value *type_name = eval_node(interp, args[1]);
+        Value *off = eval_node(interp, args[2]);
+        Value *val = arg_count >= 4 && strcmp(name, "system.buffer.put") == 0 ? eval_node(interp, args[3]) : NULL;
+        Value *result = NULL;
+        BufferType type;
+        int big_endian;
+        size_t offset;
+        if (b->type == VAL_BUFFER && type_name->type == VAL_STRING &&
+            buffer_type_parse(type_name->data.string, &type, &big_endian) && buffer_offset(off, &offset))
+        {
+            if (!val)
+                result = buffer_get_value(b->data.buffer, type, big_endian, offset);
+            else if (buffer_put_value(b->data.buffer, type, big_endian, offset, val))
+                result = value_create_int((long long)(offset + buffer_type_size(type)));
+        }
+        value_free(b);
+        value_free(type_name);
+        value_free(off);
+        if (val)
+            value_free(val);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.buffer.getArray: Read count consecutive values of one type
+     *
+     * Takes a buffer, a type name, a byte offset and a count (by default as
+     * many as fit)
+     * Returns: Array of the values that lie inside the buffer
+     */
+    if (strcmp(name, "system.buffer.getArray") == 0 && arg_count >= 3)
+    {
+        Value *b = eval_node(interp, args[0]);
+        Value *type_name = eval_node(interp, args[1]);
+        Value *off = eval_node(interp, args[2]);
+        Value *cnt = arg_count >= 4 ? eval_node(interp, args[3]) : NULL;
+        Value *result = NULL;
+        BufferType type;
+        int big_endian;
+        size_t offset, count = (size_t)-1;
+        if (b->type == VAL_BUFFER && type_name->type == VAL_STRING &&
+            buffer_type_parse(type_name->data.string, &type, &big_endian) && buffer_offset(off, &offset) &&
+            (!cnt || buffer_offset(cnt, &count)))
+        {
+            size_t size = buffer_type_size(type);
+            result = value_create_array();
+            Value *item;
+            for (size_t i = 0; i < count && (item = buffer_get_value(b->data.buffer, type, big_endian, offset)); i++)
+            {
+                value_array_push(result, item);
+                offset += size;
+            }
+        }
+        value_free(b);
+        value_free(type_name);
+        value_free(off);
+        if (cnt)
+            value_free(cnt);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.buffer.putArray: Write an array of values of one type from an offset
+     *
+     * Returns: The offset just past the last value, or null (writing nothing)
+     * if they do not all fit
+     */
+    if (strcmp(name, "system.buffer.putArray") == 0 && arg_count >= 4)
+    {
+        Value *b = eval_node(interp, args[0]);
+        Value *type_name = eval_node(interp, args[1]);
+        Value *off = eval_node(interp, args[2]);
+        Value *arr = eval_node(interp, args[3]);
+        Value *result = NULL;
+        BufferType type;
+        int big_endian;
+        size_t offset;
+        if (b->type == VAL_BUFFER && type_name->type == VAL_STRING && arr->type == VAL_ARRAY &&
+            buffer_type_parse(type_name->data.string, &type, &big_endian) && buffer_offset(off, &offset))
+        {
+            size_t size = buffer_type_size(type), length = buffer_length(b->data.buffer);
+            size_t count = (size_t)arr->data.array.count;
+            if (offset <= length && count <= (length - offset) / size)
+            {
+                for (size_t i = 0; i < count; i++)
+                    buffer_put_value(b->data.buffer, type, big_endian, offset + i * size, arr->data.array.elements[i]);
+                result = value_create_int((long long)(offset + count * size));
+            }
+        }
+        value_free(b);
+        value_free(type_name);
+        value_free(off);
+        value_free(arr);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.buffer.slice: A view of part of a buffer, sharing its bytes
+     *
+     * Takes a buffer, a start offset and an optional end offset (exclusive,
+     * by default the end of the buffer); both are clamped to the buffer
+     * Returns: New buffer view; writes through it change the original
+     */
+    if (strcmp(name, "system.buffer.slice") == 0 && arg_count >= 2)
+    {
+        Value *b = eval_node(interp, args[0]);
+        Value *from = eval_node(interp, args[1]);
+        Value *to = arg_count >= 3 ? eval_node(interp, args[2]) : NULL;
+        Value *result = NULL;
+        size_t start, end = (size_t)-1;
+        if (b->type == VAL_BUFFER && buffer_offset(from, &start) && (!to || buffer_offset(to, &end)))
+            result = value_create_buffer(buffer_slice(b->data.buffer, start, end > start ? end - start : 0));
+        value_free(b);
+        value_free(from);
+        if (to)
+            value_free(to);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.buffer.toString / system.buffer.toArray: The bytes of a buffer
+     * as a string (ending at the first zero byte) or as an array of numbers
+     */
+    if ((strcmp(name, "system.buffer.toString") == 0 || strcmp(name, "system.buffer.toArray") == 0) &&
+        arg_count >= 1)
+    {
+        Value *b = eval_node(interp, args[0]);
+        if (b->type != VAL_BUFFER)
+        {
+            value_free(b);
+            return value_create_null();
+        }
+        const uint8_t *data = buffer_data(b->data.buffer);
+        size_t length = buffer_length(b->data.buffer);
+        Value *result;
+        if (strcmp(name, "system.buffer.toString") == 0)
+        {
+            char *text = memory_allocate(length + 1);
+            memcpy(text, data, length);
+            text[length] = '\0';
+            result = value_create_string(text);
+            memory_free(text);
+        }
+        else
+        {
+            result = value_create_array();
+            for (size_t i = 0; i < length; i++)
+                value_array_push(result, value_create_int(data[i]));
+        }
+        value_free(b);
+        return result;
+    }
+
+    /*
+     * system.hash: Hash a string, buffer or number
+     *
+     * Takes the data, an optional algorithm ("xxh64" by default, "xxh32",
+     * "crc32c", "crc32" or "sha256") and an optional seed (the starting CRC for the CRCs)
+     * Returns: Hex digest, or null for other data or an unknown algorithm
+     */
+    if (strcmp(name, "system.hash") == 0 && arg_count >= 1)
+    {
+        Value *data = eval_node(interp, args[0]);
+        Value *algo = arg_count >= 2 ? eval_node(interp, args[1]) : NULL;
+        Value *seed_val = arg_count >= 3 ? eval_node(interp, args[2]) : NULL;
+        Value *result = NULL;
+        HashKind kind;
+        uint64_t seed;
+        size_t len;
+        char *text;
+        const uint8_t *bytes = hash_input(data, &len, &text);
+        if (bytes && hash_options(algo, seed_val, &kind, &seed))
+        {
+            HashState state;
+            uint8_t digest[HASH_MAX_DIGEST];
+            hash_init(&state, kind, seed);
+            hash_update(&state, bytes, len);
+            result = hash_hex(digest, hash_final(&state, digest));
+        }
+        memory_free(text);
+        value_free(data);
+        if (algo)
+            value_free(algo);
+        if (seed_val)
+            value_free(seed_val);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.hash.file: Hash a file without loading it, reading 64 KB at a time
+     *
+     * Takes a path, an optional algorithm and an optional seed, as system.hash
+     * Returns: Hex digest, or null if the file cannot be read
+     */
+    if (strcmp(name, "system.hash.file") == 0 && arg_count >= 1)
+    {
+        Value *path = eval_node(interp, args[0]);
+        Value *algo = arg_count >= 2 ? eval_node(interp, args[1]) : NULL;
+        Value *seed_val = arg_count >= 3 ? eval_node(interp, args[2]) : NULL;
+        Value *result = NULL;
+        HashKind kind;
+        uint64_t seed;
+        uint8_t digest[HASH_MAX_DIGEST];
+        if (path->type == VAL_STRING && hash_options(algo, seed_val, &kind, &seed) &&
+            hash_file(path->data.string, kind, seed, digest))
+            result = hash_hex(digest, hash_digest_size(kind));
+        value_free(path);
+        if (algo)
+            value_free(algo);
+        if (seed_val)
+            value_free(seed_val);
+        return result ? result : value_create_null();
+    }
+
+    /*
+     * system.hash.crc32c: CRC-32C of a string or buffer as a number
+     *
+     * Takes the data and an optional CRC to continue from, so chunks can be
+     * checked one at a time
+     * Returns: The CRC, or null for other data
+     */
+    if (strcmp(name, "system.hash.crc32c") == 0 && arg_count >= 1)
+    {
+        Value *data = eval_node(interp, args[0]);
+        Value *crc = arg_count >= 2 ? eval_node(interp, args[1]) : NULL;
+        size_t len;
+        char *text;
+        const uint8_t *bytes = hash_input(data, &len, &text);
+        Value *result = bytes ? value_create_int(hash_crc32c(crc ? (uint32_t)value_as_int(crc) : 0, bytes, len))
+                              : value_create_null();
+        memory_free(text);
+        value_free(data);
+        if (crc)
+            value_free(crc);
+        return result;
     }
 
     /*
-     * system.error: Print error message to stderr
+     * system.hash.bucket: Map a key to one of n buckets with xxHash64
      *
-     * Takes multiple arguments and prints them as an error message.
-     * Each argument is evaluated and printed to stderr with spaces between them.
-     * Non-string values are converted to their string representation.
+     * Integral numbers hash as 64-bit integers, so 3 and 3.0 share a bucket
+     * Returns: Bucket index in [0, n), or null for n < 1 or unhashable keys
      */
-    if (strcmp(name, "system.error") == 0)
+    if (strcmp(name, "system.hash.bucket") == 0 && arg_count >= 2)
     {
-        fprintf(stderr, "Error: ");
-        for (int i = 0; i < arg_count; i++)
+        Value *key = eval_node(interp, args[0]);
+        Value *n = eval_node(interp, args[1]);
+        Value *seed_val = arg_count >= 3 ? eval_node(interp, args[2]) : NULL;
+        Value *result = NULL;
+        long long buckets = value_as_int(n);
+        uint64_t seed = seed_val ? (uint64_t)value_as_int(seed_val) : 0;
+        if (value_is_number(n) && buckets >= 1)
         {
-            Value *val = eval_node(interp, args[i]);
-            if (val->type == VAL_STRING)
-                fprintf(stderr, "%s", val->data.string);
+            double d = value_as_number(key);
+            if (key->type == VAL_INT || (key->type == VAL_NUMBER && d == floor(d) && d >= -9.2e18 && d <= 9.2e18))
+            {
+                long long integer = value_as_int(key);
+                result = value_create_int((long long)(hash_xxh64(&integer, sizeof(integer), seed) % (uint64_t)buckets));
+            }
             else
             {
-                // Handle non-string types by converting to their string representation
-                if (val->type == VAL_NUMBER)
-                    fprintf(stderr, "%g", val->data.number);
-                else if (val->type == VAL_BOOLEAN)
-                    fprintf(stderr, "%s", val->data.boolean ? "true" : "false");
-                else
-                    fprintf(stderr, "null");
+                size_t len;
+                char *text;
+                const uint8_t *bytes = hash_input(key, &len, &text);
+                if (bytes)
+                    result = value_create_int((long long)(hash_xxh64(bytes, len, seed) % (uint64_t)buckets));
+                memory_free(text);
             }
-            value_free(val);
-            if (i < arg_count - 1)
-                fprintf(stderr, " ");
         }
-        fprintf(stderr, "\n");
-        return value_create_null();
+        value_free(key);
+        value_free(n);
+        if (seed_val)
+            value_free(seed_val);
+        return result ? result : value_create_null();
     }
 
     /*
-     * system.warning: Print warning message to stdout
+     * system.compress: Compress a string or buffer
      *
-     * Takes multiple arguments and prints them as a warning message.
-     * Each argument is evaluated and printed to stdout with spaces between them.
-     * Uses value_print() for consistent formatting across all value types.
+     * Takes the data and an optional format: "gzip" (the default; readable
+     * by gzip and zcat), "deflate" (raw RFC 1951) or "lz4" (an LZ4 frame, as
+     * the lz4 command writes)
+     * Returns: Buffer of compressed bytes, or null for other data or formats
      */
-    if (strcmp(name, "system.warning") == 0)
+    if (strcmp(name, "system.compress") == 0 && arg_count >= 1)
     {
-        printf("Warning: ");
-        for (int i = 0; i < arg_count; i++)
+        Value *data = eval_node(interp, args[0]);
+        Value *format_val = arg_count >= 2 ? eval_node(interp, args[1]) : NULL;
+        Value *result = NULL;
+        CompressFormat format = COMPRESS_GZIP;
+        size_t len, packed_len;
+        char *text;
+        const uint8_t *bytes = hash_input(data, &len, &text);
+        if (bytes && (!format_val || (format_val->type == VAL_STRING &&
+                                      compress_format_parse(format_val->data.string, &format))))
         {
-            Value *val = eval_node(interp, args[i]);
-            value_print(val);
-            value_free(val);
-            if (i < arg_count - 1)
-                printf(" ");
+            uint8_t *packed = compress_encode(format, bytes, len, &packed_len);
+            result = value_create_buffer(buffer_wrap(packed, packed_len));
         }
-        printf("\n");
-        return value_create_null();
+        memory_free(text);
+        value_free(data);
+        if (format_val)
+            value_free(format_val);
+        return result ? result : value_create_null();
     }
 
     /*
-     * system.input: Read user input from stdin
+     * system.decompress: Decompress gzip, raw DEFLATE or LZ4 data
      *
-     * Optional argument: prompt message to display
-     * Returns: String containing the user's input (without newline)
-     * If input fails, returns an empty string
+     * Takes a buffer (or string) and an optional format; without one gzip
+     * and LZ4 are told apart by their magic numbers. Concatenated gzip
+     * members and LZ4 frames decode as one.
+     * Returns: Buffer of the original bytes, or null if the data is not in
+     * the format or fails its checks
      */
-    if (strcmp(name, "system.input") == 0)
+    if (strcmp(name, "system.decompress") == 0 && arg_count >= 1)
     {
-        if (arg_count > 0)
+        Value *data = eval_node(interp, args[0]);
+        Value *format_val = arg_count >= 2 ? eval_node(interp, args[1]) : NULL;
+        Value *result = NULL;
+        CompressFormat format = COMPRESS_AUTO;
+        size_t len, plain_len;
+        char *text;
+        const uint8_t *bytes = hash_input(data, &len, &text);
+        if (bytes && (!format_val || (format_val->type == VAL_STRING &&
+                                      compress_format_parse(format_val->data.string, &format))))
         {
-            Value *prompt = eval_node(interp, args[0]);
-            value_print(prompt);
-            value_free(prompt);
+            if (format == COMPRESS_AUTO)
+                format = compress_sniff(bytes, len);
+            uint8_t *plain = format != COMPRESS_NONE ? compress_decode(format, bytes, len, &plain_len) : NULL;
+            if (plain)
+                result = value_create_buffer(buffer_wrap(plain, plain_len));
         }
+        memory_free(text);
+        value_free(data);
+        if (format_val)
+            value_free(format_val);
+        return result ? result : value_create_null();
+    }
 
-        char buffer[1024];
-        if (fgets(buffer, sizeof(buffer), stdin))
+    /*
+     * system.base64.encode / system.base64url.encode: Encode a string,
+     * buffer or number as base64 text
+     *
+     * system.base64 uses the standard alphabet with "=" padding (MIME, data
+     * URLs); system.base64url uses "-" and "_" without padding (JWTs, URLs)
+     * Returns: The text, or null for other data
+     */
+    if ((strcmp(name, "system.base64.encode") == 0 || strcmp(name, "system.base64url.encode") == 0) &&
+        arg_count >= 1)
+    {
+        Value *data = eval_node(interp, args[0]);
+        Value *result = NULL;
+        int url = strcmp(name, "system.base64url.encode") == 0;
+        size_t len;
+        char *text;
+        const uint8_t *bytes = hash_input(data, &len, &text);
+        if (bytes)
         {
-            buffer[strcspn(buffer, "\n")] = 0; // Remove trailing newline
-            return value_create_string(buffer);
+            char *encoded = memory_allocate(base64_encoded_size(len, !url) + 1);
+            encoded[base64_encode(bytes, len, url, !url, encoded)] = '\0';
+            result = value_create_string(encoded);
+            memory_free(encoded);
         }
-        return value_create_string("");
+        memory_free(text);
+        value_free(data);
+        return result ? result : value_create_null();
     }
 
     /*
-     * Trigonometric functions
-     * Each takes one numeric argument and returns the trigonometric result
-     * Non-numeric arguments are treated as 0.0
+     * system.base64.decode / system.base64url.decode: Decode base64 text
+     *
+     * Padding is optional and whitespace between groups of four characters
+     * (line-wrapped MIME bodies) is skipped
+     * Returns: Buffer of the bytes, or null for anything else in the text
      */
-
-    // system.sin: Sine function (radians)
-    if (strcmp(name, "system.sin") == 0 && arg_count >= 1)
+    if ((strcmp(name, "system.base64.decode") == 0 || strcmp(name, "system.base64url.decode") == 0) &&
+        arg_count >= 1)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(sin(v));
+        Value *data = eval_node(interp, args[0]);
+        Value *result = NULL;
+        size_t len, decoded_len;
+        char *text;
+        const uint8_t *bytes = hash_input(data, &len, &text);
+        if (bytes)
+        {
+            uint8_t *decoded = memory_allocate(len / 4 * 3 + 3);
+            if (base64_decode((const char *)bytes, len, strcmp(name, "system.base64url.decode") == 0, decoded,
+                              &decoded_len))
+                result = value_create_buffer(buffer_wrap(decoded, decoded_len));
+            else
+                memory_free(decoded);
+        }
+        memory_free(text);
+        value_free(data);
+        return result ? result : value_create_null();
     }
 
-    // system.cos: Cosine function (radians)
-    if (strcmp(name, "system.cos") == 0 && arg_count >= 1)
+    /*
+     * system.hex.encode: Encode a string, buffer or number as lowercase hex
+     * Returns: The text, or null for other data
+     */
+    if (strcmp(name, "system.hex.encode") == 0 && arg_count >= 1)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(cos(v));
+        Value *data = eval_node(interp, args[0]);
+        Value *result = NULL;
+        size_t len;
+        char *text;
+        const uint8_t *bytes = hash_input(data, &len, &text);
+        if (bytes)
+        {
+            char *encoded = memory_allocate(2 * len + 1);
+            hex_encode(bytes, len, encoded);
+            encoded[2 * len] = '\0';
+            result = value_create_string(encoded);
+            memory_free(encoded);
+        }
+        memory_free(text);
+        value_free(data);
+        return result ? result : value_create_null();
     }
 
-    // system.tan: Tangent function (radians)
-    if (strcmp(name, "system.tan") == 0 && arg_count >= 1)
+    /*
+     * system.hex.decode: Decode hex text in either case
+     * Returns: Buffer of the bytes, or null for an odd length or a non-hex
+     * character
+     */
+    if (strcmp(name, "system.hex.decode") == 0 && arg_count >= 1)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(tan(v));
+        Value *data = eval_node(interp, args[0]);
+        Value *result = NULL;
+        size_t len;
+        char *text;
+        const uint8_t *bytes = hash_input(data, &len, &text);
+        if (bytes)
+        {
+            uint8_t *decoded = memory_allocate(len / 2 + 1);
+            if (hex_decode((const char *)bytes, len, decoded))
+                result = value_create_buffer(buffer_wrap(decoded, len / 2));
+            else
+                memory_free(decoded);
+        }
+        memory_free(text);
+        value_free(data);
+        return result ? result : value_create_null();
     }
 
-    // system.asin: Arcsine function (returns radians)
-    if (strcmp(name, "system.asin") == 0 && arg_count >= 1)
+    /*
+     * system.time.now: The wall clock
+     * Returns: Seconds since the Unix epoch, with a fraction
+     */
+    if (strcmp(name, "system.time.now") == 0)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(asin(v));
+        int64_t seconds;
+        int nanos;
+        datetime_now(&seconds, &nanos);
+        return value_create_number((double)seconds + nanos / 1e9);
     }
 
-    // system.acos: Arccosine function (returns radians)
-    if (strcmp(name, "system.acos") == 0 && arg_count >= 1)
+    /*
+     * system.time.parse: Parse a timestamp
+     *
+     * Takes the text, an optional strftime-style format (null or omitted
+     * for ISO-8601) and an optional zone for text without an offset (UTC by
+     * default). Formats are compiled once and cached; ones made of
+     * fixed-width fields only are matched by position.
+     * Returns: Seconds since the epoch (an integer unless there is a
+     * fraction), or null if the text does not match or the zone is unknown
+     */
+    if (strcmp(name, "system.time.parse") == 0 && arg_count >= 1)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(acos(v));
+        Value *text = eval_node(interp, args[0]);
+        Value *format = arg_count >= 2 ? eval_node(interp, args[1]) : NULL;
+        Value *zone_val = arg_count >= 3 ? eval_node(interp, args[2]) : NULL;
+        Value *result = NULL;
+        const TimeZone *zone = time_zone_arg(zone_val);
+        int64_t seconds;
+        int nanos;
+        if (text->type == VAL_STRING && zone && (!format || format->type == VAL_NULL || format->type == VAL_STRING) &&
+            datetime_parse(text->data.string, format && format->type == VAL_STRING ? format->data.string : NULL, zone,
+                           &seconds, &nanos))
+            result = time_value(seconds, nanos);
+        value_free(text);
+        if (format)
+            value_free(format);
+        if (zone_val)
+            value_free(zone_val);
+        return result ? result : value_create_null();
     }
-    // system.atan: Arctangent function (returns radians)
-    if (strcmp(name, "system.atan") == 0 && arg_count >= 1)
+
+    /*
+     * system.time.format: Format epoch seconds as text
+     *
+     * Takes the seconds, an optional strftime-style format (null or omitted
+     * for ISO-8601) and an optional zone (UTC by default)
+     * Returns: The text, or null for a non-number or an unknown zone
+     */
+    if (strcmp(name, "system.time.format") == 0 && arg_count >= 1)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(atan(v));
+        Value *when = eval_node(interp, args[0]);
+        Value *format = arg_count >= 2 ? eval_node(interp, args[1]) : NULL;
+        Value *zone_val = arg_count >= 3 ? eval_node(interp, args[2]) : NULL;
+        Value *result = NULL;
+        const TimeZone *zone = time_zone_arg(zone_val);
+        int64_t seconds;
+        int nanos;
+        if (time_input(when, &seconds, &nanos) && zone &&
+            (!format || format->type == VAL_NULL || format->type == VAL_STRING))
+        {
+            char *text = datetime_format(seconds, nanos, format && format->type == VAL_STRING ? format->data.string : NULL,
+                                         zone);
+            result = value_create_string(text);
+            memory_free(text);
+        }
+        value_free(when);
+        if (format)
+            value_free(format);
+        if (zone_val)
+            value_free(zone_val);
+        return result ? result : value_create_null();
     }
 
-    // system.log: Base-10 logarithm function
-    if (strcmp(name, "system.log") == 0 && arg_count >= 1)
+    /*
+     * system.time.parts: Calendar fields of epoch seconds in a zone
+     *
+     * Takes the seconds and an optional zone (UTC by default)
+     * Returns: Map of year, month, day, hour, minute, second, weekday
+     * (0 = Sunday), yearday, offset (seconds east of UTC) and zone
+     * (abbreviation); null for a non-number or an unknown zone
+     */
+    if (strcmp(name, "system.time.parts") == 0 && arg_count >= 1)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(log10(v));
+        Value *when = eval_node(interp, args[0]);
+        Value *zone_val = arg_count >= 2 ? eval_node(interp, args[1]) : NULL;
+        Value *result = NULL;
+        const TimeZone *zone = time_zone_arg(zone_val);
+        int64_t seconds;
+        int nanos;
+        if (time_input(when, &seconds, &nanos) && zone)
+        {
+            DateTimeParts parts;
+            datetime_split(seconds, nanos, zone, &parts);
+            result = value_create_map();
+            value_map_set(result, "year", value_create_int(parts.year));
+            value_map_set(result, "month", value_create_int(parts.month));
+            value_map_set(result, "day", value_create_int(parts.day));
+            value_map_set(result, "hour", value_create_int(parts.hour));
+            value_map_set(result, "minute", value_create_int(parts.minute));
+            value_map_set(result, "second", value_create_int(parts.second));
+            value_map_set(result, "weekday", value_create_int(parts.weekday));
+            value_map_set(result, "yearday", value_create_int(parts.yearday));
+            value_map_set(result, "offset", value_create_int(parts.offset));
+            value_map_set(result, "zone", value_create_string(parts.abbrev));
+        }
+        value_free(when);
+        if (zone_val)
+            value_free(zone_val);
+        return result ? result : value_create_null();
     }
 
-    // system.ln: Natural logarithm function
-    if (strcmp(name, "system.ln") == 0 && arg_count >= 1)
+    /*
+     * system.symbol: The symbol for a name, as the :name literal gives
+     *
+     * For names only known at run time (read from input or built from
+     * strings); every symbol lives until the program exits
+     * Returns: The symbol, or null for an empty or non-string name
+     */
+    if (strcmp(name, "system.symbol") == 0 && arg_count >= 1)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(log(v));
+        Value *text = eval_node(interp, args[0]);
+        Value *result = text->type == VAL_STRING && text->data.string[0]
+                            ? value_create_symbol(symbol_intern(text->data.string))
+                            : value_create_null();
+        value_free(text);
+        return result;
     }
 
-    // system.exp: Exponential function (e^x)
-    if (strcmp(name, "system.exp") == 0 && arg_count >= 1)
+    /*
+     * system.symbol.name: The name of a symbol, without the colon
+     * Returns: The name as a string, or null for other values
+     */
+    if (strcmp(name, "system.symbol.name") == 0 && arg_count >= 1)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(exp(v));
+        Value *sym = eval_node(interp, args[0]);
+        Value *result = sym->type == VAL_SYMBOL ? value_create_string(sym->data.symbol->name) : value_create_null();
+        value_free(sym);
+        return result;
     }
 
-    // system.sqrt: Square root function
-    if (strcmp(name, "system.sqrt") == 0 && arg_count >= 1)
+    /*
+     * system.stats.histogram: Create a histogram of equal-width buckets
+     *
+     * Takes three arguments: minimum, maximum and bucket count
+     * Values outside [min, max) are counted in the first or last bucket
+     * Returns: Histogram sketch, or null for an empty range
+     */
+    if (strcmp(name, "system.stats.histogram") == 0 && arg_count >= 3)
     {
-        Value *x = eval_node(interp, args[0]);
-        double v = x->type == VAL_NUMBER ? x->data.number : 0.0;
-        value_free(x);
-        return value_create_number(sqrt(v));
+        Value *lo = eval_node(interp, args[0]);
+        Value *hi = eval_node(interp, args[1]);
+        Value *n = eval_node(interp, args[2]);
+        long long buckets = value_as_int(n);
+        StatsSketch *s = buckets > 0 && buckets <= INT_MAX
+                             ? stats_histogram_create(value_as_number(lo), value_as_number(hi), (int)buckets)
+                             : NULL;
+        value_free(lo);
+        value_free(hi);
+        value_free(n);
+        return s ? value_create_sketch(s) : value_create_null();
     }
-    // system.pow: Power function (a^b)
-    if (strcmp(name, "system.pow") == 0 && arg_count >= 2)
+
+    /*
+     * system.stats.hdr: Create a log-linear (HDR) histogram
+     *
+     * Takes the lowest and highest positive values to track and optionally the
+     * significant digits to keep (1-5, default 3)
+     * Returns: HDR sketch, or null for an invalid range
+     */
+    if (strcmp(name, "system.stats.hdr") == 0 && arg_count >= 2)
     {
-        Value *a = eval_node(interp, args[0]);
-        Value *b = eval_node(interp, args[1]);
-        double av = a->type == VAL_NUMBER ? a->data.number : 0.0;
-        double bv = b->type == VAL_NUMBER ? b->data.number : 0.0;
-        value_free(a);
-        value_free(b);
-        return value_create_number(pow(av, bv));
+        Value *lo = eval_node(interp, args[0]);
+        Value *hi = eval_node(interp, args[1]);
+        Value *d = arg_count >= 3 ? eval_node(interp, args[2]) : value_create_int(3);
+        long long digits = value_as_int(d);
+        StatsSketch *s = stats_hdr_create(value_as_number(lo), value_as_number(hi),
+                                          digits < 0 || digits > INT_MAX ? 0 : (int)digits);
+        value_free(lo);
+        value_free(hi);
+        value_free(d);
+        return s ? value_create_sketch(s) : value_create_null();
     }
 
     /*
-     * system.store: Store a value in calculator memory
+     * system.stats.tdigest: Create a t-digest for streaming percentiles
      *
-     * Takes two arguments: name (string) and value to store
-     * Creates a copy of the value and stores it in the calculator memory environment
+     * Takes an optional compression (default 100); larger keeps more centroids
+     * and gives more accurate percentiles
      */
-    if (strcmp(name, "system.store") == 0 && arg_count >= 2)
+    if (strcmp(name, "system.stats.tdigest") == 0)
     {
-        Value *n = eval_node(interp, args[0]);
-        Value *v = eval_node(interp, args[1]);
-        if (n->type == VAL_STRING)
+        double compression = 100.0;
+        if (arg_count >= 1)
         {
-            Value *copy = memory_allocate(sizeof(Value));
-            memcpy(copy, v, sizeof(Value));
-            if (v->type == VAL_STRING)
-                copy->data.string = memory_strdup(v->data.string);
-            env_set(calc_mem, n->data.string, copy);
+            Value *c = eval_node(interp, args[0]);
+            compression = value_as_number(c);
+            value_free(c);
         }
-        value_free(n);
-        value_free(v);
-        return value_create_null();
+        return value_create_sketch(stats_tdigest_create(compression));
     }
+
     /*
-     * system.recall: Recall a value from calculator memory
+     * system.stats.hll: Create a HyperLogLog distinct counter
      *
-     * Takes one argument: name (string) of the stored value
-     * Returns: Copy of the stored value, or null if not found
+     * Takes an optional precision (4-18, default 14): 2^precision one-byte
+     * registers, with a standard error of about 1.04 / sqrt(2^precision)
      */
-    if (strcmp(name, "system.recall") == 0 && arg_count >= 1)
+    if (strcmp(name, "system.stats.hll") == 0)
     {
-        Value *n = eval_node(interp, args[0]);
-        if (n->type == VAL_STRING)
+        long long precision = 14;
+        if (arg_count >= 1)
         {
-            Value *val = env_get(calc_mem, n->data.string);
-            if (val)
-            {
-                Value *copy = memory_allocate(sizeof(Value));
-                memcpy(copy, val, sizeof(Value));
-                if (val->type == VAL_STRING)
-                    copy->data.string = memory_strdup(val->data.string);
-                value_free(n);
-                return copy;
-            }
+            Value *p = eval_node(interp, args[0]);
+            precision = value_as_int(p);
+            value_free(p);
         }
-        value_free(n);
-        return value_create_null();
+        return value_create_sketch(stats_hll_create(precision < 0 ? 0 : precision > 64 ? 64 : (int)precision));
     }
-    if (strcmp(name, "system.memclear") == 0)
+
+    /*
+     * system.stats.countmin: Create a count-min sketch for frequency estimates
+     *
+     * Takes an optional width and depth (default 2048 x 5)
+     * Returns: Count-min sketch, or null for a non-positive size
+     */
+    if (strcmp(name, "system.stats.countmin") == 0)
     {
-        env_free(calc_mem);
-        calc_mem = env_create(NULL);
-        return value_create_null();
+        long long width = 2048, depth = 5;
+        if (arg_count >= 1)
+        {
+            Value *w = eval_node(interp, args[0]);
+            width = value_as_int(w);
+            value_free(w);
+        }
+        if (arg_count >= 2)
+        {
+            Value *d = eval_node(interp, args[1]);
+            depth = value_as_int(d);
+            value_free(d);
+        }
+        if (width <= 0 || depth <= 0 || width * depth > INT_MAX)
+            return value_create_null();
+        return value_create_sketch(stats_countmin_create((int)width, (int)depth));
     }
 
     /*
-     * system.convert: Convert between different units
+     * system.stats.add: Add a value, or every element of an array, to a sketch
      *
-     * Takes three arguments: value (number), from_unit (string), to_unit (string)
-     * Supported conversions:
-     * - Length: meters (m), kilometers (km), miles (mi)
-     * - Weight: kilograms (kg), pounds (lb)
-     * - Temperature: Celsius (C), Fahrenheit (F), Kelvin (K)
-     * Returns: Converted value as number, or null if conversion not supported
+     * Takes a sketch, the value and optionally how many times to count it
+     * Histograms and t-digests skip non-numbers; hll and countmin take any key
+     * Returns: The sketch (sketches are shared, so the update is visible
+     * through every variable holding it)
      */
-    if (strcmp(name, "system.convert") == 0 && arg_count >= 3)
+    if (strcmp(name, "system.stats.add") == 0 && arg_count >= 2)
     {
-        Value *val = eval_node(interp, args[0]);
-        Value *from = eval_node(interp, args[1]);
-        Value *to = eval_node(interp, args[2]);
-        double num = val->type == VAL_NUMBER ? val->data.number : 0.0;
-        const char *fu = (from->type == VAL_STRING) ? from->data.string : "";
-        const char *tu = (to->type == VAL_STRING) ? to->data.string : "";
-        double out = 0.0;
-        int ok = 1; // okay
-        if (strcmp(fu, "m") == 0 && strcmp(tu, "km") == 0)
-            out = num / 1000.0;
-        else if (strcmp(fu, "km") == 0 && strcmp(tu, "m") == 0)
-            out = num * 1000.0;
-        else if (strcmp(fu, "m") == 0 && strcmp(tu, "mi") == 0)
-            out = num / 1609.344;
-        else if (strcmp(fu, "mi") == 0 && strcmp(tu, "m") == 0)
-            out = num * 1609.344;
-        else if (strcmp(fu, "kg") == 0 && strcmp(tu, "lb") == 0)
-            out = num * 2.20462;
-        else if (strcmp(fu, "lb") == 0 && strcmp(tu, "kg") == 0)
-            out = num / 2.20462;
-        else if (strcmp(fu, "C") == 0 && strcmp(tu, "F") == 0)
-            out = num * 9.0 / 5.0 + 32.0;
-        else if (strcmp(fu, "F") == 0 && strcmp(tu, "C") == 0)
-            out = (num - 32.0) * 5.0 / 9.0;
-        else if (strcmp(fu, "C") == 0 && strcmp(tu, "K") == 0)
-            out = num + 273.15;
-        else if (strcmp(fu, "K") == 0 && strcmp(tu, "C") == 0)
-            out = num - 273.15;
-        else
-            ok = 0; // okay
+        Value *s = eval_node(interp, args[0]);
+        Value *val = eval_node(interp, args[1]);
+        Value *c = arg_count >= 3 ? eval_node(interp, args[2]) : value_create_int(1);
+        long long count = value_as_int(c);
+        if (s->type == VAL_SKETCH && count > 0)
+            sketch_add(s->data.sketch, val, (uint64_t)count);
         value_free(val);
-        value_free(from);
-        value_free(to);
-        if (!ok)
+        value_free(c);
+        if (s->type != VAL_SKETCH)
+        {
+            value_free(s);
             return value_create_null();
-        return value_create_number(out);
+        }
+        return s;
+    }
+
+    /*
+     * system.stats.percentile: Get percentiles of an array or sketch
+     *
+     * Takes an array of numbers (exact, by quickselect) or a histogram, hdr or
+     * tdigest sketch (estimated), and a percentile 0-100 or array of them
+     * Returns: The percentile(s), or null when there is nothing to rank
+     */
+    if ((strcmp(name, "system.stats.percentile") == 0 && arg_count >= 2) ||
+        (strcmp(name, "system.stats.median") == 0 && arg_count >= 1))
+    {
+        Value *source = eval_node(interp, args[0]);
+        Value *p = strcmp(name, "system.stats.percentile") == 0 ? eval_node(interp, args[1]) : value_create_int(50);
+        Value *result = eval_percentile(source, p);
+        value_free(source);
+        value_free(p);
+        return result;
+    }
+
+    /*
+     * system.stats.count: Query a sketch's counts
+     *
+     * With one argument: values added (distinct estimate for hll)
+     * With a key: estimated occurrences of the key (countmin only)
+     */
+    if (strcmp(name, "system.stats.count") == 0 && arg_count >= 1)
+    {
+        Value *s = eval_node(interp, args[0]);
+        Value *result;
+        if (s->type != VAL_SKETCH)
+            result = value_create_null();
+        else if (arg_count >= 2)
+        {
+            Value *key = eval_node(interp, args[1]);
+            double estimate = stats_estimate(s->data.sketch, sketch_key_hash(key));
+            result = estimate == estimate ? value_create_int((long long)estimate) : value_create_null();
+            value_free(key);
+        }
+        else
+            result = value_create_int(llround(stats_count(s->data.sketch)));
+        value_free(s);
+        return result;
+    }
+
+    /*
+     * system.stats.buckets: List a histogram's buckets
+     *
+     * Returns: Array of [lower bound, count] pairs (non-empty buckets only for
+     * hdr), or null for other sketches
+     */
+    if (strcmp(name, "system.stats.buckets") == 0 && arg_count >= 1)
+    {
+        Value *s = eval_node(interp, args[0]);
+        Value *result = value_create_null();
+        if (s->type == VAL_SKETCH && stats_takes_numbers(s->data.sketch) &&
+            stats_kind(s->data.sketch) != STATS_TDIGEST)
+        {
+            double *lower;
+            uint64_t *counts;
+            int n = stats_buckets(s->data.sketch, &lower, &counts);
+            value_free(result);
+            result = value_create_array();
+            for (int i = 0; i < n; i++)
+            {
+                Value *pair = value_create_array();
+                value_array_push(pair, value_create_number(lower[i]));
+                value_array_push(pair, value_create_int((long long)counts[i]));
+                value_array_push(result, pair);
+            }
+            memory_free(lower);
+            memory_free(counts);
+        }
+        value_free(s);
+        return result;
     }
 
     /*
      * system.history.add: Add a value to the command history
      *
      * Takes one argument: value to add to history
-     * Automatically grows the history array when needed
+     * When the history is full the oldest entry is dropped
      * Returns: null
      */
     if (strcmp(name, "system.history.add") == 0 && arg_count >= 1)
     {
-        Value *v = eval_node(interp, args[0]);
-        if (history_count >= history_capacity)
-        {
-            history_capacity *= 2;
-            history = memory_reallocate(history, sizeof(Value *) * history_capacity);
-        }
-        history[history_count++] = v;
+        history_add(&interp->history, eval_node(interp, args[0]));
         return value_create_null();
     }
     /*
-     * system.history.get: Get all values from command history
+     * system.history.get: Get values from command history
      *
-     * Returns: Array containing copies of all history values
-     * The returned array is a copy, so modifications don't affect the original history
+     * No arguments: every entry, oldest first
+     * One argument n: the last n entries
+     * Two arguments start, count: a window starting at start (negative counts from the end)
+     * Returns: Array containing copies of the selected entries only
      */
     if (strcmp(name, "system.history.get") == 0)
     {
-        Value *arr = value_create_array();
-        for (int i = 0; i < history_count; i++)
+        History *h = &interp->history;
+        int start = 0;
+        int count = h->count;
+        if (arg_count == 1)
         {
-            if (arr->data.array.count >= arr->data.array.capacity)
-            {
-                arr->data.array.capacity *= 2;
-                arr->data.array.elements = memory_reallocate(
-                    arr->data.array.elements,
-                    sizeof(Value *) * arr->data.array.capacity);
-            }
-            Value *copy = memory_allocate(sizeof(Value));
-            memcpy(copy, history[i], sizeof(Value));
-            if (history[i]->type == VAL_STRING)
-                copy->data.string = memory_strdup(history[i]->data.string);
-            arr->data.array.elements[arr->data.array.count++] = copy;
+            Value *n = eval_node(interp, args[0]);
+            count = (int)value_as_number(n);
+            value_free(n);
+            if (count < 0)
+                count = 0;
+            if (count > h->count)
+                count = h->count;
+            start = h->count - count;
         }
+        else if (arg_count >= 2)
+        {
+            Value *s = eval_node(interp, args[0]);
+            Value *n = eval_node(interp, args[1]);
+            start = (int)value_as_number(s);
+            count = (int)value_as_number(n);
+            value_free(s);
+            value_free(n);
+            if (start < 0)
+                start += h->count;
+            if (start < 0)
+                start = 0;
+            if (start > h->count)
+                start = h->count;
+            if (count < 0)
+                count = 0;
+            if (count > h->count - start)
+                count = h->count - start;
+        }
+
+        Value *arr = value_create_array();
+        for (int i = 0; i < count; i++)
+            value_array_push(arr, value_clone(history_at(h, start + i)));
         return arr;
     }
+    /*
+     * system.history.at: Get a single history entry
+     *
+     * Takes one argument: index (0 is the oldest kept entry, -1 the newest)
+     * Returns: Copy of the entry, or null when out of range
+     */
+    if (strcmp(name, "system.history.at") == 0 && arg_count >= 1)
+    {
+        History *h = &interp->history;
+        Value *i = eval_node(interp, args[0]);
+        int index = (int)value_as_number(i);
+        value_free(i);
+        if (index < 0)
+            index += h->count;
+        if (index < 0 || index >= h->count)
+            return value_create_null();
+        return value_clone(history_at(h, index));
+    }
+    /*
+     * system.history.count: Number of entries currently kept
+     */
+    if (strcmp(name, "system.history.count") == 0)
+    {
+        return value_create_int(interp->history.count);
+    }
+    /*
+     * system.history.capacity: Get or set the maximum number of entries kept
+     *
+     * Optional argument: new capacity; shrinking drops the oldest entries
+     * Returns: The capacity in effect
+     */
+    if (strcmp(name, "system.history.capacity") == 0)
+    {
+        if (arg_count >= 1)
+        {
+            Value *c = eval_node(interp, args[0]);
+            if (value_is_number(c))
+                history_resize(&interp->history, (int)value_as_number(c));
+            value_free(c);
+        }
+        return value_create_int(interp->history.capacity);
+    }
     /*
      * system.history.clear: Clear all values from command history
      *
@@ -1350,11 +4982,7 @@ static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args
      */
     if (strcmp(name, "system.history.clear") == 0)
     {
-        for (int i = 0; i < history_count; i++)
-        {
-            value_free(history[i]);
-        }
-        history_count = 0;
+        history_clear(&interp->history);
         return value_create_null();
     }
 
@@ -1369,7 +4997,8 @@ static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args
      */
     if (strcmp(name, "system.len") == 0 && arg_count > 0)
     {
-        Value *val = eval_node(interp, args[0]);
+        int owned;
+        Value *val = eval_borrowed(interp, args[0], &owned);
         int len = 0;
 
         if (val->type == VAL_STRING)
@@ -1380,9 +5009,42 @@ static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args
         {
             len = val->data.array.count;
         }
+        else if (val->type == VAL_MATRIX)
+        {
+            len = val->data.matrix->rows;
+        }
+        else if (val->type == VAL_SET)
+        {
+            len = set_count(val->data.set);
+        }
+        else if (val->type == VAL_ORDMAP)
+        {
+            len = ordmap_count(val->data.ordmap);
+        }
+        else if (val->type == VAL_HEAP)
+        {
+            len = heap_count(val->data.heap);
+        }
+        else if (val->type == VAL_DEQUE)
+        {
+            len = deque_count(val->data.deque);
+        }
+        else if (val->type == VAL_BUFFER)
+        {
+            len = (int)buffer_length(val->data.buffer);
+        }
+        else if (val->type == VAL_BITSET)
+        {
+            // the number of set bits, which can exceed an int
+            Value *count = value_create_int((long long)bitset_count(val->data.bitset));
+            if (owned)
+                value_free(val);
+            return count;
+        }
 
-        value_free(val);
-        return value_create_number(len);
+        if (owned)
+            value_free(val);
+        return value_create_int(len);
     }
 
     /*
@@ -1390,18 +5052,54 @@ static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args
      *
      * Takes one argument: value to check
      * Returns: String representation of the type
-     * Possible return values: "number", "string", "boolean", "array", "function", "null"
+     * Possible return values: "number", "bigint", "decimal", "string", "boolean", "array", "matrix", "set", "ordmap",
+     * "heap", "deque", "bitset", "buffer", "lines", "symbol", a sketch kind ("histogram", "hdr", "tdigest", "hll", "countmin"), "function", "null"
      */
     if (strcmp(name, "system.type") == 0 && arg_count > 0)
     {
-        Value *val = eval_node(interp, args[0]);
+        int owned;
+        Value *val = eval_borrowed(interp, args[0], &owned);
         const char *type_name;
 
         switch (val->type)
         {
         case VAL_NUMBER:
+        case VAL_INT:
             type_name = "number";
             break;
+        case VAL_BIGNUM:
+            type_name = bignum_is_decimal(val->data.bignum) ? "decimal" : "bigint";
+            break;
+        case VAL_MATRIX:
+            type_name = "matrix";
+            break;
+        case VAL_SKETCH:
+            type_name = stats_kind_name(val->data.sketch);
+            break;
+        case VAL_SET:
+            type_name = "set";
+            break;
+        case VAL_ORDMAP:
+            type_name = "ordmap";
+            break;
+        case VAL_HEAP:
+            type_name = "heap";
+            break;
+        case VAL_DEQUE:
+            type_name = "deque";
+            break;
+        case VAL_BITSET:
+            type_name = "bitset";
+            break;
+        case VAL_BUFFER:
+            type_name = "buffer";
+            break;
+        case VAL_LINES:
+            type_name = "lines";
+            break;
+        case VAL_SYMBOL:
+            type_name = "symbol";
+            break;
         case VAL_STRING:
             type_name = "string";
             break;
@@ -1419,7 +5117,8 @@ static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args
             break;
         }
 
-        value_free(val);
+        if (owned)
+            value_free(val);
         return value_create_string(type_name);
     }
 
@@ -1482,7 +5181,7 @@ static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args
         if (arg_count >= 3)
         {
             Value *c = eval_node(interp, args[2]);
-            code = (c->type == VAL_NUMBER) ? (int)c->data.number : 0;
+            code = (int)value_as_number(c);
             value_free(c);
         }
         Value *err = value_create_error(namev, msg, code);
@@ -1490,27 +5189,75 @@ static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args
         return value_create_null();
     }
 
+    /*
+     * system.load: Load a native extension module
+     *
+     * Takes one argument: path of a shared library exporting sharpscript_module_init
+     * The functions it registers become callable by name from the script
+     * Returns: true if the module was loaded and initialised, false otherwise
+     */
+    if (strcmp(name, "system.load") == 0 && arg_count >= 1)
+    {
+        Value *p = eval_node(interp, args[0]);
+        int ok = 0;
+        if (p->type == VAL_STRING)
+            ok = native_load_library(p->data.string);
+        value_free(p);
+        return value_create_boolean(ok);
+    }
+
     /*
      * file.read: Read contents of a file
      *
-     * Takes one argument: file_path (string)
+     * Takes one argument: file_path (string); gzip and LZ4 files are
+     * decompressed
      * Returns: String containing file contents, or null if file cannot be read
      */
     if (strcmp(name, "file.read") == 0 && arg_count >= 1)
     {
         Value *p = eval_node(interp, args[0]);
-        Value *out = value_create_null();
-        if (p->type == VAL_STRING)
-            out = io_read_file(p->data.string);
+        Value *out = p->type == VAL_STRING ? io_read_file(p->data.string) : value_create_null();
         value_free(p);
         return out;
     }
 
+    /*
+     * file.readBytes: Read a file as bytes
+     *
+     * Takes one argument: file_path (string)
+     * Returns: Buffer holding the whole file, or null if it cannot be read
+     */
+    if (strcmp(name, "file.readBytes") == 0 && arg_count >= 1)
+    {
+        Value *p = eval_node(interp, args[0]);
+        Buffer *b = p->type == VAL_STRING ? buffer_read_file(p->data.string) : NULL;
+        value_free(p);
+        return b ? value_create_buffer(b) : value_create_null();
+    }
+
+    /*
+     * file.lines: Stream the lines of a text file for for-in
+     *
+     * Takes one argument: file_path (string). gzip and LZ4 files are
+     * decompressed as they are read, 64 KB at a time, so neither the file
+     * nor its decompressed text is ever held whole.
+     * Returns: Lines value (read once; later loops over it continue where
+     * the last stopped), or null if the file cannot be opened
+     */
+    if (strcmp(name, "file.lines") == 0 && arg_count >= 1)
+    {
+        Value *p = eval_node(interp, args[0]);
+        LineReader *r = p->type == VAL_STRING ? io_lines_open(p->data.string) : NULL;
+        value_free(p);
+        return r ? value_create_lines(r) : value_create_null();
+    }
+
     /*
      * file.write: Write data to a file
      *
      * Takes two arguments: file_path (string), data (any type)
-     * Writes the string representation of data to the specified file
+     * Writes the string representation of data to the specified file, or
+     * the bytes of a buffer as they are
      * Returns: null
      */
     if (strcmp(name, "file.write") == 0 && arg_count >= 2)
@@ -1518,15 +5265,56 @@ static Value *eval_builtin(Interpreter *interp, const char *name, ASTNode **args
         Value *p = eval_node(interp, args[0]);
         Value *d = eval_node(interp, args[1]);
         if (p->type == VAL_STRING)
-            io_write_file(p->data.string, d);
+            value_free(io_write_file(p->data.string, d));
         value_free(p);
         value_free(d);
         return value_create_null();
     }
 
+    /*
+     * file.remove: Delete a file
+     *
+     * Takes one argument: file_path (string)
+     * Returns: true if the file was deleted, false otherwise
+     */
+    if (strcmp(name, "file.remove") == 0 && arg_count >= 1)
+    {
+        Value *p = eval_node(interp, args[0]);
+        int removed = p->type == VAL_STRING && remove(p->data.string) == 0;
+        value_free(p);
+        return value_create_boolean(removed);
+    }
+
     return value_create_null(); // return the null function for *node
 }
 
+/*
+ * Call a native function registered through system.load
+ *
+ * @param interp: Interpreter instance
+ * @param entry: Registry entry of the native function
+ * @param node: Call AST node whose arguments are evaluated here
+ * @return: Result of the native function
+ *
+ * Arguments are evaluated left to right and freed after the call returns.
+ */
+static Value *eval_native_call(Interpreter *interp, NativeEntry *entry, ASTNode *node)
+{
+    int count = node->data.call.arg_count;
+    Value *small[8];
+    Value **values = count <= 8 ? small : memory_allocate(sizeof(Value *) * count);
+    for (int i = 0; i < count; i++)
+        values[i] = eval_node(interp, node->data.call.args[i]);
+
+    Value *result = native_invoke(interp, entry, values, count);
+
+    for (int i = 0; i < count; i++)
+        value_free(values[i]);
+    if (values != small)
+        memory_free(values);
+    return result;
+}
+
 /*
  * eval_node: Evaluate an AST node and return its computed value
  *
@@ -1550,6 +5338,13 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
     {
     case AST_NUMBER:
         // Convert numeric literal to Value
+        if (node->data.number.text)
+        {
+            BigNum *num = bignum_from_string(node->data.number.text, node->data.number.is_decimal);
+            return num ? value_create_bignum(num) : value_create_null();
+        }
+        if (node->data.number.is_integer)
+            return value_create_int(node->data.number.integer);
         return value_create_number(node->data.number.value);
 
     case AST_STRING:
@@ -1564,6 +5359,33 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
         // Convert null literal to Value
         return value_create_null();
 
+    case AST_SYMBOL:
+        // Intern once; later evaluations reuse the symbol without hashing
+        if (!node->data.symbol.interned)
+            node->data.symbol.interned = symbol_intern(node->data.symbol.name);
+        return value_create_symbol(node->data.symbol.interned);
+
+    case AST_MAP:
+    {
+        // Keys are strings, or the names of symbols and the text of numbers and booleans
+        Value *map = value_create_map();
+        for (int i = 0; i < node->data.map_expr.count; i++)
+        {
+            Value *key = eval_node(interp, node->data.map_expr.keys[i]);
+            Value *value = eval_node(interp, node->data.map_expr.values[i]);
+            if (key->type == VAL_STRING || key->type == VAL_SYMBOL)
+                value_map_set(map, key->type == VAL_STRING ? key->data.string : key->data.symbol->name, value);
+            else
+            {
+                char *text = concat_operand_text(key);
+                value_map_set(map, text, value);
+                memory_free(text);
+            }
+            value_free(key);
+        }
+        return map;
+    }
+
     case AST_IDENTIFIER:
     {
         // Look up variable in current environment and return a copy
@@ -1574,15 +5396,8 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
             return value_create_null();
         }
 
-        // Create a copy of the value to avoid reference issues
-        Value *copy = memory_allocate(sizeof(Value));
-        memcpy(copy, val, sizeof(Value));
-        if (val->type == VAL_STRING)
-        {
-            // Deep copy string data
-            copy->data.string = memory_strdup(val->data.string);
-        }
-        return copy;
+        // Return a deep copy: the caller frees it, the variable keeps its own
+        return value_clone(val);
     }
 
     case AST_BINARY_OP:
@@ -1591,7 +5406,7 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
 
     case AST_UNARY_OP:
     {
-        // Evaluate unary operations (NOT, negation)
+        // Evaluate unary operations (NOT, negation, bitwise NOT)
         Value *operand = eval_node(interp, node->data.unary_op.operand);
 
         if (node->data.unary_op.op == TOKEN_NOT)
@@ -1603,9 +5418,22 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
 
         if (node->data.unary_op.op == TOKEN_SUB)
         {
-            double result = -operand->data.number;
+            Value *result;
+            if (operand->type == VAL_INT && operand->data.integer != LLONG_MIN)
+                result = value_create_int(-operand->data.integer);
+            else if (operand->type == VAL_BIGNUM)
+                result = value_create_bignum(bignum_neg(operand->data.bignum));
+            else
+                result = value_create_number(-value_as_number(operand));
+            value_free(operand);
+            return result;
+        }
+
+        if (node->data.unary_op.op == TOKEN_BIT_NOT)
+        {
+            long long result = ~value_as_int(operand);
             value_free(operand);
-            return value_create_number(result);
+            return value_create_int(result);
         }
 
         value_free(operand);
@@ -1620,9 +5448,9 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
         if (node->data.assign.op == TOKEN_PLUS_ASSIGN)
         {
             Value *old = env_get(interp->current, node->data.assign.name);
-            if (old && old->type == VAL_NUMBER && value->type == VAL_NUMBER)
+            if (value_is_number(old) && value_is_number(value))
             {
-                Value *new_val = value_create_number(old->data.number + value->data.number);
+                Value *new_val = numeric_op(TOKEN_ADD, old, value);
                 value_free(value);
                 value = new_val;
             }
@@ -1630,9 +5458,9 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
         else if (node->data.assign.op == TOKEN_MINUS_ASSIGN)
         {
             Value *old = env_get(interp->current, node->data.assign.name);
-            if (old && old->type == VAL_NUMBER && value->type == VAL_NUMBER)
+            if (value_is_number(old) && value_is_number(value))
             {
-                Value *new_val = value_create_number(old->data.number - value->data.number);
+                Value *new_val = numeric_op(TOKEN_SUB, old, value);
                 value_free(value);
                 value = new_val;
             }
@@ -1640,9 +5468,9 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
         else if (node->data.assign.op == TOKEN_MUL_ASSIGN)
         {
             Value *old = env_get(interp->current, node->data.assign.name);
-            if (old && old->type == VAL_NUMBER && value->type == VAL_NUMBER)
+            if (value_is_number(old) && value_is_number(value))
             {
-                Value *new_val = value_create_number(old->data.number * value->data.number);
+                Value *new_val = numeric_op(TOKEN_MUL, old, value);
                 value_free(value);
                 value = new_val;
             }
@@ -1650,9 +5478,9 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
         else if (node->data.assign.op == TOKEN_DIV_ASSIGN)
         {
             Value *old = env_get(interp->current, node->data.assign.name);
-            if (old && old->type == VAL_NUMBER && value->type == VAL_NUMBER)
+            if (value_is_number(old) && value_is_number(value))
             {
-                Value *new_val = value_create_number(old->data.number / value->data.number);
+                Value *new_val = numeric_op(TOKEN_DIV, old, value);
                 value_free(value);
                 value = new_val;
             }
@@ -1660,9 +5488,9 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
         else if (node->data.assign.op == TOKEN_MOD_ASSIGN)
         {
             Value *old = env_get(interp->current, node->data.assign.name);
-            if (old && old->type == VAL_NUMBER && value->type == VAL_NUMBER)
+            if (value_is_number(old) && value_is_number(value))
             {
-                Value *new_val = value_create_number(fmod(old->data.number, value->data.number));
+                Value *new_val = numeric_op(TOKEN_MOD, old, value);
                 value_free(value);
                 value = new_val;
             }
@@ -1689,7 +5517,7 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
                     return value_create_null();
                 }
             }
-            env_declare(interp->current, node->data.assign.name, value, 0);
+            interp_declare(interp, interp->current, node->data.assign.name, value, 0);
             if (node->data.assign.type_name)
                 env_annotate(interp->current, node->data.assign.name, node->data.assign.type_name);
             return value_create_null();
@@ -1707,7 +5535,7 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
                     return value_create_null();
                 }
             }
-            env_declare(interp->current, node->data.assign.name, value, 1);
+            interp_declare(interp, interp->current, node->data.assign.name, value, 1);
             if (node->data.assign.type_name)
                 env_annotate(interp->current, node->data.assign.name, node->data.assign.type_name);
             return value_create_null();
@@ -1831,6 +5659,18 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
 
     case AST_CALL:
     {
+        // Native functions resolved by an earlier call skip the builtin and
+        // registry lookups, but a script function defined since then (e.g.
+        // after a watch reload) still takes precedence, as it does uncached
+        if (node->data.call.native)
+        {
+            Value *shadow = env_get(interp->current, node->data.call.name);
+            if (node->data.call.native_generation == native_registry_generation() &&
+                (!shadow || shadow->type != VAL_FUNCTION))
+                return eval_native_call(interp, node->data.call.native, node);
+            node->data.call.native = NULL;
+        }
+
         // Handle function calls (both built-in and user-defined)
         if (strcmp(node->data.call.name, "system.print") == 0 ||
             strcmp(node->data.call.name, "system.input") == 0 ||
@@ -1856,11 +5696,115 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
             strcmp(node->data.call.name, "system.recall") == 0 ||
             strcmp(node->data.call.name, "system.memclear") == 0 ||
             strcmp(node->data.call.name, "system.convert") == 0 ||
+            strcmp(node->data.call.name, "system.units.define") == 0 ||
+            strcmp(node->data.call.name, "system.bigint") == 0 ||
+            strcmp(node->data.call.name, "system.decimal") == 0 ||
+            strcmp(node->data.call.name, "system.matrix") == 0 ||
+            strcmp(node->data.call.name, "system.matrix.zeros") == 0 ||
+            strcmp(node->data.call.name, "system.matrix.identity") == 0 ||
+            strcmp(node->data.call.name, "system.matrix.toArray") == 0 ||
+            strcmp(node->data.call.name, "system.matrix.shape") == 0 ||
+            strcmp(node->data.call.name, "system.matrix.transpose") == 0 ||
+            strcmp(node->data.call.name, "system.matrix.hadamard") == 0 ||
+            strcmp(node->data.call.name, "system.matrix.solve") == 0 ||
+            strcmp(node->data.call.name, "system.random") == 0 ||
+            strcmp(node->data.call.name, "system.random.matrix") == 0 ||
+            strcmp(node->data.call.name, "system.randomInt") == 0 ||
+            strcmp(node->data.call.name, "system.seed") == 0 ||
+            strcmp(node->data.call.name, "system.clock") == 0 ||
+            strcmp(node->data.call.name, "system.bench") == 0 ||
+            strcmp(node->data.call.name, "system.set") == 0 ||
+            strcmp(node->data.call.name, "system.set.add") == 0 ||
+            strcmp(node->data.call.name, "system.set.has") == 0 ||
+            strcmp(node->data.call.name, "system.set.remove") == 0 ||
+            strcmp(node->data.call.name, "system.set.union") == 0 ||
+            strcmp(node->data.call.name, "system.set.intersection") == 0 ||
+            strcmp(node->data.call.name, "system.set.difference") == 0 ||
+            strcmp(node->data.call.name, "system.set.toArray") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.set") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.get") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.has") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.remove") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.range") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.floor") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.ceil") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.first") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.last") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.keys") == 0 ||
+            strcmp(node->data.call.name, "system.ordmap.values") == 0 ||
+            strcmp(node->data.call.name, "system.heap") == 0 ||
+            strcmp(node->data.call.name, "system.heap.push") == 0 ||
+            strcmp(node->data.call.name, "system.heap.pop") == 0 ||
+            strcmp(node->data.call.name, "system.heap.peek") == 0 ||
+            strcmp(node->data.call.name, "system.heap.toArray") == 0 ||
+            strcmp(node->data.call.name, "system.deque") == 0 ||
+            strcmp(node->data.call.name, "system.deque.pushBack") == 0 ||
+            strcmp(node->data.call.name, "system.deque.pushFront") == 0 ||
+            strcmp(node->data.call.name, "system.deque.popBack") == 0 ||
+            strcmp(node->data.call.name, "system.deque.popFront") == 0 ||
+            strcmp(node->data.call.name, "system.deque.peekBack") == 0 ||
+            strcmp(node->data.call.name, "system.deque.peekFront") == 0 ||
+            strcmp(node->data.call.name, "system.bitset") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.set") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.clear") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.test") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.next") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.and") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.or") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.xor") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.andNot") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.toArray") == 0 ||
+            strcmp(node->data.call.name, "system.bitset.bytes") == 0 ||
+            strcmp(node->data.call.name, "system.buffer") == 0 ||
+            strcmp(node->data.call.name, "system.hash") == 0 ||
+            strcmp(node->data.call.name, "system.hash.file") == 0 ||
+            strcmp(node->data.call.name, "system.hash.crc32c") == 0 ||
+            strcmp(node->data.call.name, "system.hash.bucket") == 0 ||
+            strcmp(node->data.call.name, "system.compress") == 0 ||
+            strcmp(node->data.call.name, "system.decompress") == 0 ||
+            strcmp(node->data.call.name, "system.base64.encode") == 0 ||
+            strcmp(node->data.call.name, "system.base64.decode") == 0 ||
+            strcmp(node->data.call.name, "system.base64url.encode") == 0 ||
+            strcmp(node->data.call.name, "system.base64url.decode") == 0 ||
+            strcmp(node->data.call.name, "system.hex.encode") == 0 ||
+            strcmp(node->data.call.name, "system.hex.decode") == 0 ||
+            strcmp(node->data.call.name, "system.time.now") == 0 ||
+            strcmp(node->data.call.name, "system.time.parse") == 0 ||
+            strcmp(node->data.call.name, "system.time.format") == 0 ||
+            strcmp(node->data.call.name, "system.time.parts") == 0 ||
+            strcmp(node->data.call.name, "system.symbol") == 0 ||
+            strcmp(node->data.call.name, "system.symbol.name") == 0 ||
+            strcmp(node->data.call.name, "system.buffer.get") == 0 ||
+            strcmp(node->data.call.name, "system.buffer.put") == 0 ||
+            strcmp(node->data.call.name, "system.buffer.getArray") == 0 ||
+            strcmp(node->data.call.name, "system.buffer.putArray") == 0 ||
+            strcmp(node->data.call.name, "system.buffer.slice") == 0 ||
+            strcmp(node->data.call.name, "system.buffer.toString") == 0 ||
+            strcmp(node->data.call.name, "system.buffer.toArray") == 0 ||
+            strcmp(node->data.call.name, "system.stats.histogram") == 0 ||
+            strcmp(node->data.call.name, "system.stats.hdr") == 0 ||
+            strcmp(node->data.call.name, "system.stats.tdigest") == 0 ||
+            strcmp(node->data.call.name, "system.stats.hll") == 0 ||
+            strcmp(node->data.call.name, "system.stats.countmin") == 0 ||
+            strcmp(node->data.call.name, "system.stats.add") == 0 ||
+            strcmp(node->data.call.name, "system.stats.percentile") == 0 ||
+            strcmp(node->data.call.name, "system.stats.median") == 0 ||
+            strcmp(node->data.call.name, "system.stats.count") == 0 ||
+            strcmp(node->data.call.name, "system.stats.buckets") == 0 ||
+            strcmp(node->data.call.name, "system.memfile") == 0 ||
             strcmp(node->data.call.name, "system.history.add") == 0 ||
             strcmp(node->data.call.name, "system.history.get") == 0 ||
+            strcmp(node->data.call.name, "system.history.at") == 0 ||
+            strcmp(node->data.call.name, "system.history.count") == 0 ||
+            strcmp(node->data.call.name, "system.history.capacity") == 0 ||
             strcmp(node->data.call.name, "system.history.clear") == 0 ||
+            strcmp(node->data.call.name, "system.load") == 0 ||
             strcmp(node->data.call.name, "file.read") == 0 ||
-            strcmp(node->data.call.name, "file.write") == 0)
+            strcmp(node->data.call.name, "file.readBytes") == 0 ||
+            strcmp(node->data.call.name, "file.lines") == 0 ||
+            strcmp(node->data.call.name, "file.write") == 0 ||
+            strcmp(node->data.call.name, "file.remove") == 0)
         {
             return eval_builtin(interp, node->data.call.name,
                                 node->data.call.args, node->data.call.arg_count);
@@ -1869,48 +5813,26 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
         Value *func = env_get(interp->current, node->data.call.name);
         if (!func || func->type != VAL_FUNCTION)
         {
-            fprintf(stderr, "Undefined function: %s\n", node->data.call.name);
-            return value_create_null();
-        }
-
-        ASTNode *func_node = func->data.function.function;
-        Environment *func_env = env_create(func->data.function.closure);
-
-        for (int i = 0; i < func_node->data.function.param_count; i++)
-        {
-            if (i < node->data.call.arg_count)
-            {
-                Value *arg = eval_node(interp, node->data.call.args[i]);
-                env_set(func_env, func_node->data.function.params[i], arg);
-            }
-            else if (func_node->data.function.defaults && func_node->data.function.defaults[i])
-            {
-                Value *defv = eval_node(interp, func_node->data.function.defaults[i]);
-                env_set(func_env, func_node->data.function.params[i], defv);
-            }
-            else
+            NativeEntry *native = native_lookup(node->data.call.name);
+            if (native)
             {
-                env_set(func_env, func_node->data.function.params[i], value_create_null());
+                node->data.call.native = native;
+                node->data.call.native_generation = native_registry_generation();
+                return eval_native_call(interp, native, node);
             }
+            fprintf(stderr, "Undefined function: %s\n", node->data.call.name);
+            return value_create_null();
         }
 
-        Environment *saved_env = interp->current;
-        interp->current = func_env;
-        Value *result = eval_node(interp, func_node->data.function.body);
-        interp->current = saved_env;
-
-        if (result->type == VAL_RETURN)
-        {
-            Value *ret_val = result->data.return_val.value;
-            result->data.return_val.value = NULL;
-            value_free(result);
-            env_free(func_env);
-            return ret_val ? ret_val : value_create_null();
-        }
-
-        env_free(func_env);
-        value_free(result);
-        return value_create_null();
+        int param_count;
+        function_params(func->data.function.function, &param_count);
+        int arg_count = node->data.call.arg_count < param_count ? node->data.call.arg_count : param_count;
+        Value **call_args = memory_allocate(sizeof(Value *) * (arg_count + 1));
+        for (int i = 0; i < arg_count; i++)
+            call_args[i] = eval_node(interp, node->data.call.args[i]);
+        Value *result = call_function(interp, func, call_args, arg_count);
+        memory_free(call_args);
+        return result;
     }
 
     case AST_RETURN:
@@ -1952,7 +5874,7 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
             char *full_name = memory_allocate(name_len);
             sprintf(full_name, "%s.%s", node->data.namespace_decl.name, ns_env->names[i]);
             Value *vclone = value_clone(ns_env->values[i]);
-            env_declare(saved, full_name, vclone, ns_env->is_const[i]);
+            interp_declare(interp, saved, full_name, vclone, ns_env->is_const[i]);
             memory_free(full_name);
         }
         interp->current = saved;
@@ -1967,7 +5889,7 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
             char *full_name = memory_allocate(name_len);
             sprintf(full_name, "%s.%s", node->data.enum_decl.name, node->data.enum_decl.members[i]);
             Value *val = value_create_number(node->data.enum_decl.values[i]);
-            env_declare(interp->current, full_name, val, 1);
+            interp_declare(interp, interp->current, full_name, val, 1);
             memory_free(full_name);
         }
         return value_create_null();
@@ -1995,36 +5917,98 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
 
     case AST_INDEX:
     {
-        Value *obj = eval_node(interp, node->data.index_expr.object);
-        Value *idx = eval_node(interp, node->data.index_expr.index);
+        // A variable is borrowed rather than copied, and only the selected
+        // element is cloned. The index is evaluated first in that case, since
+        // it may call code that reassigns the variable.
+        ASTNode *object = node->data.index_expr.object;
+        int owned = 1;
+        Value *obj, *idx;
+        if (object->type == AST_IDENTIFIER)
+        {
+            idx = eval_node(interp, node->data.index_expr.index);
+            obj = eval_borrowed(interp, object, &owned);
+        }
+        else
+        {
+            obj = eval_node(interp, object);
+            idx = eval_node(interp, node->data.index_expr.index);
+        }
+        Value *result = NULL;
 
-        if (obj->type == VAL_ARRAY && idx->type == VAL_NUMBER)
+        if (obj->type == VAL_MATRIX && value_is_number(idx))
+        {
+            // a row of a matrix, as an array
+            long long index = value_as_int(idx);
+            result = index >= 0 && index < obj->data.matrix->rows ? matrix_row_array(obj->data.matrix, (int)index)
+                                                                  : value_create_null();
+        }
+        else if (obj->type == VAL_ARRAY && value_is_number(idx))
         {
-            int index = (int)idx->data.number;
+            long long index = value_as_int(idx);
             if (index >= 0 && index < obj->data.array.count)
             {
-                Value *elem = obj->data.array.elements[index];
-                Value *copy = memory_allocate(sizeof(Value));
-                memcpy(copy, elem, sizeof(Value));
-                if (elem->type == VAL_STRING)
+                // a temporary gives up the element instead of copying it
+                result = obj->data.array.elements[index];
+                if (owned)
+                    obj->data.array.elements[index] = value_create_null();
+                else
+                    result = value_clone(result);
+            }
+        }
+        else if (obj->type == VAL_DEQUE && value_is_number(idx))
+        {
+            // negative indexes count from the back
+            long long index = value_as_int(idx);
+            Value *found = index >= INT_MIN && index <= INT_MAX ? deque_get(obj->data.deque, (int)index) : NULL;
+            result = found ? value_clone(found) : value_create_null();
+        }
+        else if (obj->type == VAL_BUFFER && value_is_number(idx))
+        {
+            // b[i] reads one byte
+            long long index = value_as_int(idx);
+            result = index >= 0 && (size_t)index < buffer_length(obj->data.buffer)
+                         ? value_create_int(buffer_data(obj->data.buffer)[index])
+                         : value_create_null();
+        }
+        else if (obj->type == VAL_BITSET)
+        {
+            uint64_t index;
+            result = value_create_boolean(bitset_index(idx, &index) && bitset_test(obj->data.bitset, index));
+        }
+        else if (obj->type == VAL_ORDMAP)
+        {
+            SetKey key;
+            Value *found = ordmap_key_from_value(idx, &key) ? ordmap_get(obj->data.ordmap, &key) : NULL;
+            result = found ? value_clone(found) : value_create_null();
+        }
+        else if (obj->type == VAL_MAP && (idx->type == VAL_STRING || idx->type == VAL_SYMBOL))
+        {
+            // m[:name] reads the same entry as m["name"]
+            const char *key = idx->type == VAL_STRING ? idx->data.string : idx->data.symbol->name;
+            for (int i = 0; i < obj->data.map.count && !result; i++)
+            {
+                if (strcmp(obj->data.map.keys[i], key) == 0)
                 {
-                    copy->data.string = memory_strdup(elem->data.string);
+                    result = obj->data.map.values[i];
+                    if (owned)
+                        obj->data.map.values[i] = value_create_null();
+                    else
+                        result = value_clone(result);
                 }
-                value_free(obj);
-                value_free(idx);
-                return copy;
             }
         }
 
-        value_free(obj);
+        if (owned)
+            value_free(obj);
         value_free(idx);
-        return value_create_null();
+        return result ? result : value_create_null();
     }
 
     case AST_TRY_CATCH: // try-catch statement
     {
         Value *result = value_create_null();
         Value *error_value = NULL;
+        ValuePin *pins = pinned_values;
 
         // Execute try block
         if (setjmp(interp->jmp_buf) == 0)
@@ -2035,7 +6019,8 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
         }
         else
         {
-            // Exception was thrown
+            // Exception was thrown; loops it skipped leave their pins behind
+            value_unpin_to(pins);
             error_value = interp->current_error;
             interp->current_error = NULL;
 
@@ -2101,8 +6086,17 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
 
     case AST_FOR_IN:
     {
-        // Evaluate the collection
-        Value *collection = eval_node(interp, node->data.for_in.collection);
+        // Evaluate the collection. An array or map held in a variable is
+        // borrowed and pinned rather than copied: if the body reassigns the
+        // variable, the loop still finishes the value it started on.
+        int owned;
+        Value *collection = eval_borrowed(interp, node->data.for_in.collection, &owned);
+        if (!owned && collection->type != VAL_ARRAY && collection->type != VAL_MAP)
+        {
+            collection = value_clone(collection);
+            owned = 1;
+        }
+        ValuePin *pin = owned ? NULL : value_pin(collection);
         Value *result = value_create_null();
 
         if (collection->type == VAL_ARRAY)
@@ -2135,7 +6129,10 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
                 else if (result->type == VAL_RETURN)
                 {
                     // Return from function
-                    value_free(collection);
+                    if (pin)
+                        value_unpin_to(pin->next);
+                    else
+                        value_free(collection);
                     return result;
                 }
             }
@@ -2191,7 +6188,10 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
                 else if (result->type == VAL_RETURN)
                 {
                     // Return from function
-                    value_free(collection);
+                    if (pin)
+                        value_unpin_to(pin->next);
+                    else
+                        value_free(collection);
                     value_free(pair);
                     return result;
                 }
@@ -2199,12 +6199,234 @@ static Value *eval_node(Interpreter *interp, ASTNode *node)
                 value_free(pair);
             }
         }
+        else if (collection->type == VAL_SET)
+        {
+            // Iterate over set elements in insertion order
+            SetKey key;
+            int cursor = 0;
+            while (set_next(collection->data.set, &cursor, &key))
+            {
+                env_set(interp->current, node->data.for_in.var, set_key_value(&key));
+
+                value_free(result);
+                result = eval_node(interp, node->data.for_in.body);
+
+                if (result->type == VAL_BREAK)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    break;
+                }
+                else if (result->type == VAL_CONTINUE)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    continue;
+                }
+                else if (result->type == VAL_RETURN)
+                {
+                    if (pin)
+                        value_unpin_to(pin->next);
+                    else
+                        value_free(collection);
+                    return result;
+                }
+            }
+        }
+        else if (collection->type == VAL_DEQUE)
+        {
+            // Iterate front to back; the length is read each step as the body may push or pop
+            for (int i = 0; i < deque_count(collection->data.deque); i++)
+            {
+                env_set(interp->current, node->data.for_in.var, value_clone(deque_get(collection->data.deque, i)));
+
+                value_free(result);
+                result = eval_node(interp, node->data.for_in.body);
+
+                if (result->type == VAL_BREAK)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    break;
+                }
+                else if (result->type == VAL_CONTINUE)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    continue;
+                }
+                else if (result->type == VAL_RETURN)
+                {
+                    if (pin)
+                        value_unpin_to(pin->next);
+                    else
+                        value_free(collection);
+                    return result;
+                }
+            }
+        }
+        else if (collection->type == VAL_BUFFER)
+        {
+            // Iterate over byte values front to back
+            for (size_t i = 0; i < buffer_length(collection->data.buffer); i++)
+            {
+                env_set(interp->current, node->data.for_in.var, value_create_int(buffer_data(collection->data.buffer)[i]));
+
+                value_free(result);
+                result = eval_node(interp, node->data.for_in.body);
+
+                if (result->type == VAL_BREAK)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    break;
+                }
+                else if (result->type == VAL_CONTINUE)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    continue;
+                }
+                else if (result->type == VAL_RETURN)
+                {
+                    if (pin)
+                        value_unpin_to(pin->next);
+                    else
+                        value_free(collection);
+                    return result;
+                }
+            }
+        }
+        else if (collection->type == VAL_LINES)
+        {
+            // Read one line per step; a break leaves the rest for the next loop
+            char *line;
+            while ((line = io_lines_next(collection->data.lines)) != NULL)
+            {
+                env_set(interp->current, node->data.for_in.var, value_create_string(line));
+                memory_free(line);
+
+                value_free(result);
+                result = eval_node(interp, node->data.for_in.body);
+
+                if (result->type == VAL_BREAK)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    break;
+                }
+                else if (result->type == VAL_CONTINUE)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    continue;
+                }
+                else if (result->type == VAL_RETURN)
+                {
+                    if (pin)
+                        value_unpin_to(pin->next);
+                    else
+                        value_free(collection);
+                    return result;
+                }
+            }
+            if (io_lines_failed(collection->data.lines))
+                fprintf(stderr, "Error: %s: corrupt compressed data\n", io_lines_path(collection->data.lines));
+        }
+        else if (collection->type == VAL_BITSET)
+        {
+            // Iterate over set bit indexes in ascending order, seeking from
+            // the previous index each step so the body may change the bitset
+            uint64_t index, from = 0;
+            while (bitset_next(collection->data.bitset, from, &index))
+            {
+                from = index + 1;
+                env_set(interp->current, node->data.for_in.var, value_create_int((long long)index));
+
+                value_free(result);
+                result = eval_node(interp, node->data.for_in.body);
+
+                if (result->type == VAL_BREAK)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    break;
+                }
+                else if (result->type == VAL_CONTINUE)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                    continue;
+                }
+                else if (result->type == VAL_RETURN)
+                {
+                    if (pin)
+                        value_unpin_to(pin->next);
+                    else
+                        value_free(collection);
+                    return result;
+                }
+            }
+        }
+        else if (collection->type == VAL_ORDMAP)
+        {
+            // Iterate over entries in key order; seeking past the previous key
+            // each step lets the body change the map
+            OrderedCursor cursor;
+            SetKey key, last;
+            void *value;
+            int started = 0;
+            while (1)
+            {
+                if (started)
+                    ordmap_ceil(collection->data.ordmap, &last, 1, &cursor);
+                else
+                    ordmap_first(collection->data.ordmap, &cursor);
+                if (started && last.kind == SET_KEY_STRING)
+                    memory_free((char *)last.u.string);
+                if (!ordmap_entry(&cursor, &key, &value))
+                    break;
+                last = key;
+                if (key.kind == SET_KEY_STRING)
+                    last.u.string = memory_strdup(key.u.string);
+                started = 1;
+                env_set(interp->current, node->data.for_in.var, ordmap_entry_value(&key, value));
+
+                value_free(result);
+                result = eval_node(interp, node->data.for_in.body);
+
+                if (result->type == VAL_BREAK || result->type == VAL_RETURN)
+                {
+                    if (last.kind == SET_KEY_STRING)
+                        memory_free((char *)last.u.string);
+                    if (result->type == VAL_RETURN)
+                    {
+                        if (pin)
+                            value_unpin_to(pin->next);
+                        else
+                            value_free(collection);
+                        return result;
+                    }
+                    value_free(result);
+                    result = value_create_null();
+                    break;
+                }
+                else if (result->type == VAL_CONTINUE)
+                {
+                    value_free(result);
+                    result = value_create_null();
+                }
+            }
+        }
         else
         {
-            fprintf(stderr, "Error: for-in loop requires an array or map, got type %d\n", collection->type);
+            fprintf(stderr, "Error: for-in loop requires an array, map, set, ordmap, deque, bitset, buffer or lines, got type %d\n", collection->type);
         }
 
-        value_free(collection);
+        if (pin)
+            value_unpin_to(pin->next);
+        else
+            value_free(collection);
         return result;
     }
 
@@ -28,6 +28,7 @@ Lexer *lexer_create(const char *source)
     lexer->line = 1;
     lexer->column = 1;
     lexer->length = strlen(source);
+    lexer->previous = TOKEN_EOF;
     return lexer;
 }
 
@@ -111,6 +112,190 @@ static char lexer_advance(Lexer *lexer)
     return c;
 }
 
+/*
+ * Vectorized scanning
+ *
+ * Runs of whitespace, comment bodies and string contents are scanned a block
+ * at a time (32 bytes with AVX2 when the CPU has it, 16 with SSE2) instead of
+ * one lexer_advance call per character. Newlines inside a run are counted by
+ * popcount of the newline mask, so line/column tracking stays exact.
+ * Other targets and the tail of the input use the scalar loop.
+ */
+#define LEXER_SCAN_SPACE 0   // stop at the first non-whitespace byte
+#define LEXER_SCAN_LINE 1    // stop at '\n'
+#define LEXER_SCAN_STRING 2  // stop at '"'
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define LEXER_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEXER_SIMD_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(LEXER_SIMD_SSE2) || defined(LEXER_SIMD_AVX2)
+/*
+ * lexer_scan_block: Account for one block given its stop and newline masks
+ *
+ * Returns: 1 if the block contains a stop byte (pos is moved onto it), 0 otherwise
+ */
+static inline int lexer_scan_block(unsigned int stop, unsigned int newline, int *pos, int width,
+                                   int *newlines, int *last_newline)
+{
+    if (stop)
+    {
+        int index = __builtin_ctz(stop);
+        newline &= (1u << index) - 1;
+        width = index;
+    }
+    if (newline)
+    {
+        *newlines += __builtin_popcount(newline);
+        *last_newline = *pos + 31 - __builtin_clz(newline);
+    }
+    *pos += width;
+    return stop != 0;
+}
+#endif
+
+#ifdef LEXER_SIMD_AVX2
+/*
+ * lexer_has_avx2: Whether the CPU has AVX2, detected on first use
+ *
+ * Lexers run on the include parser's worker threads too, so the cached
+ * answer is read and written atomically.
+ */
+static int lexer_avx2 = -1;
+
+static int lexer_has_avx2(void)
+{
+    int avx2 = __atomic_load_n(&lexer_avx2, __ATOMIC_RELAXED);
+    if (avx2 < 0)
+    {
+        avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+        __atomic_store_n(&lexer_avx2, avx2, __ATOMIC_RELAXED);
+    }
+    return avx2;
+}
+
+__attribute__((target("avx2")))
+static int lexer_scan_avx2(const char *src, int *pos, int length, int kind, int *newlines, int *last_newline)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i target = _mm256_set1_epi8(kind == LEXER_SCAN_STRING ? '"' : '\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+
+    while (*pos + 32 <= length)
+    {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(src + *pos));
+        unsigned int newline = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl));
+        unsigned int stop;
+        if (kind == LEXER_SCAN_SPACE)
+        {
+            // isspace: ' ' or '\t'..'\r' (c - '\t' <= 4 unsigned)
+            __m256i rel = _mm256_sub_epi8(chunk, tab);
+            __m256i ctrl = _mm256_cmpeq_epi8(_mm256_min_epu8(rel, four), rel);
+            __m256i ws = _mm256_or_si256(ctrl, _mm256_cmpeq_epi8(chunk, space));
+            stop = ~(unsigned int)_mm256_movemask_epi8(ws);
+        }
+        else
+        {
+            stop = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, target));
+        }
+        if (lexer_scan_block(stop, newline, pos, 32, newlines, last_newline))
+            return 1;
+    }
+    return 0;
+}
+#endif
+
+#ifdef LEXER_SIMD_SSE2
+static int lexer_scan_sse2(const char *src, int *pos, int length, int kind, int *newlines, int *last_newline)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i target = _mm_set1_epi8(kind == LEXER_SCAN_STRING ? '"' : '\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+
+    while (*pos + 16 <= length)
+    {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(src + *pos));
+        unsigned int newline = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+        unsigned int stop;
+        if (kind == LEXER_SCAN_SPACE)
+        {
+            __m128i rel = _mm_sub_epi8(chunk, tab);
+            __m128i ctrl = _mm_cmpeq_epi8(_mm_min_epu8(rel, four), rel);
+            __m128i ws = _mm_or_si128(ctrl, _mm_cmpeq_epi8(chunk, space));
+            stop = ~(unsigned int)_mm_movemask_epi8(ws) & 0xFFFFu;
+        }
+        else
+        {
+            stop = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, target));
+        }
+        if (lexer_scan_block(stop, newline, pos, 16, newlines, last_newline))
+            return 1;
+    }
+    return 0;
+}
+#endif
+
+/*
+ * lexer_scan: Move the lexer to the end of a whitespace run, comment body or string
+ *
+ * Parameters:
+ *   lexer: The lexer instance
+ *   kind: One of the LEXER_SCAN_* constants
+ */
+static void lexer_scan(Lexer *lexer, int kind)
+{
+    const char *src = lexer->source;
+    int pos = lexer->position;
+    int length = lexer->length;
+    int newlines = 0;
+    int last_newline = -1;
+    int found = 0;
+
+#ifdef LEXER_SIMD_AVX2
+    if (lexer_has_avx2())
+        found = lexer_scan_avx2(src, &pos, length, kind, &newlines, &last_newline);
+#endif
+#ifdef LEXER_SIMD_SSE2
+    if (!found)
+        found = lexer_scan_sse2(src, &pos, length, kind, &newlines, &last_newline);
+#endif
+
+    // scalar tail (and the whole scan where no vector unit is available)
+    while (!found && pos < length)
+    {
+        char c = src[pos];
+        if (kind == LEXER_SCAN_SPACE ? !isspace((unsigned char)c)
+                                     : c == (kind == LEXER_SCAN_STRING ? '"' : '\n'))
+            break;
+        if (c == '\n')
+        {
+            newlines++;
+            last_newline = pos;
+        }
+        pos++;
+    }
+
+    if (newlines)
+    {
+        lexer->line += newlines;
+        lexer->column = pos - last_newline;
+    }
+    else
+    {
+        lexer->column += pos - lexer->position;
+    }
+    lexer->position = pos;
+}
+
 /*
  * lexer_skip_whitespace: Skip whitespace characters
  * 
@@ -122,10 +307,7 @@ static char lexer_advance(Lexer *lexer)
  */
 static void lexer_skip_whitespace(Lexer *lexer)
 {
-    while (isspace(lexer_peek(lexer)))
-    {
-        lexer_advance(lexer);
-    }
+    lexer_scan(lexer, LEXER_SCAN_SPACE);
 }
 
 /*
@@ -159,10 +341,7 @@ static void lexer_skip_comment(Lexer *lexer)
         {
             return; // Don't skip #involve directives
         }
-        while (lexer_peek(lexer) != '\n' && lexer_peek(lexer) != '\0')
-        {
-            lexer_advance(lexer);
-        }
+        lexer_scan(lexer, LEXER_SCAN_LINE);
     }
 }
 
@@ -194,7 +373,8 @@ static Token *token_create(TokenType type, const char *value, int line, int col)
  * lexer_read_number: Read a numeric literal token
  * 
  * Consumes digits and optional decimal points to form a number token.
- * Handles both integer and floating-point number formats.
+ * Handles both integer and floating-point number formats, plus the n
+ * (bigint) and m (decimal) literal suffixes.
  * 
  * Parameters:
  *   lexer: The lexer instance
@@ -213,6 +393,15 @@ static Token *lexer_read_number(Lexer *lexer)
         lexer_advance(lexer);
     }
 
+    // Optional n (bigint) or m (decimal) suffix, when not the start of a word
+    char suffix = lexer_peek(lexer);
+    if (suffix == 'n' || suffix == 'm')
+    {
+        char after = lexer->position + 1 < lexer->length ? lexer->source[lexer->position + 1] : '\0';
+        if (!isalnum((unsigned char)after) && after != '_')
+            lexer_advance(lexer);
+    }
+
     int length = lexer->position - start;
     char *value = malloc(length + 1);
     strncpy(value, lexer->source + start, length);
@@ -241,10 +430,7 @@ static Token *lexer_read_string(Lexer *lexer)
     lexer_advance(lexer); // consume opening quote
 
     int start = lexer->position;
-    while (lexer_peek(lexer) != '"' && lexer_peek(lexer) != '\0')
-    {
-        lexer_advance(lexer);
-    }
+    lexer_scan(lexer, LEXER_SCAN_STRING);
 
     int length = lexer->position - start;
     char *value = malloc(length + 1);
@@ -375,7 +561,56 @@ static Token *lexer_read_identifier(Lexer *lexer)
 }
 
 /*
- * lexer_next_token: Get the next token from the lexer
+ * lexer_symbol_allowed: Whether a colon before a name starts a :name symbol
+ *
+ * A colon right after something that ends an operand (x:int, class A:Base,
+ * case 1:x, "key":value) or after default stays a colon; anywhere an operand can start
+ * (after =, (, [, ",", return, case, another colon) it begins a symbol.
+ */
+static int lexer_symbol_allowed(Lexer *lexer)
+{
+    switch (lexer->previous)
+    {
+    case TOKEN_IDENTIFIER:
+    case TOKEN_NUMBER:
+    case TOKEN_STRING:
+    case TOKEN_SYMBOL:
+    case TOKEN_TRUE:
+    case TOKEN_FALSE:
+    case TOKEN_NULL:
+    case TOKEN_RPAREN:
+    case TOKEN_RBRACKET:
+    case TOKEN_RBRACE:
+    case TOKEN_INC:
+    case TOKEN_DEC:
+    case TOKEN_DEFAULT: // default:
+        return 0;
+    default:
+        return isalpha(lexer_peek(lexer)) || lexer_peek(lexer) == '_';
+    }
+}
+
+/*
+ * lexer_read_symbol: Read the name of a :name symbol after its colon
+ *
+ * Returns: A TOKEN_SYMBOL token whose value is the name without the colon
+ */
+static Token *lexer_read_symbol(Lexer *lexer, int line, int col)
+{
+    int start = lexer->position;
+    while (isalnum(lexer_peek(lexer)) || lexer_peek(lexer) == '_')
+        lexer_advance(lexer);
+    int length = lexer->position - start;
+    char *name = malloc(length + 1);
+    strncpy(name, lexer->source + start, length);
+    name[length] = '\0';
+    Token *token = token_create(TOKEN_SYMBOL, name, line, col);
+    free(name);
+    return token;
+}
+
+/*
+ * lexer_read_token: Read the next token
  * 
  * Main tokenization function that processes the lexer state and returns the next token.
  * Handles whitespace/comment skipping, EOF detection, and delegates to specialized readers
@@ -386,12 +621,16 @@ static Token *lexer_read_identifier(Lexer *lexer)
  * 
  * Returns: The next token in the input stream, or TOKEN_ERROR for unrecognized input
  */
-Token *lexer_next_token(Lexer *lexer)
+static Token *lexer_read_token(Lexer *lexer)
 {
-    // Skip whitespace and comments before tokenizing
-    lexer_skip_whitespace(lexer);
-    lexer_skip_comment(lexer);
-    lexer_skip_whitespace(lexer);
+    // Skip whitespace and comments (possibly several lines of them) before tokenizing
+    int before;
+    do
+    {
+        before = lexer->position;
+        lexer_skip_whitespace(lexer);
+        lexer_skip_comment(lexer);
+    } while (lexer->position != before);
 
     // Handle end of file
     if (lexer->position >= lexer->length)
@@ -474,12 +713,23 @@ Token *lexer_next_token(Lexer *lexer)
             
             // Skip whitespace after directive
             while (isspace(lexer_peek(lexer))) lexer_advance(lexer);
+
+            // #involve native "lib.so" loads a shared library instead of a script
+            TokenType involve_type = TOKEN_INVOLVE;
+            if (lexer->length - lexer->position > 6 &&
+                strncmp(lexer->source + lexer->position, "native", 6) == 0 &&
+                isspace((unsigned char)lexer->source[lexer->position + 6]))
+            {
+                for (int k = 0; k < 6; k++) lexer_advance(lexer);
+                while (isspace(lexer_peek(lexer))) lexer_advance(lexer);
+                involve_type = TOKEN_INVOLVE_NATIVE;
+            }
             
             // Expect string literal for file path
             if (lexer_peek(lexer) == '"')
             {
                 Token *path = lexer_read_string(lexer);
-                Token *tok = token_create(TOKEN_INVOLVE, path->value, line, col);
+                Token *tok = token_create(involve_type, path->value, line, col);
                 token_free(path);
                 return tok;
             }
@@ -563,6 +813,11 @@ Token *lexer_next_token(Lexer *lexer)
             lexer_advance(lexer);
             return token_create(TOKEN_LTE, "<=", line, col);
         }
+        if (lexer_peek(lexer) == '<')
+        {
+            lexer_advance(lexer);
+            return token_create(TOKEN_SHL, "<<", line, col);
+        }
         return token_create(TOKEN_LT, "<", line, col);
     case '>':
         if (lexer_peek(lexer) == '=')
@@ -570,6 +825,11 @@ Token *lexer_next_token(Lexer *lexer)
             lexer_advance(lexer);
             return token_create(TOKEN_GTE, ">=", line, col);
         }
+        if (lexer_peek(lexer) == '>')
+        {
+            lexer_advance(lexer);
+            return token_create(TOKEN_SHR, ">>", line, col);
+        }
         return token_create(TOKEN_GT, ">", line, col);
     case '&':
         if (lexer_peek(lexer) == '&')
@@ -577,28 +837,26 @@ Token *lexer_next_token(Lexer *lexer)
             lexer_advance(lexer);
             return token_create(TOKEN_AND, "&&", line, col);
         }
+        // &insert keyword; otherwise a bitwise and (only consume "insert" on a full match)
+        if (lexer->length - lexer->position >= 6 &&
+            strncmp(lexer->source + lexer->position, "insert", 6) == 0)
         {
-            int i = 0;
-            const char *kw = "insert";
-            while (kw[i] && lexer->position < lexer->length &&
-                   lexer->source[lexer->position] == kw[i])
-            {
+            for (int k = 0; k < 6; k++)
                 lexer_advance(lexer);
-                i++;
-            }
-            if (!kw[i])
-            {
-                return token_create(TOKEN_INSERT, "&insert", line, col);
-            }
+            return token_create(TOKEN_INSERT, "&insert", line, col);
         }
-        break;
+        return token_create(TOKEN_BIT_AND, "&", line, col);
     case '|':
         if (lexer_peek(lexer) == '|')
         {
             lexer_advance(lexer);
             return token_create(TOKEN_OR, "||", line, col);
         }
-        break;
+        return token_create(TOKEN_BIT_OR, "|", line, col);
+    case '^':
+        return token_create(TOKEN_BIT_XOR, "^", line, col);
+    case '~':
+        return token_create(TOKEN_BIT_NOT, "~", line, col);
         // I LOVE THIS
     case '(':
         return token_create(TOKEN_LPAREN, "(", line, col);
@@ -619,10 +877,30 @@ Token *lexer_next_token(Lexer *lexer)
     case ';':
         return token_create(TOKEN_SEMICOLON, ";", line, col);
     case ':':
+        if (lexer_symbol_allowed(lexer))
+            return lexer_read_symbol(lexer, line, col);
         return token_create(TOKEN_COLON, ":", line, col);
     }
 
     return token_create(TOKEN_ERROR, NULL, line, col);
 }
 
+/*
+ * lexer_next_token: Get the next token from the lexer
+ * 
+ * Remembers the token's type so the next call can tell a :name symbol from
+ * a colon.
+ * 
+ * Parameters:
+ *   lexer: The lexer instance
+ * 
+ * Returns: The next token in the input stream, or TOKEN_ERROR for unrecognized input
+ */
+Token *lexer_next_token(Lexer *lexer)
+{
+    Token *token = lexer_read_token(lexer);
+    lexer->previous = token->type;
+    return token;
+}
+
 // END OF lexer.c
@@ -9,12 +9,16 @@
 #include "include/lexer.h"
 #include "include/parser.h"
 #include "include/interpreter.h"
+#include "include/watch.h"
+#include "builtins/calcmem.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 // how to tell the compiler to shut up?
 
+static const char *memory_file = NULL; // --memory <file>
+
 char *read_file(const char *filename)
 {
     FILE *file = fopen(filename, "r");
@@ -43,6 +47,8 @@ void show_help(void)
     printf("Usage:\n");
     printf("  sharpscript            - Starts the interactive REPL\n");
     printf("  sharpscript <file>     - Executes a .sharp script\n");
+    printf("  sharpscript --watch <file> - Executes a script and reloads it when it or its includes change\n");
+    printf("  sharpscript --memory <store> [...] - Keeps system.store values in <store> across runs\n");
     printf("  sharpscript --help     - Displays this help message\n\n");
     
     printf("Language Syntax Overview:\n");
@@ -57,6 +63,8 @@ void show_help(void)
 void run_repl(void)
 {
     Interpreter *interp = interpreter_create();
+    if (memory_file)
+        calcmem_open(interp->memory, memory_file);
     char line[1024];
 
     printf("SharpScript REPL v1.0\n");
@@ -94,9 +102,11 @@ void run_file(const char *filename)
 
     Lexer *lexer = lexer_create(source);
     Parser *parser = parser_create(lexer);
-    ASTNode *ast = parser_parse(parser);
+    ASTNode *ast = parser_parse_parallel(parser);
 
     Interpreter *interp = interpreter_create();
+    if (memory_file)
+        calcmem_open(interp->memory, memory_file);
     Value *result = interpreter_eval(interp, ast);
     value_free(result);
 
@@ -118,6 +128,12 @@ int main(int argc, char* argv[]) {
         show_help();
         return 0;
     }
+    // --memory <file> may come before any of the other forms
+    if (argc >= 3 && strcmp(argv[1], "--memory") == 0) {
+        memory_file = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
     if (argc == 1) {
         run_repl();
         return 0;
@@ -126,6 +142,10 @@ int main(int argc, char* argv[]) {
         run_file(argv[1]);
         return 0;
     }
+    if (argc == 3 && strcmp(argv[1], "--watch") == 0) {
+        watch_run(argv[2], memory_file);
+        return 0;
+    }
     // never knew why compilers do this error but i kinda like it
     fprintf(stderr, "Error: Too many arguments.\n");
     show_help();
@@ -10,6 +10,15 @@
 #include <string.h>
 #include <stdio.h>
 
+/* Allocations made so far; worker threads allocate too, so updates are atomic */
+static size_t allocation_count;
+
+#ifdef __GNUC__
+#define COUNT_ALLOCATION() __atomic_fetch_add(&allocation_count, 1, __ATOMIC_RELAXED)
+#else
+#define COUNT_ALLOCATION() (allocation_count++)
+#endif
+
 /*
  * memory_allocate: Allocate memory with error handling
  * 
@@ -26,6 +35,7 @@
 void *memory_allocate(size_t size)
 {
     void *ptr = malloc(size);
+    COUNT_ALLOCATION();
     if (!ptr)
     {
         fprintf(stderr, "Memory allocation failed\n");
@@ -51,6 +61,7 @@ void *memory_allocate(size_t size)
 void *memory_reallocate(void *ptr, size_t size)
 {
     void *new_ptr = realloc(ptr, size);
+    COUNT_ALLOCATION();
     if (!new_ptr)
     {
         fprintf(stderr, "Memory reallocation failed\n");
@@ -99,4 +110,18 @@ char *memory_strdup(const char *str)
     return copy;
 }
 
+/*
+ * memory_allocation_count: Number of memory_allocate and memory_reallocate calls so far
+ *
+ * Used by system.bench to report allocations per iteration.
+ */
+size_t memory_allocation_count(void)
+{
+#ifdef __GNUC__
+    return __atomic_load_n(&allocation_count, __ATOMIC_RELAXED);
+#else
+    return allocation_count;
+#endif
+}
+
 // END OF memory.c
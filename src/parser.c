@@ -10,6 +10,14 @@
 #include "include/memory.h"
 #include <stdio.h>
 #include <stdlib.h> // For atof
+#include <errno.h>
+
+// Included files are parsed on a thread pool where POSIX threads are available
+#ifndef _WIN32
+#define PARSER_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 /*
  * parser_create: Create a new parser instance
@@ -27,16 +35,24 @@ Parser *parser_create(Lexer *lexer)
     Parser *parser = memory_allocate(sizeof(Parser));
     parser->lexer = lexer;
     parser->current_token = lexer_next_token(lexer);
+    parser->lookahead_head = 0;
+    parser->lookahead_count = 0;
     parser->include_paths = memory_allocate(sizeof(char *) * 8);
     parser->include_count = 0;
     parser->include_capacity = 8;
+    parser->parent = NULL;
+    parser->cache = NULL;
+    parser->deferred = NULL;
+    parser->deferred_count = 0;
+    parser->deferred_capacity = 0;
     return parser;
 }
 
 /*
  * parser_free: Free a parser and all its resources
  * 
- * Frees the current token, all include paths, and the parser structure itself.
+ * Frees the current token, any tokens buffered for lookahead, all include
+ * paths, and the parser structure itself.
  * 
  * Parameters:
  *   parser: The parser to free
@@ -44,18 +60,24 @@ Parser *parser_create(Lexer *lexer)
 void parser_free(Parser *parser)
 {
     token_free(parser->current_token);
+    for (int i = 0; i < parser->lookahead_count; i++)
+    {
+        token_free(parser->lookahead[(parser->lookahead_head + i) & (PARSER_LOOKAHEAD - 1)]);
+    }
     for (int i = 0; i < parser->include_count; i++)
     {
         memory_free(parser->include_paths[i]);
     }
     memory_free(parser->include_paths);
+    memory_free(parser->deferred);
     memory_free(parser);
 }
 
 /*
  * parser_advance: Advance to the next token
  * 
- * Frees the current token and gets the next token from the lexer.
+ * Frees the current token and takes the next one from the lookahead buffer,
+ * or from the lexer when nothing has been peeked.
  * This is the primary way to move through the token stream during parsing.
  * 
  * Parameters:
@@ -64,6 +86,13 @@ void parser_free(Parser *parser)
 static void parser_advance(Parser *parser)
 {
     token_free(parser->current_token);
+    if (parser->lookahead_count > 0)
+    {
+        parser->current_token = parser->lookahead[parser->lookahead_head];
+        parser->lookahead_head = (parser->lookahead_head + 1) & (PARSER_LOOKAHEAD - 1);
+        parser->lookahead_count--;
+        return;
+    }
     parser->current_token = lexer_next_token(parser->lexer);
 }
 
@@ -83,8 +112,8 @@ static int parser_expect(Parser *parser, TokenType type)
 {
     if (parser->current_token->type != type)
     {
-        fprintf(stderr, "Parse error at line %d: unexpected token '%s', expected type %d\n",
-                parser->current_token->line, parser->current_token->value, type);
+        fprintf(stderr, "Parse error at line %d, column %d: unexpected token '%s', expected type %d\n",
+                parser->current_token->line, parser->current_token->column, parser->current_token->value, type);
         return 0;
     }
     parser_advance(parser);
@@ -92,35 +121,33 @@ static int parser_expect(Parser *parser, TokenType type)
 }
 
 /*
- * parser_peek_token: Peek at the next token without consuming it
+ * parser_peek_token: Peek at a token after the current one without consuming it
  * 
- * Gets the next token from the lexer while preserving the current lexer state.
- * This allows looking ahead in the token stream without advancing the current position.
+ * Tokens are lexed once into a ring buffer and handed to parser_advance later,
+ * so looking ahead never re-runs the lexer.
  * 
  * Parameters:
  *   parser: The parser instance
+ *   offset: 1 for the token after current_token, up to PARSER_LOOKAHEAD
  * 
- * Returns: The next token (caller must free it)
+ * Returns: The token (owned by the parser, valid until it is advanced past)
  */
-static Token *parser_peek_token(Parser *parser)
+static Token *parser_peek_token(Parser *parser, int offset)
 {
-    int pos = parser->lexer->position;
-    int line = parser->lexer->line;
-    int col = parser->lexer->column;
-    
-    Token *tok = lexer_next_token(parser->lexer);
-    
-    parser->lexer->position = pos;
-    parser->lexer->line = line;
-    parser->lexer->column = col;
-    
-    return tok;
+    while (parser->lookahead_count < offset)
+    {
+        int slot = (parser->lookahead_head + parser->lookahead_count) & (PARSER_LOOKAHEAD - 1);
+        parser->lookahead[slot] = lexer_next_token(parser->lexer);
+        parser->lookahead_count++;
+    }
+    return parser->lookahead[(parser->lookahead_head + offset - 1) & (PARSER_LOOKAHEAD - 1)];
 }
 
 /*
  * parser_has_included: Check if a file has already been included
  * 
  * Prevents circular includes by checking if a file path is already in the include history.
+ * The history is kept by the root parser, so nested includes share it.
  * 
  * Parameters:
  *   parser: The parser instance
@@ -130,6 +157,8 @@ static Token *parser_peek_token(Parser *parser)
  */
 static int parser_has_included(Parser *parser, const char *path)
 {
+    while (parser->parent)
+        parser = parser->parent;
     for (int i = 0; i < parser->include_count; i++)
     {
         if (strcmp(parser->include_paths[i], path) == 0)
@@ -142,14 +171,19 @@ static int parser_has_included(Parser *parser, const char *path)
  * parser_add_include: Add a file path to the include history
  * 
  * Records that a file has been included to prevent circular includes.
+ * Paths are recorded on the root parser, which therefore ends up holding every
+ * file the program pulls in. Seeding a fresh parser with paths makes it skip
+ * those includes (used by watch mode to re-parse only changed files).
  * Dynamically resizes the include_paths array if needed.
  * 
  * Parameters:
  *   parser: The parser instance
  *   path: The file path to add (will be copied)
  */
-static void parser_add_include(Parser *parser, const char *path)
+void parser_add_include(Parser *parser, const char *path)
 {
+    while (parser->parent)
+        parser = parser->parent;
     if (parser->include_count >= parser->include_capacity)
     {
         parser->include_capacity *= 2;
@@ -157,6 +191,80 @@ static void parser_add_include(Parser *parser, const char *path)
     }
     parser->include_paths[parser->include_count++] = memory_strdup(path);
 }
+/*
+ * parser_resolve_include: Resolve the path of an included file
+ * 
+ * Paths are tried as given first, then relative to src/ (where the bundled
+ * libraries live).
+ * 
+ * Parameters:
+ *   path: The path as written in the directive
+ * 
+ * Returns: The resolved path (caller must free it)
+ */
+static char *parser_resolve_include(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (f)
+    {
+        fclose(f);
+        return memory_strdup(path);
+    }
+    char *full = memory_allocate(strlen("src/") + strlen(path) + 1);
+    sprintf(full, "src/%s", path);
+    return full;
+}
+
+/*
+ * parser_read_source: Read an included file into memory
+ * 
+ * Parameters:
+ *   path: The resolved path of the file
+ * 
+ * Returns: The file content (caller must free it), or NULL if it cannot be opened
+ */
+static char *parser_read_source(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *content = malloc(size + 1);
+    size_t n = fread(content, 1, size, file);
+    content[n] = '\0';
+    fclose(file);
+    return content;
+}
+
+static void include_cache_request(struct IncludeCache *cache, const char *path);
+
+/*
+ * parser_defer_include: Create a placeholder for an include parsed in parallel
+ * 
+ * Records the placeholder so it can be spliced in declaration order and asks
+ * the include pool to parse the file.
+ * 
+ * Parameters:
+ *   parser: The parser instance (in parallel mode)
+ *   path: The resolved path of the included file
+ * 
+ * Returns: The placeholder node
+ */
+static ASTNode *parser_defer_include(Parser *parser, const char *path)
+{
+    ASTNode *placeholder = ast_create_include(path);
+    if (parser->deferred_count >= parser->deferred_capacity)
+    {
+        parser->deferred_capacity = parser->deferred_capacity ? parser->deferred_capacity * 2 : 8;
+        parser->deferred = memory_reallocate(parser->deferred, sizeof(ASTNode *) * parser->deferred_capacity);
+    }
+    parser->deferred[parser->deferred_count++] = placeholder;
+    include_cache_request(parser->cache, path);
+    return placeholder;
+}
+
 static ASTNode *parse_expression(Parser *parser);
 static ASTNode *parse_statement(Parser *parser);
 static ASTNode *parse_block(Parser *parser);
@@ -187,6 +295,27 @@ static ASTNode *parse_primary(Parser *parser)
 
     if (token->type == TOKEN_NUMBER)
     {
+        size_t len = strlen(token->value);
+        char suffix = len ? token->value[len - 1] : '\0';
+        if (suffix == 'n' || suffix == 'm')
+        {
+            // bigint (n) or decimal (m) literal, evaluated exactly from its digits
+            char *digits = memory_strdup(token->value);
+            digits[len - 1] = '\0';
+            ASTNode *node = ast_create_bignum(digits, suffix == 'm');
+            memory_free(digits);
+            parser_advance(parser);
+            return node;
+        }
+        // Literals without a decimal point are integers; past 64 bits they become bigints
+        if (!strchr(token->value, '.'))
+        {
+            errno = 0;
+            long long integer = strtoll(token->value, NULL, 10);
+            ASTNode *node = errno != ERANGE ? ast_create_integer(integer) : ast_create_bignum(token->value, 0);
+            parser_advance(parser);
+            return node;
+        }
         double value = atof(token->value);
         parser_advance(parser);
         return ast_create_number(value);
@@ -199,6 +328,13 @@ static ASTNode *parse_primary(Parser *parser)
         return node;
     }
 
+    if (token->type == TOKEN_SYMBOL)
+    {
+        ASTNode *node = ast_create_symbol(token->value);
+        parser_advance(parser);
+        return node;
+    }
+
     if (token->type == TOKEN_TRUE)
     {
         parser_advance(parser);
@@ -459,8 +595,8 @@ static ASTNode *parse_primary(Parser *parser)
         return ast_create_call(func_name, args, count);
     }
 
-    fprintf(stderr, "Parse error: unexpected token at line %d: %s\n",
-            token->line, token->value ? token->value : "<unknown>");
+    fprintf(stderr, "Parse error: unexpected token at line %d, column %d: %s\n",
+            token->line, token->column, token->value ? token->value : "<unknown>");
     parser_advance(parser);
     return ast_create_null();
 }
@@ -518,9 +654,10 @@ static ASTNode *parse_postfix(Parser *parser)
  */
 static ASTNode *parse_unary(Parser *parser)
 {
-    // Handle unary operators: ! or -
+    // Handle unary operators: !, - or ~
     if (parser->current_token->type == TOKEN_NOT ||
-        parser->current_token->type == TOKEN_SUB)
+        parser->current_token->type == TOKEN_SUB ||
+        parser->current_token->type == TOKEN_BIT_NOT)
     {
         TokenType op = parser->current_token->type;
         parser_advance(parser); // eat operator
@@ -597,15 +734,42 @@ static ASTNode *parse_additive(Parser *parser)
  * 
  * Returns: The parsed AST node for the comparison expression
  */
+static ASTNode *parse_shift(Parser *parser);
+
 static ASTNode *parse_comparison(Parser *parser)
 {
-    ASTNode *left = parse_additive(parser);
+    ASTNode *left = parse_shift(parser);
 
     // Handle left-associative comparison operators
     while (parser->current_token->type == TOKEN_LT ||
            parser->current_token->type == TOKEN_GT ||
            parser->current_token->type == TOKEN_LTE ||
            parser->current_token->type == TOKEN_GTE)
+    {
+        TokenType op = parser->current_token->type;
+        parser_advance(parser); // eat operator
+        left = ast_create_binary_op(op, left, parse_shift(parser));
+    }
+
+    return left;
+}
+
+/*
+ * parse_shift: Parse shift expressions (<<, >>)
+ * 
+ * Binds tighter than comparisons and looser than additive operations, as in C.
+ * 
+ * Parameters:
+ *   parser: The parser instance
+ * 
+ * Returns: The parsed AST node for the shift expression
+ */
+static ASTNode *parse_shift(Parser *parser)
+{
+    ASTNode *left = parse_additive(parser);
+
+    while (parser->current_token->type == TOKEN_SHL ||
+           parser->current_token->type == TOKEN_SHR)
     {
         TokenType op = parser->current_token->type;
         parser_advance(parser); // eat operator
@@ -642,11 +806,38 @@ static ASTNode *parse_equality(Parser *parser)
     return left;
 }
 
+/*
+ * parse_bitwise: Parse bitwise and/xor/or expressions (&, ^, |)
+ * 
+ * The three levels sit between equality and logical AND with C's relative
+ * precedence (& binds tightest, then ^, then |).
+ * 
+ * Parameters:
+ *   parser: The parser instance
+ *   level: 0 for |, 1 for ^, 2 for &
+ * 
+ * Returns: The parsed AST node for the bitwise expression
+ */
+static ASTNode *parse_bitwise(Parser *parser, int level)
+{
+    static const TokenType ops[] = {TOKEN_BIT_OR, TOKEN_BIT_XOR, TOKEN_BIT_AND};
+    ASTNode *left = level < 2 ? parse_bitwise(parser, level + 1) : parse_equality(parser);
+
+    while (parser->current_token->type == ops[level])
+    {
+        parser_advance(parser); // eat operator
+        ASTNode *right = level < 2 ? parse_bitwise(parser, level + 1) : parse_equality(parser);
+        left = ast_create_binary_op(ops[level], left, right);
+    }
+
+    return left;
+}
+
 /*
  * parse_logical_and: Parse logical AND expressions (&&)
  * 
  * Handles logical AND operations with left associativity.
- * Lower precedence than equality operations.
+ * Lower precedence than bitwise operations.
  * 
  * Parameters:
  *   parser: The parser instance
@@ -655,14 +846,14 @@ static ASTNode *parse_equality(Parser *parser)
  */
 static ASTNode *parse_logical_and(Parser *parser)
 {
-    ASTNode *left = parse_equality(parser);
+    ASTNode *left = parse_bitwise(parser, 0);
 
     // Handle left-associative logical AND
     while (parser->current_token->type == TOKEN_AND)
     {
         TokenType op = parser->current_token->type;
         parser_advance(parser); // eat operator
-        left = ast_create_binary_op(op, left, parse_equality(parser));
+        left = ast_create_binary_op(op, left, parse_bitwise(parser, 0));
     }
 
     return left;
@@ -1008,11 +1199,7 @@ static ASTNode *parse_for_statement(Parser *parser)
     // Check for for-in loop: for (identifier in collection)
     if (parser->current_token->type == TOKEN_IDENTIFIER)
     {
-        Token *peek = parser_peek_token(parser);
-        int is_in = (peek->type == TOKEN_IN);
-        token_free(peek);
-
-        if (is_in)
+        if (parser_peek_token(parser, 1)->type == TOKEN_IN)
         {
             char *var = memory_strdup(parser->current_token->value);
             parser_advance(parser); // eat var
@@ -1313,62 +1500,53 @@ static ASTNode *parse_statement(Parser *parser)
     if (parser->current_token->type == TOKEN_TRY)
         return parse_try(parser);
         
+    // Handle native module involves: loaded at run time through system.load
+    if (parser->current_token->type == TOKEN_INVOLVE_NATIVE)
+    {
+        ASTNode **args = memory_allocate(sizeof(ASTNode *));
+        args[0] = ast_create_string(parser->current_token->value);
+        parser_advance(parser); // eat involve native
+        return ast_create_call("system.load", args, 1);
+    }
+
     // Handle include/involve statements (file inclusion)
     if (parser->current_token->type == TOKEN_INCLUDE || parser->current_token->type == TOKEN_INVOLVE)
     {
         char *path = memory_strdup(parser->current_token->value);
         parser_advance(parser); // eat include/involve
-        char *full = NULL;
-        
-        // Try to open file directly first
-        FILE *f = fopen(path, "r");
-        if (!f)
-        {
-            // Try with src/ prefix
-            int len = strlen("src/") + strlen(path) + 1;
-            full = memory_allocate(len);
-            sprintf(full, "src/%s", path);
-        }
-        else
+        char *full = parser_resolve_include(path);
+        memory_free(path);
+
+        // Parallel mode: leave a placeholder, the file is parsed by the include pool
+        if (parser->cache)
         {
-            full = memory_strdup(path);
-            fclose(f);
+            ASTNode *placeholder = parser_defer_include(parser, full);
+            memory_free(full);
+            return placeholder;
         }
         
-        const char *guard_path = full ? full : path;
-        
         // Check if file has already been included (prevent circular includes)
-        if (parser_has_included(parser, guard_path))
+        if (parser_has_included(parser, full))
         {
-            if (full) memory_free(full);
-            memory_free(path);
+            memory_free(full);
             return ast_create_null();
         }
         
-        parser_add_include(parser, guard_path);
+        parser_add_include(parser, full);
         
         // Open and read the file
-        FILE *file = fopen(full, "r");
-        if (!file)
+        char *content = parser_read_source(full);
+        if (!content)
         {
             fprintf(stderr, "Include error: could not open %s\n", full);
-            if (full) memory_free(full);
-            memory_free(path);
+            memory_free(full);
             return ast_create_null();
         }
         
-        // Read entire file content
-        fseek(file, 0, SEEK_END);
-        long size = ftell(file);
-        fseek(file, 0, SEEK_SET);
-        char *content = malloc(size + 1);
-        fread(content, 1, size, file);
-        content[size] = '\0';
-        fclose(file);
-        
         // Create lexer and parser for included file
         Lexer *inc_lexer = lexer_create(content);
         Parser *inc_parser = parser_create(inc_lexer);
+        inc_parser->parent = parser;
         
         // Parse the included file
         ASTNode *inc_ast = parser_parse(inc_parser);
@@ -1377,8 +1555,7 @@ static ASTNode *parse_statement(Parser *parser)
         parser_free(inc_parser);
         lexer_free(inc_lexer);
         free(content);
-        if (full) memory_free(full);
-        memory_free(path);
+        memory_free(full);
         return inc_ast;
     }
     // Handle namespace declarations
@@ -1550,7 +1727,13 @@ static ASTNode *parse_statement(Parser *parser)
         }
 
     // Regular variable assignment or increment/decrement
-    if (parser->current_token->type == TOKEN_IDENTIFIER)
+    // Peek first so an identifier starting a plain expression is left in place
+    TokenType after = parser->current_token->type == TOKEN_IDENTIFIER
+                          ? parser_peek_token(parser, 1)->type
+                          : TOKEN_EOF;
+    if (after == TOKEN_ASSIGN || after == TOKEN_PLUS_ASSIGN || after == TOKEN_MINUS_ASSIGN ||
+        after == TOKEN_MUL_ASSIGN || after == TOKEN_DIV_ASSIGN || after == TOKEN_MOD_ASSIGN ||
+        after == TOKEN_INC || after == TOKEN_DEC || after == TOKEN_LPAREN)
     {
         char *name = memory_strdup(parser->current_token->value);
         parser_advance(parser); // eat identifier
@@ -1576,7 +1759,7 @@ static ASTNode *parse_statement(Parser *parser)
         {
             TokenType incdec = parser->current_token->type;
             parser_advance(parser); // eat ++ or --
-            ASTNode *one = ast_create_number(1);
+            ASTNode *one = ast_create_integer(1);
             TokenType op = (incdec == TOKEN_INC) ? TOKEN_PLUS_ASSIGN : TOKEN_MINUS_ASSIGN;
             ASTNode *assign = ast_create_assign(name, one, op);
             memory_free(name);
@@ -1621,11 +1804,6 @@ static ASTNode *parse_statement(Parser *parser)
             memory_free(name);
             return call;
         }
-        else if (parser->current_token->type == TOKEN_NEW)
-        {
-            // Future enhancement: support 'new' prefix for object instantiation
-            // Currently handled as builtin function calls
-        }
         memory_free(name);
     }
 
@@ -1674,3 +1852,328 @@ ASTNode *parser_parse(Parser *parser)
     // Create block node containing all parsed statements
     return ast_create_block(statements, count);
 }
+
+/*
+ * Parallel include parsing
+ * 
+ * parser_parse_parallel parses the root file with includes deferred: every
+ * #include/#involve becomes a placeholder and the file is handed to a pool of
+ * worker threads, which parse it the same way (so nested includes fan out too).
+ * A cheap text pre-scan of each file queues its includes before parsing starts.
+ * Once the root is parsed, placeholders are replaced in declaration order,
+ * applying the include-once guard exactly as the sequential parser would, so
+ * the resulting tree is identical. Trees of files that end up guarded out are
+ * discarded. Worker threads are started lazily, so programs without includes
+ * pay nothing.
+ */
+
+typedef struct IncludeJob
+{
+    char *path;              // resolved path
+    ASTNode *ast;            // parsed tree, NULL if the file could not be read
+    ASTNode **placeholders;  // includes inside the file, in parse order
+    int placeholder_count;
+    int done;
+} IncludeJob;
+
+typedef struct IncludeCache
+{
+    IncludeJob **jobs;
+    int job_count;
+    int job_capacity;
+    int next_job;            // first job no worker has picked up yet
+    char **skip;             // paths already loaded before parsing started
+    int skip_count;
+    int shutdown;
+#ifdef PARSER_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t job_done;
+    pthread_t *threads;
+    int thread_count;
+    int max_threads;
+#endif
+} IncludeCache;
+
+static void include_parse_job(IncludeCache *cache, IncludeJob *job);
+
+#ifdef PARSER_THREADS
+static void *include_worker(void *arg)
+{
+    IncludeCache *cache = arg;
+    pthread_mutex_lock(&cache->lock);
+    while (1)
+    {
+        while (cache->next_job >= cache->job_count && !cache->shutdown)
+            pthread_cond_wait(&cache->work_ready, &cache->lock);
+        if (cache->next_job >= cache->job_count)
+            break;
+        IncludeJob *job = cache->jobs[cache->next_job++];
+        pthread_mutex_unlock(&cache->lock);
+
+        include_parse_job(cache, job);
+
+        pthread_mutex_lock(&cache->lock);
+        job->done = 1;
+        pthread_cond_broadcast(&cache->job_done);
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return NULL;
+}
+#endif
+
+/*
+ * include_cache_request: Queue a file for parsing unless already known
+ */
+static void include_cache_request(IncludeCache *cache, const char *path)
+{
+#ifdef PARSER_THREADS
+    pthread_mutex_lock(&cache->lock);
+#endif
+    int known = 0;
+    for (int i = 0; i < cache->skip_count && !known; i++)
+        known = strcmp(cache->skip[i], path) == 0;
+    for (int i = 0; i < cache->job_count && !known; i++)
+        known = strcmp(cache->jobs[i]->path, path) == 0;
+
+    if (!known)
+    {
+        if (cache->job_count >= cache->job_capacity)
+        {
+            cache->job_capacity = cache->job_capacity ? cache->job_capacity * 2 : 8;
+            cache->jobs = memory_reallocate(cache->jobs, sizeof(IncludeJob *) * cache->job_capacity);
+        }
+        IncludeJob *job = memory_allocate(sizeof(IncludeJob));
+        job->path = memory_strdup(path);
+        job->ast = NULL;
+        job->placeholders = NULL;
+        job->placeholder_count = 0;
+        job->done = 0;
+        cache->jobs[cache->job_count++] = job;
+#ifdef PARSER_THREADS
+        // grow the pool while there is more queued work than workers
+        int queued = cache->job_count - cache->next_job;
+        if (cache->thread_count < cache->max_threads && queued > 0)
+        {
+            if (pthread_create(&cache->threads[cache->thread_count], NULL, include_worker, cache) == 0)
+                cache->thread_count++;
+        }
+        pthread_cond_signal(&cache->work_ready);
+#endif
+    }
+#ifdef PARSER_THREADS
+    pthread_mutex_unlock(&cache->lock);
+#endif
+}
+
+/*
+ * include_prescan: Queue the includes of a source text before parsing it
+ * 
+ * Looks for lines starting with #include/#involve followed by a quoted path.
+ * This is only a head start for the pool; the parser still requests every
+ * include it actually meets.
+ */
+static void include_prescan(IncludeCache *cache, const char *source)
+{
+    const char *p = source;
+    while (*p)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+            p++;
+        if (strncmp(p, "#include", 8) == 0 || strncmp(p, "#involve", 8) == 0)
+        {
+            const char *q = p + 8;
+            while (*q == ' ' || *q == '\t')
+                q++;
+            const char *end = *q == '"' ? strchr(q + 1, '"') : NULL;
+            if (end && !memchr(q + 1, '\n', end - q - 1))
+            {
+                int len = (int)(end - q - 1);
+                char *path = memory_allocate(len + 1);
+                memcpy(path, q + 1, len);
+                path[len] = '\0';
+                char *full = parser_resolve_include(path);
+                include_cache_request(cache, full);
+                memory_free(full);
+                memory_free(path);
+            }
+        }
+        while (*p && *p != '\n')
+            p++;
+    }
+}
+
+/*
+ * include_parse_job: Parse one included file with its own includes deferred
+ */
+static void include_parse_job(IncludeCache *cache, IncludeJob *job)
+{
+    char *content = parser_read_source(job->path);
+    if (!content)
+        return;
+    include_prescan(cache, content);
+
+    Lexer *lexer = lexer_create(content);
+    Parser *parser = parser_create(lexer);
+    parser->cache = cache;
+    job->ast = parser_parse(parser);
+
+    job->placeholders = parser->deferred;
+    job->placeholder_count = parser->deferred_count;
+    parser->deferred = NULL;
+    parser_free(parser);
+    lexer_free(lexer);
+    free(content);
+}
+
+/*
+ * include_cache_wait: Get the finished job for a path
+ * 
+ * Without threads the job is parsed on the spot.
+ */
+static IncludeJob *include_cache_wait(IncludeCache *cache, const char *path)
+{
+    IncludeJob *job = NULL;
+#ifdef PARSER_THREADS
+    pthread_mutex_lock(&cache->lock);
+#endif
+    for (int i = 0; i < cache->job_count && !job; i++)
+    {
+        if (strcmp(cache->jobs[i]->path, path) == 0)
+            job = cache->jobs[i];
+    }
+#ifdef PARSER_THREADS
+    while (job && !job->done)
+        pthread_cond_wait(&cache->job_done, &cache->lock);
+    pthread_mutex_unlock(&cache->lock);
+#else
+    if (job && !job->done)
+    {
+        include_parse_job(cache, job);
+        job->done = 1;
+    }
+#endif
+    return job;
+}
+
+/*
+ * include_splice: Replace placeholders with the trees of the included files
+ * 
+ * Walks placeholders in declaration order, depth first, which reproduces the
+ * order in which the sequential parser would have met each include.
+ */
+static void include_splice(Parser *root, IncludeCache *cache, ASTNode **placeholders, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        ASTNode *placeholder = placeholders[i];
+        char *path = placeholder->data.include.path;
+        ASTNode *tree = NULL;
+
+        if (!parser_has_included(root, path))
+        {
+            parser_add_include(root, path);
+            IncludeJob *job = include_cache_wait(cache, path);
+            if (job && job->ast)
+            {
+                include_splice(root, cache, job->placeholders, job->placeholder_count);
+                tree = job->ast;
+                job->ast = NULL;
+            }
+            else
+            {
+                fprintf(stderr, "Include error: could not open %s\n", path);
+            }
+        }
+
+        memory_free(path);
+        if (tree)
+        {
+            *placeholder = *tree;
+            memory_free(tree);
+        }
+        else
+        {
+            placeholder->type = AST_NULL;
+        }
+    }
+}
+
+/*
+ * parser_parse_parallel: Parse a program, parsing included files concurrently
+ * 
+ * Produces the same tree as parser_parse. Paths already in the parser's
+ * include history are treated as loaded and never parsed.
+ * 
+ * Parameters:
+ *   parser: The parser instance for the root file
+ * 
+ * Returns: The root AST node containing all parsed statements
+ */
+ASTNode *parser_parse_parallel(Parser *parser)
+{
+    IncludeCache cache;
+    memset(&cache, 0, sizeof(cache));
+    cache.skip = parser->include_paths;
+    cache.skip_count = parser->include_count;
+#ifdef PARSER_THREADS
+    pthread_mutex_init(&cache.lock, NULL);
+    pthread_cond_init(&cache.work_ready, NULL);
+    pthread_cond_init(&cache.job_done, NULL);
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cache.max_threads = cpus < 1 ? 1 : (cpus > 16 ? 16 : (int)cpus);
+    cache.threads = memory_allocate(sizeof(pthread_t) * cache.max_threads);
+#endif
+
+    include_prescan(&cache, parser->lexer->source + parser->lexer->position);
+    parser->cache = &cache;
+    ASTNode *ast = parser_parse(parser);
+    parser->cache = NULL;
+
+    // the skip list aliases the history, which splicing is about to grow
+    ASTNode **placeholders = parser->deferred;
+    int placeholder_count = parser->deferred_count;
+    parser->deferred = NULL;
+    parser->deferred_count = 0;
+    parser->deferred_capacity = 0;
+
+#ifdef PARSER_THREADS
+    pthread_mutex_lock(&cache.lock);
+    cache.skip = NULL;
+    cache.skip_count = 0;
+    pthread_mutex_unlock(&cache.lock);
+#else
+    cache.skip = NULL;
+    cache.skip_count = 0;
+#endif
+    include_splice(parser, &cache, placeholders, placeholder_count);
+    memory_free(placeholders);
+
+#ifdef PARSER_THREADS
+    pthread_mutex_lock(&cache.lock);
+    cache.shutdown = 1;
+    pthread_cond_broadcast(&cache.work_ready);
+    pthread_mutex_unlock(&cache.lock);
+    for (int i = 0; i < cache.thread_count; i++)
+        pthread_join(cache.threads[i], NULL);
+    memory_free(cache.threads);
+    pthread_cond_destroy(&cache.job_done);
+    pthread_cond_destroy(&cache.work_ready);
+    pthread_mutex_destroy(&cache.lock);
+#endif
+
+    // drop trees of files that were never spliced in (guarded out)
+    for (int i = 0; i < cache.job_count; i++)
+    {
+        IncludeJob *job = cache.jobs[i];
+        if (job->ast)
+            ast_free(job->ast);
+        memory_free(job->placeholders);
+        memory_free(job->path);
+        memory_free(job);
+    }
+    memory_free(cache.jobs);
+    return ast;
+}
+
+// END OF parser.c
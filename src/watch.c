@@ -0,0 +1,331 @@
+/*
+    Copyright (c) 2024-2026 SharpScript Programming Language
+
+    Licensed under the MIT License
+*/
+
+// START OF watch.c
+
+/*
+ * Watch mode (sharpscript --watch <file>)
+ *
+ * The script runs once as usual, but the interpreter stays alive afterwards.
+ * Every file pulled in through #include/#involve is tracked (the root parser
+ * records them all in its include history). When a file changes, only that
+ * file is re-parsed: its parser is seeded with the other tracked paths so
+ * unchanged includes are skipped, and its definitions are evaluated into the
+ * live interpreter in redefine mode. main(void) is then invoked again.
+ *
+ * Linux uses inotify on the directories of the tracked files (editors often
+ * save by renaming over the original); other platforms poll modification times.
+ */
+
+#include "include/watch.h"
+#include "include/lexer.h"
+#include "include/parser.h"
+#include "include/interpreter.h"
+#include "include/memory.h"
+#include "builtins/calcmem.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+typedef struct
+{
+    char *path;     // path as recorded by the parser (openable from the working directory)
+    char *base;     // file name part of path
+    time_t mtime;
+    int wd;         // inotify watch descriptor of the containing directory
+    int changed;
+} WatchedFile;
+
+typedef struct
+{
+    Interpreter *interp;
+    WatchedFile *files; // files[0] is the main script
+    int file_count;
+    int file_capacity;
+    ASTNode **asts;     // every parsed tree stays alive: function values point into them
+    int ast_count;
+    int ast_capacity;
+    int notify_fd;
+} WatchSession;
+
+static char *watch_read_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *content = memory_allocate(size + 1);
+    size_t n = fread(content, 1, size, f);
+    content[n] = '\0';
+    fclose(f);
+    return content;
+}
+
+static time_t watch_mtime(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return 0;
+    return st.st_mtime;
+}
+
+static void watch_sleep_ms(int ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    struct timespec ts;
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+/*
+ * watch_track: Start tracking a file (no-op if already tracked)
+ */
+static void watch_track(WatchSession *session, const char *path)
+{
+    for (int i = 0; i < session->file_count; i++)
+    {
+        if (strcmp(session->files[i].path, path) == 0)
+            return;
+    }
+    if (session->file_count >= session->file_capacity)
+    {
+        session->file_capacity = session->file_capacity ? session->file_capacity * 2 : 8;
+        session->files = memory_reallocate(session->files, sizeof(WatchedFile) * session->file_capacity);
+    }
+
+    WatchedFile *file = &session->files[session->file_count++];
+    file->path = memory_strdup(path);
+    const char *slash = strrchr(path, '/');
+#ifdef _WIN32
+    const char *bslash = strrchr(path, '\\');
+    if (bslash && (!slash || bslash > slash))
+        slash = bslash;
+#endif
+    file->base = memory_strdup(slash ? slash + 1 : path);
+    file->mtime = watch_mtime(path);
+    file->wd = -1;
+    file->changed = 0;
+
+#ifdef __linux__
+    if (session->notify_fd >= 0)
+    {
+        char *dir;
+        if (slash)
+        {
+            int len = (int)(slash - path);
+            dir = memory_allocate(len + 2);
+            memcpy(dir, path, len);
+            dir[len] = '\0';
+            if (len == 0)
+                strcpy(dir, "/");
+        }
+        else
+        {
+            dir = memory_strdup(".");
+        }
+        // inotify returns the existing descriptor when the directory is already watched
+        file->wd = inotify_add_watch(session->notify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        memory_free(dir);
+    }
+#endif
+}
+
+static void watch_keep_ast(WatchSession *session, ASTNode *ast)
+{
+    if (session->ast_count >= session->ast_capacity)
+    {
+        session->ast_capacity = session->ast_capacity ? session->ast_capacity * 2 : 8;
+        session->asts = memory_reallocate(session->asts, sizeof(ASTNode *) * session->ast_capacity);
+    }
+    session->asts[session->ast_count++] = ast;
+}
+
+/*
+ * watch_load: Parse one tracked file and evaluate it into the interpreter
+ *
+ * The parser is seeded with every other tracked path, so includes that are
+ * already loaded are not parsed again. Includes the file newly pulls in are
+ * parsed normally and start being tracked.
+ */
+static int watch_load(WatchSession *session, int index)
+{
+    const char *path = session->files[index].path;
+    char *source = watch_read_file(path);
+    if (!source)
+    {
+        fprintf(stderr, "[watch] could not read %s\n", path);
+        return 0;
+    }
+
+    Lexer *lexer = lexer_create(source);
+    Parser *parser = parser_create(lexer);
+    for (int i = 0; i < session->file_count; i++)
+    {
+        if (i != index)
+            parser_add_include(parser, session->files[i].path);
+    }
+    ASTNode *ast = parser_parse_parallel(parser);
+
+    // the include history now also holds whatever this file pulled in
+    for (int i = 0; i < parser->include_count; i++)
+        watch_track(session, parser->include_paths[i]);
+
+    parser_free(parser);
+    lexer_free(lexer);
+    memory_free(source);
+
+    watch_keep_ast(session, ast);
+    Value *result = interpreter_eval(session->interp, ast);
+    value_free(result);
+    return 1;
+}
+
+static void watch_run_main(WatchSession *session)
+{
+    ASTNode *main_call = ast_create_call("main", NULL, 0);
+    Value *main_result = interpreter_eval(session->interp, main_call);
+    value_free(main_result);
+    ast_free(main_call);
+    fflush(stdout);
+}
+
+/*
+ * watch_wait: Block until at least one tracked file changed
+ *
+ * Marks the changed files. Bursts of events (editors write in several steps)
+ * are collected until the files have been quiet for a short while.
+ */
+static void watch_wait(WatchSession *session)
+{
+#ifdef __linux__
+    if (session->notify_fd >= 0)
+    {
+        char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+        int any = 0;
+        while (1)
+        {
+            struct pollfd pfd;
+            pfd.fd = session->notify_fd;
+            pfd.events = POLLIN;
+            int ready = poll(&pfd, 1, any ? 100 : -1);
+            if (ready <= 0)
+            {
+                if (any)
+                    return;
+                continue;
+            }
+
+            ssize_t len = read(session->notify_fd, buf, sizeof(buf));
+            for (char *p = buf; len > 0 && p < buf + len;)
+            {
+                struct inotify_event *ev = (struct inotify_event *)p;
+                if (ev->len > 0)
+                {
+                    for (int i = 0; i < session->file_count; i++)
+                    {
+                        if (session->files[i].wd == ev->wd && strcmp(session->files[i].base, ev->name) == 0)
+                        {
+                            session->files[i].changed = 1;
+                            any = 1;
+                        }
+                    }
+                }
+                p += sizeof(struct inotify_event) + ev->len;
+            }
+        }
+    }
+#endif
+    // portable fallback: poll modification times
+    while (1)
+    {
+        int any = 0;
+        for (int i = 0; i < session->file_count; i++)
+        {
+            time_t m = watch_mtime(session->files[i].path);
+            if (m != 0 && m != session->files[i].mtime)
+            {
+                session->files[i].mtime = m;
+                session->files[i].changed = 1;
+                any = 1;
+            }
+        }
+        if (any)
+            return;
+        watch_sleep_ms(250);
+    }
+}
+
+/*
+ * watch_run: Run a script in watch mode
+ *
+ * Never returns normally; stop it with Ctrl+C.
+ */
+void watch_run(const char *filename, const char *memory_file)
+{
+    WatchSession session;
+    memset(&session, 0, sizeof(session));
+    session.notify_fd = -1;
+#ifdef __linux__
+    session.notify_fd = inotify_init1(IN_CLOEXEC);
+    if (session.notify_fd < 0)
+        fprintf(stderr, "[watch] inotify unavailable, falling back to polling\n");
+#endif
+
+    char *probe = watch_read_file(filename);
+    if (!probe)
+    {
+        fprintf(stderr, "Error: Could not open file %s\n", filename);
+        return;
+    }
+    memory_free(probe);
+    session.interp = interpreter_create();
+    if (memory_file)
+        calcmem_open(session.interp->memory, memory_file);
+    watch_track(&session, filename);
+
+    watch_load(&session, 0);
+    watch_run_main(&session);
+    fprintf(stderr, "[watch] watching %d file(s), press Ctrl+C to stop\n", session.file_count);
+
+    while (1)
+    {
+        watch_wait(&session);
+
+        // includes first, the main script last: it usually pulls them in at the top
+        session.interp->redefine = 1;
+        int tracked = session.file_count;
+        for (int i = 1; i <= tracked; i++)
+        {
+            int index = i % tracked;
+            if (!session.files[index].changed)
+                continue;
+            session.files[index].changed = 0;
+            session.files[index].mtime = watch_mtime(session.files[index].path);
+            fprintf(stderr, "[watch] reloading %s\n", session.files[index].path);
+            watch_load(&session, index);
+        }
+        session.interp->redefine = 0;
+
+        watch_run_main(&session);
+    }
+}
+
+// END OF watch.c